@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+#
+# Copyright 2023 The Hafnium Authors.
+#
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file or at
+# https://opensource.org/licenses/BSD-3-Clause.
+
+"""Decodes the binary logs written by Hafnium when built with plat_log_binary.
+
+Each logged message is written to the console as a line of hexadecimal values:
+    #DLOG <cpu> <sequence number> <format string address> <arguments...>
+where string arguments are given as their bytes, prefixed with "s". These lines
+are preceded by a line giving the runtime address of `dlog_binary_drain`:
+    #DLOG-BASE <address>
+The format strings are read from the ELF image of Hafnium. Other lines are passed through unchanged, and the
+records of each drain are printed in the order they were logged.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+BASE_SYMBOL = "dlog_binary_drain"
+
+SHT_SYMTAB = 2
+PT_LOAD = 1
+
+CONVERSION = re.compile(r"%([ 0\-+#]*)(\*|[0-9]*)([hljzt]*)([a-zA-Z%]?)")
+
+
+class Elf:
+    """Minimal reader of a little-endian ELF64 file."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 2:
+            raise Exception(f"{path} is not an ELF64 file")
+
+        (phoff, shoff) = struct.unpack_from("<QQ", self.data, 0x20)
+        (phentsize, phnum, shentsize, shnum) = struct.unpack_from(
+            "<HHHH", self.data, 0x36)
+
+        self.segments = []
+        for i in range(phnum):
+            (p_type, _, p_offset, p_vaddr, _, p_filesz) = struct.unpack_from(
+                "<IIQQQQ", self.data, phoff + i * phentsize)
+            if p_type == PT_LOAD:
+                self.segments.append((p_vaddr, p_filesz, p_offset))
+
+        self.symbols = {}
+        sections = [
+            struct.unpack_from("<IIQQQQIIQQ", self.data, shoff + i * shentsize)
+            for i in range(shnum)
+        ]
+        for section in sections:
+            if section[1] != SHT_SYMTAB:
+                continue
+            strtab = sections[section[6]]
+            for off in range(section[4], section[4] + section[5], 24):
+                (name, _, _, _, value, _) = struct.unpack_from(
+                    "<IBBHQQ", self.data, off)
+                self.symbols[self.string_at(strtab[4] + name)] = value
+
+    def string_at(self, offset):
+        end = self.data.index(b"\0", offset)
+        return self.data[offset:end].decode("utf-8", "replace")
+
+    def string_at_address(self, address):
+        """Returns the string at the given address, or None if not mapped."""
+        for (vaddr, size, offset) in self.segments:
+            if vaddr <= address < vaddr + size:
+                return self.string_at(offset + address - vaddr)
+        return None
+
+
+def format_message(fmt, args):
+    """Formats the message as Hafnium's vdlog would."""
+    args = list(args)
+
+    def next_arg():
+        return args.pop(0) if args else 0
+
+    def replace(match):
+        (flags, width, length, conversion) = match.groups()
+        bits = 64 if any(c in length for c in "ljzt") else 32
+        mask = (1 << bits) - 1
+        if width == "*":
+            value = next_arg() & 0xffffffff
+            if value & 0x80000000:
+                value -= 1 << 32
+                flags += "-"
+            width = str(abs(value))
+        spec = "%" + flags.replace("#", "") + width
+        alt = "#" in flags
+
+        if conversion in ("d", "i"):
+            value = next_arg() & mask
+            if value >> (bits - 1):
+                value -= 1 << bits
+            return (spec + "d") % value
+        if conversion == "c":
+            return (spec + "c") % chr(next_arg() & 0xff)
+        if conversion == "s":
+            string = next_arg()
+            if not isinstance(string, str):
+                string = f"<string expected, got {string:#x}>"
+            return (spec + "s") % string
+        if conversion == "p":
+            return "%016x" % next_arg()
+        if conversion in ("x", "X"):
+            return (spec + ("#" if alt else "") + conversion) % (
+                next_arg() & mask)
+        if conversion == "u":
+            return (spec + "d") % (next_arg() & mask)
+        if conversion == "o":
+            return (spec + ("#" if alt else "") + "o") % (next_arg() & mask)
+        if conversion == "%":
+            return "%"
+        return "%" + flags + width + length + conversion
+
+    return CONVERSION.sub(replace, fmt)
+
+
+def parse_value(field):
+    """Parses an argument of a record, a number or a string."""
+    if field.startswith("s"):
+        return bytes.fromhex(field[1:]).decode("utf-8", "replace")
+    return int(field, 16)
+
+
+class Decoder:
+
+    def __init__(self, elf, out):
+        self.elf = elf
+        self.out = out
+        self.base = elf.symbols.get(BASE_SYMBOL)
+        if self.base is None:
+            raise Exception(f"Symbol {BASE_SYMBOL} not found in the ELF")
+        self.delta = 0
+        self.records = []
+
+    def flush(self):
+        for (seq, cpu, fmt, args) in sorted(self.records):
+            string = self.elf.string_at_address(fmt - self.delta)
+            if string is None:
+                self.out.write(f"[cpu {cpu}] <format at {fmt:#x}>\n")
+                continue
+            self.out.write(f"[cpu {cpu}] " + format_message(string, args))
+        self.records = []
+
+    def line(self, line):
+        fields = line.split()
+        if fields and fields[0] == "#DLOG-BASE":
+            self.flush()
+            self.delta = int(fields[1], 16) - self.base
+        elif fields and fields[0] == "#DLOG":
+            values = [parse_value(f) for f in fields[1:]]
+            self.records.append(
+                (values[1], values[0], values[2], values[3:]))
+        elif fields and fields[0] == "#DLOG-DROPPED":
+            self.out.write(f"[cpu {int(fields[1], 16)}] "
+                           f"{int(fields[2], 16)} messages dropped\n")
+        else:
+            self.flush()
+            self.out.write(line)
+
+
+def Main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("elf", help="ELF image of Hafnium which was run")
+    parser.add_argument("log", nargs="?", help="Console log, stdin if absent")
+    args = parser.parse_args()
+
+    decoder = Decoder(Elf(args.elf), sys.stdout)
+    with (open(args.log, errors="replace") if args.log else sys.stdin) as log:
+        for line in log:
+            decoder.line(line)
+    decoder.flush()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(Main())
@@ -9,7 +9,8 @@
 """Generate an initial RAM disk for the hypervisor.
 
 Packages the VMs, initrds for the VMs and the list of secondary VMs (vms.txt)
-into an initial RAM disk image.
+into an initial RAM disk image. The kernels and FDTs of VMs may be compressed,
+to be decompressed by Hafnium as it loads them.
 """
 
 import argparse
@@ -18,12 +19,18 @@ import shutil
 import subprocess
 import sys
 
+import lz4_frame
+
 def Main():
     parser = argparse.ArgumentParser()
     parser.add_argument("-f", "--file",
         action="append", nargs=2,
         metavar=("NAME", "PATH"),
         help="File at host location PATH to be added to the RAM disk as NAME")
+    parser.add_argument("-z", "--compress",
+        action="append", default=[],
+        metavar="NAME",
+        help="Compress the file added as NAME, which must be a VM's kernel or FDT")
     parser.add_argument("-s", "--staging", required=True)
     parser.add_argument("-o", "--output", required=True)
     args = parser.parse_args()
@@ -35,7 +42,13 @@ def Main():
     # Copy files into the staging folder.
     staged_files = []
     for name, path in args.file:
-        shutil.copyfile(path, os.path.join(args.staging, name))
+        if name in args.compress:
+            with open(path, "rb") as f:
+                data = lz4_frame.compress(f.read())
+            with open(os.path.join(args.staging, name), "wb") as f:
+                f.write(data)
+        else:
+            shutil.copyfile(path, os.path.join(args.staging, name))
         assert name not in staged_files
         staged_files.append(name)
 
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+#
+# Copyright 2023 The Hafnium Authors.
+#
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file or at
+# https://opensource.org/licenses/BSD-3-Clause.
+
+"""Compress images in the LZ4 frame format, as Hafnium decompresses them.
+
+The frames record the size of their contents and consist of independent blocks
+of at most 1MiB, without checksums of their blocks or contents. The blocks are
+compressed greedily, which is simple rather than fast or thorough.
+"""
+
+import argparse
+import sys
+
+FRAME_MAGIC = 0x184D2204
+FLG_VERSION = 0x40
+FLG_BLOCK_INDEPENDENCE = 0x20
+FLG_CONTENT_SIZE = 0x08
+BD_MAX_SIZE_1M = 0x60
+BLOCK_SIZE = 1024 * 1024
+BLOCK_UNCOMPRESSED = 0x80000000
+
+MIN_MATCH = 4
+# The last match must start this far from the end of the block.
+MATCH_LIMIT = 12
+# The last literals must be at least this long.
+LAST_LITERALS = 5
+MAX_OFFSET = 0xFFFF
+
+XXH_PRIME32_1 = 0x9E3779B1
+XXH_PRIME32_2 = 0x85EBCA77
+XXH_PRIME32_3 = 0xC2B2AE3D
+XXH_PRIME32_4 = 0x27D4EB2F
+XXH_PRIME32_5 = 0x165667B1
+
+def _rotl32(x, r):
+    return ((x << r) | (x >> (32 - r))) & 0xFFFFFFFF
+
+def xxh32(data, seed=0):
+    """Returns the XXH32 hash of the data, used for the header checksum."""
+    mask = 0xFFFFFFFF
+    length = len(data)
+    i = 0
+    if length >= 16:
+        acc = [(seed + XXH_PRIME32_1 + XXH_PRIME32_2) & mask,
+               (seed + XXH_PRIME32_2) & mask,
+               seed,
+               (seed - XXH_PRIME32_1) & mask]
+        while i + 16 <= length:
+            for lane in range(4):
+                word = int.from_bytes(data[i:i + 4], "little")
+                acc[lane] = (acc[lane] + word * XXH_PRIME32_2) & mask
+                acc[lane] = (_rotl32(acc[lane], 13) * XXH_PRIME32_1) & mask
+                i += 4
+        h = (_rotl32(acc[0], 1) + _rotl32(acc[1], 7) +
+             _rotl32(acc[2], 12) + _rotl32(acc[3], 18)) & mask
+    else:
+        h = (seed + XXH_PRIME32_5) & mask
+    h = (h + length) & mask
+    while i + 4 <= length:
+        word = int.from_bytes(data[i:i + 4], "little")
+        h = (h + word * XXH_PRIME32_3) & mask
+        h = (_rotl32(h, 17) * XXH_PRIME32_4) & mask
+        i += 4
+    while i < length:
+        h = (h + data[i] * XXH_PRIME32_5) & mask
+        h = (_rotl32(h, 11) * XXH_PRIME32_1) & mask
+        i += 1
+    h ^= h >> 15
+    h = (h * XXH_PRIME32_2) & mask
+    h ^= h >> 13
+    h = (h * XXH_PRIME32_3) & mask
+    h ^= h >> 16
+    return h
+
+def _append_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+def _append_sequence(out, literals, offset=0, match_length=0):
+    match = match_length - MIN_MATCH if offset else 0
+    out.append((min(len(literals), 15) << 4) | min(match, 15))
+    if len(literals) >= 15:
+        _append_length(out, len(literals) - 15)
+    out += literals
+    if offset:
+        out += offset.to_bytes(2, "little")
+        if match >= 15:
+            _append_length(out, match - 15)
+
+def compress_block(block):
+    """Compresses a block greedily, with matches only within the block."""
+    out = bytearray()
+    last_seen = {}
+    anchor = 0
+    i = 0
+    match_end = len(block) - LAST_LITERALS
+    while i < len(block) - MATCH_LIMIT:
+        key = block[i:i + MIN_MATCH]
+        ref = last_seen.get(key)
+        last_seen[key] = i
+        if ref is None or i - ref > MAX_OFFSET:
+            i += 1
+            continue
+        length = MIN_MATCH
+        while (i + length < match_end and
+               block[ref + length] == block[i + length]):
+            length += 1
+        _append_sequence(out, block[anchor:i], i - ref, length)
+        i += length
+        anchor = i
+    _append_sequence(out, block[anchor:])
+    return out
+
+def compress(data):
+    """Returns the data compressed in an LZ4 frame."""
+    descriptor = bytes([FLG_VERSION | FLG_BLOCK_INDEPENDENCE | FLG_CONTENT_SIZE,
+                        BD_MAX_SIZE_1M]) + len(data).to_bytes(8, "little")
+    out = bytearray(FRAME_MAGIC.to_bytes(4, "little"))
+    out += descriptor
+    out.append((xxh32(descriptor) >> 8) & 0xFF)
+    for begin in range(0, len(data), BLOCK_SIZE):
+        block = data[begin:begin + BLOCK_SIZE]
+        compressed = compress_block(block)
+        if len(compressed) < len(block):
+            out += len(compressed).to_bytes(4, "little")
+            out += compressed
+        else:
+            out += (len(block) | BLOCK_UNCOMPRESSED).to_bytes(4, "little")
+            out += block
+    out += bytes(4)
+    return bytes(out)
+
+def Main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("input")
+    parser.add_argument("output")
+    args = parser.parse_args()
+    with open(args.input, "rb") as f:
+        data = f.read()
+    with open(args.output, "wb") as f:
+        f.write(compress(data))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(Main())
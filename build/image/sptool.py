@@ -17,6 +17,8 @@ import sys
 from shutil import copyfileobj
 import os
 
+import lz4_frame
+
 HF_PAGE_SIZE = 0x1000 # bytes
 HEADER_ELEMENT_BYTES = 4 # bytes
 MANIFEST_IMAGE_SPLITTER=':'
@@ -36,7 +38,7 @@ def to_bytes(value):
 
 class SpPkg:
     def __init__(self, pm_path : str, img_path : str, pm_offset: int,
-                 img_offset: int):
+                 img_offset: int, compress: bool = False):
         if not os.path.isfile(pm_path) or not os.path.isfile(img_path):
             raise Exception(f"Parameters should be path.  \
                               manifest: {pm_path}; img: {img_path}")
@@ -60,6 +62,13 @@ class SpPkg:
         self.pm_offset = pm_offset
         self.img_offset = img_offset
 
+        # A compressed image is decompressed in place by Hafnium, which needs
+        # the partition's memory to also hold the compressed image after it.
+        self.compressed_img = None
+        if compress:
+            with open(img_path, "rb") as img:
+                self.compressed_img = lz4_frame.compress(img.read())
+
     def __str__(self):
         return \
         f'''--SP package Info--
@@ -82,6 +91,8 @@ class SpPkg:
 
     @property
     def img_size(self):
+        if self.compressed_img is not None:
+            return len(self.compressed_img)
         return os.path.getsize(self.img_path)
 
     @property
@@ -107,6 +118,9 @@ class SpPkg:
             with open(self.pm_path, "rb") as pm:
                 copyfileobj(pm, output)
             output.seek(self.img_offset)
+            if self.compressed_img is not None:
+                output.write(self.compressed_img)
+                return
             with open(self.img_path, "rb") as img:
                 copyfileobj(img, output)
 
@@ -119,6 +133,8 @@ def Main():
     parser.add_argument("--img-offset", required=False, default=IMG_OFFSET_DEFAULT,
                         help="set partition image offset.")
     parser.add_argument("-o", required=True, help="set output file path.")
+    parser.add_argument("--compress", required=False, action="store_true",
+                        help="compress the partition image.")
     parser.add_argument("-v", required=False, action="store_true",
                         help="print package information.")
     args = parser.parse_args()
@@ -129,7 +145,8 @@ def Main():
     image_path, manifest_path = split_dtb_bin(args.i)
     pm_offset = int(args.pm_offset, 0)
     img_offset = int(args.img_offset, 0)
-    pkg = SpPkg(manifest_path, image_path, pm_offset, img_offset)
+    pkg = SpPkg(manifest_path, image_path, pm_offset, img_offset,
+                args.compress)
     pkg.generate(args.o)
 
     if args.v is True:
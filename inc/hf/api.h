@@ -21,6 +21,9 @@ void api_regs_state_saved(struct vcpu *vcpu);
 int64_t api_mailbox_writable_get(const struct vcpu *current);
 int64_t api_mailbox_waiter_get(ffa_vm_id_t vm_id, const struct vcpu *current);
 int64_t api_debug_log(char c, struct vcpu *current);
+int64_t api_console_ring_register(ipaddr_t ring_ipa, struct vcpu *current);
+int64_t api_console_ring_unregister(struct vcpu *current);
+int64_t api_console_ring_flush(struct vcpu *current);
 
 struct vcpu *api_preempt(struct vcpu *current);
 struct vcpu *api_wait_for_interrupt(struct vcpu *current);
@@ -37,6 +40,14 @@ int64_t api_interrupt_inject(ffa_vm_id_t target_vm_id,
 int64_t api_interrupt_inject_locked(struct vcpu_locked target_locked,
 				    uint32_t intid, struct vcpu *current,
 				    struct vcpu **next);
+int64_t api_timer_deadline_get(struct vcpu *current);
+int64_t api_timer_expired_get(struct vcpu *current);
+int64_t api_vm_tlb_invalidations_get(ffa_vm_id_t vm_id, bool skipped,
+				     struct vcpu *current);
+int64_t api_iommu_faults_get(ffa_vm_id_t vm_id, struct vcpu *current);
+int64_t api_cpu_exit_stat_get(uint32_t cpu_index, uint32_t stat, uint32_t key,
+			      struct vcpu *current);
+int64_t api_sri_stat_get(uint32_t stat);
 void api_sri_send_if_delayed(struct vcpu *current);
 
 struct ffa_value api_ffa_msg_send(ffa_vm_id_t sender_vm_id,
@@ -66,3 +66,40 @@ struct ffa_value arch_regs_get_args(struct arch_regs *regs);
  * Initialize and reset CPU-wide register values.
  */
 void arch_cpu_init(struct cpu *c, ipaddr_t entry_point);
+
+/**
+ * Returns the ID of the physical CPU this is called on, as used by cpu_find.
+ */
+cpu_id_t arch_cpu_current_id(void);
+
+/**
+ * Powers on the given CPU, while it isn't running any vCPU yet, to run
+ * `fn(arg)` and then power off again. This lets the boot CPU share work with
+ * the others while it initialises Hafnium.
+ *
+ * Returns false if the CPU can't be powered on by Hafnium.
+ */
+bool arch_cpu_start_helper(struct cpu *c, void (*fn)(void *arg), void *arg);
+
+/**
+ * Waits for a CPU powered on by arch_cpu_start_helper to have powered off
+ * again, once its function has returned, so that it can be powered on as usual.
+ * Returns straight away if its power state can't be queried.
+ */
+void arch_cpu_join_helper(struct cpu *c);
+
+/**
+ * Runs the function the current CPU was powered on by arch_cpu_start_helper
+ * for, then powers it off. Returns without doing anything if the CPU was
+ * powered on for any other reason.
+ */
+void arch_cpu_run_helper(struct cpu *c);
+
+/**
+ * Reads a statistic, one of `HF_EXIT_STAT_*`, of the exits from VMs to Hafnium
+ * on the CPU with the given index, for the given key.
+ *
+ * Returns false if the statistic isn't collected or the key is out of range.
+ */
+bool arch_cpu_exit_stat_get(size_t cpu_index, uint32_t stat, uint32_t key,
+			    uint64_t *value);
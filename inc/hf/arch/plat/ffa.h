@@ -51,6 +51,20 @@ enum plat_ffa_sri_state {
 	TRIGGERED,
 };
 
+/**
+ * Statistics of the SRI handling:
+ * - sent: number of SRIs sent to the receiver scheduler.
+ * - coalesced: number of SRIs deferred to be covered by a single SRI sent
+ * later, as they were requested within the coalescing window.
+ * - suppressed: number of SRIs not sent because one was already outstanding,
+ * or the scheduler was still draining the notifications info.
+ */
+struct plat_ffa_sri_stats {
+	uint64_t sent;
+	uint64_t coalesced;
+	uint64_t suppressed;
+};
+
 /** Returns information on features that are specific to the platform. */
 struct ffa_value plat_ffa_features(uint32_t function_feature_id);
 /** Returns the SPMC ID. */
@@ -231,6 +245,16 @@ void plat_ffa_sri_trigger_if_delayed(struct cpu *cpu);
  */
 void plat_ffa_sri_trigger_not_delayed(struct cpu *cpu);
 
+/**
+ * Tracks whether the receiver scheduler is draining the notifications info,
+ * i.e. FFA_NOTIFICATION_INFO_GET reported more pending info. SRIs are
+ * suppressed meanwhile, as the scheduler is bound to call it again.
+ */
+void plat_ffa_sri_set_draining(bool draining);
+
+/** Retrieves the statistics of the SRI handling. */
+void plat_ffa_sri_stats_get(struct plat_ffa_sri_stats *stats);
+
 /**
  * Initialize Schedule Receiver Interrupts needed in the context of
  * notifications support.
@@ -18,6 +18,7 @@ int memcmp(const void *a, const void *b, size_t n);
 int strncmp(const char *a, const char *b, size_t n);
 
 #define ctz(x) __builtin_ctz(x)
+#define ctz64(x) __builtin_ctzll(x)
 
 /* Compatibility with old compilers */
 #ifndef __has_builtin
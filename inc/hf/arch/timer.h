@@ -53,3 +53,9 @@ void arch_timer_disable_current(void);
  * the timer is not enabled.
  */
 uint64_t arch_timer_remaining_ns_current(void);
+
+/**
+ * Returns the current value of the system counter, converted to nanoseconds.
+ * The counter is monotonic and shared by all CPUs.
+ */
+uint64_t arch_timer_now_ns(void);
@@ -14,3 +14,10 @@
  * Set architecture-specific features for the specified VM.
  */
 void arch_vm_features_set(struct vm *vm);
+
+/**
+ * Returns the number of TLB invalidations skipped, if `skipped` is true, or
+ * issued otherwise, across all CPUs because a different vCPU of the VM than
+ * the last ran on the CPU.
+ */
+uint64_t arch_vm_tlb_invalidations_get(const struct vm *vm, bool skipped);
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "hf/boot_params.h"
+#include "hf/cpio.h"
 #include "hf/manifest.h"
 #include "hf/memiter.h"
 #include "hf/mm.h"
@@ -17,5 +18,5 @@ bool boot_flow_get_params(struct boot_params *p, const struct fdt *fdt);
 
 bool boot_flow_update(struct mm_stage1_locked stage1_locked,
 		      const struct manifest *manifest,
-		      struct boot_params_update *p, struct memiter *cpio,
+		      struct boot_params_update *p, struct cpio *cpio,
 		      struct mpool *ppool);
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** The most spans recorded, beyond which further spans are dropped. */
+#define BOOT_TIMELINE_MAX_SPANS 128
+
+/** Returned instead of a span once the timeline is full. */
+#define BOOT_TIMELINE_NONE SIZE_MAX
+
+/**
+ * A phase of the boot, from when it began to when it ended as read from the
+ * system counter, and how deeply it is nested within other phases.
+ */
+struct boot_timeline_span {
+	/** The name of the phase, which must be a string literal. */
+	const char *name;
+
+	/** The ID of what the phase is for, such as a VM, or 0. */
+	uint16_t id;
+
+	/** The number of phases the phase is nested in. */
+	uint16_t depth;
+
+	uint64_t begin_ns;
+
+	/** When the phase ended, or 0 if it hasn't yet. */
+	uint64_t end_ns;
+};
+
+size_t boot_timeline_begin(const char *name, uint16_t id);
+void boot_timeline_end(size_t span);
+const struct boot_timeline_span *boot_timeline_get(size_t *count);
+void boot_timeline_reset(void);
+void boot_timeline_dump(void);
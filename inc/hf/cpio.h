@@ -9,9 +9,59 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "hf/memiter.h"
 #include "hf/string.h"
 
-bool cpio_get_file(const struct memiter *cpio, const struct string *name,
+/** Index of an entry meaning there is no such entry. */
+#define CPIO_INDEX_NONE UINT32_MAX
+
+/** Entry of the index of an archive for one of its files. */
+struct cpio_index_entry {
+	const char *name;
+	const void *contents;
+	size_t size;
+
+	/** Hash of the name, to skip most entries without comparing names. */
+	uint32_t hash;
+
+	/** Index of the next entry in the same bucket, or CPIO_INDEX_NONE. */
+	uint32_t next;
+};
+
+/**
+ * Hash table of the files of an archive, built in a single pass over it so
+ * that they can then be found without scanning the archive again. The bucket
+ * heads follow the entries.
+ */
+struct cpio_index {
+	uint32_t count;
+	uint32_t bucket_count;
+	struct cpio_index_entry entries[];
+};
+
+/** A cpio archive, as validated by `cpio_init`. */
+struct cpio {
+	struct memiter archive;
+
+	/** The number of files in the archive. */
+	size_t file_count;
+
+	/**
+	 * Index of the files of the archive, or NULL if each lookup is to scan
+	 * the archive.
+	 */
+	const struct cpio_index *index;
+};
+
+bool cpio_init(struct cpio *cpio, const void *buf, size_t size);
+size_t cpio_index_size(const struct cpio *cpio);
+bool cpio_index_init(struct cpio *cpio, void *buf, size_t size);
+void *cpio_index_fini(struct cpio *cpio);
+
+bool cpio_get_file(const struct cpio *cpio, const struct string *name,
 		   struct memiter *it);
+bool cpio_find_overlapping(const struct cpio *cpio, const void *begin,
+			   const void *end, const void *skip,
+			   const char **name);
@@ -26,37 +26,66 @@ extern size_t dlog_buffer_offset;
 extern char dlog_buffer[];
 
 void dlog_enable_lock(void);
-void dlog(const char *fmt, ...);
-void vdlog(const char *fmt, va_list args);
+void dlog_binary_enable(size_t (*cpu_index_get)(void));
+void dlog_binary_drain(void);
+void dlog(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void vdlog(const char *fmt, va_list args)
+	__attribute__((format(printf, 1, 0)));
 
-#if LOG_LEVEL >= LOG_LEVEL_ERROR
-#define dlog_error(...) dlog("ERROR: " __VA_ARGS__)
-#else
-#define dlog_error(...)
+/*
+ * The messages of a subsystem can be limited at build time to a lower level
+ * than LOG_LEVEL by defining its DLOG_LEVEL_<subsystem>, so that its hot paths
+ * contain no logging code at all. A source file logs on behalf of a subsystem
+ * by defining DLOG_SUBSYSTEM before including any header.
+ */
+#ifndef DLOG_LEVEL_api
+#define DLOG_LEVEL_api LOG_LEVEL
 #endif
 
-#if LOG_LEVEL >= LOG_LEVEL_NOTICE
-#define dlog_notice(...) dlog("NOTICE: " __VA_ARGS__)
-#else
-#define dlog_notice(...)
+#ifndef DLOG_LEVEL_boot
+#define DLOG_LEVEL_boot LOG_LEVEL
 #endif
 
-#if LOG_LEVEL >= LOG_LEVEL_WARNING
-#define dlog_warning(...) dlog("WARNING: " __VA_ARGS__)
-#else
-#define dlog_warning(...)
+#ifndef DLOG_LEVEL_ffa_mem
+#define DLOG_LEVEL_ffa_mem LOG_LEVEL
 #endif
 
-#if LOG_LEVEL >= LOG_LEVEL_INFO
-#define dlog_info(...) dlog("INFO: " __VA_ARGS__)
-#else
-#define dlog_info(...)
+#ifndef DLOG_LEVEL_spmc
+#define DLOG_LEVEL_spmc LOG_LEVEL
 #endif
 
-#if LOG_LEVEL >= LOG_LEVEL_VERBOSE
-#define dlog_verbose(...) dlog("VERBOSE: " __VA_ARGS__)
+/**
+ * Whether messages of the subsystem at the given level, e.g. VERBOSE, are
+ * compiled in. This can be used in preprocessor conditionals.
+ */
+#define DLOG_SUBSYS(subsys, level)             \
+	(LOG_LEVEL_##level <= LOG_LEVEL &&      \
+	 LOG_LEVEL_##level <= DLOG_LEVEL_##subsys)
+
+/* Expands DLOG_SUBSYSTEM before it is pasted. */
+#define DLOG_SUBSYS_EXPAND(subsys, level) DLOG_SUBSYS(subsys, level)
+
+#ifdef DLOG_SUBSYSTEM
+#define DLOG_ENABLED(level) DLOG_SUBSYS_EXPAND(DLOG_SUBSYSTEM, level)
 #else
-#define dlog_verbose(...)
+#define DLOG_ENABLED(level) (LOG_LEVEL_##level <= LOG_LEVEL)
 #endif
 
+/*
+ * Messages below the level are still type checked against their format, but
+ * are optimised out along with their arguments.
+ */
+#define DLOG_AT(level, ...)                     \
+	do {                                    \
+		if (DLOG_ENABLED(level)) {      \
+			dlog(__VA_ARGS__);      \
+		}                               \
+	} while (0)
+
+#define dlog_error(...) DLOG_AT(ERROR, "ERROR: " __VA_ARGS__)
+#define dlog_notice(...) DLOG_AT(NOTICE, "NOTICE: " __VA_ARGS__)
+#define dlog_warning(...) DLOG_AT(WARNING, "WARNING: " __VA_ARGS__)
+#define dlog_info(...) DLOG_AT(INFO, "INFO: " __VA_ARGS__)
+#define dlog_verbose(...) DLOG_AT(VERBOSE, "VERBOSE: " __VA_ARGS__)
+
 void dlog_flush_vm_buffer(ffa_vm_id_t id, char buffer[], size_t length);
@@ -11,6 +11,8 @@
 #include "hf/memiter.h"
 #include "hf/string.h"
 
+struct fdt_index;
+
 /**
  * Wrapper around a pointer to a Flattened Device Tree (FDT) structure located
  * somewhere in mapped main memory. Sanity checks are performed on initilization
@@ -19,6 +21,12 @@
  */
 struct fdt {
 	struct memiter buf;
+
+	/**
+	 * Optional index of the nodes and properties, used instead of libfdt
+	 * to look them up if present. See `fdt_index_init`.
+	 */
+	const struct fdt_index *index;
 };
 
 /**
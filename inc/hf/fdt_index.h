@@ -0,0 +1,59 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include "hf/fdt.h"
+
+/** Index of an entry meaning there is no such entry. */
+#define FDT_INDEX_NONE UINT32_MAX
+
+/** The deepest nesting of nodes which can be indexed. */
+#define FDT_INDEX_MAX_DEPTH 16
+
+/**
+ * Entry of the index for a node or a property. Entries are in the order the
+ * nodes and properties appear in the FDT, so a node's entry is followed by
+ * those of its properties and then by those of its children.
+ */
+struct fdt_index_entry {
+	/** Offset of the node or property in the FDT, as used by libfdt. */
+	uint32_t offset;
+
+	/** Hash of the name, to skip most entries without comparing names. */
+	uint32_t hash;
+
+	/** Number of properties of a node, 0 for a property. */
+	uint16_t prop_count;
+
+	/** Number of children of a node, 0 for a property. */
+	uint16_t child_count;
+
+	/** Index of the next sibling of a node, or FDT_INDEX_NONE. */
+	uint32_t next_sibling;
+};
+
+/**
+ * Table of the nodes and properties of an FDT, built in a single pass over it
+ * so that they can then be found without scanning the FDT again.
+ */
+struct fdt_index {
+	uint32_t count;
+	uint32_t capacity;
+	struct fdt_index_entry entries[];
+};
+
+size_t fdt_index_size(const struct fdt *fdt);
+bool fdt_index_init(struct fdt *fdt, void *buf, size_t size);
+void *fdt_index_fini(struct fdt *fdt);
+
+bool fdt_index_read_property(const struct fdt_node *node, const char *name,
+			     struct memiter *data);
+bool fdt_index_first_child(struct fdt_node *node);
+bool fdt_index_next_sibling(struct fdt_node *node);
+bool fdt_index_find_child(struct fdt_node *node, const struct string *name);
@@ -8,8 +8,6 @@
 
 #pragma once
 
-#include <stdatomic.h>
-
 #include "hf/arch/types.h"
 
 #include "vmapi/hf/ffa.h"
@@ -20,6 +18,10 @@
 /* The number of bits in each element of the interrupt bitfields. */
 #define INTERRUPT_REGISTER_BITS 32
 
+/*
+ * The words are accessed atomically so that bits can be set by other CPUs, e.g.
+ * when injecting an interrupt, without holding the lock of the owning vCPU.
+ */
 struct interrupt_bitmap {
 	uint32_t bitmap[HF_NUM_INTIDS / INTERRUPT_REGISTER_BITS];
 };
@@ -30,25 +32,39 @@ static inline uint32_t interrupt_bitmap_get_value(
 	uint32_t index = intid / INTERRUPT_REGISTER_BITS;
 	uint32_t shift = intid % INTERRUPT_REGISTER_BITS;
 
-	return (bitmap->bitmap[index] >> shift) & 1U;
+	return (__atomic_load_n(&bitmap->bitmap[index], __ATOMIC_ACQUIRE) >>
+		shift) &
+	       1U;
 }
 
-static inline void interrupt_bitmap_set_value(struct interrupt_bitmap *bitmap,
-					      uint32_t intid)
+/**
+ * Sets the bit for the given interrupt ID, returning its previous value.
+ */
+static inline uint32_t interrupt_bitmap_set_value(
+	struct interrupt_bitmap *bitmap, uint32_t intid)
 {
 	uint32_t index = intid / INTERRUPT_REGISTER_BITS;
 	uint32_t shift = intid % INTERRUPT_REGISTER_BITS;
 
-	bitmap->bitmap[index] |= 1U << shift;
+	return (__atomic_fetch_or(&bitmap->bitmap[index], 1U << shift,
+				  __ATOMIC_ACQ_REL) >>
+		shift) &
+	       1U;
 }
 
-static inline void interrupt_bitmap_clear_value(struct interrupt_bitmap *bitmap,
-						uint32_t intid)
+/**
+ * Clears the bit for the given interrupt ID, returning its previous value.
+ */
+static inline uint32_t interrupt_bitmap_clear_value(
+	struct interrupt_bitmap *bitmap, uint32_t intid)
 {
 	uint32_t index = intid / INTERRUPT_REGISTER_BITS;
 	uint32_t shift = intid % INTERRUPT_REGISTER_BITS;
 
-	bitmap->bitmap[index] &= ~(1U << shift);
+	return (__atomic_fetch_and(&bitmap->bitmap[index], ~(1U << shift),
+				   __ATOMIC_ACQ_REL) >>
+		shift) &
+	       1U;
 }
 /**
  * Attributes encoding in the manifest:
@@ -19,6 +19,6 @@
 #include "hf/mpool.h"
 
 bool load_vms(struct mm_stage1_locked stage1_locked,
-	      const struct manifest *manifest, const struct memiter *cpio,
+	      const struct manifest *manifest, const struct cpio *cpio,
 	      const struct boot_params *params,
 	      struct boot_params_update *update, struct mpool *ppool);
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The size of the chunks images are copied in by the CPUs sharing a queue. */
+#define LOAD_QUEUE_CHUNK_SIZE (1024 * 1024)
+
+/** The maximum number of chunks queued before they are all copied. */
+#define LOAD_QUEUE_CAPACITY 256
+
+/** A chunk of an image to be copied to its place in memory. */
+struct load_queue_chunk {
+	void *to;
+	const void *from;
+	size_t size;
+};
+
+/**
+ * Chunks of images to be copied by any of the CPUs working on the queue, so
+ * that the images of VMs are copied and cleaned to memory in parallel while
+ * the boot CPU goes on loading.
+ *
+ * Only the boot CPU adds chunks. The counts only ever increase and are
+ * accessed atomically, so that CPUs claim chunks without taking a lock.
+ */
+struct load_queue {
+	struct load_queue_chunk chunks[LOAD_QUEUE_CAPACITY];
+
+	/** The number of chunks added, published with release semantics. */
+	uint32_t count;
+
+	/** The number of chunks claimed by a CPU to copy. */
+	uint32_t claimed;
+
+	/** The number of chunks copied. */
+	uint32_t done;
+
+	/** Whether the boot CPU has stopped adding chunks. */
+	bool closed;
+};
+
+void load_queue_init(struct load_queue *queue);
+bool load_queue_add(struct load_queue *queue, void *to, const void *from,
+		    size_t size);
+void load_queue_work(struct load_queue *queue);
+void load_queue_join(struct load_queue *queue);
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hf/memiter.h"
+
+/** The magic number an LZ4 frame starts with, in little-endian. */
+#define LZ4_FRAME_MAGIC UINT32_C(0x184d2204)
+
+/**
+ * An image compressed in the LZ4 frame format, being decompressed one block at
+ * a time. Only frames which record the size of their contents are supported,
+ * so that the memory they are decompressed into can be set aside beforehand.
+ */
+struct lz4_frame {
+	/** The blocks not decompressed yet, up to the end of the image. */
+	struct memiter blocks;
+
+	/** The size of the decompressed contents, from the frame header. */
+	size_t content_size;
+
+	/** The number of bytes decompressed so far. */
+	size_t decompressed;
+
+	/** The most bytes a block decompresses to. */
+	size_t max_block_size;
+
+	/** Whether each block is followed by a checksum. */
+	bool block_checksum;
+};
+
+enum lz4_result {
+	/** A block was decompressed. */
+	LZ4_BLOCK,
+	/** All the blocks have been decompressed. */
+	LZ4_END,
+	/** The frame is malformed or doesn't match its content size. */
+	LZ4_MALFORMED,
+};
+
+bool lz4_is_frame(const struct memiter *image);
+bool lz4_frame_init(struct lz4_frame *frame, const struct memiter *image);
+enum lz4_result lz4_frame_next(struct lz4_frame *frame, void *dest);
+bool lz4_frame_decompress(struct lz4_frame *frame, void *dest);
@@ -178,6 +178,7 @@ struct manifest_vm {
 	struct string debug_name;
 	struct string kernel_filename;
 	struct smc_whitelist smc_whitelist;
+	bool consistent_asids;
 	bool is_ffa_partition;
 	bool is_hyp_loaded;
 	struct partition_manifest partition;
@@ -8,4 +8,5 @@
 
 #pragma once
 
-__attribute__((__noreturn__)) void panic(const char *fmt, ...);
+__attribute__((__noreturn__, format(printf, 1, 2))) void panic(
+	const char *fmt, ...);
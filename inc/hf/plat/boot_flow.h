@@ -10,6 +10,7 @@
 
 #include "hf/addr.h"
 #include "hf/boot_params.h"
+#include "hf/cpio.h"
 #include "hf/fdt.h"
 #include "hf/manifest.h"
 #include "hf/memiter.h"
@@ -21,5 +22,5 @@ bool plat_boot_flow_get_initrd_range(const struct fdt *fdt, paddr_t *begin,
 				     paddr_t *end);
 bool plat_boot_flow_update(struct mm_stage1_locked stage1_locked,
 			   const struct manifest *manifest,
-			   struct boot_params_update *p, struct memiter *cpio,
+			   struct boot_params_update *p, struct cpio *cpio,
 			   struct mpool *ppool);
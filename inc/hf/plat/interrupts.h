@@ -31,3 +31,6 @@ void plat_interrupts_end_of_interrupt(uint32_t id);
 void plat_interrupts_configure_interrupt(struct interrupt_descriptor int_desc);
 void plat_interrupts_send_sgi(uint32_t id, struct cpu *cpu,
 			      bool to_this_security_state);
+void plat_interrupts_send_sgi_multicast(uint32_t id, struct cpu **cpus,
+					uint32_t cpu_count,
+					bool to_this_security_state);
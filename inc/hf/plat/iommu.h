@@ -46,6 +46,31 @@ bool plat_iommu_unmap_iommus(struct vm_locked vm_locked, struct mpool *ppool);
 void plat_iommu_identity_map(struct vm_locked vm_locked, paddr_t begin,
 			     paddr_t end, uint32_t mode);
 
+/**
+ * Completes the changes made to the IOMMU mappings of the given VM by
+ * `plat_iommu_identity_map` since the last call, for example by invalidating
+ * the IOMMU's TLB entries for all of them at once. This is called at the end of
+ * each series of page table updates, before the VM is unlocked.
+ *
+ * As with `plat_iommu_identity_map`, this is assumed not to fail.
+ */
+void plat_iommu_sync(struct vm_locked vm_locked);
+
+/**
+ * Handles the physical interrupt if it is one of the IOMMU's own, such as one
+ * signalling faults of the devices assigned to VMs. VMs are told about such
+ * faults with the HF_IOMMU_FAULT_INTID virtual interrupt, if they enabled it.
+ *
+ * Returns true if the interrupt was handled, in which case the caller ends it.
+ */
+bool plat_iommu_handle_interrupt(uint32_t intid, struct vcpu *current);
+
+/**
+ * Returns the number of faults the IOMMU has reported for the devices assigned
+ * to the given VM. This doesn't tell any VM about new faults.
+ */
+uint64_t plat_iommu_fault_count(ffa_vm_id_t vm_id);
+
 /**
  * Configure IOMMU to perform address translation of memory transactions on the
  * bus generated by each upstream peripheral device associated with a VM.
@@ -53,3 +53,7 @@ bool sp_pkg_init(struct mm_stage1_locked stage1_locked, paddr_t pkg_start,
 
 void sp_pkg_deinit(struct mm_stage1_locked stage1_locked, vaddr_t pkg_start,
 		   struct sp_pkg_header *header, struct mpool *ppool);
+
+bool sp_pkg_decompress_image(struct mm_stage1_locked stage1_locked,
+			     paddr_t pkg_start, paddr_t mem_end,
+			     struct mpool *ppool);
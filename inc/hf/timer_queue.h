@@ -0,0 +1,61 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hf/spinlock.h"
+
+/** The maximum number of deadlines queued, one for each possible vCPU. */
+#define TIMER_QUEUE_CAPACITY (MAX_VMS * MAX_CPUS)
+
+/** Deadline returned when nothing is queued. */
+#define TIMER_QUEUE_NO_DEADLINE UINT64_MAX
+
+/**
+ * A deadline which can be queued, to be embedded in the object it belongs to.
+ * A zeroed entry is not queued.
+ */
+struct timer_queue_entry {
+	/** The time the deadline expires, in nanoseconds. */
+	uint64_t deadline_ns;
+
+	/**
+	 * One more than the position in the heap, or 0 if not queued. Only
+	 * written with the queue's lock held, but may be read without it.
+	 */
+	uint32_t position;
+};
+
+/**
+ * Min-heap of deadlines, so the earliest is found in constant time and
+ * deadlines are queued, updated and removed in logarithmic time.
+ */
+struct timer_queue {
+	struct spinlock lock;
+	uint32_t count;
+	struct timer_queue_entry *heap[TIMER_QUEUE_CAPACITY];
+};
+
+void timer_queue_init(struct timer_queue *queue);
+void timer_queue_update(struct timer_queue *queue,
+			struct timer_queue_entry *entry, uint64_t deadline_ns);
+void timer_queue_remove(struct timer_queue *queue,
+			struct timer_queue_entry *entry);
+uint64_t timer_queue_next_deadline(struct timer_queue *queue);
+struct timer_queue_entry *timer_queue_pop_expired(struct timer_queue *queue,
+						  uint64_t now_ns);
+
+static inline bool timer_queue_entry_is_queued(
+	const struct timer_queue_entry *entry)
+{
+	return __atomic_load_n(&entry->position, __ATOMIC_RELAXED) != 0;
+}
@@ -13,6 +13,7 @@
 #include "hf/addr.h"
 #include "hf/interrupt_desc.h"
 #include "hf/spinlock.h"
+#include "hf/timer_queue.h"
 
 #include "vmapi/hf/ffa.h"
 
@@ -70,6 +71,38 @@ enum schedule_mode {
 	SPMC_MODE,
 };
 
+/* The number of bits in each word of the enabled and pending summary. */
+#define INTERRUPT_SUMMARY_BITS 64
+
+/* The number of words needed to summarise all the interrupt IDs. */
+#define INTERRUPT_SUMMARY_WORDS \
+	((HF_NUM_INTIDS + INTERRUPT_SUMMARY_BITS - 1) / INTERRUPT_SUMMARY_BITS)
+
+/* The number of words needed to summarise `INTERRUPT_SUMMARY_WORDS`. */
+#define INTERRUPT_SUMMARY_L1_WORDS                                \
+	((INTERRUPT_SUMMARY_WORDS + INTERRUPT_SUMMARY_BITS - 1) / \
+	 INTERRUPT_SUMMARY_BITS)
+
+/* Position of the virtual FIQ count in `enabled_and_pending_count`. */
+#define INTERRUPT_COUNT_FIQ_SHIFT 32
+
+/*
+ * Virtual interrupt priorities follow the GIC convention, where lower values
+ * mean higher priority. Interrupts not given a priority in the partition
+ * manifest get the default one.
+ */
+#define VIRT_INTERRUPT_DEFAULT_PRIORITY 0x80U
+
+/* Running priority of a vCPU which isn't handling any virtual interrupt. */
+#define VIRT_INTERRUPT_IDLE_PRIORITY 0xffU
+
+/*
+ * Interrupts are ordered by priority level, i.e. the most significant 5 bits
+ * of their priority, as by a GIC implementing 32 priority levels.
+ */
+#define VIRT_INTERRUPT_PRIORITY_LEVEL_SHIFT 3
+#define VIRT_INTERRUPT_PRIORITY_LEVELS 32
+
 struct interrupts {
 	/** Bitfield keeping track of which interrupts are enabled. */
 	struct interrupt_bitmap interrupt_enabled;
@@ -79,12 +112,40 @@ struct interrupts {
 	struct interrupt_bitmap interrupt_type;
 	/**
 	 * The number of interrupts which are currently both enabled and
-	 * pending. Count independently virtual IRQ and FIQ interrupt types
-	 * i.e. the sum of the two counters is the number of bits set in
+	 * pending. Virtual IRQ and FIQ interrupt types are counted
+	 * independently, in the low and high halves respectively, so that both
+	 * are updated and read with a single atomic operation. The sum of the
+	 * two counters is the number of bits set in
 	 * interrupt_enable & interrupt_pending.
 	 */
-	uint32_t enabled_and_pending_irq_count;
-	uint32_t enabled_and_pending_fiq_count;
+	uint64_t enabled_and_pending_count;
+	/**
+	 * Two level summary of `interrupt_enabled & interrupt_pending` for each
+	 * priority level, such that the enabled and pending interrupt of the
+	 * highest priority is found without scanning the bitmaps. For each
+	 * level, a bit in `enabled_and_pending` is set for each interrupt of
+	 * the level that is both enabled and pending, and a bit in
+	 * `enabled_and_pending_l1` for each non-zero word of the former. A bit
+	 * in `enabled_and_pending_levels` is set for each level with any.
+	 * Only to be updated through the `vcpu_virt_interrupt_*` helpers.
+	 *
+	 * Pending bits may be set by other CPUs without holding the vCPU lock,
+	 * so the bitmaps, the summary and the counters are all accessed with
+	 * atomic builtins. Everything else still requires the lock.
+	 */
+	uint64_t enabled_and_pending[VIRT_INTERRUPT_PRIORITY_LEVELS]
+				    [INTERRUPT_SUMMARY_WORDS];
+	uint64_t enabled_and_pending_l1[VIRT_INTERRUPT_PRIORITY_LEVELS]
+				       [INTERRUPT_SUMMARY_L1_WORDS];
+	uint32_t enabled_and_pending_levels;
+	/** The virtual priority of each interrupt. */
+	uint8_t priority[HF_NUM_INTIDS];
+	/**
+	 * A bit for each priority level of the interrupts the vCPU is handling.
+	 * A handler is preempted by interrupts of higher priority, so several
+	 * may be nested, and the vCPU runs at the highest of their priorities.
+	 */
+	uint32_t active_priorities;
 };
 
 struct vcpu_fault_info {
@@ -118,6 +179,13 @@ struct vcpu {
 	struct arch_regs regs;
 	struct interrupts interrupts;
 
+	/*
+	 * Deadline of the virtual timer while the vCPU is waiting for it,
+	 * queued so the hypervisor can expire it. Protected by the lock of the
+	 * timer queue rather than the vCPU lock.
+	 */
+	struct timer_queue_entry timer;
+
 	/*
 	 * Determine whether the 'regs' field is available for use. This is set
 	 * to false when a vCPU is about to run on a physical CPU, and is set
@@ -230,6 +298,24 @@ void vcpu_reset(struct vcpu *vcpu);
 
 void vcpu_set_phys_core_idx(struct vcpu *vcpu);
 
+uint32_t vcpu_virt_interrupt_first_enabled_and_pending(
+	struct interrupts *interrupts);
+uint32_t vcpu_virt_interrupt_highest_priority_pending(
+	struct interrupts *interrupts);
+bool vcpu_virt_interrupt_preempts(struct interrupts *interrupts,
+				  uint32_t intid);
+uint8_t vcpu_virt_interrupt_running_priority(struct interrupts *interrupts);
+void vcpu_virt_interrupt_activate(struct interrupts *interrupts,
+				  uint32_t intid);
+void vcpu_virt_interrupt_priority_drop(struct interrupts *interrupts);
+void vcpu_virt_interrupt_priority_drop_all(struct interrupts *interrupts);
+void vcpu_virt_interrupt_set_priority(struct interrupts *interrupts,
+				      uint32_t intid, uint8_t priority);
+uint32_t vcpu_virt_interrupt_update_summary(struct interrupts *interrupts,
+					    uint32_t intid);
+uint32_t vcpu_virt_interrupt_inject(struct interrupts *interrupts,
+				    uint32_t intid);
+
 static inline bool vcpu_is_virt_interrupt_enabled(struct interrupts *interrupts,
 						  uint32_t intid)
 {
@@ -237,35 +323,49 @@ static inline bool vcpu_is_virt_interrupt_enabled(struct interrupts *interrupts,
 					  intid) == 1U;
 }
 
+static inline bool vcpu_is_virt_interrupt_pending(struct interrupts *interrupts,
+						  uint32_t intid)
+{
+	return interrupt_bitmap_get_value(&interrupts->interrupt_pending,
+					  intid) == 1U;
+}
+
 static inline void vcpu_virt_interrupt_set_enabled(
 	struct interrupts *interrupts, uint32_t intid)
 {
 	interrupt_bitmap_set_value(&interrupts->interrupt_enabled, intid);
+	vcpu_virt_interrupt_update_summary(interrupts, intid);
 }
 
 static inline void vcpu_virt_interrupt_clear_enabled(
 	struct interrupts *interrupts, uint32_t intid)
 {
 	interrupt_bitmap_clear_value(&interrupts->interrupt_enabled, intid);
-}
-
-static inline bool vcpu_is_virt_interrupt_pending(struct interrupts *interrupts,
-						  uint32_t intid)
-{
-	return interrupt_bitmap_get_value(&interrupts->interrupt_pending,
-					  intid) == 1U;
+	vcpu_virt_interrupt_update_summary(interrupts, intid);
 }
 
 static inline void vcpu_virt_interrupt_set_pending(
 	struct interrupts *interrupts, uint32_t intid)
 {
 	interrupt_bitmap_set_value(&interrupts->interrupt_pending, intid);
+	vcpu_virt_interrupt_update_summary(interrupts, intid);
 }
 
 static inline void vcpu_virt_interrupt_clear_pending(
 	struct interrupts *interrupts, uint32_t intid)
 {
 	interrupt_bitmap_clear_value(&interrupts->interrupt_pending, intid);
+	vcpu_virt_interrupt_update_summary(interrupts, intid);
+}
+
+/*
+ * The priority is read by other CPUs injecting the interrupt, and only written
+ * with the vCPU lock held.
+ */
+static inline uint8_t vcpu_virt_interrupt_get_priority(
+	struct interrupts *interrupts, uint32_t intid)
+{
+	return __atomic_load_n(&interrupts->priority[intid], __ATOMIC_RELAXED);
 }
 
 static inline enum interrupt_type vcpu_virt_interrupt_get_type(
@@ -287,66 +387,30 @@ static inline void vcpu_virt_interrupt_set_type(struct interrupts *interrupts,
 	}
 }
 
-static inline void vcpu_irq_count_increment(struct vcpu_locked vcpu_locked)
-{
-	vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count++;
-}
-
-static inline void vcpu_irq_count_decrement(struct vcpu_locked vcpu_locked)
-{
-	vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count--;
-}
-
-static inline void vcpu_fiq_count_increment(struct vcpu_locked vcpu_locked)
-{
-	vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count++;
-}
-
-static inline void vcpu_fiq_count_decrement(struct vcpu_locked vcpu_locked)
-{
-	vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count--;
-}
-
-static inline void vcpu_interrupt_count_increment(
-	struct vcpu_locked vcpu_locked, struct interrupts *interrupts,
-	uint32_t intid)
-{
-	if (vcpu_virt_interrupt_get_type(interrupts, intid) ==
-	    INTERRUPT_TYPE_IRQ) {
-		vcpu_irq_count_increment(vcpu_locked);
-	} else {
-		vcpu_fiq_count_increment(vcpu_locked);
-	}
-}
-
-static inline void vcpu_interrupt_count_decrement(
-	struct vcpu_locked vcpu_locked, struct interrupts *interrupts,
-	uint32_t intid)
-{
-	if (vcpu_virt_interrupt_get_type(interrupts, intid) ==
-	    INTERRUPT_TYPE_IRQ) {
-		vcpu_irq_count_decrement(vcpu_locked);
-	} else {
-		vcpu_fiq_count_decrement(vcpu_locked);
-	}
-}
-
 static inline uint32_t vcpu_interrupt_irq_count_get(
 	struct vcpu_locked vcpu_locked)
 {
-	return vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count;
+	return (uint32_t)__atomic_load_n(
+		&vcpu_locked.vcpu->interrupts.enabled_and_pending_count,
+		__ATOMIC_ACQUIRE);
 }
 
 static inline uint32_t vcpu_interrupt_fiq_count_get(
 	struct vcpu_locked vcpu_locked)
 {
-	return vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count;
+	return (uint32_t)(__atomic_load_n(&vcpu_locked.vcpu->interrupts
+						   .enabled_and_pending_count,
+					  __ATOMIC_ACQUIRE) >>
+			  INTERRUPT_COUNT_FIQ_SHIFT);
 }
 
 static inline uint32_t vcpu_interrupt_count_get(struct vcpu_locked vcpu_locked)
 {
-	return vcpu_locked.vcpu->interrupts.enabled_and_pending_irq_count +
-	       vcpu_locked.vcpu->interrupts.enabled_and_pending_fiq_count;
+	uint64_t count = __atomic_load_n(
+		&vcpu_locked.vcpu->interrupts.enabled_and_pending_count,
+		__ATOMIC_ACQUIRE);
+
+	return (uint32_t)count + (uint32_t)(count >> INTERRUPT_COUNT_FIQ_SHIFT);
 }
 
 static inline void vcpu_call_chain_extend(struct vcpu *vcpu1,
@@ -198,6 +198,15 @@ struct vm {
 	char log_buffer[LOG_BUFFER_SIZE];
 	uint16_t log_buffer_length;
 
+	/**
+	 * The console ring shared with the VM, mapped in the hypervisor's
+	 * address space, or NULL if the VM hasn't registered one.
+	 */
+	struct hf_console_ring *console_ring;
+
+	/* The mode of the console ring in the VM before it was registered. */
+	uint32_t console_ring_mode;
+
 	/**
 	 * Wait entries to be used when waiting on other VM mailboxes. See
 	 * comments on `struct wait_entry` for the lock discipline of these.
@@ -238,6 +247,13 @@ struct vm {
 	struct arch_vm arch;
 	bool el0_partition;
 
+	/**
+	 * Whether the VM uses ASIDs consistently across its vCPUs, as the
+	 * architecture requires, so that the TLB entries of one of its vCPUs
+	 * remain valid for another on the same CPU.
+	 */
+	bool consistent_asids;
+
 	/** Interrupt descriptor */
 	struct interrupt_descriptor interrupt_desc[VM_MANIFEST_MAX_INTERRUPTS];
 };
@@ -21,6 +21,15 @@
 #define HF_INTERRUPT_GET               0xff04
 #define HF_INTERRUPT_INJECT            0xff05
 #define HF_INTERRUPT_DEACTIVATE	       0xff08
+#define HF_TIMER_DEADLINE_GET          0xff09
+#define HF_TIMER_EXPIRED_GET           0xff0a
+#define HF_CONSOLE_RING_REGISTER       0xff0b
+#define HF_CONSOLE_RING_FLUSH          0xff0c
+#define HF_VM_TLB_INVALIDATIONS_GET    0xff0d
+#define HF_IOMMU_FAULTS_GET            0xff0e
+#define HF_CPU_EXIT_STAT_GET           0xff0f
+#define HF_SRI_STAT_GET                0xff10
+#define HF_CONSOLE_RING_UNREGISTER     0xff11
 
 /* Custom FF-A-like calls returned from FFA_RUN. */
 #define HF_FFA_RUN_WAIT_FOR_INTERRUPT 0xff06
@@ -384,6 +384,125 @@ static inline int64_t hf_interrupt_inject(ffa_vm_id_t target_vm_id,
 		       intid);
 }
 
+/**
+ * Gets the time until the earliest virtual timer deadline of the secondary
+ * vCPUs, so the primary VM only needs a single timer for all of them.
+ *
+ * Returns:
+ *  - -1 if no vCPU is waiting for its timer, or the caller is not the primary
+ *    VM.
+ *  - 0 if a deadline has already passed.
+ *  - The number of nanoseconds until the earliest deadline otherwise.
+ */
+static inline int64_t hf_timer_deadline_get(void)
+{
+	return hf_call(HF_TIMER_DEADLINE_GET, 0, 0, 0);
+}
+
+/**
+ * Expires the earliest virtual timer deadline if it has passed, injecting the
+ * virtual timer interrupt into its vCPU.
+ *
+ * Returns the VM and vCPU whose deadline expired, in the same encoding as the
+ * first argument of FFA_RUN, for the primary VM to run, or -1 if none has
+ * expired. It is to be called until it returns -1.
+ */
+static inline int64_t hf_timer_expired_get(void)
+{
+	return hf_call(HF_TIMER_EXPIRED_GET, 0, 0, 0);
+}
+
+/**
+ * Registers the page at the given address as the VM's console ring, a
+ * `struct hf_console_ring` which the VM writes lines into with
+ * `hf_console_ring_write` rather than calling `hf_debug_log` for each
+ * character. The page is shared with Hafnium from then on.
+ *
+ * Returns 0 on success, or -1 if the address isn't a page owned exclusively by
+ * the VM or a console ring is already registered.
+ */
+static inline int64_t hf_console_ring_register(hf_ipaddr_t ring)
+{
+	return hf_call(HF_CONSOLE_RING_REGISTER, ring, 0, 0);
+}
+
+/**
+ * Prints what is left in the VM's console ring and stops sharing its page with
+ * Hafnium, which gives it back to the VM with the access it had before. Hafnium
+ * also does so when the VM aborts.
+ *
+ * Returns 0 on success, or -1 if the VM has no console ring.
+ */
+static inline int64_t hf_console_ring_unregister(void)
+{
+	return hf_call(HF_CONSOLE_RING_UNREGISTER, 0, 0, 0);
+}
+
+/**
+ * Prints the lines written to the VM's console ring so far and makes their
+ * space available again. Hafnium also does so whenever the VM aborts or logs
+ * through one of the other calls, so this is only needed once the ring is
+ * full or the output is wanted straight away.
+ *
+ * Returns 0 on success, or -1 if the VM has no console ring.
+ */
+static inline int64_t hf_console_ring_flush(void)
+{
+	return hf_call(HF_CONSOLE_RING_FLUSH, 0, 0, 0);
+}
+
+/**
+ * Returns the number of TLB invalidations Hafnium skipped, if `skipped` is
+ * true, or issued otherwise, because a different vCPU of the given VM than the
+ * last ran on a CPU. Invalidations are only skipped for VMs declaring
+ * `consistent_asids` in their manifest.
+ *
+ * Returns -1 if the VM doesn't exist or the caller is not the primary VM.
+ */
+static inline int64_t hf_vm_tlb_invalidations_get(ffa_vm_id_t vm_id,
+						  bool skipped)
+{
+	return hf_call(HF_VM_TLB_INVALIDATIONS_GET, vm_id, skipped, 0);
+}
+
+/**
+ * Returns the number of faults the IOMMU has reported for the devices assigned
+ * to the given VM.
+ *
+ * Returns -1 if the VM doesn't exist or the caller is not the primary VM.
+ */
+static inline int64_t hf_iommu_faults_get(ffa_vm_id_t vm_id)
+{
+	return hf_call(HF_IOMMU_FAULTS_GET, vm_id, 0, 0);
+}
+
+/**
+ * Returns a statistic, one of `HF_EXIT_STAT_*`, of the exits from VMs to
+ * Hafnium on the CPU with the given index. `key` selects the exception class
+ * for `HF_EXIT_STAT_SYNC`, and the function ID for the statistics of calls.
+ * Only FF-A and Hafnium function IDs are counted on their own, and the calls of
+ * all others under `HF_EXIT_STAT_CALL_OTHER`.
+ *
+ * Returns -1 if the CPU or statistic doesn't exist, the function ID isn't
+ * counted on its own, or the caller is not the primary VM.
+ */
+static inline int64_t hf_cpu_exit_stat_get(uint32_t cpu_index, uint32_t stat,
+					   uint32_t key)
+{
+	return hf_call(HF_CPU_EXIT_STAT_GET, cpu_index, stat, key);
+}
+
+/**
+ * Returns a statistic, one of `HF_SRI_STAT_*`, of the Schedule Receiver
+ * Interrupts sent by the SPMC. These are all zero without an SPMC.
+ *
+ * Returns -1 if the statistic doesn't exist.
+ */
+static inline int64_t hf_sri_stat_get(uint32_t stat)
+{
+	return hf_call(HF_SRI_STAT_GET, stat, 0, 0);
+}
+
 /**
  * Sends a character to the debug log for the VM.
  *
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include "hf/types.h"
+
+/** The size of the console ring shared between a VM and Hafnium. */
+#define HF_CONSOLE_RING_SIZE 4096
+
+/** The size of the character data, the rest of the page after its offsets. */
+#define HF_CONSOLE_RING_DATA_SIZE (HF_CONSOLE_RING_SIZE - 8)
+
+/**
+ * A single page of a VM's memory, registered with HF_CONSOLE_RING_REGISTER,
+ * through which the VM writes to the console without a call per character.
+ *
+ * The VM writes characters at `head` and Hafnium reads them from `tail`, both
+ * offsets in `data` which wrap around at its end. The ring is empty when they
+ * are equal, so it holds at most one character less than `data`. Only the VM
+ * writes `head` and only Hafnium writes `tail`.
+ */
+struct hf_console_ring {
+	uint32_t head;
+	uint32_t tail;
+	char data[HF_CONSOLE_RING_DATA_SIZE];
+};
+
+/**
+ * Writes the characters to the console ring, if there is room for all of
+ * them. The VM is expected to write whole lines, ending in '\n', which
+ * Hafnium prints when the ring is next drained.
+ *
+ * Returns true on success, or false if there wasn't enough room, in which case
+ * the ring should be flushed with `hf_console_ring_flush` and the write
+ * retried.
+ */
+static inline bool hf_console_ring_write(struct hf_console_ring *ring,
+					 const char *str, uint32_t size)
+{
+	uint32_t head = ring->head;
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	uint32_t used = (head + HF_CONSOLE_RING_DATA_SIZE - tail) %
+			HF_CONSOLE_RING_DATA_SIZE;
+	uint32_t i;
+
+	if (size >= HF_CONSOLE_RING_DATA_SIZE - used) {
+		return false;
+	}
+
+	for (i = 0; i < size; i++) {
+		ring->data[head] = str[i];
+		head = (head + 1) % HF_CONSOLE_RING_DATA_SIZE;
+	}
+
+	/* Publish the characters only once they have all been written. */
+	__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+	return true;
+}
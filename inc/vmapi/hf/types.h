@@ -61,5 +61,47 @@ typedef uintptr_t hf_ipaddr_t;
 /** The virtual interrupt ID used for notification pending interrupt. */
 #define HF_NOTIFICATION_PENDING_INTID 5
 
+/**
+ * The virtual interrupt ID used to tell a partition that the IOMMU reported
+ * faults for the devices assigned to it.
+ */
+#define HF_IOMMU_FAULT_INTID 6
+
 /** The physical interrupt ID use for the schedule receiver interrupt. */
 #define HF_SCHEDULE_RECEIVER_INTID 8
+
+/**
+ * Statistics of the exits from VMs to Hafnium on a CPU, read with
+ * hf_cpu_exit_stat_get:
+ * - SYNC: synchronous exceptions of the exception class given as the key.
+ * - IRQ and FIQ: interrupts taken while running a VM.
+ * - CALL_COUNT: HVC, SVC and SMC calls of the function ID given as the key.
+ *   Only FF-A and Hafnium function IDs are counted on their own, and calls of
+ *   all others are counted together under the key CALL_OTHER.
+ * - CALL_TICKS: system counter ticks, not CPU cycles, spent handling those
+ *   calls. The cycle counter doesn't count at EL2 as Hafnium sets
+ *   MDCR_EL2.HCCD.
+ * - CALL_BUCKET(n): those calls that took at least 2^(n-1) ticks and fewer
+ *   than 2^n, with bucket 0 counting the calls taking no ticks and the last
+ *   bucket all the calls longer than the one before it.
+ */
+#define HF_EXIT_STAT_SYNC 0
+#define HF_EXIT_STAT_IRQ 1
+#define HF_EXIT_STAT_FIQ 2
+#define HF_EXIT_STAT_CALL_COUNT 3
+#define HF_EXIT_STAT_CALL_TICKS 4
+#define HF_EXIT_STAT_CALL_BUCKET(n) (0x10 + (n))
+#define HF_EXIT_STAT_CALL_BUCKETS 16
+#define HF_EXIT_STAT_CALL_OTHER 0xffffffff
+
+/**
+ * Statistics of the Schedule Receiver Interrupts sent by the SPMC, read with
+ * hf_sri_stat_get:
+ * - SENT: SRIs sent to the receiver scheduler.
+ * - COALESCED: SRIs deferred to be covered by a single SRI sent later.
+ * - SUPPRESSED: SRIs not sent as one was outstanding, or the scheduler was
+ *   still retrieving the notifications info.
+ */
+#define HF_SRI_STAT_SENT 0
+#define HF_SRI_STAT_COALESCED 1
+#define HF_SRI_STAT_SUPPRESSED 2
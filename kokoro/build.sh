@@ -49,6 +49,7 @@ then
 	default_value HAFNIUM_RUN_ALL_QEMU_CPUS true
 	default_value USE_TFA true
 	default_value HAFNIUM_RUN_ASSERT_DISABLED_BUILD true
+	default_value HAFNIUM_RUN_LAZY_SWITCHING_BUILD true
 elif is_jenkins_build
 then
 	# Default config for Jenkins builds.
@@ -57,6 +58,7 @@ then
 	default_value HAFNIUM_RUN_ALL_QEMU_CPUS true
 	default_value USE_TFA true
 	default_value HAFNIUM_RUN_ASSERT_DISABLED_BUILD true
+	default_value HAFNIUM_RUN_LAZY_SWITCHING_BUILD true
 else
 	# Default config for local builds.
 	default_value HAFNIUM_HERMETIC_BUILD false
@@ -64,6 +66,7 @@ else
 	default_value HAFNIUM_RUN_ALL_QEMU_CPUS false
 	default_value USE_TFA false
 	default_value HAFNIUM_RUN_ASSERT_DISABLED_BUILD false
+	default_value HAFNIUM_RUN_LAZY_SWITCHING_BUILD false
 fi
 
 # If HAFNIUM_HERMETIC_BUILD is "true", relaunch this script inside a container.
@@ -91,6 +94,9 @@ do
 	--run-assert-disabled-build)
 		HAFNIUM_RUN_ASSERT_DISABLED_BUILD=true
 		;;
+	--run-lazy-switching-build)
+		HAFNIUM_RUN_LAZY_SWITCHING_BUILD=true
+		;;
 	*)
 		echo "Unexpected argument $1"
 		exit 1
@@ -125,6 +131,33 @@ then
 	rm out/reference/build.ninja out/reference/args.gn
 fi
 
+#
+# Build and run tests with lazy floating point and system register switching
+# if required.
+#
+if [ "$HAFNIUM_RUN_LAZY_SWITCHING_BUILD" == "true" ]
+then
+	#
+	# Call 'make clean' and remove args.gn file to ensure the value of
+	# enable_lazy_fp and enable_lazy_regs are updated from the default.
+	#
+	if [ -d "out/reference" ]; then
+		make clean
+		rm -f out/reference/build.ninja out/reference/args.gn
+	fi
+
+	make PROJECT=reference ENABLE_LAZY_FP=1 ENABLE_LAZY_REGS=1
+
+	run_tests
+
+	#
+	# Call 'make clean' and remove args.gn file so future runs of make
+	# use the default switching.
+	#
+	make clean
+	rm out/reference/build.ninja out/reference/args.gn
+fi
+
 #
 # Build and run with asserts enabled.
 #
@@ -6,6 +6,9 @@
  * https://opensource.org/licenses/BSD-3-Clause.
  */
 
+/* Logs of this file are limited by DLOG_LEVEL_api. */
+#define DLOG_SUBSYSTEM api
+
 #include "hf/api.h"
 
 #include "hf/arch/cpu.h"
@@ -23,12 +26,15 @@
 #include "hf/mm.h"
 #include "hf/plat/console.h"
 #include "hf/plat/interrupts.h"
+#include "hf/plat/iommu.h"
 #include "hf/spinlock.h"
 #include "hf/static_assert.h"
 #include "hf/std.h"
+#include "hf/timer_queue.h"
 #include "hf/vm.h"
 
 #include "vmapi/hf/call.h"
+#include "vmapi/hf/console_ring.h"
 #include "vmapi/hf/ffa.h"
 
 static_assert(sizeof(struct ffa_partition_info_v1_0) == 8,
@@ -37,6 +43,9 @@ static_assert(sizeof(struct ffa_partition_info_v1_0) == 8,
 static_assert(sizeof(struct ffa_partition_info) == 24,
 	      "Partition information descriptor size doesn't match the one in "
 	      "the FF-A 1.1 BETA0 EAC specification, Table 13.34.");
+static_assert(sizeof(struct hf_console_ring) == HF_CONSOLE_RING_SIZE &&
+		      HF_CONSOLE_RING_SIZE == PAGE_SIZE,
+	      "The console ring must fill a single page.");
 
 /*
  * To eliminate the risk of deadlocks, we define a partial order for the
@@ -60,6 +69,12 @@ static_assert(MM_PPOOL_ENTRY_SIZE >= HF_MAILBOX_SIZE,
 
 static struct mpool api_page_pool;
 
+/*
+ * Virtual timer deadlines of the vCPUs which are waiting for their timer, so
+ * they can be expired by the hypervisor.
+ */
+static struct timer_queue api_timer_queue;
+
 /**
  * Initialises the API page pool by taking ownership of the contents of the
  * given page pool.
@@ -67,6 +82,23 @@ static struct mpool api_page_pool;
 void api_init(struct mpool *ppool)
 {
 	mpool_init_from(&api_page_pool, ppool);
+	timer_queue_init(&api_timer_queue);
+}
+
+/**
+ * Queues the deadline of the virtual timer of the given vCPU, which expires in
+ * the given number of nanoseconds, or removes it if the vCPU is to sleep
+ * indefinitely.
+ */
+static void api_timer_queue_update(struct vcpu *vcpu, uint64_t remaining_ns)
+{
+	if (remaining_ns == FFA_SLEEP_INDEFINITE) {
+		timer_queue_remove(&api_timer_queue, &vcpu->timer);
+		return;
+	}
+
+	timer_queue_update(&api_timer_queue, &vcpu->timer,
+			   arch_timer_now_ns() + remaining_ns);
 }
 
 /**
@@ -111,6 +143,12 @@ static struct vcpu *api_switch_to_vm(struct vcpu *current,
 
 	CHECK(next != NULL);
 
+	/*
+	 * Control returns to the scheduler, in the primary VM or the other
+	 * world, so write out the messages logged in binary form meanwhile.
+	 */
+	dlog_binary_drain();
+
 	/* Set the return value for the target VM. */
 	arch_regs_set_retval(&next->regs, to_ret);
 
@@ -157,6 +195,7 @@ static struct vcpu *api_switch_to_primary(struct vcpu *current,
 		} else {
 			primary_ret.arg2 = FFA_SLEEP_INDEFINITE;
 		}
+		api_timer_queue_update(current, primary_ret.arg2);
 		break;
 	}
 
@@ -237,6 +276,12 @@ struct vcpu *api_wait_for_interrupt(struct vcpu *current)
 		.func = HF_FFA_RUN_WAIT_FOR_INTERRUPT,
 		.arg1 = ffa_vm_vcpu(current->vm->id, vcpu_index(current)),
 	};
+	struct vcpu_locked current_locked;
+
+	/* The vCPU is done handling interrupts if it waits for more. */
+	current_locked = vcpu_lock(current);
+	vcpu_virt_interrupt_priority_drop_all(&current->interrupts);
+	vcpu_unlock(&current_locked);
 
 	return api_switch_to_primary(current, ret,
 				     VCPU_STATE_BLOCKED_INTERRUPT);
@@ -314,12 +359,116 @@ struct vcpu *api_wake_up(struct vcpu *current, struct vcpu *target_vcpu)
 	return api_switch_to_primary(current, ret, VCPU_STATE_BLOCKED);
 }
 
+/**
+ * Appends the character to the VM's log buffer, printing the buffer if the
+ * character ends a line or the buffer is full.
+ */
+static void api_log_char_locked(struct vm_locked vm_locked, char c)
+{
+	struct vm *vm = vm_locked.vm;
+	bool flush;
+
+	if (c == '\n' || c == '\0') {
+		flush = true;
+	} else {
+		vm->log_buffer[vm->log_buffer_length++] = c;
+		flush = (vm->log_buffer_length == LOG_BUFFER_SIZE);
+	}
+
+	if (flush) {
+		dlog_flush_vm_buffer(vm->id, vm->log_buffer,
+				     vm->log_buffer_length);
+		vm->log_buffer_length = 0;
+	}
+}
+
+/**
+ * Prints the characters written to the VM's console ring since it was last
+ * drained, if it has one, and makes their space available to the VM again.
+ * Only complete lines are printed, the rest is kept in the VM's log buffer
+ * until the line is completed.
+ */
+static void api_console_ring_drain_locked(struct vm_locked vm_locked)
+{
+	struct hf_console_ring *ring = vm_locked.vm->console_ring;
+	uint32_t head;
+	uint32_t tail;
+
+	if (ring == NULL) {
+		return;
+	}
+
+	/* Pairs with the release of the head by the VM. */
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	tail = ring->tail;
+	if (head == tail) {
+		return;
+	}
+
+	/* The ring is in the VM's memory so it can't be trusted. */
+	if (head >= HF_CONSOLE_RING_DATA_SIZE ||
+	    tail >= HF_CONSOLE_RING_DATA_SIZE) {
+		dlog_verbose("Discarding corrupt console ring of VM %#x.\n",
+			     vm_locked.vm->id);
+		tail = head;
+	}
+
+	while (tail != head) {
+		api_log_char_locked(vm_locked, ring->data[tail]);
+		tail = (tail + 1) % HF_CONSOLE_RING_DATA_SIZE;
+	}
+
+	/* Only hand the space back once the characters have been read. */
+	__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * Prints what is left in the VM's console ring, if it has one, then unmaps it
+ * from the hypervisor and gives the page back to the VM with the access it had
+ * before registering it.
+ *
+ * Returns false if the VM has no console ring.
+ */
+static bool api_console_ring_unregister_locked(struct vm_locked vm_locked)
+{
+	struct vm *vm = vm_locked.vm;
+	struct mm_stage1_locked mm_stage1_locked;
+	paddr_t pa_begin;
+	paddr_t pa_end;
+
+	if (vm->console_ring == NULL) {
+		return false;
+	}
+
+	api_console_ring_drain_locked(vm_locked);
+
+	pa_begin = pa_from_va(va_from_ptr(vm->console_ring));
+	pa_end = pa_add(pa_begin, HF_CONSOLE_RING_SIZE);
+
+	mm_stage1_locked = mm_lock_stage1();
+
+	/*
+	 * The page was mapped in this mode before it was registered, so it can
+	 * safely be remapped.
+	 */
+	CHECK(vm_identity_map(vm_locked, pa_begin, pa_end,
+			      vm->console_ring_mode, &api_page_pool, NULL));
+	CHECK(mm_unmap(mm_stage1_locked, pa_begin, pa_end, &api_page_pool));
+
+	mm_unlock_stage1(&mm_stage1_locked);
+
+	vm->console_ring = NULL;
+
+	return true;
+}
+
 /**
  * Aborts the vCPU and triggers its VM to abort fully.
  */
 struct vcpu *api_abort(struct vcpu *current)
 {
 	struct ffa_value ret = ffa_error(FFA_ABORTED);
+	struct vm_locked vm_locked;
 
 	dlog_notice("Aborting VM %#x vCPU %u\n", current->vm->id,
 		    vcpu_index(current));
@@ -334,6 +483,14 @@ struct vcpu *api_abort(struct vcpu *current)
 	atomic_store_explicit(&current->vm->aborting, true,
 			      memory_order_relaxed);
 
+	/*
+	 * Don't lose the last lines the VM wrote before aborting, and stop
+	 * reading the ring as the VM can no longer be expected to maintain it.
+	 */
+	vm_locked = vm_lock(current->vm);
+	api_console_ring_unregister_locked(vm_locked);
+	vm_unlock(&vm_locked);
+
 	/* TODO: free resources once all vCPUs abort. */
 
 	return api_switch_to_primary(current, ret, VCPU_STATE_ABORTED);
@@ -588,38 +745,47 @@ static struct wait_entry *api_fetch_waiter(struct vm_locked locked_vm)
  * cause the vCPU to actually be run immediately; it will be taken when the vCPU
  * is next run, which is up to the scheduler.
  *
+ * The pending bit and the counters are updated atomically, so the target vCPU
+ * doesn't need to be locked. It can't miss the interrupt when going to sleep,
+ * as it checks the count with its lock held, and it is woken up by the primary
+ * VM when the count goes from 0 to 1.
+ *
  * Returns:
  *  - 0 on success if no further action is needed.
  *  - 1 if it was called by the primary VM and the primary VM now needs to wake
  *    up or kick the target vCPU.
  */
-int64_t api_interrupt_inject_locked(struct vcpu_locked target_locked,
-				    uint32_t intid, struct vcpu *current,
-				    struct vcpu **next)
+static int64_t internal_interrupt_inject(struct vcpu *target_vcpu,
+					 uint32_t intid, struct vcpu *current,
+					 struct vcpu **next)
 {
-	struct vcpu *target_vcpu = target_locked.vcpu;
 	struct interrupts *interrupts = &target_vcpu->interrupts;
-	int64_t ret = 0;
+	bool preempts;
+	uint32_t count;
+
+	/*
+	 * Whether it preempts must be known before it is made pending. The
+	 * running priority is only a hint when the target vCPU isn't locked,
+	 * at worst it causes a spurious kick.
+	 */
+	preempts = vcpu_virt_interrupt_preempts(interrupts, intid);
+	count = vcpu_virt_interrupt_inject(interrupts, intid);
 
 	/*
 	 * We only need to change state and (maybe) trigger a virtual interrupt
-	 * if it is enabled and was not previously pending. Otherwise we can
-	 * skip everything except setting the pending bit.
+	 * if it is enabled and was not previously pending.
 	 */
-	if (!(vcpu_is_virt_interrupt_enabled(interrupts, intid) &&
-	      !vcpu_is_virt_interrupt_pending(interrupts, intid))) {
-		goto out;
+	if (count == 0) {
+		return 0;
 	}
 
-	/* Increment the count. */
-	vcpu_interrupt_count_increment(target_locked, interrupts, intid);
-
 	/*
 	 * Only need to update state if there was not already an
-	 * interrupt enabled and pending.
+	 * interrupt enabled and pending, or if this one has higher priority
+	 * than everything the target vCPU is handling or has pending.
 	 */
-	if (vcpu_interrupt_count_get(target_locked) != 1) {
-		goto out;
+	if (count != 1 && !preempts) {
+		return 0;
 	}
 
 	if (current->vm->id == HF_PRIMARY_VM_ID) {
@@ -627,31 +793,26 @@ int64_t api_interrupt_inject_locked(struct vcpu_locked target_locked,
 		 * If the call came from the primary VM, let it know that it
 		 * should run or kick the target vCPU.
 		 */
-		ret = 1;
-	} else if (current != target_vcpu && next != NULL) {
-		*next = api_wake_up(current, target_vcpu);
+		return 1;
 	}
 
-out:
-	/* Either way, make it pending. */
-	vcpu_virt_interrupt_set_pending(interrupts, intid);
+	if (current != target_vcpu && next != NULL) {
+		*next = api_wake_up(current, target_vcpu);
+	}
 
-	return ret;
+	return 0;
 }
 
-/* Wrapper to internal_interrupt_inject with locking of target vCPU */
-static int64_t internal_interrupt_inject(struct vcpu *target_vcpu,
-					 uint32_t intid, struct vcpu *current,
-					 struct vcpu **next)
+/**
+ * As internal_interrupt_inject, for callers which already hold the lock of the
+ * target vCPU.
+ */
+int64_t api_interrupt_inject_locked(struct vcpu_locked target_locked,
+				    uint32_t intid, struct vcpu *current,
+				    struct vcpu **next)
 {
-	int64_t ret;
-	struct vcpu_locked target_locked;
-
-	target_locked = vcpu_lock(target_vcpu);
-	ret = api_interrupt_inject_locked(target_locked, intid, current, next);
-	vcpu_unlock(&target_locked);
-
-	return ret;
+	return internal_interrupt_inject(target_locked.vcpu, intid, current,
+					 next);
 }
 
 /**
@@ -743,7 +904,7 @@ static bool api_vcpu_prepare_run(struct vcpu *current, struct vcpu *vcpu,
 	bool is_vcpu_reset_and_start = vcpu_secondary_reset_and_start(
 		vcpu_locked, vcpu->vm->secondary_ep, 0);
 	if (is_vcpu_reset_and_start) {
-		dlog_verbose("%s secondary cold boot vmid %#x vcpu id %#x\n",
+		dlog_verbose("%s secondary cold boot vmid %#x vcpu id %#lx\n",
 			     __func__, vcpu->vm->id, current->cpu->id);
 	}
 
@@ -862,6 +1023,7 @@ static bool api_vcpu_prepare_run(struct vcpu *current, struct vcpu *vcpu,
 		run_ret->func = FFA_MSG_WAIT_32;
 		run_ret->arg1 = ffa_vm_vcpu(vcpu->vm->id, vcpu_index(vcpu));
 		run_ret->arg2 = timer_remaining_ns;
+		api_timer_queue_update(vcpu, timer_remaining_ns);
 		ret = false;
 		goto out;
 	case VCPU_STATE_BLOCKED_INTERRUPT:
@@ -897,6 +1059,7 @@ static bool api_vcpu_prepare_run(struct vcpu *current, struct vcpu *vcpu,
 		run_ret->func = HF_FFA_RUN_WAIT_FOR_INTERRUPT;
 		run_ret->arg1 = ffa_vm_vcpu(vcpu->vm->id, vcpu_index(vcpu));
 		run_ret->arg2 = timer_remaining_ns;
+		api_timer_queue_update(vcpu, timer_remaining_ns);
 
 		ret = false;
 		goto out;
@@ -923,6 +1086,7 @@ static bool api_vcpu_prepare_run(struct vcpu *current, struct vcpu *vcpu,
 	plat_ffa_init_schedule_mode_ffa_run(current, vcpu_locked);
 
 	/* It has been decided that the vCPU should be run. */
+	timer_queue_remove(&api_timer_queue, &vcpu->timer);
 	vcpu->cpu = current->cpu;
 	vcpu->state = VCPU_STATE_RUNNING;
 
@@ -2150,25 +2314,14 @@ int64_t api_interrupt_enable(uint32_t intid, bool enable,
 	current_locked = vcpu_lock(current);
 	if (enable) {
 		/*
-		 * If it is pending and was not enabled before, increment the
-		 * count.
+		 * The type selects the counter updated if the interrupt is
+		 * pending, so it is only changed while the interrupt is
+		 * disabled.
 		 */
-		if (vcpu_is_virt_interrupt_pending(interrupts, intid) &&
-		    !vcpu_is_virt_interrupt_enabled(interrupts, intid)) {
-			vcpu_interrupt_count_increment(current_locked,
-						       interrupts, intid);
-		}
-		vcpu_virt_interrupt_set_enabled(interrupts, intid);
+		vcpu_virt_interrupt_clear_enabled(interrupts, intid);
 		vcpu_virt_interrupt_set_type(interrupts, intid, type);
+		vcpu_virt_interrupt_set_enabled(interrupts, intid);
 	} else {
-		/*
-		 * If it is pending and was enabled before, decrement the count.
-		 */
-		if (vcpu_is_virt_interrupt_pending(interrupts, intid) &&
-		    vcpu_is_virt_interrupt_enabled(interrupts, intid)) {
-			vcpu_interrupt_count_decrement(current_locked,
-						       interrupts, intid);
-		}
 		vcpu_virt_interrupt_clear_enabled(interrupts, intid);
 		vcpu_virt_interrupt_set_type(interrupts, intid,
 					     INTERRUPT_TYPE_IRQ);
@@ -2178,49 +2331,38 @@ int64_t api_interrupt_enable(uint32_t intid, bool enable,
 	return 0;
 }
 
-static void api_interrupt_clear_decrement(struct vcpu_locked locked_vcpu,
-					  struct interrupts *interrupts,
-					  uint32_t intid)
-{
-	vcpu_virt_interrupt_clear_pending(interrupts, intid);
-	vcpu_interrupt_count_decrement(locked_vcpu, interrupts, intid);
-}
-
 /**
- * Returns the ID of the next pending interrupt for the calling vCPU, and
- * acknowledges it (i.e. marks it as no longer pending). Returns
+ * Returns the ID of the highest priority pending interrupt for the calling
+ * vCPU, and acknowledges it (i.e. marks it as no longer pending). Returns
  * HF_INVALID_INTID if there are no pending interrupts.
+ *
+ * The vCPU is considered to be handling the returned interrupt until it
+ * acknowledges the next one, so it is only preempted by interrupts of higher
+ * priority meanwhile.
  */
 uint32_t api_interrupt_get(struct vcpu *current)
 {
-	uint32_t i;
-	uint32_t first_interrupt = HF_INVALID_INTID;
+	uint32_t first_interrupt;
 	struct vcpu_locked current_locked;
 	struct interrupts *interrupts = &current->interrupts;
 
 	/*
-	 * Find the first enabled and pending interrupt ID, return it, and
-	 * deactivate it.
+	 * Find the highest priority enabled and pending interrupt ID, return
+	 * it, and deactivate it.
 	 */
 	current_locked = vcpu_lock(current);
-	for (i = 0; i < HF_NUM_INTIDS / INTERRUPT_REGISTER_BITS; ++i) {
-		uint32_t enabled_and_pending =
-			interrupts->interrupt_enabled.bitmap[i] &
-			interrupts->interrupt_pending.bitmap[i];
-
-		if (enabled_and_pending != 0) {
-			uint8_t bit_index = ctz(enabled_and_pending);
-
-			first_interrupt =
-				i * INTERRUPT_REGISTER_BITS + bit_index;
-
-			/*
-			 * Mark it as no longer pending and decrement the count.
-			 */
-			api_interrupt_clear_decrement(
-				current_locked, interrupts, first_interrupt);
-			break;
-		}
+	first_interrupt =
+		vcpu_virt_interrupt_highest_priority_pending(interrupts);
+	if (first_interrupt != HF_INVALID_INTID) {
+		/* Mark it as no longer pending, which updates the count. */
+		vcpu_virt_interrupt_clear_pending(interrupts, first_interrupt);
+		vcpu_virt_interrupt_activate(interrupts, first_interrupt);
+	} else {
+		/*
+		 * With nothing left pending, the handler of the highest
+		 * priority is done and the one it preempted resumes.
+		 */
+		vcpu_virt_interrupt_priority_drop(interrupts);
 	}
 
 	vcpu_unlock(&current_locked);
@@ -2291,6 +2433,151 @@ int64_t api_interrupt_inject(ffa_vm_id_t target_vm_id,
 	return internal_interrupt_inject(target_vcpu, intid, current, next);
 }
 
+/**
+ * Returns the number of nanoseconds until the earliest virtual timer deadline
+ * of the vCPUs waiting for their timer, 0 if it has already passed, or -1 if
+ * there is none or the caller is not the primary VM.
+ *
+ * This allows the primary VM to program a single physical timer for all the
+ * secondary vCPUs, rather than keep a timer for each of them.
+ */
+int64_t api_timer_deadline_get(struct vcpu *current)
+{
+	uint64_t deadline_ns;
+	uint64_t now_ns;
+
+	if (current->vm->id != HF_PRIMARY_VM_ID) {
+		return -1;
+	}
+
+	deadline_ns = timer_queue_next_deadline(&api_timer_queue);
+	if (deadline_ns == TIMER_QUEUE_NO_DEADLINE) {
+		return -1;
+	}
+
+	now_ns = arch_timer_now_ns();
+	if (deadline_ns <= now_ns) {
+		return 0;
+	}
+
+	return (int64_t)(deadline_ns - now_ns);
+}
+
+/**
+ * Expires the earliest virtual timer deadline if it has passed, injecting the
+ * virtual timer interrupt into its vCPU.
+ *
+ * Returns the vCPU whose deadline expired, encoded as by `ffa_vm_vcpu`, for the
+ * primary VM to run, or -1 if none has expired or the caller is not the
+ * primary VM.
+ */
+int64_t api_timer_expired_get(struct vcpu *current)
+{
+	struct timer_queue_entry *entry;
+	struct vcpu *vcpu;
+
+	if (current->vm->id != HF_PRIMARY_VM_ID) {
+		return -1;
+	}
+
+	entry = timer_queue_pop_expired(&api_timer_queue, arch_timer_now_ns());
+	if (entry == NULL) {
+		return -1;
+	}
+
+	vcpu = CONTAINER_OF(entry, struct vcpu, timer);
+	internal_interrupt_inject(vcpu, HF_VIRTUAL_TIMER_INTID, current, NULL);
+
+	return ffa_vm_vcpu(vcpu->vm->id, vcpu_index(vcpu));
+}
+
+/**
+ * Returns the number of TLB invalidations skipped, if `skipped` is true, or
+ * issued otherwise, because a different vCPU of the given VM than the last ran
+ * on a CPU, or -1 if the VM doesn't exist or the caller is not the primary VM.
+ */
+int64_t api_vm_tlb_invalidations_get(ffa_vm_id_t vm_id, bool skipped,
+				     struct vcpu *current)
+{
+	struct vm *vm;
+
+	if (current->vm->id != HF_PRIMARY_VM_ID) {
+		return -1;
+	}
+
+	vm = vm_find(vm_id);
+	if (vm == NULL) {
+		return -1;
+	}
+
+	return (int64_t)arch_vm_tlb_invalidations_get(vm, skipped);
+}
+
+/**
+ * Returns the number of faults the IOMMU has reported for the devices assigned
+ * to the given VM, or -1 if the VM doesn't exist or the caller is not the
+ * primary VM.
+ */
+int64_t api_iommu_faults_get(ffa_vm_id_t vm_id, struct vcpu *current)
+{
+	if (current->vm->id != HF_PRIMARY_VM_ID) {
+		return -1;
+	}
+
+	if (vm_find(vm_id) == NULL) {
+		return -1;
+	}
+
+	return (int64_t)plat_iommu_fault_count(vm_id);
+}
+
+/**
+ * Returns the given statistic of the exits from VMs to Hafnium on the CPU with
+ * the given index, or -1 if the CPU or statistic doesn't exist or the caller is
+ * not the primary VM.
+ */
+int64_t api_cpu_exit_stat_get(uint32_t cpu_index, uint32_t stat, uint32_t key,
+			      struct vcpu *current)
+{
+	uint64_t value;
+
+	if (current->vm->id != HF_PRIMARY_VM_ID) {
+		return -1;
+	}
+
+	if (cpu_find_index(cpu_index) == NULL) {
+		return -1;
+	}
+
+	if (!arch_cpu_exit_stat_get(cpu_index, stat, key, &value)) {
+		return -1;
+	}
+
+	return (int64_t)value;
+}
+
+/**
+ * Returns the given statistic of the Schedule Receiver Interrupts, or -1 if the
+ * statistic doesn't exist.
+ */
+int64_t api_sri_stat_get(uint32_t stat)
+{
+	struct plat_ffa_sri_stats stats;
+
+	plat_ffa_sri_stats_get(&stats);
+
+	switch (stat) {
+	case HF_SRI_STAT_SENT:
+		return (int64_t)stats.sent;
+	case HF_SRI_STAT_COALESCED:
+		return (int64_t)stats.coalesced;
+	case HF_SRI_STAT_SUPPRESSED:
+		return (int64_t)stats.suppressed;
+	default:
+		return -1;
+	}
+}
+
 /** Returns the version of the implemented FF-A specification. */
 struct ffa_value api_ffa_version(struct vcpu *current,
 				 uint32_t requested_version)
@@ -2319,26 +2606,139 @@ struct ffa_value api_ffa_version(struct vcpu *current,
 
 int64_t api_debug_log(char c, struct vcpu *current)
 {
-	bool flush;
+	struct vm_locked vm_locked = vm_lock(current->vm);
+
+	/* Keep the output in the order the VM wrote it. */
+	api_console_ring_drain_locked(vm_locked);
+	api_log_char_locked(vm_locked, c);
+
+	vm_unlock(&vm_locked);
+
+	return 0;
+}
+
+/**
+ * Registers the page at the given address as the VM's console ring, sharing it
+ * with the hypervisor so that lines written to it can be printed without a
+ * call for each character.
+ *
+ * Returns 0 on success, or -1 if the address isn't a page owned exclusively by
+ * the VM with read and write access, a console ring is already registered or
+ * there wasn't enough memory to map it.
+ */
+int64_t api_console_ring_register(ipaddr_t ring_ipa, struct vcpu *current)
+{
 	struct vm *vm = current->vm;
-	struct vm_locked vm_locked = vm_lock(vm);
+	struct vm_locked vm_locked;
+	struct mm_stage1_locked mm_stage1_locked;
+	struct mpool local_page_pool;
+	paddr_t pa_begin;
+	paddr_t pa_end;
+	uint32_t orig_mode;
+	uint32_t mode;
+	uint32_t extra_attributes;
+	struct hf_console_ring *ring;
+	int64_t ret = -1;
 
-	if (c == '\n' || c == '\0') {
-		flush = true;
-	} else {
-		vm->log_buffer[vm->log_buffer_length++] = c;
-		flush = (vm->log_buffer_length == sizeof(vm->log_buffer));
+	if (!is_aligned(ipa_addr(ring_ipa), PAGE_SIZE)) {
+		return -1;
 	}
 
-	if (flush) {
-		dlog_flush_vm_buffer(vm->id, vm->log_buffer,
-				     vm->log_buffer_length);
-		vm->log_buffer_length = 0;
+	pa_begin = pa_from_ipa(ring_ipa);
+	pa_end = pa_add(pa_begin, HF_CONSOLE_RING_SIZE);
+
+	vm_locked = vm_lock(vm);
+
+	/*
+	 * Create a local pool so any freed memory can't be used by another
+	 * thread. This is to ensure the original mapping can be restored if the
+	 * hypervisor mapping fails.
+	 */
+	mpool_init_with_fallback(&local_page_pool, &api_page_pool);
+	mm_stage1_locked = mm_lock_stage1();
+
+	if (vm->console_ring != NULL) {
+		goto out;
 	}
 
+	if (!vm_mem_get_mode(vm_locked, ring_ipa,
+			     ipa_add(ring_ipa, HF_CONSOLE_RING_SIZE),
+			     &orig_mode) ||
+	    !api_mode_valid_owned_and_exclusive(orig_mode) ||
+	    (orig_mode & MM_MODE_R) == 0 || (orig_mode & MM_MODE_W) == 0) {
+		dlog_verbose("Invalid console ring for VM %#x.\n", vm->id);
+		goto out;
+	}
+
+	/* The VM keeps its access but the page is now shared. */
+	mode = MM_MODE_UNOWNED | MM_MODE_SHARED | MM_MODE_R | MM_MODE_W;
+	extra_attributes = arch_mm_extra_attributes_from_vm(vm->id);
+	if (vm->el0_partition) {
+		mode |= MM_MODE_USER | MM_MODE_NG;
+		extra_attributes |= MM_MODE_NG;
+	}
+
+	if (!vm_identity_map(vm_locked, pa_begin, pa_end, mode,
+			     &local_page_pool, NULL)) {
+		goto out;
+	}
+
+	ring = mm_identity_map(mm_stage1_locked, pa_begin, pa_end,
+			       MM_MODE_R | MM_MODE_W | extra_attributes,
+			       &local_page_pool);
+	if (ring == NULL) {
+		CHECK(vm_identity_map(vm_locked, pa_begin, pa_end, orig_mode,
+				      &local_page_pool, NULL));
+		goto out;
+	}
+
+	vm->console_ring = ring;
+	vm->console_ring_mode = orig_mode;
+	ret = 0;
+
+out:
+	mpool_fini(&local_page_pool);
+	mm_unlock_stage1(&mm_stage1_locked);
 	vm_unlock(&vm_locked);
 
-	return 0;
+	return ret;
+}
+
+/**
+ * Prints what is left in the VM's console ring and gives the page back to the
+ * VM, so that it is no longer shared with the hypervisor and can be registered
+ * again.
+ *
+ * Returns 0 on success, or -1 if the VM hasn't registered a console ring.
+ */
+int64_t api_console_ring_unregister(struct vcpu *current)
+{
+	struct vm_locked vm_locked = vm_lock(current->vm);
+	int64_t ret = api_console_ring_unregister_locked(vm_locked) ? 0 : -1;
+
+	vm_unlock(&vm_locked);
+
+	return ret;
+}
+
+/**
+ * Prints the lines written to the VM's console ring so far.
+ *
+ * Returns 0 on success, or -1 if the VM hasn't registered a console ring.
+ */
+int64_t api_console_ring_flush(struct vcpu *current)
+{
+	struct vm_locked vm_locked = vm_lock(current->vm);
+	int64_t ret = -1;
+
+	if (vm_locked.vm->console_ring != NULL) {
+		api_console_ring_drain_locked(vm_locked);
+		ret = 0;
+	}
+
+	vm_unlock(&vm_locked);
+
+	return ret;
 }
 
 /**
@@ -2707,9 +3107,8 @@ struct ffa_value api_ffa_msg_send_direct_resp(ffa_vm_id_t sender_vm_id,
 
 		if (vcpu_is_virt_interrupt_pending(interrupts,
 						   HF_MANAGED_EXIT_INTID)) {
-			api_interrupt_clear_decrement(current_locked,
-						      interrupts,
-						      HF_MANAGED_EXIT_INTID);
+			vcpu_virt_interrupt_clear_pending(
+				interrupts, HF_MANAGED_EXIT_INTID);
 		}
 	}
 
@@ -2814,7 +3213,7 @@ struct ffa_value api_ffa_mem_send(uint32_t share_func, uint32_t length,
 				      sizeof(struct ffa_memory_access)) {
 		dlog_verbose(
 			"Initial fragment length %d smaller than header size "
-			"%d.\n",
+			"%ld.\n",
 			fragment_length,
 			sizeof(struct ffa_memory_region) +
 				sizeof(struct ffa_memory_access));
@@ -3412,7 +3811,7 @@ struct ffa_value api_ffa_notification_update_bindings(
 	if (vm_are_notifications_pending(receiver_locked,
 					 plat_ffa_is_vm_id(sender_vm_id),
 					 notifications)) {
-		dlog_verbose("Notifications within '%x' pending.\n",
+		dlog_verbose("Notifications within '%lx' pending.\n",
 			     notifications);
 		ret = ffa_error(FFA_DENIED);
 		goto out;
@@ -3497,7 +3896,7 @@ struct ffa_value api_ffa_notification_set(
 		receiver_locked, plat_ffa_is_vm_id(sender_vm_id), notifications,
 		vcpu_id, is_per_vcpu);
 
-	dlog_verbose("Set the notifications: %x.\n", notifications);
+	dlog_verbose("Set the notifications: %lx.\n", notifications);
 
 	if ((FFA_NOTIFICATIONS_FLAG_DELAY_SRI & flags) == 0) {
 		dlog_verbose("SRI was NOT delayed. vcpu: %u!\n",
@@ -3580,7 +3979,8 @@ struct ffa_value api_ffa_notification_get(ffa_vm_id_t receiver_vm_id,
 	    (receiver_locked.vm->vcpu_count != 1 &&
 	     cpu_index(current->cpu) != vcpu_id)) {
 		dlog_verbose(
-			"Invalid VCPU ID %u. vcpu count %u current core: %u!\n",
+			"Invalid VCPU ID %u. vcpu count %u current core: "
+			"%zu!\n",
 			vcpu_id, receiver_locked.vm->vcpu_count,
 			cpu_index(current->cpu));
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
@@ -3743,6 +4143,15 @@ struct ffa_value api_ffa_notification_info_get(struct vcpu *current)
 
 	plat_ffa_sri_state_set(HANDLED);
 
+	/*
+	 * If there is more info pending, the scheduler is bound to call
+	 * FFA_NOTIFICATION_INFO_GET again, so it needn't be signaled meanwhile.
+	 */
+	plat_ffa_sri_set_draining(
+		result.func == FFA_SUCCESS_64 &&
+		(result.arg2 & FFA_NOTIFICATIONS_INFO_GET_FLAG_MORE_PENDING) !=
+			0U);
+
 	return result;
 }
 
@@ -3939,32 +4348,11 @@ static rsize_t arg_to_char_helper(struct vm_locked from_locked,
 				  const uint64_t src, rsize_t src_size,
 				  rsize_t to_write)
 {
-	bool flush = false;
-	char c;
 	rsize_t size = src_size < to_write ? src_size : to_write;
-	rsize_t written = 0;
+	rsize_t written;
 
-	if (size == 0) {
-		return 0;
-	}
-
-	while (written < size) {
-		c = ((char *)&src)[written++];
-		if (c == '\n' || c == '\0') {
-			flush = true;
-		} else {
-			from_locked.vm->log_buffer
-				[from_locked.vm->log_buffer_length++] = c;
-			flush = (from_locked.vm->log_buffer_length ==
-				 LOG_BUFFER_SIZE);
-		}
-
-		if (flush) {
-			dlog_flush_vm_buffer(from_locked.vm->id,
-					     from_locked.vm->log_buffer,
-					     from_locked.vm->log_buffer_length);
-			from_locked.vm->log_buffer_length = 0;
-		}
+	for (written = 0; written < size; written++) {
+		api_log_char_locked(from_locked, ((char *)&src)[written]);
 	}
 
 	return written;
@@ -3989,6 +4377,9 @@ struct ffa_value api_ffa_console_log(const struct ffa_value args,
 
 	vm_locked = vm_lock(vm);
 
+	/* Keep the output in the order the VM wrote it. */
+	api_console_ring_drain_locked(vm_locked);
+
 	total_to_write -= arg_to_char_helper(vm_locked, args.arg2,
 					     chars_in_param, total_to_write);
 	total_to_write -= arg_to_char_helper(vm_locked, args.arg3,
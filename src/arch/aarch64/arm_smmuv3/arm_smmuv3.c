@@ -8,16 +8,47 @@
 
 #include "arm_smmuv3.h"
 
+#include "hf/api.h"
+#include "hf/check.h"
+#include "hf/cpu.h"
 #include "hf/dlog.h"
 #include "hf/io.h"
 #include "hf/panic.h"
+#include "hf/plat/interrupts.h"
+#include "hf/spinlock.h"
 #include "hf/static_assert.h"
+#include "hf/vcpu.h"
 
 #define MAX_ATTEMPTS 50000
 
+/*
+ * The SPMC handles the event queue interrupt itself, if one is given, and tells
+ * the VMs about their faults. The hypervisor leaves physical interrupts to the
+ * primary VM, so only reads the event queue when the fault counters are
+ * queried instead.
+ */
+#if SECURE_WORLD == 1 && defined(SMMUv3_EVTQ_INTID)
+#define SMMUV3_EVTQ_IRQ 1
+#else
+#define SMMUV3_EVTQ_IRQ 0
+#undef SMMUv3_EVTQ_INTID
+#define SMMUv3_EVTQ_INTID HF_INVALID_INTID
+#endif
+
+#define SMMUV3_EVTQ_IRQ_PRIORITY 0x10
+
 static struct smmuv3_driver arm_smmuv3;
 static unsigned int smmu_instance = 0;
 
+/*
+ * Serialises use of the command queue once VMs are running, as the TLB
+ * invalidations of different VMs can be issued from different CPUs.
+ */
+static struct spinlock cmdq_lock = SPINLOCK_INIT;
+
+/* Serialises reading the event queue and updating the fault counters. */
+static struct spinlock evtq_lock = SPINLOCK_INIT;
+
 static uint32_t find_offset(uint32_t secure, uint32_t non_secure)
 {
 #if SECURE_WORLD == 1
@@ -187,6 +218,14 @@ static bool smmuv3_identify_features(struct smmuv3_driver *smmuv3)
 	smmuv3->prop.xlat_format = xlat_format;
 	smmuv3->prop.xlat_stages = EXTRACT(idr0, XLAT_STG_SHIFT, XLAT_STG_MASK);
 
+	/* Range invalidation of the TLB was introduced in SMMUv3.2. */
+	smmuv3->prop.range_inv = false;
+	if (arch_version >= 2) {
+		smmuv3->prop.range_inv =
+			EXTRACT(mmio_read32_offset(smmuv3->base_addr, IDR3),
+				RIL_SHIFT, RIL_MASK) != 0;
+	}
+
 	return true;
 }
 
@@ -261,7 +300,7 @@ static bool smmuv3_queue_sizes(struct smmuv3_driver *smmuv3)
 		return false;
 	}
 
-	if (size >= 7 && smmuv3->prop.linear_str_table) {
+	if (size >= 7 && !smmuv3->prop.lvl2_str_table) {
 		dlog_error(
 			"SMMUv3: Linear Stream Table cannot be supported when "
 			"StreamID bits > 7\n");
@@ -375,7 +414,7 @@ static bool smmuv3_xlat_support(struct smmuv3_driver *smmuv3)
 		smmuv3->prop.ias = ias_aarch32;
 	}
 
-	dlog_verbose("SMMUv3: Input Addr: %d-bits, Output Addr: %d-bits\n",
+	dlog_verbose("SMMUv3: Input Addr: %ld-bits, Output Addr: %ld-bits\n",
 		     smmuv3->prop.ias, smmuv3->prop.oas);
 
 	/*
@@ -415,6 +454,9 @@ static bool smmuv3_configure_cmdq(struct smmuv3_driver *smmuv3,
 {
 	uint32_t cmdq_size;
 	uint64_t cmdq_base_reg;
+	uint32_t offset_cmdq_cons;
+	uint32_t offset_cmdq_prod;
+	uint32_t offset_cmdq_base;
 	void *q_base;
 
 	cmdq_size = (1 << smmuv3->prop.cmdq_entries_log2) * CMD_SIZE;
@@ -432,33 +474,25 @@ static bool smmuv3_configure_cmdq(struct smmuv3_driver *smmuv3,
 	}
 
 	dlog_verbose("SMMUv3: Memory allocated at %p for CMDQ\n", q_base);
-	smmuv3->cmd_queue.q_base = q_base;
 
 	cmdq_base_reg = (uint64_t)q_base & GEN_MASK(51, 5);
 	cmdq_base_reg = cmdq_base_reg | (1ULL << RA_HINT_SHIFT);
 	cmdq_base_reg = cmdq_base_reg | smmuv3->prop.cmdq_entries_log2;
 
-	uint32_t offset_cmdq_cons;
-	uint32_t offset_cmdq_prod;
-	uint32_t offset_cmdq_base;
-
 	offset_cmdq_cons = find_offset(S_CMDQ_CONS, CMDQ_CONS);
 	offset_cmdq_prod = find_offset(S_CMDQ_PROD, CMDQ_PROD);
 	offset_cmdq_base = find_offset(S_CMDQ_BASE, CMDQ_BASE);
 
-	smmuv3->cmd_queue.cons_reg_base =
-		(void *)((uint8_t *)smmuv3->base_addr + offset_cmdq_cons);
-	smmuv3->cmd_queue.prod_reg_base =
-		(void *)((uint8_t *)smmuv3->base_addr + offset_cmdq_prod);
-
 	/* Initialize SMMU_CMDQ_BASE register */
 	dlog_verbose("SMMUv3: write to (S_)CMDQ_BASE\n");
 	mmio_write64_offset(smmuv3->base_addr, offset_cmdq_base, cmdq_base_reg);
 
 	/* Initialize SMMU_CMDQ_CONS and SMMU_CMDQ_PROD registers */
 	dlog_verbose("SMMUv3: write to (S_)CMDQ_CONS, (S_)CMDQ_PROD\n");
-	mmio_write32(smmuv3->cmd_queue.cons_reg_base, 0);
-	mmio_write32(smmuv3->cmd_queue.prod_reg_base, 0);
+	smmuv3_cmdq_init(
+		&smmuv3->cmd_queue, q_base, smmuv3->prop.cmdq_entries_log2,
+		(void *)((uint8_t *)smmuv3->base_addr + offset_cmdq_prod),
+		(void *)((uint8_t *)smmuv3->base_addr + offset_cmdq_cons));
 
 	return true;
 }
@@ -500,8 +534,10 @@ static bool smmuv3_configure_evtq(struct smmuv3_driver *smmuv3,
 	offset_evtq_prod = find_offset(S_EVTQ_PROD, EVTQ_PROD);
 	offset_evtq_cons = find_offset(S_EVTQ_CONS, EVTQ_CONS);
 
-	mmio_write32_offset(smmuv3->base_addr, offset_evtq_prod, 0);
-	mmio_write32_offset(smmuv3->base_addr, offset_evtq_cons, 0);
+	smmuv3_evtq_init(
+		&smmuv3->evt_queue, q_base, smmuv3->prop.evtq_entries_log2,
+		(void *)((uint8_t *)smmuv3->base_addr + offset_evtq_prod),
+		(void *)((uint8_t *)smmuv3->base_addr + offset_evtq_cons));
 
 	return true;
 }
@@ -515,81 +551,35 @@ static inline void clear_ste(uint64_t *data)
 	}
 }
 
-static inline void write_ste(uint64_t *st_entry, const uint64_t *data)
-{
-	int i;
-
-	/*
-	 * Mark the stream table entry as invalid to avoid race condition
-	 * STE.V = 0 (bit 0) of first double word
-	 */
-	st_entry[0] = 0;
-
-	/*
-	 * Write to memory from upper double word of Stream Table entry such
-	 * that the bottom double word which has the STE.Valid bit is written
-	 * last.
-	 */
-	for (i = STE_SIZE_DW - 1U; i >= 0; i--) {
-		st_entry[i] = data[i];
-	}
-
-	/* Ensure written data(STE) is observable to SMMU by performing DSB */
-	dsb(sy);
-}
-
-static void smmuv3_invalidate_stes(struct smmuv3_driver *smmuv3)
-{
-	unsigned int i;
-	unsigned int ste_count;
-
-	/* Each stream table entry is 64 bytes wide i.e., 8 Double Words*/
-	uint64_t ste_data[STE_SIZE_DW];
-	uint64_t *ste_addr;
-
-	clear_ste(ste_data);
-	ste_addr = (uint64_t *)smmuv3->strtab_cfg.base;
-	ste_count = (1 << smmuv3->prop.stream_n_bits);
-
-	for (i = 0; i < ste_count; i++) {
-		write_ste(ste_addr, ste_data);
-		ste_addr += STE_SIZE_DW;
-	}
-}
-
 static bool smmuv3_configure_str_table(struct smmuv3_driver *smmuv3,
 				       struct mpool *pool)
 {
-	uint32_t strtab_size;
 	uint32_t strtab_cfg_reg;
 	uint64_t strtab_base_reg;
 	uint32_t offset_strtab_base_cfg;
 	uint32_t offset_strtab_base;
-	void *tbl_base;
-
-	strtab_size = (1 << smmuv3->prop.stream_n_bits) * STE_SIZE;
-	dlog_verbose("SMMUv3 Total StreamTable entries: %d\n",
-		     (1 << smmuv3->prop.stream_n_bits));
 
-	tbl_base = mpool_alloc_contiguous(pool,
-					  (strtab_size / FFA_PAGE_SIZE) + 1, 1);
-
-	if (tbl_base == NULL) {
+	/*
+	 * Use a two-level table if the SMMU supports it, so that memory is only
+	 * needed for the spans of StreamIDs that devices are attached to. All
+	 * the STEs are invalid to begin with.
+	 */
+	if (!smmuv3_strtab_init(&smmuv3->strtab_cfg,
+				smmuv3->prop.stream_n_bits,
+				smmuv3->prop.lvl2_str_table, pool)) {
 		dlog_error(
 			"SMMUv3: Could not allocate memory for stream table "
 			"entries\n");
 		return false;
 	}
 
-	dlog_verbose("SMMUv3: Memory allocated at %p for Stream Table\n",
-		     tbl_base);
-	smmuv3->strtab_cfg.base = tbl_base;
-	strtab_base_reg = (uint64_t)tbl_base & GEN_MASK(51, 6);
-	strtab_base_reg = strtab_base_reg | (1ULL << RA_HINT_SHIFT);
+	dlog_verbose("SMMUv3: Memory allocated at %p for %s Stream Table\n",
+		     smmuv3->strtab_cfg.base,
+		     smmuv3->strtab_cfg.two_level ? "two-level" : "linear");
 
-	/* We assume Linear format for stream table */
-	strtab_cfg_reg = LINEAR_STR_TABLE << STR_FMT_SHIFT;
-	strtab_cfg_reg = strtab_cfg_reg | smmuv3->prop.stream_n_bits;
+	strtab_base_reg = (uint64_t)smmuv3->strtab_cfg.base & GEN_MASK(51, 6);
+	strtab_base_reg = strtab_base_reg | (1ULL << RA_HINT_SHIFT);
+	strtab_cfg_reg = smmuv3_strtab_base_cfg(&smmuv3->strtab_cfg);
 
 	dlog_verbose("SMMUv3: write to (S_)STRTAB_BASE_CFG\n");
 	offset_strtab_base_cfg =
@@ -602,9 +592,6 @@ static bool smmuv3_configure_str_table(struct smmuv3_driver *smmuv3,
 	mmio_write64_offset(smmuv3->base_addr, offset_strtab_base,
 			    strtab_base_reg);
 
-	/* Mark STE as invalid */
-	smmuv3_invalidate_stes(smmuv3);
-
 	return true;
 }
 
@@ -653,70 +640,6 @@ static void construct_tlbi_cmd(uint64_t *cmd, struct cmd_tlbi cmd_format)
 }
 #endif
 
-static void construct_cmd_sync(uint64_t *cmd)
-{
-	cmd[0] = COMPOSE(OP_CMD_SYNC, OP_SHIFT, OP_MASK);
-	cmd[0] = cmd[0] | COMPOSE(CSIGNAL_NONE, CSIGNAL_SHIFT, CSIGNAL_MASK);
-	cmd[1] = 0;
-}
-
-static inline uint32_t find_offset_next_wr_idx(struct smmuv3_driver *smmuv3,
-					       uint32_t current_idx,
-					       uint32_t prod_wrap)
-{
-	uint32_t next_idx;
-	uint32_t max_idx;
-	uint32_t wrap_bit_set;
-
-	max_idx = (1 << smmuv3->prop.cmdq_entries_log2) - 1;
-	if (current_idx > max_idx) {
-		panic("Prod idx overflow\n");
-	}
-
-	if (current_idx < max_idx) {
-		next_idx = current_idx + 1;
-		return next_idx | prod_wrap;
-	}
-
-	/*
-	 * If current write index is already at the end, we need to wrap
-	 * it around i.e, start from 0 and toggle wrap bit
-	 */
-	next_idx = 0;
-	wrap_bit_set = 1 << smmuv3->prop.cmdq_entries_log2;
-
-	if (prod_wrap == 0) {
-		return next_idx | wrap_bit_set;
-	}
-
-	return next_idx;
-}
-
-static inline void push_entry_to_cmdq(uint64_t *cmdq_entry,
-				      const uint64_t *cmd_dword)
-{
-	dlog_verbose("SMMUv3: Writing command to: %p\n", cmdq_entry);
-
-	for (unsigned int i = 0; i < CMD_SIZE_DW; i++) {
-		cmdq_entry[i] = cmd_dword[i];
-	}
-
-	/*
-	 * Ensure written data(command) is observable to SMMU by performing DSB
-	 */
-	dsb(sy);
-}
-
-static void update_cmdq_prod(struct smmuv3_driver *smmuv3, uint32_t idx)
-{
-	dlog_verbose("SMMUv3: updated write to CMDQ-PRODBASE\n");
-	mmio_write32(smmuv3->cmd_queue.prod_reg_base, idx);
-
-	if (mmio_read32(smmuv3->cmd_queue.prod_reg_base) != idx) {
-		panic("Hardware not updated with write index\n");
-	}
-}
-
 static void smmuv3_show_cmdq_err(struct smmuv3_driver *smmuv3)
 {
 	uint32_t cons_reg;
@@ -778,130 +701,17 @@ static inline void track_cmdq_idx(struct smmuv3_driver *smmuv3)
 		     mmio_read32(smmuv3->cmd_queue.prod_reg_base));
 }
 
-static bool smmuv3_issue_cmd(struct smmuv3_driver *smmuv3, uint64_t *cmd)
-{
-	uint32_t prod_idx;
-	uint32_t cons_idx;
-	uint32_t prod_wrap;
-	uint32_t cons_wrap;
-	uint32_t prod_reg;
-	uint32_t cons_reg;
-	uint32_t index_mask;
-	uint32_t q_max_entries;
-	uint32_t q_empty_slots;
-	void *cmd_target;
-	uint32_t next_wr_idx;
-	uint32_t current_wr_idx;
-
-	q_max_entries = 1 << smmuv3->prop.cmdq_entries_log2;
-	index_mask = ALL_1s(smmuv3->prop.cmdq_entries_log2);
-	prod_reg = mmio_read32(smmuv3->cmd_queue.prod_reg_base);
-	prod_wrap =
-		EXTRACT(prod_reg, smmuv3->prop.cmdq_entries_log2, WRAP_MASK);
-	prod_idx = prod_reg & index_mask;
-
-	cons_reg = mmio_read32(smmuv3->cmd_queue.cons_reg_base);
-	cons_wrap =
-		EXTRACT(cons_reg, smmuv3->prop.cmdq_entries_log2, WRAP_MASK);
-	cons_idx = cons_reg & index_mask;
-
-	smmuv3_show_cmdq_err(smmuv3);
-
-	if (prod_wrap == cons_wrap) {
-		q_empty_slots = q_max_entries - (prod_idx - cons_idx);
-	} else {
-		q_empty_slots = cons_idx - prod_idx;
-	}
-
-	if (q_empty_slots == 0) {
-		dlog_error(
-			"SMMUv3: Command queue full; No cmd can be "
-			"issued\n");
-		return false;
-	}
-
-	current_wr_idx = prod_idx;
-	cmd_target = (void *)((uint8_t *)smmuv3->cmd_queue.q_base +
-			      current_wr_idx * CMD_SIZE);
-	push_entry_to_cmdq((uint64_t *)cmd_target, cmd);
-
-	next_wr_idx = find_offset_next_wr_idx(
-		smmuv3, current_wr_idx,
-		(prod_wrap << smmuv3->prop.cmdq_entries_log2));
-
-	track_cmdq_idx(smmuv3);
-	dlog_verbose("current_wr_idx: %x; next_wr_idx: %x\n", current_wr_idx,
-		     next_wr_idx);
-
-	/*
-	 * Host(PE) updates the register indicating the next empty space in
-	 * queue
-	 */
-	update_cmdq_prod(smmuv3, next_wr_idx);
-
-	return true;
-}
-
-static bool smmuv3_rd_meets_wr_idx(struct smmuv3_driver *smmuv3)
-{
-	unsigned int attempts;
-	uint32_t prod_reg;
-	uint32_t cons_reg;
-	uint32_t prod_idx;
-	uint32_t cons_idx;
-	uint32_t prod_wrap;
-	uint32_t cons_wrap;
-	uint32_t index_mask;
-
-	index_mask = ALL_1s(smmuv3->prop.cmdq_entries_log2);
-	prod_reg = mmio_read32(smmuv3->cmd_queue.prod_reg_base);
-	prod_wrap =
-		EXTRACT(prod_reg, smmuv3->prop.cmdq_entries_log2, WRAP_MASK);
-	prod_idx = prod_reg & index_mask;
-
-	cons_reg = mmio_read32(smmuv3->cmd_queue.cons_reg_base);
-	cons_wrap =
-		EXTRACT(cons_reg, smmuv3->prop.cmdq_entries_log2, WRAP_MASK);
-	cons_idx = cons_reg & index_mask;
-
-	attempts = 0;
-	while (attempts++ < 100000) {
-		if ((cons_wrap == prod_wrap) && (prod_idx == cons_idx)) {
-			return true;
-		}
-
-		cons_reg = mmio_read32(smmuv3->cmd_queue.cons_reg_base);
-		cons_wrap = EXTRACT(cons_reg, smmuv3->prop.cmdq_entries_log2,
-				    WRAP_MASK);
-		cons_idx = cons_reg & index_mask;
-	}
-
-	dlog_error("SMMUv3: Timeout CMDQ; CONS_REG: %x; PROD_REG: %x\n",
-		   cons_reg, prod_reg);
-
-	return false;
-}
-
-static bool smmuv3_synchronize_cmdq(struct smmuv3_driver *smmuv3)
+/*
+ * Completes the commands of the batch with a CMD_SYNC, reporting any error the
+ * SMMU encountered processing them.
+ */
+static bool smmuv3_cmd_batch_complete(struct smmuv3_driver *smmuv3,
+				      struct smmuv3_cmd_batch *batch)
 {
-	uint64_t cmd[CMD_SIZE_DW];
-
-	construct_cmd_sync(cmd);
-
-	if (!smmuv3_issue_cmd(smmuv3, cmd)) {
-		return false;
-	}
-
-	/*
-	 * CMD_SYNC waits for completion of all prior commands and ensures
-	 * observability of any related transactions through and from the SMMU.
-	 * Ensure command queue read(consumer) index catches up with the write
-	 * (producer) index.
-	 */
-
 	track_cmdq_idx(smmuv3);
 
-	if (!smmuv3_rd_meets_wr_idx(smmuv3)) {
+	if (!smmuv3_cmd_batch_sync(batch)) {
+		smmuv3_show_cmdq_err(smmuv3);
 		dlog_error(
 			"SMMUv3: Timeout: CMDQ populated by PE not consumed by "
 			"SMMU\n");
@@ -915,52 +725,42 @@ static bool smmuv3_synchronize_cmdq(struct smmuv3_driver *smmuv3)
 
 static bool inval_cached_cfgs(struct smmuv3_driver *smmuv3)
 {
-	uint64_t cmd[CMD_SIZE_DW];
+	struct smmuv3_cmd_batch batch;
 
-	/* Invalidate configuration caches */
-	construct_inv_all_cfg(cmd);
+	smmuv3_cmd_batch_init(&batch, &smmuv3->cmd_queue);
 
-	if (!smmuv3_issue_cmd(smmuv3, cmd)) {
-		dlog_error(
-			"SMMUv3: Failed to issue CFGI_ALL command to CMDQ\n");
-		return false;
-	}
+	/* Invalidate configuration caches */
+	construct_inv_all_cfg(smmuv3_cmd_batch_next(&batch));
 
 	/*
 	 * Issue CMD_SYNC to ensure completion of prior commands used for
 	 * invalidation
 	 */
-	if (!smmuv3_synchronize_cmdq(smmuv3)) {
-		dlog_error("SMMUv3: Failed to synchronize\n");
-		return false;
-	}
-
-	return true;
+	return smmuv3_cmd_batch_complete(smmuv3, &batch);
 }
 
-static bool inval_cached_STE(struct smmuv3_driver *smmuv3, uint32_t sid)
+/*
+ * Invalidates the configuration cached for each of the given streams, with a
+ * single CMD_SYNC for all of them.
+ */
+static bool inval_cached_STEs(struct smmuv3_driver *smmuv3,
+			      const uint32_t *sids, uint32_t sid_count)
 {
-	uint64_t cmd[CMD_SIZE_DW];
+	struct smmuv3_cmd_batch batch;
+	uint32_t i;
 
-	/* Invalidate configuration related to a STE */
-	construct_inv_ste_cfg(cmd, sid);
+	smmuv3_cmd_batch_init(&batch, &smmuv3->cmd_queue);
 
-	if (!smmuv3_issue_cmd(smmuv3, cmd)) {
-		dlog_error(
-			"SMMUv3: Failed to issue CFGI_STE command to CMDQ\n");
-		return false;
+	/* Invalidate configuration related to each STE */
+	for (i = 0; i < sid_count; i++) {
+		construct_inv_ste_cfg(smmuv3_cmd_batch_next(&batch), sids[i]);
 	}
 
 	/*
 	 * Issue CMD_SYNC to ensure completion of prior commands used for
 	 * invalidation
 	 */
-	if (!smmuv3_synchronize_cmdq(smmuv3)) {
-		dlog_error("SMMUv3: Failed to synchronize\n");
-		return false;
-	}
-
-	return true;
+	return smmuv3_cmd_batch_complete(smmuv3, &batch);
 }
 
 static bool smmuv3_inv_cfg_tlbs(struct smmuv3_driver *smmuv3)
@@ -982,30 +782,24 @@ static bool smmuv3_inv_cfg_tlbs(struct smmuv3_driver *smmuv3)
 		return false;
 	}
 #else
-	uint64_t cmd[CMD_SIZE_DW];
+	struct smmuv3_cmd_batch batch;
+	struct cmd_tlbi cmd_tlbi_format = {.opcode = OP_TLBI_EL2_ALL};
+
+	smmuv3_cmd_batch_init(&batch, &smmuv3->cmd_queue);
 
 	/* Invalidate all cached configurations */
-	if (!inval_cached_cfgs(smmuv3)) {
-		return false;
-	}
+	construct_inv_all_cfg(smmuv3_cmd_batch_next(&batch));
 
 	/* Invalidate TLB entries using:
 	 * CMD_TLBI_EL2_ALL and CMD_TLBI_NSNH_ALL
 	 */
-	struct cmd_tlbi cmd_tlbi_format = {.opcode = OP_TLBI_EL2_ALL};
-
-	construct_tlbi_cmd(cmd, cmd_tlbi_format);
-
-	if (!smmuv3_issue_cmd(smmuv3, cmd)) {
-		dlog_error("SMMUv3: Failed to invalidate TLB entries\n");
-		return false;
-	}
+	construct_tlbi_cmd(smmuv3_cmd_batch_next(&batch), cmd_tlbi_format);
 
 	cmd_tlbi_format.opcode = OP_TLBI_NSNH_ALL;
+	construct_tlbi_cmd(smmuv3_cmd_batch_next(&batch), cmd_tlbi_format);
 
-	construct_tlbi_cmd(cmd, cmd_tlbi_format);
-
-	if (!smmuv3_issue_cmd(smmuv3, cmd)) {
+	/* Complete all of them with a single CMD_SYNC. */
+	if (!smmuv3_cmd_batch_complete(smmuv3, &batch)) {
 		dlog_error("SMMUv3: Failed to invalidate TLB entries\n");
 		return false;
 	}
@@ -1049,23 +843,16 @@ static void create_bypass_ste(uint64_t *ste)
  */
 static void smmuv3_default_translation(struct smmuv3_driver *smmuv3)
 {
-	unsigned int i;
-	unsigned int ste_count;
-
 	/* Each stream table entry is 64 bytes wide i.e., 8 Double Words*/
 	uint64_t ste_data[STE_SIZE_DW];
-	uint64_t *ste_addr;
-
-	ste_count = (1 << smmuv3->prop.stream_n_bits);
 
 	create_bypass_ste(ste_data);
-	ste_addr = (uint64_t *)smmuv3->strtab_cfg.base;
 
-	/* Populate all stream table entries */
-	for (i = 0; i < ste_count; i++) {
-		write_ste(ste_addr, ste_data);
-		ste_addr += STE_SIZE_DW;
-	}
+	/*
+	 * Populate all stream table entries, including those of level 2 arrays
+	 * allocated later on.
+	 */
+	smmuv3_strtab_set_default(&smmuv3->strtab_cfg, ste_data);
 
 	/*
 	 * Note 1:
@@ -1078,6 +865,28 @@ static void smmuv3_default_translation(struct smmuv3_driver *smmuv3)
 	}
 }
 
+/*
+ * Makes the SMMU raise its event queue interrupt when it writes new events.
+ */
+static bool smmuv3_enable_evtq_irq(struct smmuv3_driver *smmuv3)
+{
+	uint32_t offset_irq_ctrl = find_offset(S_IRQ_CTRL, IRQ_CTRL);
+	uint32_t offset_irq_ctrlack = find_offset(S_IRQ_CTRLACK, IRQ_CTRLACK);
+	uint32_t irq_ctrl;
+
+	irq_ctrl = mmio_read32_offset(smmuv3->base_addr, offset_irq_ctrl);
+	irq_ctrl |= EVENTQ_IRQEN_MASK;
+	mmio_write32_offset(smmuv3->base_addr, offset_irq_ctrl, irq_ctrl);
+
+	if (!smmuv3_poll(smmuv3->base_addr, offset_irq_ctrlack, irq_ctrl,
+			 EVENTQ_IRQEN_MASK)) {
+		dlog_error("SMMUv3: Failed to enable event queue interrupt\n");
+		return false;
+	}
+
+	return true;
+}
+
 static bool smmuv3_enable_init(struct smmuv3_driver *smmuv3)
 {
 	uint32_t offset_cr0;
@@ -1114,6 +923,10 @@ static bool smmuv3_enable_init(struct smmuv3_driver *smmuv3)
 		return false;
 	}
 
+	if (SMMUV3_EVTQ_IRQ && !smmuv3_enable_evtq_irq(smmuv3)) {
+		return false;
+	}
+
 	/* Invalidate cached configurations and TLBs */
 	if (!smmuv3_inv_cfg_tlbs(smmuv3)) {
 		return false;
@@ -1156,6 +969,7 @@ bool smmuv3_driver_init(struct smmuv3_driver *smmuv3, uintpaddr_t base,
 	smmuv3->base_addr = base_addr;
 	smmuv3->smmu_id = smmu_instance;
 	smmu_instance++;
+	smmuv3_fault_stats_init(&smmuv3->faults);
 
 	if (!smmuv3_reset(smmuv3)) {
 		return false;
@@ -1302,27 +1116,79 @@ static bool smmuv3_config_ste_stg2(struct smmuv3_driver *smmuv3, struct vm *vm,
 	return true;
 }
 
-static bool smmuv3_configure_stream(struct smmuv3_driver *smmuv3,
-				    struct vm_locked locked_vm, uint32_t sid)
+/*
+ * Returns the TLB invalidations pending for the VM, or NULL if none of its
+ * streams have been configured.
+ */
+static struct smmuv3_tlbi_ranges *smmuv3_vm_tlbi_ranges(
+	struct smmuv3_driver *smmuv3, ffa_vm_id_t vm_id)
+{
+	uint32_t i;
+
+	for (i = 0; i < smmuv3->vm_tlbi_count; i++) {
+		if (smmuv3->vm_tlbi[i].vm_id == vm_id) {
+			return &smmuv3->vm_tlbi[i].ranges;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Starts recording the changes to the stage 2 translation of the VM, so that
+ * they can be invalidated from the TLB of the SMMU.
+ */
+static void smmuv3_vm_tlbi_track(struct smmuv3_driver *smmuv3,
+				 ffa_vm_id_t vm_id)
+{
+	struct smmuv3_vm_tlbi *vm_tlbi;
+
+	if (smmuv3_vm_tlbi_ranges(smmuv3, vm_id) != NULL) {
+		return;
+	}
+
+	CHECK(smmuv3->vm_tlbi_count < MAX_VMS);
+	vm_tlbi = &smmuv3->vm_tlbi[smmuv3->vm_tlbi_count++];
+	vm_tlbi->vm_id = vm_id;
+	smmuv3_tlbi_ranges_init(&vm_tlbi->ranges);
+}
+
+/*
+ * Points the given streams at the stage 2 translation of the VM. Their cached
+ * configuration is invalidated for all of them at once, before and after their
+ * stream table entries are written.
+ */
+static bool smmuv3_configure_streams(struct smmuv3_driver *smmuv3,
+				     struct vm_locked locked_vm,
+				     const uint32_t *sids, uint32_t sid_count,
+				     struct mpool *ppool)
 {
 	track_cmdq_idx(smmuv3);
 
 	/* Each stream table entry is 64 bytes wide i.e., 8 Double Words*/
 	uint64_t ste_data[STE_SIZE_DW];
-	uint64_t *ste_addr;
-	uint32_t max_sid;
+	uint64_t *ste_addrs[PARTITION_MAX_STREAMS_PER_DEVICE];
+	uint32_t i;
 	struct vm *vm;
 
 	vm = locked_vm.vm;
-	max_sid = (1 << smmuv3->prop.stream_n_bits) - 1;
 
-	if (sid > max_sid) {
-		dlog_error("SMMUv3: Illegal streamID specified: %u\n", sid);
-		return false;
+	CHECK(sid_count <= PARTITION_MAX_STREAMS_PER_DEVICE);
+
+	/*
+	 * Find the STEs of the streams first, allocating the level 2 arrays of
+	 * their spans if needed.
+	 */
+	for (i = 0; i < sid_count; i++) {
+		ste_addrs[i] = smmuv3_strtab_get_ste(&smmuv3->strtab_cfg,
+						     sids[i], ppool);
+		if (ste_addrs[i] == NULL) {
+			return false;
+		}
 	}
 
 	/* Refer Note 1 */
-	if (!inval_cached_STE(smmuv3, sid)) {
+	if (!inval_cached_STEs(smmuv3, sids, sid_count)) {
 		return false;
 	}
 
@@ -1331,12 +1197,25 @@ static bool smmuv3_configure_stream(struct smmuv3_driver *smmuv3,
 		return false;
 	}
 
-	/* StreamID serves as an index into Stream Table */
-	ste_addr = (uint64_t *)smmuv3->strtab_cfg.base + sid * STE_SIZE_DW;
-	write_ste(ste_addr, ste_data);
+	for (i = 0; i < sid_count; i++) {
+		smmuv3_write_ste(ste_addrs[i], ste_data);
+	}
+
+	smmuv3_vm_tlbi_track(smmuv3, vm->id);
+
+	sl_lock(&evtq_lock);
+	for (i = 0; i < sid_count; i++) {
+		if (!smmuv3_fault_stats_add_stream(&smmuv3->faults, sids[i],
+						   vm->id)) {
+			dlog_warning(
+				"SMMUv3: Faults of streamID %u not counted\n",
+				sids[i]);
+		}
+	}
+	sl_unlock(&evtq_lock);
 
 	/* Refer Note 1 */
-	if (!inval_cached_STE(smmuv3, sid)) {
+	if (!inval_cached_STEs(smmuv3, sids, sid_count)) {
 		return false;
 	}
 
@@ -1369,9 +1248,168 @@ bool plat_iommu_unmap_iommus(struct vm_locked vm_locked, struct mpool *ppool)
 	return true;
 }
 
+/*
+ * The stage 2 translation of the VM is shared with its streams, so only the
+ * TLB of the SMMU needs maintaining. The range is recorded for the TLB entries
+ * to be invalidated by `plat_iommu_sync`, together with the other ranges
+ * changed by the same operation.
+ */
 void plat_iommu_identity_map(struct vm_locked vm_locked, paddr_t begin,
 			     paddr_t end, uint32_t mode)
 {
+	struct smmuv3_tlbi_ranges *ranges =
+		smmuv3_vm_tlbi_ranges(&arm_smmuv3, vm_locked.vm->id);
+
+	(void)mode;
+
+	if (ranges != NULL) {
+		smmuv3_tlbi_ranges_add(ranges, pa_addr(begin), pa_addr(end));
+	}
+}
+
+/*
+ * Invalidates the TLB entries of the ranges recorded for the VM, with a single
+ * CMD_SYNC for all of them.
+ */
+void plat_iommu_sync(struct vm_locked vm_locked)
+{
+	struct smmuv3_tlbi_ranges *ranges =
+		smmuv3_vm_tlbi_ranges(&arm_smmuv3, vm_locked.vm->id);
+	struct smmuv3_cmd_batch batch;
+	bool ret;
+
+	if (ranges == NULL || ranges->count == 0) {
+		return;
+	}
+
+	/* Commands are written to the queue as soon as the batch fills up. */
+	sl_lock(&cmdq_lock);
+	smmuv3_cmd_batch_init(&batch, &arm_smmuv3.cmd_queue);
+	smmuv3_tlbi_ranges_flush(ranges, &batch, vm_locked.vm->id,
+				 arm_smmuv3.prop.range_inv);
+	ret = smmuv3_cmd_batch_complete(&arm_smmuv3, &batch);
+	sl_unlock(&cmdq_lock);
+
+	if (!ret) {
+		panic("SMMUv3: Failed to invalidate TLB entries of VM %#x\n",
+		      vm_locked.vm->id);
+	}
+}
+
+/*
+ * Raises the HF_IOMMU_FAULT_INTID virtual interrupt in the VM, on its vCPU for
+ * the current CPU or on its first vCPU if it has fewer vCPUs than there are
+ * CPUs. It is only taken if the VM has enabled it.
+ */
+static void smmuv3_report_faults(ffa_vm_id_t vm_id, struct vcpu *current)
+{
+	struct vm *vm = vm_find(vm_id);
+	ffa_vcpu_index_t vcpu_index;
+	struct vcpu *vcpu;
+	struct vcpu_locked vcpu_locked;
+
+	CHECK(vm != NULL);
+
+	vcpu_index = cpu_index(current->cpu);
+	if (vcpu_index >= vm->vcpu_count) {
+		vcpu_index = 0;
+	}
+
+	vcpu = vm_get_vcpu(vm, vcpu_index);
+	vcpu_locked = vcpu_lock(vcpu);
+	(void)api_interrupt_inject_locked(vcpu_locked, HF_IOMMU_FAULT_INTID,
+					  current, NULL);
+	vcpu_unlock(&vcpu_locked);
+}
+
+/*
+ * Reads the events the SMMU has written to the event queue into the fault
+ * counters, and lets the VMs with new faults know about them.
+ */
+static void smmuv3_service_evtq(struct smmuv3_driver *smmuv3,
+				struct vcpu *current)
+{
+	uint32_t i;
+
+	sl_lock(&evtq_lock);
+
+	/*
+	 * Faults may also have been picked up by `plat_iommu_fault_count`
+	 * since the interrupt was raised, so report all those unreported.
+	 */
+	smmuv3_evtq_drain(&smmuv3->evt_queue, &smmuv3->faults);
+
+	for (i = 0; i < smmuv3->faults.vm_count; i++) {
+		struct smmuv3_vm_faults *vm_faults = &smmuv3->faults.vms[i];
+
+		if (vm_faults->unreported == 0) {
+			continue;
+		}
+
+		dlog_verbose("SMMUv3: %u new faults for VM %#x\n",
+			     vm_faults->unreported, vm_faults->vm_id);
+		smmuv3_report_faults(vm_faults->vm_id, current);
+		vm_faults->unreported = 0;
+	}
+
+	sl_unlock(&evtq_lock);
+}
+
+bool plat_iommu_handle_interrupt(uint32_t intid, struct vcpu *current)
+{
+	if (!SMMUV3_EVTQ_IRQ || intid != SMMUv3_EVTQ_INTID) {
+		return false;
+	}
+
+	smmuv3_service_evtq(&arm_smmuv3, current);
+
+	return true;
+}
+
+uint64_t plat_iommu_fault_count(ffa_vm_id_t vm_id)
+{
+	struct smmuv3_vm_faults *vm_faults;
+	uint64_t count = 0;
+
+	/*
+	 * Pick up the events which haven't been signalled yet, leaving them to
+	 * be reported to the VMs by the event queue interrupt, if any, so that
+	 * querying the counters has no effect on the VMs.
+	 */
+	sl_lock(&evtq_lock);
+	smmuv3_evtq_drain(&arm_smmuv3.evt_queue, &arm_smmuv3.faults);
+	vm_faults = smmuv3_fault_stats_get_vm(&arm_smmuv3.faults, vm_id);
+	if (vm_faults != NULL) {
+		count = vm_faults->count;
+	}
+	sl_unlock(&evtq_lock);
+
+	return count;
+}
+
+/*
+ * Routes the event queue interrupt to the SPMC, once there are streams whose
+ * faults it may report.
+ */
+static void smmuv3_configure_evtq_irq(void)
+{
+	static bool configured;
+	struct interrupt_descriptor int_desc;
+
+	if (!SMMUV3_EVTQ_IRQ || configured) {
+		return;
+	}
+
+	interrupt_desc_set_id(&int_desc, SMMUv3_EVTQ_INTID);
+	interrupt_desc_set_priority(&int_desc, SMMUV3_EVTQ_IRQ_PRIORITY);
+	interrupt_desc_set_valid(&int_desc, true);
+
+	/* Configure the interrupt as a secure, edge triggered SPI. */
+	interrupt_desc_set_type_config_sec_state(&int_desc,
+						 (INT_DESC_TYPE_SPI << 2) | 1);
+
+	plat_interrupts_configure_interrupt(int_desc);
+	configured = true;
 }
 
 bool plat_iommu_attach_peripheral(struct mm_stage1_locked stage1_locked,
@@ -1380,10 +1418,8 @@ bool plat_iommu_attach_peripheral(struct mm_stage1_locked stage1_locked,
 				  struct mpool *ppool)
 {
 	(void)stage1_locked;
-	(void)ppool;
 
 	unsigned int i;
-	unsigned int j;
 
 	struct device_region upstream_peripheral;
 
@@ -1418,27 +1454,30 @@ bool plat_iommu_attach_peripheral(struct mm_stage1_locked stage1_locked,
 		}
 
 		if (upstream_peripheral.stream_count >
-		    (1 << arm_smmuv3.prop.stream_n_bits)) {
+		    (1 << arm_smmuv3.strtab_cfg.stream_n_bits)) {
 			dlog_error(
 				"SMMUv3: Count of stream IDs exceeds the "
 				"limit of %u\n",
-				(1 << arm_smmuv3.prop.stream_n_bits));
+				(1 << arm_smmuv3.strtab_cfg.stream_n_bits));
 			return false;
 		}
 
 		dlog_verbose("stream_count of upstream peripheral device: %u\n",
 			     upstream_peripheral.stream_count);
 
-		for (j = 0; j < upstream_peripheral.stream_count; j++) {
-			if (!smmuv3_configure_stream(
-				    &arm_smmuv3, vm_locked,
-				    upstream_peripheral.stream_ids[j])) {
-				dlog_error(
-					"SMMUv3: Could not configure "
-					"streamID: %u",
-					j);
-				return false;
-			}
+		if (!smmuv3_configure_streams(
+			    &arm_smmuv3, vm_locked,
+			    upstream_peripheral.stream_ids,
+			    upstream_peripheral.stream_count, ppool)) {
+			dlog_error(
+				"SMMUv3: Could not configure streamIDs of "
+				"device region %u\n",
+				i);
+			return false;
+		}
+
+		if (upstream_peripheral.stream_count > 0) {
+			smmuv3_configure_evtq_irq();
 		}
 	}
 
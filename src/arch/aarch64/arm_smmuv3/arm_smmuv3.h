@@ -6,6 +6,8 @@
  * https://opensource.org/licenses/BSD-3-Clause.
  */
 
+#pragma once
+
 #include "hf/plat/iommu.h"
 
 #define EXTRACT(data, shift, mask) (((data) >> (shift)) & (mask))
@@ -16,6 +18,7 @@
 /* Offset of SMMUv3 registers */
 #define IDR0 0x0
 #define IDR1 0x4
+#define IDR3 0xc
 #define GBPA 0x44
 #define GERROR 0x60
 #define GERRORN 0x64
@@ -25,6 +28,8 @@
 #define CR0_ACK 0x024
 #define CR1 0x028
 #define CR2 0x02c
+#define IRQ_CTRL 0x050
+#define IRQ_CTRLACK 0x054
 #define STRTAB_BASE 0x080
 #define STRTAB_BASE_CFG 0x088
 #define CMDQ_BASE 0x090
@@ -44,6 +49,8 @@
 #define S_CR2 0x802c
 #define S_CR0_ACK 0x8024
 #define S_INIT 0x803c
+#define S_IRQ_CTRL 0x8050
+#define S_IRQ_CTRLACK 0x8054
 #define S_STRTAB_BASE 0x8080
 #define S_STRTAB_BASE_CFG 0x8088
 #define S_CMDQ_BASE 0x8090
@@ -80,7 +87,10 @@
 #define RA_HINT_SHIFT (62)
 #define WA_HINT_SHIFT (62)
 #define STR_FMT_SHIFT (16)
+#define STR_SPLIT_SHIFT (6)
 #define WRAP_MASK (1)
+#define RIL_SHIFT (14)
+#define RIL_MASK (1)
 
 /* Command Error codes and fields */
 #define CMDQ_ERRORCODE_SHIFT (24)
@@ -104,6 +114,18 @@
 #define S_STREAM (1)
 #define NS_STREAM (0)
 
+/* Fields of the TLB invalidation commands */
+#define CMD_NUM_SHIFT 12
+#define CMD_NUM_MASK (0x1F)
+#define CMD_SCALE_SHIFT 20
+#define CMD_SCALE_MASK (0x1F)
+#define CMD_VMID_SHIFT 32
+#define CMD_VMID_MASK (0xFFFF)
+#define CMD_TG_SHIFT 10
+#define CMD_TG_MASK (0x3)
+#define CMD_TG_4KB 1
+#define CMD_ADDR_MASK GEN_MASK(63, 12)
+
 /* Completion Signal */
 #define CSIGNAL_NONE (0)
 #define CSIGNAL_SHIFT 12
@@ -113,6 +135,8 @@
 #define OP_CFGI_ALL 0x04
 #define OP_CFGI_STE 0x03
 #define OP_TLBI_EL2_ALL 0x20
+#define OP_TLBI_S12_VMALL 0x28
+#define OP_TLBI_S2_IPA 0x2a
 #define OP_TLBI_NSNH_ALL 0x30
 #define OP_CMD_SYNC 0x46
 #define OP_TLBI_SEL2_ALL 0x50
@@ -149,6 +173,7 @@
 #define SEL2_STG2_SUPPORT (1 << 29)
 #define CMDQEN_MASK (1 << 3)
 #define EVTQEN_MASK (1 << 2)
+#define EVENTQ_IRQEN_MASK (1 << 2)
 #define SMMUEN_MASK (1 << 0)
 #define SMMU_ENABLE (1 << 0)
 #define SMMUEN_CLR_MASK (0xFFFFFFFE)
@@ -160,9 +185,33 @@
 #define CMD_SIZE 16
 #define CMD_SIZE_DW (CMD_SIZE / 8)
 #define EVT_RECORD_SIZE 32
+#define EVT_RECORD_SIZE_DW (EVT_RECORD_SIZE / 8)
 #define STE_SIZE 64
 #define STE_SIZE_DW (STE_SIZE / 8)
 
+/*
+ * Two-level stream table: each level 1 descriptor points to an array of
+ * 1 << STRTAB_SPLIT STEs, which fills a page, and there are at most
+ * 1 << STRTAB_L1_MAX_LOG2 of them.
+ */
+#define STRTAB_SPLIT 6
+#define STRTAB_L1_MAX_LOG2 10
+#define L1STD_SIZE 8
+#define L1STD_SPAN_MASK 0x1f
+
+/* Event queue and event record fields */
+#define EVTQ_OVFLG_MASK (1U << 31)
+#define EVT_ID_SHIFT 0
+#define EVT_ID_MASK 0xFF
+#define EVT_SID_SHIFT 32
+#define EVT_SID_MASK 0xFFFFFFFF
+
+/* Event types reporting a fault translating an input address */
+#define EVT_F_TRANSLATION 0x10
+#define EVT_F_ADDR_SIZE 0x11
+#define EVT_F_ACCESS 0x12
+#define EVT_F_PERMISSION 0x13
+
 /* Global ByPass Attribute fields */
 #define BYPASS_GBPA 0
 #define INCOMING_CFG 0
@@ -291,17 +340,119 @@ struct smmuv3_context_desc {
 };
 
 struct smmuv3_stream_table_config {
+	/* The STEs of a linear table, or the level 1 descriptors. */
 	void *base;
+	bool two_level;
+	uint32_t stream_n_bits;
+
+	/*
+	 * STEs given to streams of a two-level table which haven't had a level
+	 * 2 array of their own allocated, shared by all their spans.
+	 */
+	uint64_t *default_l2;
+
+	/* STE for the streams the driver hasn't configured. */
+	uint64_t default_ste[STE_SIZE_DW];
 };
 
 struct smmuv3_queue {
 	void *q_base;
+
+	/*
+	 * The consumer index last read from the CONS register and the producer
+	 * index last written to the PROD register, both with the wrap bit.
+	 * Only the driver writes PROD, so the cached value is always current
+	 * and CONS only needs reading again when the queue looks too full.
+	 */
 	uint32_t rd_idx, wr_idx;
 	uint32_t q_entries;
 	void *cons_reg_base;
 	void *prod_reg_base;
 };
 
+/* Number of commands gathered before they are written to the command queue. */
+#define SMMUV3_CMD_BATCH_MAX 16
+
+/*
+ * Commands gathered to be written to the command queue together, with a single
+ * update of the PROD register, and completed by a single CMD_SYNC.
+ */
+struct smmuv3_cmd_batch {
+	struct smmuv3_queue *cmdq;
+	uint64_t cmds[SMMUV3_CMD_BATCH_MAX][CMD_SIZE_DW];
+	uint32_t count;
+	bool failed;
+};
+
+/* Number of IPA ranges recorded before the closest ones are merged. */
+#define SMMUV3_TLBI_RANGES_MAX 8
+
+/*
+ * Number of TLBI_S2_IPA commands beyond which all the TLB entries of the VMID
+ * are invalidated instead.
+ */
+#define SMMUV3_TLBI_CMDS_MAX 32
+
+/*
+ * IPA ranges of a VM whose stage 2 translation changed, in ascending order and
+ * neither overlapping nor adjacent, waiting for their TLB entries to be
+ * invalidated.
+ */
+struct smmuv3_tlbi_ranges {
+	struct {
+		uint64_t begin;
+		uint64_t end;
+	} ranges[SMMUV3_TLBI_RANGES_MAX + 1];
+	uint32_t count;
+};
+
+/* TLB invalidations pending for a VM whose stage 2 translates streams. */
+struct smmuv3_vm_tlbi {
+	ffa_vm_id_t vm_id;
+	struct smmuv3_tlbi_ranges ranges;
+};
+
+/* Number of event records consumed before the CONS register is updated. */
+#define SMMUV3_EVTQ_BATCH_MAX 16
+
+/* Number of streams whose faults are counted individually. */
+#define SMMUV3_FAULT_STREAMS_MAX 64
+
+struct smmuv3_stream_faults {
+	uint32_t sid;
+	ffa_vm_id_t vm_id;
+	uint32_t count;
+
+	/*
+	 * Type of the last event recorded for the stream, and the input
+	 * address if it was a translation fault.
+	 */
+	uint8_t last_event;
+	uint64_t last_addr;
+};
+
+struct smmuv3_vm_faults {
+	ffa_vm_id_t vm_id;
+	uint32_t count;
+
+	/* Faults recorded since the VM was last told about them. */
+	uint32_t unreported;
+};
+
+/* Events read from the event queue, by stream and by VM. */
+struct smmuv3_fault_stats {
+	struct smmuv3_stream_faults streams[SMMUV3_FAULT_STREAMS_MAX];
+	uint32_t stream_count;
+	struct smmuv3_vm_faults vms[MAX_VMS];
+	uint32_t vm_count;
+
+	/* Events of streams which aren't attached to a VM. */
+	uint32_t unattributed;
+
+	/* Number of times the event queue overflowed and events were lost. */
+	uint32_t overflows;
+};
+
 struct smmuv3_features {
 	bool linear_str_table;
 	bool lvl2_str_table;
@@ -317,6 +468,7 @@ struct smmuv3_features {
 	uint64_t oas;
 	uint32_t oas_encoding;
 	uint32_t minor_version;
+	bool range_inv;
 };
 
 struct smmuv3_driver {
@@ -326,6 +478,9 @@ struct smmuv3_driver {
 	struct smmuv3_queue cmd_queue;
 	struct smmuv3_queue evt_queue;
 	struct smmuv3_stream_table_config strtab_cfg;
+	struct smmuv3_vm_tlbi vm_tlbi[MAX_VMS];
+	uint32_t vm_tlbi_count;
+	struct smmuv3_fault_stats faults;
 };
 
 #include "hf/io.h"
@@ -361,3 +516,45 @@ static inline void mmio_write64_offset(void *addr, uint32_t offset,
 {
 	io_write64(io64_c((uintpaddr_t)addr, offset), data);
 }
+
+void smmuv3_cmdq_init(struct smmuv3_queue *cmdq, void *q_base,
+		      uint32_t entries_log2, void *prod_reg_base,
+		      void *cons_reg_base);
+bool smmuv3_cmdq_publish(struct smmuv3_queue *cmdq,
+			 uint64_t (*cmds)[CMD_SIZE_DW], uint32_t count);
+bool smmuv3_cmdq_wait_consumed(struct smmuv3_queue *cmdq);
+
+void smmuv3_cmd_batch_init(struct smmuv3_cmd_batch *batch,
+			   struct smmuv3_queue *cmdq);
+uint64_t *smmuv3_cmd_batch_next(struct smmuv3_cmd_batch *batch);
+bool smmuv3_cmd_batch_submit(struct smmuv3_cmd_batch *batch);
+bool smmuv3_cmd_batch_sync(struct smmuv3_cmd_batch *batch);
+
+bool smmuv3_strtab_init(struct smmuv3_stream_table_config *strtab,
+			uint32_t stream_n_bits, bool two_level,
+			struct mpool *pool);
+uint32_t smmuv3_strtab_base_cfg(
+	const struct smmuv3_stream_table_config *strtab);
+void smmuv3_strtab_set_default(struct smmuv3_stream_table_config *strtab,
+			       const uint64_t *ste);
+uint64_t *smmuv3_strtab_get_ste(struct smmuv3_stream_table_config *strtab,
+				uint32_t sid, struct mpool *pool);
+void smmuv3_write_ste(uint64_t *st_entry, const uint64_t *data);
+
+void smmuv3_tlbi_ranges_init(struct smmuv3_tlbi_ranges *ranges);
+void smmuv3_tlbi_ranges_add(struct smmuv3_tlbi_ranges *ranges, uint64_t begin,
+			    uint64_t end);
+uint32_t smmuv3_tlbi_ranges_flush(struct smmuv3_tlbi_ranges *ranges,
+				  struct smmuv3_cmd_batch *batch, uint16_t vmid,
+				  bool range_inv);
+
+void smmuv3_evtq_init(struct smmuv3_queue *evtq, void *q_base,
+		      uint32_t entries_log2, void *prod_reg_base,
+		      void *cons_reg_base);
+uint32_t smmuv3_evtq_drain(struct smmuv3_queue *evtq,
+			   struct smmuv3_fault_stats *stats);
+void smmuv3_fault_stats_init(struct smmuv3_fault_stats *stats);
+bool smmuv3_fault_stats_add_stream(struct smmuv3_fault_stats *stats,
+				   uint32_t sid, ffa_vm_id_t vm_id);
+struct smmuv3_vm_faults *smmuv3_fault_stats_get_vm(
+	struct smmuv3_fault_stats *stats, ffa_vm_id_t vm_id);
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/arch/barriers.h"
+
+#include "hf/dlog.h"
+
+#include "arm_smmuv3.h"
+
+#define CMDQ_MAX_ATTEMPTS 100000
+
+/**
+ * Returns the mask of the bits of the PROD and CONS registers holding the
+ * index and the wrap bit, leaving out the error code of CONS.
+ */
+static inline uint32_t cmdq_idx_mask(const struct smmuv3_queue *cmdq)
+{
+	return (cmdq->q_entries << 1) - 1;
+}
+
+/**
+ * Returns the number of free entries in the queue, going by the cached
+ * indices.
+ */
+static inline uint32_t cmdq_free_entries(const struct smmuv3_queue *cmdq)
+{
+	uint32_t used = (cmdq->wr_idx - cmdq->rd_idx) & cmdq_idx_mask(cmdq);
+
+	return cmdq->q_entries - used;
+}
+
+/**
+ * Updates the cached consumer index from the CONS register. Returns false if
+ * CONS reports a command error, as the SMMU stops consuming the queue until the
+ * error is handled so there is no point waiting for it.
+ */
+static bool cmdq_read_cons(struct smmuv3_queue *cmdq)
+{
+	uint32_t cons = mmio_read32(cmdq->cons_reg_base);
+	uint32_t err = EXTRACT(cons, CMDQ_ERRORCODE_SHIFT, CMDQ_ERRORCODE_MASK);
+
+	cmdq->rd_idx = cons & cmdq_idx_mask(cmdq);
+
+	if (err != CERROR_NONE) {
+		dlog_error("SMMUv3: Command queue error %u; CONS: %x\n", err,
+			   cmdq->rd_idx);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Waits until `count` entries of the queue are free, only reading the CONS
+ * register when the cached consumer index doesn't leave enough of them.
+ */
+static bool cmdq_reserve(struct smmuv3_queue *cmdq, uint32_t count)
+{
+	uint32_t attempts = 0;
+
+	while (cmdq_free_entries(cmdq) < count) {
+		if (attempts++ >= CMDQ_MAX_ATTEMPTS) {
+			dlog_error("SMMUv3: Command queue full; CONS: %x\n",
+				   cmdq->rd_idx);
+			return false;
+		}
+
+		if (!cmdq_read_cons(cmdq)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void smmuv3_cmdq_init(struct smmuv3_queue *cmdq, void *q_base,
+		      uint32_t entries_log2, void *prod_reg_base,
+		      void *cons_reg_base)
+{
+	cmdq->q_base = q_base;
+	cmdq->q_entries = 1U << entries_log2;
+	cmdq->prod_reg_base = prod_reg_base;
+	cmdq->cons_reg_base = cons_reg_base;
+	cmdq->rd_idx = 0;
+	cmdq->wr_idx = 0;
+
+	mmio_write32(cons_reg_base, 0);
+	mmio_write32(prod_reg_base, 0);
+}
+
+/**
+ * Writes the given commands to the command queue and makes them visible to the
+ * SMMU with a single update of the PROD register, or one for each time the
+ * queue fills up if there are more commands than it holds.
+ */
+bool smmuv3_cmdq_publish(struct smmuv3_queue *cmdq,
+			 uint64_t (*cmds)[CMD_SIZE_DW], uint32_t count)
+{
+	uint64_t *entries = (uint64_t *)cmdq->q_base;
+	uint32_t index_mask = cmdq->q_entries - 1;
+
+	while (count > 0) {
+		uint32_t n = count < cmdq->q_entries ? count : cmdq->q_entries;
+		uint32_t i;
+		uint32_t j;
+
+		if (!cmdq_reserve(cmdq, n)) {
+			return false;
+		}
+
+		for (i = 0; i < n; i++) {
+			uint64_t *entry =
+				&entries[((cmdq->wr_idx + i) & index_mask) *
+					 CMD_SIZE_DW];
+
+			for (j = 0; j < CMD_SIZE_DW; j++) {
+				entry[j] = cmds[i][j];
+			}
+		}
+
+		/* Ensure the commands are observable to the SMMU. */
+		data_sync_barrier();
+
+		cmdq->wr_idx = (cmdq->wr_idx + n) & cmdq_idx_mask(cmdq);
+		mmio_write32(cmdq->prod_reg_base, cmdq->wr_idx);
+
+		cmds += n;
+		count -= n;
+	}
+
+	return true;
+}
+
+/**
+ * Waits for the SMMU to consume all the commands written to the command queue.
+ */
+bool smmuv3_cmdq_wait_consumed(struct smmuv3_queue *cmdq)
+{
+	uint32_t attempts = 0;
+
+	while (cmdq->rd_idx != cmdq->wr_idx) {
+		if (attempts++ >= CMDQ_MAX_ATTEMPTS) {
+			dlog_error(
+				"SMMUv3: Timeout CMDQ; CONS_REG: %x; "
+				"PROD_REG: %x\n",
+				cmdq->rd_idx, cmdq->wr_idx);
+			return false;
+		}
+
+		if (!cmdq_read_cons(cmdq)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void smmuv3_cmd_batch_init(struct smmuv3_cmd_batch *batch,
+			   struct smmuv3_queue *cmdq)
+{
+	batch->cmdq = cmdq;
+	batch->count = 0;
+	batch->failed = false;
+}
+
+/**
+ * Returns the entry of the batch to construct the next command in. The
+ * commands gathered so far are written to the command queue first if the batch
+ * is full, and any failure to do so is reported when the batch is submitted.
+ */
+uint64_t *smmuv3_cmd_batch_next(struct smmuv3_cmd_batch *batch)
+{
+	if (batch->count == SMMUV3_CMD_BATCH_MAX) {
+		if (!smmuv3_cmdq_publish(batch->cmdq, batch->cmds,
+					 batch->count)) {
+			batch->failed = true;
+		}
+		batch->count = 0;
+	}
+
+	return batch->cmds[batch->count++];
+}
+
+/**
+ * Ends the batch with a CMD_SYNC and writes its commands to the command queue.
+ * The batch is empty again afterwards.
+ *
+ * Returns false if any of the commands of the batch couldn't be written.
+ */
+bool smmuv3_cmd_batch_submit(struct smmuv3_cmd_batch *batch)
+{
+	uint64_t *cmd = smmuv3_cmd_batch_next(batch);
+	bool ret;
+
+	/*
+	 * CMD_SYNC waits for completion of all prior commands and ensures
+	 * observability of any related transactions through and from the SMMU.
+	 */
+	cmd[0] = COMPOSE(OP_CMD_SYNC, OP_SHIFT, OP_MASK);
+	cmd[0] |= COMPOSE(CSIGNAL_NONE, CSIGNAL_SHIFT, CSIGNAL_MASK);
+	cmd[1] = 0;
+
+	ret = !batch->failed &&
+	      smmuv3_cmdq_publish(batch->cmdq, batch->cmds, batch->count);
+
+	batch->count = 0;
+	batch->failed = false;
+
+	return ret;
+}
+
+/**
+ * Submits the batch and waits for the SMMU to complete its commands.
+ *
+ * Returns false if any of the commands of the batch couldn't be written or
+ * completed.
+ */
+bool smmuv3_cmd_batch_sync(struct smmuv3_cmd_batch *batch)
+{
+	return smmuv3_cmd_batch_submit(batch) &&
+	       smmuv3_cmdq_wait_consumed(batch->cmdq);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <vector>
+
+#include "queue_test.hh"
+
+namespace
+{
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+/**
+ * A model of the SMMU's side of the command queue, with a consumer standing in
+ * for the SMMU which records the commands it reads.
+ */
+class smmuv3_cmdq : public smmuv3_test::queue_model<5, CMD_SIZE_DW>
+{
+       protected:
+	void SetUp() override
+	{
+		smmuv3_cmdq_init(&cmdq, queue, QUEUE_ENTRIES_LOG2,
+				 (void *)&prod_reg, (void *)&cons_reg);
+	}
+
+	/** Consumes the commands published so far, as the SMMU would. */
+	void consume()
+	{
+		queue_model::consume([this](const uint64_t *cmd) {
+			consumed.push_back(cmd[0]);
+		});
+	}
+
+	static uint64_t cfgi_ste(uint32_t sid)
+	{
+		return COMPOSE(OP_CFGI_STE, OP_SHIFT, OP_MASK) |
+		       COMPOSE((uint64_t)sid, CMD_SID_SHIFT, CMD_SID_MASK);
+	}
+
+	static void construct_cfgi_ste(uint64_t *cmd, uint32_t sid)
+	{
+		cmd[0] = cfgi_ste(sid);
+		cmd[1] = LEAF_STE;
+	}
+
+	static uint64_t cmd_sync()
+	{
+		return COMPOSE(OP_CMD_SYNC, OP_SHIFT, OP_MASK);
+	}
+
+	struct smmuv3_queue cmdq;
+
+	std::vector<uint64_t> consumed;
+};
+
+/** Initialising the queue sizes it from the log2 of its entries. */
+TEST_F(smmuv3_cmdq, init)
+{
+	expect_indices_reset();
+	EXPECT_THAT(cmdq.q_entries, Eq(QUEUE_ENTRIES));
+}
+
+/** The commands are written in order and published with the PROD register. */
+TEST_F(smmuv3_cmdq, publish)
+{
+	uint64_t cmds[3][CMD_SIZE_DW];
+
+	for (uint32_t i = 0; i < 3; i++) {
+		construct_cfgi_ste(cmds[i], i + 10);
+	}
+
+	ASSERT_TRUE(smmuv3_cmdq_publish(&cmdq, cmds, 3));
+	EXPECT_THAT(prod_reg, Eq(3));
+	EXPECT_THAT(queue[0], Eq(cfgi_ste(10)));
+	EXPECT_THAT(queue[1], Eq(LEAF_STE));
+	EXPECT_THAT(queue[2 * CMD_SIZE_DW], Eq(cfgi_ste(12)));
+}
+
+/**
+ * CONS is only read when the cached consumer index doesn't leave enough free
+ * entries, and publishing fails if the SMMU doesn't make room.
+ */
+TEST_F(smmuv3_cmdq, publish_uses_cached_cons)
+{
+	uint64_t cmds[QUEUE_ENTRIES][CMD_SIZE_DW] = {};
+
+	ASSERT_TRUE(smmuv3_cmdq_publish(&cmdq, cmds, QUEUE_ENTRIES - 2));
+
+	/* Reading CONS now would make the queue look full. */
+	cons_reg = (QUEUE_ENTRIES - 2 - QUEUE_ENTRIES) & IDX_MASK;
+	ASSERT_TRUE(smmuv3_cmdq_publish(&cmdq, cmds, 2));
+	EXPECT_THAT(prod_reg, Eq(QUEUE_ENTRIES));
+
+	/* The queue is full and the SMMU hasn't consumed any of it. */
+	cons_reg = 0;
+	EXPECT_FALSE(smmuv3_cmdq_publish(&cmdq, cmds, 1));
+	EXPECT_THAT(prod_reg, Eq(QUEUE_ENTRIES));
+}
+
+/**
+ * An error code in CONS means the SMMU has stopped consuming the queue, so
+ * waiting for it to make room or to consume the commands fails straight away.
+ */
+TEST_F(smmuv3_cmdq, cons_error_fails)
+{
+	uint64_t cmds[QUEUE_ENTRIES][CMD_SIZE_DW] = {};
+
+	ASSERT_TRUE(smmuv3_cmdq_publish(&cmdq, cmds, QUEUE_ENTRIES));
+
+	cons_reg = COMPOSE(CERROR_ILL, CMDQ_ERRORCODE_SHIFT,
+			   CMDQ_ERRORCODE_MASK) |
+		   1;
+	EXPECT_FALSE(smmuv3_cmdq_wait_consumed(&cmdq));
+	EXPECT_FALSE(smmuv3_cmdq_publish(&cmdq, cmds, 2));
+	EXPECT_THAT(prod_reg, Eq(QUEUE_ENTRIES));
+}
+
+/**
+ * A batch larger than the batch buffer is consumed in order and completed by a
+ * single CMD_SYNC, wrapping around the queue the second time.
+ */
+TEST_F(smmuv3_cmdq, batch_single_sync)
+{
+	constexpr uint32_t count = SMMUV3_CMD_BATCH_MAX + 5;
+	struct smmuv3_cmd_batch batch;
+	std::vector<uint64_t> expected;
+
+	smmuv3_cmd_batch_init(&batch, &cmdq);
+
+	for (uint32_t round = 0; round < 2; round++) {
+		consumed.clear();
+		expected.clear();
+
+		for (uint32_t i = 0; i < count; i++) {
+			construct_cfgi_ste(smmuv3_cmd_batch_next(&batch), i);
+			expected.push_back(cfgi_ste(i));
+		}
+		expected.push_back(cmd_sync());
+
+		ASSERT_TRUE(smmuv3_cmd_batch_submit(&batch));
+		consume();
+		ASSERT_TRUE(smmuv3_cmdq_wait_consumed(&cmdq));
+
+		EXPECT_THAT(consumed, Eq(expected));
+		EXPECT_THAT(cmdq.rd_idx,
+			    Eq(((round + 1) * (count + 1)) & IDX_MASK));
+		EXPECT_THAT(cmdq.wr_idx, Eq(cmdq.rd_idx));
+	}
+}
+
+/** A full queue is made room in as the SMMU consumes it. */
+TEST_F(smmuv3_cmdq, batch_waits_for_room)
+{
+	struct smmuv3_cmd_batch batch;
+
+	smmuv3_cmd_batch_init(&batch, &cmdq);
+
+	for (uint32_t i = 0; i < QUEUE_ENTRIES - 1; i++) {
+		construct_cfgi_ste(smmuv3_cmd_batch_next(&batch), i);
+	}
+	ASSERT_TRUE(smmuv3_cmd_batch_submit(&batch));
+	EXPECT_THAT(prod_reg, Eq(QUEUE_ENTRIES));
+
+	construct_cfgi_ste(smmuv3_cmd_batch_next(&batch), 42);
+	EXPECT_FALSE(smmuv3_cmd_batch_submit(&batch));
+
+	consume();
+	construct_cfgi_ste(smmuv3_cmd_batch_next(&batch), 42);
+	ASSERT_TRUE(smmuv3_cmd_batch_submit(&batch));
+	consume();
+	EXPECT_THAT(std::vector<uint64_t>(consumed.end() - 2, consumed.end()),
+		    ElementsAre(cfgi_ste(42), cmd_sync()));
+}
+
+/** A batch fails to sync if the SMMU never consumes its commands. */
+TEST_F(smmuv3_cmdq, batch_sync_timeout)
+{
+	struct smmuv3_cmd_batch batch;
+
+	smmuv3_cmd_batch_init(&batch, &cmdq);
+	construct_cfgi_ste(smmuv3_cmd_batch_next(&batch), 0);
+
+	EXPECT_FALSE(smmuv3_cmd_batch_sync(&batch));
+	EXPECT_THAT(prod_reg, Eq(2));
+}
+
+} /* namespace */
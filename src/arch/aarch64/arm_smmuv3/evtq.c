@@ -0,0 +1,217 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/arch/barriers.h"
+
+#include "hf/dlog.h"
+
+#include "arm_smmuv3.h"
+
+/**
+ * Returns the mask of the bits of the PROD and CONS registers holding the
+ * index and the wrap bit, leaving out the overflow flags.
+ */
+static inline uint32_t evtq_idx_mask(const struct smmuv3_queue *evtq)
+{
+	return (evtq->q_entries << 1) - 1;
+}
+
+void smmuv3_evtq_init(struct smmuv3_queue *evtq, void *q_base,
+		      uint32_t entries_log2, void *prod_reg_base,
+		      void *cons_reg_base)
+{
+	evtq->q_base = q_base;
+	evtq->q_entries = 1U << entries_log2;
+	evtq->prod_reg_base = prod_reg_base;
+	evtq->cons_reg_base = cons_reg_base;
+	evtq->rd_idx = 0;
+	evtq->wr_idx = 0;
+
+	mmio_write32(prod_reg_base, 0);
+	mmio_write32(cons_reg_base, 0);
+}
+
+void smmuv3_fault_stats_init(struct smmuv3_fault_stats *stats)
+{
+	stats->stream_count = 0;
+	stats->vm_count = 0;
+	stats->unattributed = 0;
+	stats->overflows = 0;
+}
+
+/**
+ * Returns the fault counters of the VM, or NULL if none of its streams are
+ * counted.
+ */
+struct smmuv3_vm_faults *smmuv3_fault_stats_get_vm(
+	struct smmuv3_fault_stats *stats, ffa_vm_id_t vm_id)
+{
+	uint32_t i;
+
+	for (i = 0; i < stats->vm_count; i++) {
+		if (stats->vms[i].vm_id == vm_id) {
+			return &stats->vms[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct smmuv3_stream_faults *fault_stats_get_stream(
+	struct smmuv3_fault_stats *stats, uint32_t sid)
+{
+	uint32_t i;
+
+	for (i = 0; i < stats->stream_count; i++) {
+		if (stats->streams[i].sid == sid) {
+			return &stats->streams[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Starts counting the events of the stream, and attributing them to the VM
+ * its transactions are translated for. Reattaching a stream moves its future
+ * events to the new VM.
+ *
+ * Returns false if there are already too many streams being counted, in which
+ * case the events of the stream count as unattributed.
+ */
+bool smmuv3_fault_stats_add_stream(struct smmuv3_fault_stats *stats,
+				   uint32_t sid, ffa_vm_id_t vm_id)
+{
+	struct smmuv3_stream_faults *stream =
+		fault_stats_get_stream(stats, sid);
+	struct smmuv3_vm_faults *vm = smmuv3_fault_stats_get_vm(stats, vm_id);
+
+	if (vm == NULL) {
+		if (stats->vm_count == MAX_VMS) {
+			return false;
+		}
+
+		vm = &stats->vms[stats->vm_count++];
+		vm->vm_id = vm_id;
+		vm->count = 0;
+		vm->unreported = 0;
+	}
+
+	if (stream == NULL) {
+		if (stats->stream_count == SMMUV3_FAULT_STREAMS_MAX) {
+			return false;
+		}
+
+		stream = &stats->streams[stats->stream_count++];
+		stream->sid = sid;
+		stream->count = 0;
+		stream->last_event = 0;
+		stream->last_addr = 0;
+	}
+
+	stream->vm_id = vm_id;
+
+	return true;
+}
+
+/** Counts the event against its stream and the VM the stream is attached to. */
+static void fault_stats_record(struct smmuv3_fault_stats *stats,
+			       const uint64_t *record)
+{
+	uint32_t sid = EXTRACT(record[0], EVT_SID_SHIFT, EVT_SID_MASK);
+	uint8_t type = EXTRACT(record[0], EVT_ID_SHIFT, EVT_ID_MASK);
+	struct smmuv3_stream_faults *stream =
+		fault_stats_get_stream(stats, sid);
+	struct smmuv3_vm_faults *vm;
+
+	if (stream == NULL) {
+		stats->unattributed++;
+		return;
+	}
+
+	stream->count++;
+	stream->last_event = type;
+
+	switch (type) {
+	case EVT_F_TRANSLATION:
+	case EVT_F_ADDR_SIZE:
+	case EVT_F_ACCESS:
+	case EVT_F_PERMISSION:
+		stream->last_addr = record[2];
+		break;
+	default:
+		stream->last_addr = 0;
+		break;
+	}
+
+	vm = smmuv3_fault_stats_get_vm(stats, stream->vm_id);
+	vm->count++;
+	vm->unreported++;
+}
+
+/**
+ * Reads all the event records the SMMU has written to the event queue, and
+ * counts them in `stats`.
+ *
+ * The records are consumed in batches of up to `SMMUV3_EVTQ_BATCH_MAX`, with a
+ * single read of the PROD register and write of the CONS register each, until
+ * the queue is empty. An overflow of the queue is counted and acknowledged
+ * along with the next batch.
+ *
+ * Returns the number of records read.
+ */
+uint32_t smmuv3_evtq_drain(struct smmuv3_queue *evtq,
+			   struct smmuv3_fault_stats *stats)
+{
+	const uint64_t *entries = (const uint64_t *)evtq->q_base;
+	uint32_t index_mask = evtq->q_entries - 1;
+	uint32_t acked = mmio_read32(evtq->cons_reg_base) & EVTQ_OVFLG_MASK;
+	uint32_t ovack = acked;
+	uint32_t total = 0;
+
+	for (;;) {
+		uint32_t prod = mmio_read32(evtq->prod_reg_base);
+		uint32_t count = 0;
+
+		if ((prod & EVTQ_OVFLG_MASK) != ovack) {
+			dlog_warning("SMMUv3: Event queue overflowed\n");
+			stats->overflows++;
+			ovack = prod & EVTQ_OVFLG_MASK;
+		}
+
+		evtq->wr_idx = prod & evtq_idx_mask(evtq);
+		if (evtq->rd_idx == evtq->wr_idx) {
+			break;
+		}
+
+		/* Don't read the records before the SMMU has written them. */
+		data_sync_barrier();
+
+		while (evtq->rd_idx != evtq->wr_idx &&
+		       count < SMMUV3_EVTQ_BATCH_MAX) {
+			fault_stats_record(
+				stats, &entries[(evtq->rd_idx & index_mask) *
+						EVT_RECORD_SIZE_DW]);
+			evtq->rd_idx =
+				(evtq->rd_idx + 1) & evtq_idx_mask(evtq);
+			count++;
+		}
+
+		/* Hand the entries back to the SMMU. */
+		mmio_write32(evtq->cons_reg_base, evtq->rd_idx | ovack);
+		acked = ovack;
+		total += count;
+	}
+
+	/* Acknowledge an overflow even if it left no records to read. */
+	if (acked != ovack) {
+		mmio_write32(evtq->cons_reg_base, evtq->rd_idx | ovack);
+	}
+
+	return total;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "queue_test.hh"
+
+namespace
+{
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+constexpr ffa_vm_id_t VM_A = 0x8001;
+constexpr ffa_vm_id_t VM_B = 0x8002;
+
+/**
+ * A fake SMMU writing event records to the event queue, and the counters they
+ * are read into.
+ */
+class smmuv3_evtq : public smmuv3_test::queue_model<5, EVT_RECORD_SIZE_DW>
+{
+       protected:
+	void SetUp() override
+	{
+		smmuv3_evtq_init(&evtq, queue, QUEUE_ENTRIES_LOG2,
+				 (void *)&prod_reg, (void *)&cons_reg);
+		smmuv3_fault_stats_init(&stats);
+	}
+
+	/**
+	 * Writes an event record for the stream as the SMMU would, or drops it
+	 * if the queue is full and flags an overflow unless one is already
+	 * waiting to be acknowledged.
+	 */
+	void produce(uint8_t type, uint32_t sid, uint64_t addr = 0)
+	{
+		uint32_t prod = prod_reg & IDX_MASK;
+		uint32_t cons = cons_reg & IDX_MASK;
+		uint64_t *record;
+
+		if (((prod - cons) & IDX_MASK) == QUEUE_ENTRIES) {
+			if ((prod_reg & EVTQ_OVFLG_MASK) ==
+			    (cons_reg & EVTQ_OVFLG_MASK)) {
+				prod_reg = prod_reg ^ EVTQ_OVFLG_MASK;
+			}
+			return;
+		}
+
+		record = entry(prod);
+		record[0] = COMPOSE(type, EVT_ID_SHIFT, EVT_ID_MASK) |
+			    COMPOSE((uint64_t)sid, EVT_SID_SHIFT, EVT_SID_MASK);
+		record[1] = 0;
+		record[2] = addr;
+		record[3] = 0;
+
+		prod_reg =
+			(prod_reg & EVTQ_OVFLG_MASK) | ((prod + 1) & IDX_MASK);
+	}
+
+	const struct smmuv3_stream_faults *stream(uint32_t sid)
+	{
+		for (uint32_t i = 0; i < stats.stream_count; i++) {
+			if (stats.streams[i].sid == sid) {
+				return &stats.streams[i];
+			}
+		}
+
+		return NULL;
+	}
+
+	struct smmuv3_queue evtq;
+	struct smmuv3_fault_stats stats;
+};
+
+/** There is nothing to drain from a freshly initialised queue. */
+TEST_F(smmuv3_evtq, init)
+{
+	expect_indices_reset();
+	EXPECT_THAT(smmuv3_evtq_drain(&evtq, &stats), Eq(0));
+	EXPECT_THAT(cons_reg, Eq(0));
+}
+
+/**
+ * Events are counted by stream and by the VM the stream is attached to, and
+ * those of unknown streams separately.
+ */
+TEST_F(smmuv3_evtq, counts)
+{
+	struct smmuv3_vm_faults *vm_a;
+	struct smmuv3_vm_faults *vm_b;
+
+	ASSERT_TRUE(smmuv3_fault_stats_add_stream(&stats, 3, VM_A));
+	ASSERT_TRUE(smmuv3_fault_stats_add_stream(&stats, 4, VM_A));
+	ASSERT_TRUE(smmuv3_fault_stats_add_stream(&stats, 9, VM_B));
+
+	produce(EVT_F_TRANSLATION, 3, 0x1000);
+	produce(EVT_F_PERMISSION, 3, 0x2000);
+	produce(EVT_F_TRANSLATION, 4, 0x3000);
+	produce(EVT_F_ACCESS, 9, 0x4000);
+	produce(EVT_F_TRANSLATION, 100, 0x5000);
+
+	EXPECT_THAT(smmuv3_evtq_drain(&evtq, &stats), Eq(5));
+	EXPECT_THAT(cons_reg, Eq(prod_reg));
+
+	ASSERT_THAT(stream(3), NotNull());
+	EXPECT_THAT(stream(3)->count, Eq(2));
+	EXPECT_THAT(stream(3)->last_event, Eq(EVT_F_PERMISSION));
+	EXPECT_THAT(stream(3)->last_addr, Eq(0x2000));
+	EXPECT_THAT(stream(4)->count, Eq(1));
+	EXPECT_THAT(stream(9)->count, Eq(1));
+	EXPECT_THAT(stream(100), IsNull());
+	EXPECT_THAT(stats.unattributed, Eq(1));
+
+	vm_a = smmuv3_fault_stats_get_vm(&stats, VM_A);
+	vm_b = smmuv3_fault_stats_get_vm(&stats, VM_B);
+	ASSERT_THAT(vm_a, NotNull());
+	ASSERT_THAT(vm_b, NotNull());
+	EXPECT_THAT(vm_a->count, Eq(3));
+	EXPECT_THAT(vm_a->unreported, Eq(3));
+	EXPECT_THAT(vm_b->count, Eq(1));
+	EXPECT_THAT(smmuv3_fault_stats_get_vm(&stats, 0x8003), IsNull());
+
+	/* Only the address of translation faults is kept, not of C_BAD_STE. */
+	produce(0x04, 3, 0x6000);
+	EXPECT_THAT(smmuv3_evtq_drain(&evtq, &stats), Eq(1));
+	EXPECT_THAT(stream(3)->last_addr, Eq(0));
+}
+
+/**
+ * Many more events than a batch are all read, wrapping around the queue, and
+ * handed back to the SMMU.
+ */
+TEST_F(smmuv3_evtq, batches)
+{
+	constexpr uint32_t count = QUEUE_ENTRIES - 1;
+
+	ASSERT_TRUE(smmuv3_fault_stats_add_stream(&stats, 1, VM_A));
+
+	for (uint32_t round = 0; round < 3; round++) {
+		for (uint32_t i = 0; i < count; i++) {
+			produce(EVT_F_TRANSLATION, 1, i * PAGE_SIZE);
+		}
+
+		EXPECT_THAT(smmuv3_evtq_drain(&evtq, &stats), Eq(count));
+		EXPECT_THAT(cons_reg, Eq(((round + 1) * count) & IDX_MASK));
+	}
+
+	EXPECT_THAT(stream(1)->count, Eq(3 * count));
+	EXPECT_THAT(stream(1)->last_addr, Eq((count - 1) * PAGE_SIZE));
+	EXPECT_THAT(stats.overflows, Eq(0));
+}
+
+/** An overflow of the queue is counted and acknowledged. */
+TEST_F(smmuv3_evtq, overflow)
+{
+	ASSERT_TRUE(smmuv3_fault_stats_add_stream(&stats, 1, VM_A));
+
+	for (uint32_t i = 0; i < QUEUE_ENTRIES + 2; i++) {
+		produce(EVT_F_TRANSLATION, 1);
+	}
+
+	EXPECT_THAT(prod_reg & EVTQ_OVFLG_MASK, Eq(EVTQ_OVFLG_MASK));
+	EXPECT_THAT(smmuv3_evtq_drain(&evtq, &stats), Eq(QUEUE_ENTRIES));
+	EXPECT_THAT(stats.overflows, Eq(1));
+	EXPECT_THAT(cons_reg, Eq(prod_reg));
+	EXPECT_THAT(stream(1)->count, Eq(QUEUE_ENTRIES));
+
+	/* An overflow is acknowledged even if no records are left to read. */
+	prod_reg = prod_reg ^ EVTQ_OVFLG_MASK;
+	EXPECT_THAT(smmuv3_evtq_drain(&evtq, &stats), Eq(0));
+	EXPECT_THAT(stats.overflows, Eq(2));
+	EXPECT_THAT(cons_reg, Eq(prod_reg));
+
+	/* Nothing is counted again once acknowledged. */
+	EXPECT_THAT(smmuv3_evtq_drain(&evtq, &stats), Eq(0));
+	EXPECT_THAT(stats.overflows, Eq(2));
+}
+
+/** Attaching a stream to another VM moves its later events to that VM. */
+TEST_F(smmuv3_evtq, reattach)
+{
+	ASSERT_TRUE(smmuv3_fault_stats_add_stream(&stats, 5, VM_A));
+	produce(EVT_F_TRANSLATION, 5);
+	smmuv3_evtq_drain(&evtq, &stats);
+
+	ASSERT_TRUE(smmuv3_fault_stats_add_stream(&stats, 5, VM_B));
+	produce(EVT_F_TRANSLATION, 5);
+	smmuv3_evtq_drain(&evtq, &stats);
+
+	EXPECT_THAT(stream(5)->count, Eq(2));
+	EXPECT_THAT(smmuv3_fault_stats_get_vm(&stats, VM_A)->count, Eq(1));
+	EXPECT_THAT(smmuv3_fault_stats_get_vm(&stats, VM_B)->count, Eq(1));
+}
+
+} /* namespace */
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "arm_smmuv3.h"
+}
+
+namespace smmuv3_test
+{
+/**
+ * A model of the SMMU's side of a queue of 2^`entries_log2` entries of
+ * `entry_size_dw` double words: the queue memory and the PROD and CONS
+ * registers, which start out with a value initialising the queue must clear.
+ */
+template <uint32_t entries_log2, size_t entry_size_dw>
+class queue_model : public ::testing::Test
+{
+       protected:
+	static constexpr uint32_t QUEUE_ENTRIES_LOG2 = entries_log2;
+	static constexpr uint32_t QUEUE_ENTRIES = 1 << QUEUE_ENTRIES_LOG2;
+	static constexpr uint32_t IDX_MASK = (QUEUE_ENTRIES << 1) - 1;
+
+	/** Returns the entry at the index, ignoring the wrap bit. */
+	uint64_t *entry(uint32_t idx)
+	{
+		return &queue[(idx & (QUEUE_ENTRIES - 1)) * entry_size_dw];
+	}
+
+	/**
+	 * Consumes the entries published so far as the SMMU would, passing each
+	 * of them to `f` in order.
+	 */
+	template <typename F>
+	void consume(F &&f)
+	{
+		uint32_t cons = cons_reg;
+
+		while (cons != prod_reg) {
+			f(entry(cons));
+			cons = (cons + 1) & IDX_MASK;
+		}
+
+		cons_reg = cons;
+	}
+
+	/** Initialising the queue resets both indices. */
+	void expect_indices_reset()
+	{
+		EXPECT_THAT(prod_reg, ::testing::Eq(0));
+		EXPECT_THAT(cons_reg, ::testing::Eq(0));
+	}
+
+	alignas(64) uint64_t queue[QUEUE_ENTRIES * entry_size_dw] = {};
+	volatile uint32_t prod_reg = ~0U;
+	volatile uint32_t cons_reg = ~0U;
+};
+
+} /* namespace smmuv3_test */
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/arch/barriers.h"
+
+#include "hf/dlog.h"
+#include "hf/mpool.h"
+#include "hf/static_assert.h"
+#include "hf/std.h"
+
+#include "arm_smmuv3.h"
+
+/* Each level 2 array is allocated as a single page. */
+static_assert((STE_SIZE << STRTAB_SPLIT) == PAGE_SIZE,
+	      "Level 2 stream table array must fill a page.");
+
+/* The span of a level 1 descriptor pointing to a full level 2 array. */
+#define L1STD_SPAN (STRTAB_SPLIT + 1)
+
+void smmuv3_write_ste(uint64_t *st_entry, const uint64_t *data)
+{
+	int i;
+
+	/*
+	 * Mark the stream table entry as invalid to avoid race condition
+	 * STE.V = 0 (bit 0) of first double word
+	 */
+	st_entry[0] = 0;
+
+	/*
+	 * Write to memory from upper double word of Stream Table entry such
+	 * that the bottom double word which has the STE.Valid bit is written
+	 * last.
+	 */
+	for (i = STE_SIZE_DW - 1U; i >= 0; i--) {
+		st_entry[i] = data[i];
+	}
+
+	/* Ensure written data(STE) is observable to SMMU by performing DSB */
+	data_sync_barrier();
+}
+
+static void write_stes(uint64_t *ste_addr, uint32_t ste_count,
+		       const uint64_t *data)
+{
+	uint32_t i;
+
+	for (i = 0; i < ste_count; i++) {
+		smmuv3_write_ste(ste_addr, data);
+		ste_addr += STE_SIZE_DW;
+	}
+}
+
+static inline uint64_t *l1std_l2_array(uint64_t l1std)
+{
+	return (uint64_t *)(uintptr_t)(l1std & GEN_MASK(51, 6));
+}
+
+static inline uint64_t l1std_from_l2_array(const uint64_t *l2)
+{
+	return ((uint64_t)(uintptr_t)l2 & GEN_MASK(51, 6)) | L1STD_SPAN;
+}
+
+/**
+ * Allocates the stream table. A two-level table starts with all its level 1
+ * descriptors pointing to the same level 2 array, and is limited to
+ * `STRTAB_L1_MAX_LOG2` descriptors. All the STEs are invalid to begin with.
+ */
+bool smmuv3_strtab_init(struct smmuv3_stream_table_config *strtab,
+			uint32_t stream_n_bits, bool two_level,
+			struct mpool *pool)
+{
+	uint32_t l1_count;
+	size_t size;
+	size_t pages;
+	uint64_t *l1;
+	uint32_t i;
+
+	strtab->two_level = two_level && stream_n_bits > STRTAB_SPLIT;
+	memset_s(strtab->default_ste, sizeof(strtab->default_ste), 0,
+		 sizeof(strtab->default_ste));
+
+	if (!strtab->two_level) {
+		strtab->stream_n_bits = stream_n_bits;
+		strtab->default_l2 = NULL;
+
+		size = ((size_t)1 << stream_n_bits) * STE_SIZE;
+		strtab->base = mpool_alloc_contiguous(
+			pool, (size / PAGE_SIZE) + 1, 1);
+		if (strtab->base == NULL) {
+			return false;
+		}
+
+		write_stes(strtab->base, 1U << stream_n_bits,
+			   strtab->default_ste);
+
+		return true;
+	}
+
+	if (stream_n_bits > STRTAB_SPLIT + STRTAB_L1_MAX_LOG2) {
+		dlog_verbose("SMMUv3: Limiting StreamIDs to %d bits\n",
+			     STRTAB_SPLIT + STRTAB_L1_MAX_LOG2);
+		stream_n_bits = STRTAB_SPLIT + STRTAB_L1_MAX_LOG2;
+	}
+
+	strtab->stream_n_bits = stream_n_bits;
+	l1_count = 1U << (stream_n_bits - STRTAB_SPLIT);
+
+	/* The level 1 table must be aligned to its size. */
+	size = (size_t)l1_count * L1STD_SIZE;
+	pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	l1 = mpool_alloc_contiguous(pool, pages, pages);
+	if (l1 == NULL) {
+		return false;
+	}
+
+	strtab->default_l2 = mpool_alloc(pool);
+	if (strtab->default_l2 == NULL) {
+		return false;
+	}
+
+	write_stes(strtab->default_l2, 1U << STRTAB_SPLIT,
+		   strtab->default_ste);
+
+	for (i = 0; i < l1_count; i++) {
+		l1[i] = l1std_from_l2_array(strtab->default_l2);
+	}
+	data_sync_barrier();
+
+	strtab->base = l1;
+
+	return true;
+}
+
+/**
+ * Returns the value of SMMU_(S_)STRTAB_BASE_CFG describing the table.
+ */
+uint32_t smmuv3_strtab_base_cfg(const struct smmuv3_stream_table_config *strtab)
+{
+	if (!strtab->two_level) {
+		return (LINEAR_STR_TABLE << STR_FMT_SHIFT) |
+		       strtab->stream_n_bits;
+	}
+
+	return (TWO_LVL_STR_TABLE << STR_FMT_SHIFT) |
+	       (STRTAB_SPLIT << STR_SPLIT_SHIFT) | strtab->stream_n_bits;
+}
+
+/**
+ * Sets the STE of all the streams which haven't been given one of their own
+ * with `smmuv3_strtab_get_ste`, including those of level 2 arrays allocated
+ * later on.
+ */
+void smmuv3_strtab_set_default(struct smmuv3_stream_table_config *strtab,
+			       const uint64_t *ste)
+{
+	memcpy_s(strtab->default_ste, sizeof(strtab->default_ste), ste,
+		 sizeof(strtab->default_ste));
+
+	if (!strtab->two_level) {
+		write_stes(strtab->base, 1U << strtab->stream_n_bits, ste);
+	} else {
+		write_stes(strtab->default_l2, 1U << STRTAB_SPLIT, ste);
+	}
+}
+
+/**
+ * Returns the STE of the given stream for the driver to configure.
+ *
+ * In a two-level table, this allocates the level 2 array of the stream's span
+ * from the pool the first time one of its streams is configured. The array
+ * starts as a copy of the shared one, so the streams of the span which aren't
+ * configured keep the same STE and the level 1 descriptor is switched to it
+ * with a single write. The caller invalidates the configuration cached for the
+ * stream once it has written its STE, which also discards the level 1
+ * descriptor the SMMU may have cached for it.
+ *
+ * Returns NULL if the StreamID is out of range or the array couldn't be
+ * allocated.
+ */
+uint64_t *smmuv3_strtab_get_ste(struct smmuv3_stream_table_config *strtab,
+				uint32_t sid, struct mpool *pool)
+{
+	uint64_t *l1std;
+	uint64_t *l2;
+
+	if (sid >= (1ULL << strtab->stream_n_bits)) {
+		dlog_error("SMMUv3: Illegal streamID specified: %u\n", sid);
+		return NULL;
+	}
+
+	if (!strtab->two_level) {
+		/* StreamID serves as an index into Stream Table */
+		return (uint64_t *)strtab->base + sid * STE_SIZE_DW;
+	}
+
+	l1std = (uint64_t *)strtab->base + (sid >> STRTAB_SPLIT);
+	l2 = l1std_l2_array(*l1std);
+
+	if (l2 == strtab->default_l2) {
+		l2 = mpool_alloc(pool);
+		if (l2 == NULL) {
+			dlog_error(
+				"SMMUv3: Could not allocate memory for stream "
+				"table of streamID: %u\n",
+				sid);
+			return NULL;
+		}
+
+		write_stes(l2, 1U << STRTAB_SPLIT, strtab->default_ste);
+
+		*l1std = l1std_from_l2_array(l2);
+		data_sync_barrier();
+	}
+
+	return l2 + (sid & ALL_1s(STRTAB_SPLIT)) * STE_SIZE_DW;
+}
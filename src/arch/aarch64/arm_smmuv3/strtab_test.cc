@@ -0,0 +1,211 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "hf/mpool.h"
+
+#include "arm_smmuv3.h"
+}
+
+namespace
+{
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+constexpr size_t TEST_HEAP_PAGES = 8;
+constexpr size_t TEST_HEAP_SIZE = TEST_HEAP_PAGES * PAGE_SIZE;
+
+/**
+ * Tests of the stream table against a model of how the SMMU finds the STE of a
+ * stream from the SMMU_(S_)STRTAB_BASE(_CFG) registers.
+ */
+class smmuv3_strtab : public ::testing::Test
+{
+       protected:
+	void SetUp() override
+	{
+		test_heap = static_cast<uint8_t *>(
+			std::aligned_alloc(PAGE_SIZE, TEST_HEAP_SIZE));
+		mpool_init(&ppool, PAGE_SIZE);
+		mpool_add_chunk(&ppool, test_heap, TEST_HEAP_SIZE);
+
+		for (size_t i = 0; i < STE_SIZE_DW; i++) {
+			bypass_ste[i] = i == 0 ? STE_VALID | 0x8 : i;
+			s2_ste[i] = i == 0 ? STE_VALID | 0xc : 0x100 + i;
+		}
+	}
+
+	void TearDown() override
+	{
+		std::free(test_heap);
+	}
+
+	/**
+	 * Walks the stream table as the SMMU would, returning the STE of the
+	 * stream or NULL if the StreamID is out of range or has no STE.
+	 */
+	const uint64_t *model_ste(uint32_t sid)
+	{
+		uint64_t base = (uint64_t)strtab.base & GEN_MASK(51, 6);
+		uint32_t cfg = smmuv3_strtab_base_cfg(&strtab);
+		uint32_t log2size = cfg & 0x3f;
+		uint32_t split = (cfg >> STR_SPLIT_SHIFT) & 0x1f;
+		uint64_t l1std;
+		uint32_t span;
+
+		if (sid >= (1ULL << log2size)) {
+			return NULL;
+		}
+
+		if (((cfg >> STR_FMT_SHIFT) & 0x3) == LINEAR_STR_TABLE) {
+			return (const uint64_t *)base + sid * STE_SIZE_DW;
+		}
+
+		l1std = ((const uint64_t *)base)[sid >> split];
+		span = l1std & L1STD_SPAN_MASK;
+		if (span == 0 ||
+		    (sid & ALL_1s(split)) >= (1U << (span - 1))) {
+			return NULL;
+		}
+
+		return (const uint64_t *)(l1std & GEN_MASK(51, 6)) +
+		       (sid & ALL_1s(split)) * STE_SIZE_DW;
+	}
+
+	/** Returns whether the SMMU would find the given STE for the stream. */
+	bool model_has_ste(uint32_t sid, const uint64_t *ste)
+	{
+		const uint64_t *found = model_ste(sid);
+
+		return found != NULL &&
+		       memcmp(found, ste, STE_SIZE_DW * sizeof(uint64_t)) == 0;
+	}
+
+	/** Returns the number of pages left in the pool. */
+	size_t free_pages()
+	{
+		size_t count = 0;
+
+		while (mpool_alloc(&ppool) != NULL) {
+			count++;
+		}
+
+		return count;
+	}
+
+	uint8_t *test_heap;
+	struct mpool ppool;
+	struct smmuv3_stream_table_config strtab;
+	uint64_t bypass_ste[STE_SIZE_DW];
+	uint64_t s2_ste[STE_SIZE_DW];
+};
+
+/** Few enough StreamIDs for a single level 2 array use a linear table. */
+TEST_F(smmuv3_strtab, linear)
+{
+	uint64_t *ste;
+
+	ASSERT_TRUE(smmuv3_strtab_init(&strtab, STRTAB_SPLIT, true, &ppool));
+	EXPECT_FALSE(strtab.two_level);
+	EXPECT_THAT(smmuv3_strtab_base_cfg(&strtab),
+		    Eq((LINEAR_STR_TABLE << STR_FMT_SHIFT) | STRTAB_SPLIT));
+
+	smmuv3_strtab_set_default(&strtab, bypass_ste);
+
+	ste = smmuv3_strtab_get_ste(&strtab, 5, &ppool);
+	ASSERT_THAT(ste, NotNull());
+	smmuv3_write_ste(ste, s2_ste);
+
+	EXPECT_THAT(ste, Eq(model_ste(5)));
+	EXPECT_TRUE(model_has_ste(5, s2_ste));
+	EXPECT_TRUE(model_has_ste(4, bypass_ste));
+	EXPECT_TRUE(model_has_ste((1 << STRTAB_SPLIT) - 1, bypass_ste));
+	EXPECT_THAT(smmuv3_strtab_get_ste(&strtab, 1 << STRTAB_SPLIT, &ppool),
+		    IsNull());
+}
+
+/**
+ * A two-level table only allocates the level 2 arrays of the spans streams are
+ * configured in, and the other streams keep the default STE.
+ */
+TEST_F(smmuv3_strtab, two_level_sparse)
+{
+	constexpr uint32_t sids[] = {3, 5, 40000};
+	uint64_t *ste;
+
+	ASSERT_TRUE(smmuv3_strtab_init(&strtab, 16, true, &ppool));
+	EXPECT_TRUE(strtab.two_level);
+	EXPECT_THAT(smmuv3_strtab_base_cfg(&strtab),
+		    Eq((TWO_LVL_STR_TABLE << STR_FMT_SHIFT) |
+		       (STRTAB_SPLIT << STR_SPLIT_SHIFT) | 16));
+
+	/* All the streams start with an invalid STE. */
+	EXPECT_THAT(model_ste(40000)[0] & STE_VALID, Eq(0));
+
+	smmuv3_strtab_set_default(&strtab, bypass_ste);
+
+	for (uint32_t sid : sids) {
+		ste = smmuv3_strtab_get_ste(&strtab, sid, &ppool);
+		ASSERT_THAT(ste, NotNull());
+		smmuv3_write_ste(ste, s2_ste);
+		EXPECT_THAT(ste, Eq(model_ste(sid)));
+	}
+
+	for (uint32_t sid : sids) {
+		EXPECT_TRUE(model_has_ste(sid, s2_ste));
+	}
+
+	/* Neighbours in the same span and other spans are untouched. */
+	EXPECT_TRUE(model_has_ste(4, bypass_ste));
+	EXPECT_TRUE(model_has_ste(40001, bypass_ste));
+	EXPECT_TRUE(model_has_ste(1000, bypass_ste));
+	EXPECT_TRUE(model_has_ste(0xffff, bypass_ste));
+	EXPECT_THAT(model_ste(0x10000), IsNull());
+
+	/*
+	 * Two pages for the level 1 table, one for the shared level 2 array
+	 * and one for each of the two spans with configured streams.
+	 */
+	EXPECT_THAT(free_pages(), Eq(TEST_HEAP_PAGES - 5));
+}
+
+/** StreamIDs beyond what the level 1 table covers are out of range. */
+TEST_F(smmuv3_strtab, two_level_limited)
+{
+	ASSERT_TRUE(smmuv3_strtab_init(&strtab, 32, true, &ppool));
+	EXPECT_THAT(strtab.stream_n_bits,
+		    Eq(STRTAB_SPLIT + STRTAB_L1_MAX_LOG2));
+	EXPECT_THAT(smmuv3_strtab_get_ste(
+			    &strtab, 1 << (STRTAB_SPLIT + STRTAB_L1_MAX_LOG2),
+			    &ppool),
+		    IsNull());
+	EXPECT_THAT(model_ste(1 << (STRTAB_SPLIT + STRTAB_L1_MAX_LOG2)),
+		    IsNull());
+}
+
+/**
+ * The level 1 descriptor is left alone if the level 2 array can't be
+ * allocated.
+ */
+TEST_F(smmuv3_strtab, two_level_out_of_memory)
+{
+	ASSERT_TRUE(smmuv3_strtab_init(&strtab, 16, true, &ppool));
+	smmuv3_strtab_set_default(&strtab, bypass_ste);
+
+	free_pages();
+	EXPECT_THAT(smmuv3_strtab_get_ste(&strtab, 100, &ppool), IsNull());
+	EXPECT_TRUE(model_has_ste(100, bypass_ste));
+}
+
+} /* namespace */
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/mm.h"
+#include "hf/std.h"
+
+#include "arm_smmuv3.h"
+
+/*
+ * Largest multiple of 1 << SCALE pages a range invalidation command can cover,
+ * given by its NUM field plus one.
+ */
+#define TLBI_RANGE_NUM_MAX 32
+
+void smmuv3_tlbi_ranges_init(struct smmuv3_tlbi_ranges *ranges)
+{
+	ranges->count = 0;
+}
+
+/** Removes the range at the given index, moving the ones after it down. */
+static void tlbi_ranges_remove(struct smmuv3_tlbi_ranges *ranges, uint32_t i)
+{
+	for (; i + 1 < ranges->count; i++) {
+		ranges->ranges[i] = ranges->ranges[i + 1];
+	}
+
+	ranges->count--;
+}
+
+/** Merges the range at the given index with the one following it. */
+static void tlbi_ranges_merge(struct smmuv3_tlbi_ranges *ranges, uint32_t i)
+{
+	if (ranges->ranges[i + 1].end > ranges->ranges[i].end) {
+		ranges->ranges[i].end = ranges->ranges[i + 1].end;
+	}
+
+	tlbi_ranges_remove(ranges, i + 1);
+}
+
+/**
+ * Records that the stage 2 translation of the given IPA range changed.
+ *
+ * The range is merged with any it overlaps or adjoins. If that leaves more
+ * than `SMMUV3_TLBI_RANGES_MAX` of them, the two closest to one another are
+ * merged, which invalidates the pages between them as well but keeps the
+ * number of commands down for long scatter lists.
+ */
+void smmuv3_tlbi_ranges_add(struct smmuv3_tlbi_ranges *ranges, uint64_t begin,
+			    uint64_t end)
+{
+	uint64_t smallest_gap = UINT64_MAX;
+	uint32_t closest = 0;
+	uint32_t i;
+
+	begin = align_down(begin, PAGE_SIZE);
+	end = align_up(end, PAGE_SIZE);
+
+	if (begin >= end) {
+		return;
+	}
+
+	/* Insert the range in order. */
+	for (i = ranges->count; i > 0 && ranges->ranges[i - 1].begin > begin;
+	     i--) {
+		ranges->ranges[i] = ranges->ranges[i - 1];
+	}
+
+	ranges->ranges[i].begin = begin;
+	ranges->ranges[i].end = end;
+	ranges->count++;
+
+	/* Merge it with the ranges it overlaps or adjoins. */
+	if (i > 0 && ranges->ranges[i - 1].end >= begin) {
+		i--;
+		tlbi_ranges_merge(ranges, i);
+	}
+
+	while (i + 1 < ranges->count &&
+	       ranges->ranges[i].end >= ranges->ranges[i + 1].begin) {
+		tlbi_ranges_merge(ranges, i);
+	}
+
+	if (ranges->count <= SMMUV3_TLBI_RANGES_MAX) {
+		return;
+	}
+
+	for (i = 0; i + 1 < ranges->count; i++) {
+		uint64_t gap =
+			ranges->ranges[i + 1].begin - ranges->ranges[i].end;
+
+		if (gap < smallest_gap) {
+			smallest_gap = gap;
+			closest = i;
+		}
+	}
+
+	tlbi_ranges_merge(ranges, closest);
+}
+
+/**
+ * Returns the SCALE field of a range invalidation starting a run of the given
+ * number of pages, such that NUM + 1 is at most `TLBI_RANGE_NUM_MAX`.
+ */
+static uint32_t tlbi_range_scale(uint64_t pages)
+{
+	uint32_t scale = 0;
+
+	while ((pages >> scale) > TLBI_RANGE_NUM_MAX) {
+		scale++;
+	}
+
+	return scale;
+}
+
+/**
+ * Returns the number of TLBI_S2_IPA commands needed to invalidate the given
+ * number of pages.
+ */
+static uint64_t tlbi_range_cmd_count(uint64_t pages, bool range_inv)
+{
+	uint64_t count = 0;
+
+	if (!range_inv) {
+		return pages;
+	}
+
+	while (pages > 0) {
+		uint32_t scale = tlbi_range_scale(pages);
+
+		pages -= (pages >> scale) << scale;
+		count++;
+	}
+
+	return count;
+}
+
+static void construct_tlbi_s2_ipa(uint64_t *cmd, uint16_t vmid, uint64_t ipa,
+				  uint64_t num, uint32_t scale, bool range_inv)
+{
+	cmd[0] = COMPOSE(OP_TLBI_S2_IPA, OP_SHIFT, OP_MASK);
+	cmd[0] |= COMPOSE((uint64_t)vmid, CMD_VMID_SHIFT, CMD_VMID_MASK);
+
+	/*
+	 * Leaf is left clear, so that the walk caches are invalidated along
+	 * with the TLB entries in case tables were freed.
+	 */
+	cmd[1] = ipa & CMD_ADDR_MASK;
+
+	if (range_inv) {
+		cmd[0] |= COMPOSE(num, CMD_NUM_SHIFT, CMD_NUM_MASK);
+		cmd[0] |= COMPOSE(scale, CMD_SCALE_SHIFT, CMD_SCALE_MASK);
+		cmd[1] |= COMPOSE(CMD_TG_4KB, CMD_TG_SHIFT, CMD_TG_MASK);
+	}
+}
+
+static void construct_tlbi_s12_vmall(uint64_t *cmd, uint16_t vmid)
+{
+	cmd[0] = COMPOSE(OP_TLBI_S12_VMALL, OP_SHIFT, OP_MASK);
+	cmd[0] |= COMPOSE((uint64_t)vmid, CMD_VMID_SHIFT, CMD_VMID_MASK);
+	cmd[1] = 0;
+}
+
+/**
+ * Adds the commands invalidating the TLB entries of the recorded ranges for the
+ * given VMID to the batch, and forgets the ranges. If the SMMU supports range
+ * invalidation, each command covers up to `TLBI_RANGE_NUM_MAX` << SCALE pages,
+ * otherwise a single page. Past `SMMUV3_TLBI_CMDS_MAX` commands, all the
+ * entries of the VMID are invalidated with a single command instead.
+ *
+ * The caller completes the batch with a CMD_SYNC.
+ *
+ * Returns the number of commands added to the batch.
+ */
+uint32_t smmuv3_tlbi_ranges_flush(struct smmuv3_tlbi_ranges *ranges,
+				  struct smmuv3_cmd_batch *batch, uint16_t vmid,
+				  bool range_inv)
+{
+	uint64_t cmd_count = 0;
+	uint32_t i;
+
+	for (i = 0; i < ranges->count; i++) {
+		cmd_count += tlbi_range_cmd_count(
+			(ranges->ranges[i].end - ranges->ranges[i].begin) /
+				PAGE_SIZE,
+			range_inv);
+	}
+
+	if (cmd_count > SMMUV3_TLBI_CMDS_MAX) {
+		construct_tlbi_s12_vmall(smmuv3_cmd_batch_next(batch), vmid);
+		ranges->count = 0;
+		return 1;
+	}
+
+	for (i = 0; i < ranges->count; i++) {
+		uint64_t ipa = ranges->ranges[i].begin;
+		uint64_t pages =
+			(ranges->ranges[i].end - ranges->ranges[i].begin) /
+			PAGE_SIZE;
+
+		while (pages > 0) {
+			uint32_t scale = 0;
+			uint64_t num = 1;
+
+			if (range_inv) {
+				scale = tlbi_range_scale(pages);
+				num = pages >> scale;
+			}
+
+			construct_tlbi_s2_ipa(smmuv3_cmd_batch_next(batch),
+					      vmid, ipa, num - 1, scale,
+					      range_inv);
+
+			ipa += (num << scale) * PAGE_SIZE;
+			pages -= num << scale;
+		}
+	}
+
+	ranges->count = 0;
+
+	return (uint32_t)cmd_count;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "hf/mm.h"
+}
+
+#include "queue_test.hh"
+
+namespace
+{
+using ::testing::Eq;
+using ::testing::Le;
+using ::testing::SizeIs;
+
+constexpr uint16_t VMID = 0x8001;
+
+/**
+ * Tests of the TLB invalidation of recorded IPA ranges against a model of the
+ * SMMU consuming the command queue and working out which pages each command
+ * invalidates.
+ */
+class smmuv3_tlbi : public smmuv3_test::queue_model<6, CMD_SIZE_DW>
+{
+       protected:
+	void SetUp() override
+	{
+		smmuv3_cmdq_init(&cmdq, queue, QUEUE_ENTRIES_LOG2,
+				 (void *)&prod_reg, (void *)&cons_reg);
+		smmuv3_cmd_batch_init(&batch, &cmdq);
+		smmuv3_tlbi_ranges_init(&ranges);
+	}
+
+	/**
+	 * Flushes the ranges to the command queue and consumes the commands as
+	 * the SMMU would, returning the number of commands ahead of the
+	 * CMD_SYNC.
+	 */
+	uint32_t flush(bool range_inv)
+	{
+		uint32_t count = smmuv3_tlbi_ranges_flush(&ranges, &batch,
+							  VMID, range_inv);
+
+		EXPECT_TRUE(smmuv3_cmd_batch_submit(&batch));
+
+		cmds.clear();
+		consume([this](const uint64_t *cmd) {
+			cmds.emplace_back(cmd[0], cmd[1]);
+		});
+
+		EXPECT_THAT(cmds, SizeIs(count + 1));
+		EXPECT_THAT(cmds.back().first & OP_MASK, Eq(OP_CMD_SYNC));
+
+		return count;
+	}
+
+	/**
+	 * Returns the pages invalidated by the TLBI_S2_IPA commands consumed,
+	 * in the order they were invalidated.
+	 */
+	std::vector<uint64_t> invalidated_pages()
+	{
+		std::vector<uint64_t> pages;
+
+		for (auto [cmd0, cmd1] : cmds) {
+			uint64_t tg = EXTRACT(cmd1, CMD_TG_SHIFT, CMD_TG_MASK);
+			uint64_t num =
+				EXTRACT(cmd0, CMD_NUM_SHIFT, CMD_NUM_MASK);
+			uint64_t scale =
+				EXTRACT(cmd0, CMD_SCALE_SHIFT, CMD_SCALE_MASK);
+			uint64_t count = tg == 0 ? 1 : (num + 1) << scale;
+
+			if ((cmd0 & OP_MASK) != OP_TLBI_S2_IPA) {
+				continue;
+			}
+
+			EXPECT_THAT(
+				EXTRACT(cmd0, CMD_VMID_SHIFT, CMD_VMID_MASK),
+				Eq(VMID));
+			/* Leaf is clear to invalidate the walk caches too. */
+			EXPECT_THAT(cmd1 & 1, Eq(0));
+
+			for (uint64_t i = 0; i < count; i++) {
+				pages.push_back((cmd1 & CMD_ADDR_MASK) +
+						i * PAGE_SIZE);
+			}
+		}
+
+		return pages;
+	}
+
+	static std::vector<uint64_t> page_range(uint64_t begin, uint64_t end)
+	{
+		std::vector<uint64_t> pages;
+
+		for (uint64_t page = begin; page < end; page += PAGE_SIZE) {
+			pages.push_back(page);
+		}
+
+		return pages;
+	}
+
+	struct smmuv3_queue cmdq;
+	struct smmuv3_cmd_batch batch;
+	struct smmuv3_tlbi_ranges ranges;
+
+	std::vector<std::pair<uint64_t, uint64_t>> cmds;
+};
+
+/** Nothing is invalidated if no ranges were recorded. */
+TEST_F(smmuv3_tlbi, empty)
+{
+	EXPECT_THAT(flush(false), Eq(0));
+	EXPECT_THAT(flush(true), Eq(0));
+}
+
+/**
+ * Overlapping and adjoining ranges are merged, and unaligned ones cover the
+ * pages they touch.
+ */
+TEST_F(smmuv3_tlbi, merge)
+{
+	smmuv3_tlbi_ranges_add(&ranges, 0x83000, 0x85000);
+	smmuv3_tlbi_ranges_add(&ranges, 0x80000, 0x81000);
+	smmuv3_tlbi_ranges_add(&ranges, 0x81000, 0x82000);
+	smmuv3_tlbi_ranges_add(&ranges, 0x81800, 0x83800);
+	smmuv3_tlbi_ranges_add(&ranges, 0x90000, 0x90001);
+	EXPECT_THAT(ranges.count, Eq(2));
+
+	EXPECT_THAT(flush(false), Eq(6));
+	EXPECT_THAT(invalidated_pages(), Eq([] {
+			    auto pages = page_range(0x80000, 0x85000);
+
+			    pages.push_back(0x90000);
+			    return pages;
+		    }()));
+	EXPECT_THAT(ranges.count, Eq(0));
+}
+
+/**
+ * A long scatter list is merged down to a few ranges, joining the closest ones
+ * first, and everything recorded is still invalidated.
+ */
+TEST_F(smmuv3_tlbi, scatter_list)
+{
+	std::vector<uint64_t> recorded;
+
+	for (uint64_t i = 0; i < 4 * SMMUV3_TLBI_RANGES_MAX; i++) {
+		uint64_t begin = (i * 3 + (i % 4 == 0 ? 100 : 0)) * PAGE_SIZE;
+
+		smmuv3_tlbi_ranges_add(&ranges, begin, begin + PAGE_SIZE);
+		recorded.push_back(begin);
+		EXPECT_THAT(ranges.count, Le(SMMUV3_TLBI_RANGES_MAX));
+	}
+
+	for (uint32_t i = 0; i + 1 < ranges.count; i++) {
+		EXPECT_THAT(ranges.ranges[i].end,
+			    Le(ranges.ranges[i + 1].begin));
+	}
+
+	ASSERT_THAT(flush(true), Le(2 * SMMUV3_TLBI_RANGES_MAX));
+
+	auto pages = invalidated_pages();
+
+	for (uint64_t page : recorded) {
+		EXPECT_THAT(std::count(pages.begin(), pages.end(), page),
+			    Eq(1));
+	}
+}
+
+/** Range invalidation covers large ranges with few commands. */
+TEST_F(smmuv3_tlbi, range_inv)
+{
+	constexpr uint64_t begin = 0x7000;
+	constexpr uint64_t end = begin + 1001 * PAGE_SIZE;
+
+	smmuv3_tlbi_ranges_add(&ranges, begin, end);
+
+	EXPECT_THAT(flush(true), Le(3));
+	EXPECT_THAT(invalidated_pages(), Eq(page_range(begin, end)));
+}
+
+/**
+ * All the entries of the VMID are invalidated at once rather than with too
+ * many commands, even if they span several batches.
+ */
+TEST_F(smmuv3_tlbi, vmall)
+{
+	smmuv3_tlbi_ranges_add(&ranges, 0, SMMUV3_TLBI_CMDS_MAX * PAGE_SIZE);
+	EXPECT_THAT(flush(false), Eq(SMMUV3_TLBI_CMDS_MAX));
+	EXPECT_THAT(invalidated_pages(),
+		    Eq(page_range(0, SMMUV3_TLBI_CMDS_MAX * PAGE_SIZE)));
+
+	smmuv3_tlbi_ranges_add(&ranges, 0,
+			       (SMMUV3_TLBI_CMDS_MAX + 1) * PAGE_SIZE);
+	EXPECT_THAT(flush(false), Eq(1));
+	EXPECT_THAT(cmds[0].first,
+		    Eq(COMPOSE(OP_TLBI_S12_VMALL, OP_SHIFT, OP_MASK) |
+		       COMPOSE((uint64_t)VMID, CMD_VMID_SHIFT, CMD_VMID_MASK)));
+}
+
+} /* namespace */
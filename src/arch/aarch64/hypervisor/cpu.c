@@ -22,6 +22,8 @@
 #include "hf/vm.h"
 
 #include "feature_id.h"
+#include "fp.h"
+#include "lazy_regs.h"
 #include "msr.h"
 #include "perfmon.h"
 #include "sysregs.h"
@@ -44,6 +46,11 @@ uintptr_t mte_seed;
  */
 #define ID_AA64MMFR1_EL1_LO (UINT64_C(1) << 16)
 
+/**
+ * The affinity fields of MPIDR_EL1, which identify the CPU.
+ */
+#define MPIDR_EL1_AFFINITY_MASK UINT64_C(0xff00ffffff)
+
 static void lor_disable(void)
 {
 #if SECURE_WORLD == 0
@@ -256,6 +263,8 @@ void arch_cpu_init(struct cpu *c, ipaddr_t entry_point)
 	lor_disable();
 
 	write_msr(CPTR_EL2, get_cptr_el2_value());
+	fp_cpu_init(c);
+	lazy_regs_cpu_init(c);
 
 	/* Initialize counter-timer virtual offset register to 0. */
 	write_msr(CNTVOFF_EL2, 0);
@@ -267,3 +276,8 @@ void arch_cpu_init(struct cpu *c, ipaddr_t entry_point)
 
 	plat_interrupts_controller_hw_init(c);
 }
+
+cpu_id_t arch_cpu_current_id(void)
+{
+	return read_msr(MPIDR_EL1) & MPIDR_EL1_AFFINITY_MASK;
+}
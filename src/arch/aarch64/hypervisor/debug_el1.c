@@ -164,8 +164,8 @@ bool debug_el1_process_access(struct vcpu *vcpu, ffa_vm_id_t vm_id,
 			value = vcpu->regs.r[rt_register];
 			dlog_notice(
 				"Unsupported debug system register read: "
-				"op0=%d, op1=%d, crn=%d, crm=%d, op2=%d, "
-				"rt=%d.\n",
+				"op0=%ld, op1=%ld, crn=%ld, crm=%ld, op2=%ld, "
+				"rt=%ld.\n",
 				GET_ISS_OP0(esr), GET_ISS_OP1(esr),
 				GET_ISS_CRN(esr), GET_ISS_CRM(esr),
 				GET_ISS_OP2(esr), GET_ISS_RT(esr));
@@ -180,6 +180,12 @@ bool debug_el1_process_access(struct vcpu *vcpu, ffa_vm_id_t vm_id,
 		} else {
 			value = 0;
 		}
+
+#if ENABLE_LAZY_REGS
+		/* The lazy registers written may not be saved otherwise. */
+		vcpu->regs.lazy_save_trapped = true;
+#endif
+
 		switch (sys_register) {
 #define X(reg_name, op0, op1, crn, crm, op2)              \
 	case (GET_ISS_ENCODING(op0, op1, crn, crm, op2)): \
@@ -191,8 +197,8 @@ bool debug_el1_process_access(struct vcpu *vcpu, ffa_vm_id_t vm_id,
 		default:
 			dlog_notice(
 				"Unsupported debug system register write: "
-				"op0=%d, op1=%d, crn=%d, crm=%d, op2=%d, "
-				"rt=%d.\n",
+				"op0=%ld, op1=%ld, crn=%ld, crm=%ld, op2=%ld, "
+				"rt=%ld.\n",
 				GET_ISS_OP0(esr), GET_ISS_OP1(esr),
 				GET_ISS_CRN(esr), GET_ISS_CRM(esr),
 				GET_ISS_OP2(esr), GET_ISS_RT(esr));
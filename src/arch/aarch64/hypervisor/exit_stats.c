@@ -0,0 +1,191 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "exit_stats.h"
+
+#include "hf/arch/cpu.h"
+
+#include "vmapi/hf/abi.h"
+#include "vmapi/hf/ffa.h"
+#include "vmapi/hf/types.h"
+
+#include "smc.h"
+
+/* Number of exception classes, as encoded in ESR_ELx.EC. */
+#define EXIT_STATS_EC_COUNT 64
+
+/*
+ * Calls are counted by function ID for the FF-A functions, with either calling
+ * convention, and the Hafnium ones. Each range of function IDs is mapped to a
+ * range of the calls counted, and all other functions are counted together.
+ */
+#define EXIT_STATS_FFA_BASE FFA_ERROR_32
+#define EXIT_STATS_FFA_COUNT 0x40
+#define EXIT_STATS_HF_BASE 0xff00
+#define EXIT_STATS_HF_COUNT 0x20
+
+#define EXIT_STATS_CALL_FFA_32 0
+#define EXIT_STATS_CALL_FFA_64 (EXIT_STATS_CALL_FFA_32 + EXIT_STATS_FFA_COUNT)
+#define EXIT_STATS_CALL_HF (EXIT_STATS_CALL_FFA_64 + EXIT_STATS_FFA_COUNT)
+#define EXIT_STATS_CALL_DEBUG_LOG (EXIT_STATS_CALL_HF + EXIT_STATS_HF_COUNT)
+#define EXIT_STATS_CALL_OTHER (EXIT_STATS_CALL_DEBUG_LOG + 1)
+#define EXIT_STATS_CALLS (EXIT_STATS_CALL_OTHER + 1)
+
+/*
+ * The count of calls is only incremented once their time is accounted for, so
+ * that reading it first gives a lower bound of the calls the time covers.
+ */
+struct exit_stats_call {
+	uint64_t count;
+	uint64_t ticks;
+	uint32_t buckets[HF_EXIT_STAT_CALL_BUCKETS];
+};
+
+/**
+ * Statistics of the exits from VMs on a CPU. They are only updated by the CPU
+ * itself, so without locks, but with atomic stores as other CPUs may read them.
+ */
+struct exit_stats {
+	uint64_t sync[EXIT_STATS_EC_COUNT];
+	uint64_t irq;
+	uint64_t fiq;
+	struct exit_stats_call calls[EXIT_STATS_CALLS];
+};
+
+static struct exit_stats exit_stats[MAX_CPUS];
+
+/** Increments a counter only ever written by the current CPU. */
+static void exit_stats_inc(uint64_t *counter)
+{
+	__atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+
+void exit_stats_sync(struct cpu *c, uintreg_t ec)
+{
+	struct exit_stats *stats = &exit_stats[cpu_index(c)];
+
+	exit_stats_inc(&stats->sync[ec % EXIT_STATS_EC_COUNT]);
+}
+
+void exit_stats_irq(struct cpu *c)
+{
+	exit_stats_inc(&exit_stats[cpu_index(c)].irq);
+}
+
+void exit_stats_fiq(struct cpu *c)
+{
+	exit_stats_inc(&exit_stats[cpu_index(c)].fiq);
+}
+
+/**
+ * Returns the index of the statistics of the calls of the function ID, which is
+ * `EXIT_STATS_CALL_OTHER` if it isn't counted on its own.
+ */
+static uint32_t exit_stats_call_index(uint32_t func)
+{
+	uint32_t ffa_64_base = EXIT_STATS_FFA_BASE | SMCCC_64_BIT;
+
+	if (func >= EXIT_STATS_FFA_BASE &&
+	    func < EXIT_STATS_FFA_BASE + EXIT_STATS_FFA_COUNT) {
+		return EXIT_STATS_CALL_FFA_32 + (func - EXIT_STATS_FFA_BASE);
+	}
+
+	if (func >= ffa_64_base && func < ffa_64_base + EXIT_STATS_FFA_COUNT) {
+		return EXIT_STATS_CALL_FFA_64 + (func - ffa_64_base);
+	}
+
+	if (func >= EXIT_STATS_HF_BASE &&
+	    func < EXIT_STATS_HF_BASE + EXIT_STATS_HF_COUNT) {
+		return EXIT_STATS_CALL_HF + (func - EXIT_STATS_HF_BASE);
+	}
+
+	if (func == HF_DEBUG_LOG) {
+		return EXIT_STATS_CALL_DEBUG_LOG;
+	}
+
+	return EXIT_STATS_CALL_OTHER;
+}
+
+/** Returns the histogram bucket counting calls that took the given ticks. */
+static uint32_t exit_stats_bucket(uint64_t ticks)
+{
+	uint32_t bucket = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+
+	return bucket < HF_EXIT_STAT_CALL_BUCKETS
+		       ? bucket
+		       : HF_EXIT_STAT_CALL_BUCKETS - 1;
+}
+
+/**
+ * Counts a call of the function ID, which took the given number of ticks of the
+ * system counter to handle.
+ */
+void exit_stats_call(struct cpu *c, uint32_t func, uint64_t ticks)
+{
+	struct exit_stats_call *call =
+		&exit_stats[cpu_index(c)].calls[exit_stats_call_index(func)];
+	uint32_t *bucket = &call->buckets[exit_stats_bucket(ticks)];
+
+	__atomic_store_n(&call->ticks, call->ticks + ticks, __ATOMIC_RELAXED);
+	__atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&call->count, call->count + 1, __ATOMIC_RELEASE);
+}
+
+bool arch_cpu_exit_stat_get(size_t cpu_index, uint32_t stat, uint32_t key,
+			    uint64_t *value)
+{
+	struct exit_stats *stats = &exit_stats[cpu_index];
+	struct exit_stats_call *call;
+	uint32_t index;
+
+	switch (stat) {
+	case HF_EXIT_STAT_SYNC:
+		if (key >= EXIT_STATS_EC_COUNT) {
+			return false;
+		}
+		*value = __atomic_load_n(&stats->sync[key], __ATOMIC_RELAXED);
+		return true;
+	case HF_EXIT_STAT_IRQ:
+		*value = __atomic_load_n(&stats->irq, __ATOMIC_RELAXED);
+		return true;
+	case HF_EXIT_STAT_FIQ:
+		*value = __atomic_load_n(&stats->fiq, __ATOMIC_RELAXED);
+		return true;
+	default:
+		break;
+	}
+
+	if (stat != HF_EXIT_STAT_CALL_COUNT &&
+	    stat != HF_EXIT_STAT_CALL_TICKS &&
+	    (stat < HF_EXIT_STAT_CALL_BUCKET(0) ||
+	     stat >= HF_EXIT_STAT_CALL_BUCKET(HF_EXIT_STAT_CALL_BUCKETS))) {
+		return false;
+	}
+
+	if (key == HF_EXIT_STAT_CALL_OTHER) {
+		index = EXIT_STATS_CALL_OTHER;
+	} else {
+		index = exit_stats_call_index(key);
+		if (index == EXIT_STATS_CALL_OTHER) {
+			return false;
+		}
+	}
+
+	call = &stats->calls[index];
+	if (stat == HF_EXIT_STAT_CALL_COUNT) {
+		*value = __atomic_load_n(&call->count, __ATOMIC_ACQUIRE);
+	} else if (stat == HF_EXIT_STAT_CALL_TICKS) {
+		*value = __atomic_load_n(&call->ticks, __ATOMIC_RELAXED);
+	} else {
+		*value = __atomic_load_n(
+			&call->buckets[stat - HF_EXIT_STAT_CALL_BUCKET(0)],
+			__ATOMIC_RELAXED);
+	}
+
+	return true;
+}
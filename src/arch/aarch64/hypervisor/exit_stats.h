@@ -0,0 +1,26 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include "hf/arch/types.h"
+
+#include "hf/cpu.h"
+
+#include "msr.h"
+
+/** Returns the current value of the system counter, to time calls with. */
+static inline uint64_t exit_stats_now(void)
+{
+	return read_msr(cntpct_el0);
+}
+
+void exit_stats_sync(struct cpu *c, uintreg_t ec);
+void exit_stats_irq(struct cpu *c);
+void exit_stats_fiq(struct cpu *c);
+void exit_stats_call(struct cpu *c, uint32_t func, uint64_t ticks);
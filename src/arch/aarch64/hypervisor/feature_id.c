@@ -158,7 +158,7 @@ void feature_set_traps(struct vm *vm, struct arch_regs *regs)
 	arch_features_t features = vm->arch.trapped_features;
 
 	if (features & ~HF_FEATURE_ALL) {
-		panic("features has undefined bits 0x%x", features);
+		panic("features has undefined bits 0x%lx", features);
 	}
 
 	/* By default do not mask out any features. */
@@ -254,7 +254,8 @@ bool feature_id_process_access(struct vcpu *vcpu, uintreg_t esr)
 	if (!ISS_IS_READ(esr)) {
 		dlog_notice(
 			"Unsupported feature ID register write: "
-			"op0=%d, op1=%d, crn=%d, crm=%d, op2=%d, rt=%d.\n",
+			"op0=%ld, op1=%ld, crn=%ld, crm=%ld, op2=%ld, "
+			"rt=%ld.\n",
 			GET_ISS_OP0(esr), GET_ISS_OP1(esr), GET_ISS_CRN(esr),
 			GET_ISS_CRM(esr), GET_ISS_OP2(esr), GET_ISS_RT(esr));
 		return true;
@@ -272,7 +273,8 @@ bool feature_id_process_access(struct vcpu *vcpu, uintreg_t esr)
 		value = 0;
 		dlog_notice(
 			"Unsupported feature ID register read: "
-			"op0=%d, op1=%d, crn=%d, crm=%d, op2=%d, rt=%d.\n",
+			"op0=%ld, op1=%ld, crn=%ld, crm=%ld, op2=%ld, "
+			"rt=%ld.\n",
 			GET_ISS_OP0(esr), GET_ISS_OP1(esr), GET_ISS_CRN(esr),
 			GET_ISS_CRM(esr), GET_ISS_OP2(esr), GET_ISS_RT(esr));
 		break;
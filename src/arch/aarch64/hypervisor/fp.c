@@ -0,0 +1,201 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "fp.h"
+
+#include "hf/arch/barriers.h"
+
+#include "msr.h"
+#include "sysregs.h"
+
+#if ENABLE_LAZY_FP
+
+/*
+ * The floating point registers of a vCPU are only restored when it first
+ * accesses them after being scheduled on a CPU, which traps to EL2 through
+ * CPTR_EL2. Until then, the CPU may still hold the registers of the vCPU it
+ * last loaded them for, so they don't need restoring if that vCPU runs on it
+ * again in the meantime.
+ *
+ * The registers of a vCPU that can move between CPUs are saved as soon as it
+ * stops running, so that it can be resumed anywhere. The other world vCPU
+ * never moves, so its registers are only saved when another vCPU needs them.
+ */
+
+/** Floating point state of a CPU. */
+struct fp_cpu_state {
+	/** The vCPU whose floating point registers the CPU holds, if any. */
+	struct vcpu *owner;
+
+	/** Whether the registers may differ from the owner's saved copy. */
+	bool dirty;
+
+	/** Whether accesses to the registers currently trap to EL2. */
+	bool trapped;
+};
+
+static struct fp_cpu_state fp_cpu_states[MAX_CPUS];
+
+/* Values of CPTR_EL2 with accesses to the registers enabled and trapped. */
+static uintreg_t cptr_el2_enabled;
+static uintreg_t cptr_el2_trapped;
+
+/* Assembly helpers in exceptions.S. */
+void fp_regs_save(struct vcpu *vcpu);
+void fp_regs_restore(struct vcpu *vcpu);
+
+static struct fp_cpu_state *fp_cpu_state(struct vcpu *vcpu)
+{
+	return &fp_cpu_states[cpu_index(vcpu->cpu)];
+}
+
+static void fp_set_trapped(struct fp_cpu_state *state, bool trapped)
+{
+	if (state->trapped == trapped) {
+		return;
+	}
+
+	write_msr(CPTR_EL2, trapped ? cptr_el2_trapped : cptr_el2_enabled);
+	isb();
+	state->trapped = trapped;
+}
+
+/**
+ * Returns whether the registers of the vCPU's CPU hold its floating point
+ * registers.
+ */
+static bool fp_is_loaded(struct fp_cpu_state *state, struct vcpu *vcpu)
+{
+	return state->owner == vcpu && vcpu->regs.fp_cpu == vcpu->cpu;
+}
+
+/**
+ * Loads the floating point registers of the vCPU into its CPU, saving those of
+ * the previous owner first if needed.
+ */
+static void fp_load(struct fp_cpu_state *state, struct vcpu *vcpu)
+{
+	if (!fp_is_loaded(state, vcpu)) {
+		fp_set_trapped(state, false);
+		if (state->owner != NULL && state->dirty) {
+			fp_regs_save(state->owner);
+		}
+		fp_regs_restore(vcpu);
+		state->owner = vcpu;
+		vcpu->regs.fp_cpu = vcpu->cpu;
+	}
+
+	state->dirty = true;
+}
+
+/**
+ * Resets the floating point state of the CPU as it is powered on, with
+ * accesses enabled as arch_cpu_init sets up CPTR_EL2.
+ */
+void fp_cpu_init(struct cpu *c)
+{
+	struct fp_cpu_state *state = &fp_cpu_states[cpu_index(c)];
+
+	/*
+	 * SVE instructions also access the floating point registers, so they
+	 * must trap as well.
+	 */
+	cptr_el2_enabled = get_cptr_el2_value();
+	if (has_vhe_support()) {
+		cptr_el2_trapped = cptr_el2_enabled &
+				   ~(CPTR_EL2_VHE_FPEN | CPTR_EL2_VHE_ZEN);
+	} else {
+		cptr_el2_trapped = cptr_el2_enabled | CPTR_EL2_TFP;
+		if (is_arch_feat_sve_supported()) {
+			cptr_el2_trapped |= CPTR_EL2_TZ;
+		}
+	}
+
+	state->owner = NULL;
+	state->dirty = false;
+	state->trapped = false;
+}
+
+/**
+ * Traps accesses to the floating point registers unless the CPU still holds
+ * those of the vCPU about to run.
+ */
+void fp_begin_restoring_state(struct vcpu *vcpu)
+{
+	struct fp_cpu_state *state = fp_cpu_state(vcpu);
+
+	if (fp_is_loaded(state, vcpu)) {
+		fp_set_trapped(state, false);
+		state->dirty = true;
+	} else {
+		fp_set_trapped(state, true);
+	}
+}
+
+/**
+ * Saves the floating point registers of a vCPU that has stopped running, if it
+ * accessed them.
+ */
+void fp_complete_saving_state(struct vcpu *vcpu)
+{
+	struct fp_cpu_state *state = fp_cpu_state(vcpu);
+
+	if (state->owner != vcpu || !state->dirty) {
+		return;
+	}
+
+	fp_set_trapped(state, false);
+	fp_regs_save(vcpu);
+	state->dirty = false;
+}
+
+/**
+ * Handles a trapped access to the floating point registers by loading those of
+ * the vCPU. The instruction is then executed again.
+ */
+void fp_handle_trap(struct vcpu *vcpu)
+{
+	struct fp_cpu_state *state = fp_cpu_state(vcpu);
+
+	fp_set_trapped(state, false);
+	fp_load(state, vcpu);
+}
+
+/**
+ * Loads the floating point registers of the other world vCPU before returning
+ * to it. They are left dirty as it may use them without trapping, since
+ * CPTR_EL2 of this world doesn't apply to it.
+ */
+void fp_load_other_world(struct vcpu *vcpu)
+{
+	fp_load(fp_cpu_state(vcpu), vcpu);
+}
+
+#else
+
+/*
+ * The floating point registers are saved and restored on every switch by
+ * exceptions.S, so there is nothing to track.
+ */
+
+void fp_cpu_init(struct cpu *c)
+{
+	(void)c;
+}
+
+void fp_begin_restoring_state(struct vcpu *vcpu)
+{
+	(void)vcpu;
+}
+
+void fp_complete_saving_state(struct vcpu *vcpu)
+{
+	(void)vcpu;
+}
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include "hf/cpu.h"
+
+void fp_cpu_init(struct cpu *c);
+
+void fp_begin_restoring_state(struct vcpu *vcpu);
+
+void fp_complete_saving_state(struct vcpu *vcpu);
+
+void fp_handle_trap(struct vcpu *vcpu);
+
+void fp_load_other_world(struct vcpu *vcpu);
@@ -27,7 +27,10 @@
 #include "vmapi/hf/call.h"
 
 #include "debug_el1.h"
+#include "exit_stats.h"
 #include "feature_id.h"
+#include "fp.h"
+#include "lazy_regs.h"
 #include "msr.h"
 #include "perfmon.h"
 #include "psci.h"
@@ -90,6 +93,8 @@ void complete_saving_state(struct vcpu *vcpu)
 		vcpu->regs.peripherals.cntv_ctl_el0 = read_msr(cntv_ctl_el0);
 	}
 
+	fp_complete_saving_state(vcpu);
+
 	api_regs_state_saved(vcpu);
 
 	/*
@@ -119,9 +124,12 @@ void complete_saving_state(struct vcpu *vcpu)
 
 /**
  * Restores the state of per-vCPU peripherals, such as the virtual timer.
+ * Returns whether the lazy registers of the vCPU need to be restored.
  */
-void begin_restoring_state(struct vcpu *vcpu)
+bool begin_restoring_state(struct vcpu *vcpu)
 {
+	fp_begin_restoring_state(vcpu);
+
 	/*
 	 * Clear timer control register before restoring compare value, to avoid
 	 * a spurious timer interrupt. This could be a problem if the interrupt
@@ -148,6 +156,8 @@ void begin_restoring_state(struct vcpu *vcpu)
 		write_msr(cnthp_ctl_el2, 0);
 		write_msr(cnthp_cval_el2, 0);
 	}
+
+	return lazy_regs_begin_restoring(vcpu);
 }
 
 /**
@@ -186,6 +196,9 @@ static void invalidate_vm_tlb(void)
  * specification) use inconsistent ASIDs across vCPUs. c.f. KVM's similar
  * workaround:
  * https://git.kernel.org/pub/scm/linux/kernel/git/torvalds/linux.git/commit/?id=94d0e5980d6791b9
+ *
+ * VMs declaring `consistent_asids` in their manifest keep their TLB entries,
+ * which are tagged with the VMID, when moving between vCPUs.
  */
 void maybe_invalidate_tlb(struct vcpu *vcpu)
 {
@@ -196,9 +209,17 @@ void maybe_invalidate_tlb(struct vcpu *vcpu)
 	    new_vcpu_index) {
 		/*
 		 * The vCPU has changed since the last time this VM was run on
-		 * this pCPU, so we need to invalidate the TLB.
+		 * this pCPU, so we need to invalidate the TLB, unless the VM
+		 * declared it uses ASIDs consistently across its vCPUs.
 		 */
-		invalidate_vm_tlb();
+		if (vcpu->vm->consistent_asids) {
+			vcpu->vm->arch.tlb_invalidations[current_cpu_index]
+				.skipped++;
+		} else {
+			invalidate_vm_tlb();
+			vcpu->vm->arch.tlb_invalidations[current_cpu_index]
+				.issued++;
+		}
 
 		/* Record the fact that this vCPU is now running on this CPU. */
 		vcpu->vm->arch.last_vcpu_on_cpu[current_cpu_index] =
@@ -241,12 +262,12 @@ noreturn void sync_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
 	case EC_DATA_ABORT_SAME_EL:
 		if (!(esr & (1U << 10))) { /* Check FnV bit. */
 			dlog_error(
-				"Data abort: pc=%#x, esr=%#x, ec=%#x, "
-				"far=%#x\n",
+				"Data abort: pc=%#lx, esr=%#lx, ec=%#lx, "
+				"far=%#lx\n",
 				elr, esr, ec, read_msr(far_el2));
 		} else {
 			dlog_error(
-				"Data abort: pc=%#x, esr=%#x, ec=%#x, "
+				"Data abort: pc=%#lx, esr=%#lx, ec=%#lx, "
 				"far=invalid\n",
 				elr, esr, ec);
 		}
@@ -255,8 +276,8 @@ noreturn void sync_current_exception_noreturn(uintreg_t elr, uintreg_t spsr)
 
 	default:
 		dlog_error(
-			"Unknown current sync exception pc=%#x, esr=%#x, "
-			"ec=%#x\n",
+			"Unknown current sync exception pc=%#lx, esr=%#lx, "
+			"ec=%#lx\n",
 			elr, esr, ec);
 		break;
 	}
@@ -365,13 +386,13 @@ static bool spmd_handler(struct ffa_value *args, struct vcpu *current)
 					HF_SPMD_VM_ID,
 				.arg2 = 0U};
 
-			dlog_verbose("%s cpu off notification cpuid %#x\n",
+			dlog_verbose("%s cpu off notification cpuid %#lx\n",
 				     __func__, vcpu->cpu->id);
 			cpu_off(vcpu->cpu);
 			break;
 		}
 		default:
-			dlog_verbose("%s PSCI message not handled %#x\n",
+			dlog_verbose("%s PSCI message not handled %#lx\n",
 				     __func__, args->arg3);
 			return false;
 		}
@@ -918,8 +939,8 @@ static void inject_el1_unknown_exception(struct vcpu *vcpu, uintreg_t esr_el2)
 
 	direction_str = ISS_IS_READ(esr_el2) ? "read" : "write";
 	dlog_notice(
-		"Trapped access to system register %s: op0=%d, op1=%d, crn=%d, "
-		"crm=%d, op2=%d, rt=%d.\n",
+		"Trapped access to system register %s: op0=%ld, op1=%ld, "
+		"crn=%ld, crm=%ld, op2=%ld, rt=%ld.\n",
 		direction_str, GET_ISS_OP0(esr_el2), GET_ISS_OP1(esr_el2),
 		GET_ISS_CRN(esr_el2), GET_ISS_CRM(esr_el2),
 		GET_ISS_OP2(esr_el2), GET_ISS_RT(esr_el2));
@@ -962,6 +983,45 @@ static struct vcpu *hvc_handler(struct vcpu *vcpu)
 						       args.arg3, vcpu, &next);
 		break;
 
+	case HF_TIMER_DEADLINE_GET:
+		vcpu->regs.r[0] = api_timer_deadline_get(vcpu);
+		break;
+
+	case HF_TIMER_EXPIRED_GET:
+		vcpu->regs.r[0] = api_timer_expired_get(vcpu);
+		break;
+
+	case HF_CONSOLE_RING_REGISTER:
+		vcpu->regs.r[0] =
+			api_console_ring_register(ipa_init(args.arg1), vcpu);
+		break;
+
+	case HF_CONSOLE_RING_UNREGISTER:
+		vcpu->regs.r[0] = api_console_ring_unregister(vcpu);
+		break;
+
+	case HF_CONSOLE_RING_FLUSH:
+		vcpu->regs.r[0] = api_console_ring_flush(vcpu);
+		break;
+
+	case HF_VM_TLB_INVALIDATIONS_GET:
+		vcpu->regs.r[0] = api_vm_tlb_invalidations_get(
+			args.arg1, args.arg2 != 0, vcpu);
+		break;
+
+	case HF_IOMMU_FAULTS_GET:
+		vcpu->regs.r[0] = api_iommu_faults_get(args.arg1, vcpu);
+		break;
+
+	case HF_CPU_EXIT_STAT_GET:
+		vcpu->regs.r[0] = api_cpu_exit_stat_get(args.arg1, args.arg2,
+							args.arg3, vcpu);
+		break;
+
+	case HF_SRI_STAT_GET:
+		vcpu->regs.r[0] = api_sri_stat_get(args.arg1);
+		break;
+
 	case HF_DEBUG_LOG:
 		vcpu->regs.r[0] = api_debug_log(args.arg1, vcpu);
 		break;
@@ -982,7 +1042,10 @@ static struct vcpu *hvc_handler(struct vcpu *vcpu)
 	return next;
 }
 
-struct vcpu *irq_lower(void)
+/**
+ * Handles an IRQ taken from a lower EL, or an FIQ if not in the secure world.
+ */
+static struct vcpu *lower_interrupt(void)
 {
 #if SECURE_WORLD == 1
 	struct vcpu *next = NULL;
@@ -1010,6 +1073,13 @@ struct vcpu *irq_lower(void)
 #endif
 }
 
+struct vcpu *irq_lower(void)
+{
+	exit_stats_irq(current()->cpu);
+
+	return lower_interrupt();
+}
+
 struct vcpu *fiq_lower(void)
 {
 #if SECURE_WORLD == 1
@@ -1017,6 +1087,8 @@ struct vcpu *fiq_lower(void)
 	struct vcpu *current_vcpu = current();
 	int64_t ret;
 
+	exit_stats_fiq(current_vcpu->cpu);
+
 	assert(current_vcpu->vm->ns_interrupts_action != NS_ACTION_QUEUED);
 
 	if (plat_ffa_vm_managed_exit_supported(current_vcpu->vm)) {
@@ -1055,7 +1127,9 @@ struct vcpu *fiq_lower(void)
 	 */
 	return plat_ffa_unwind_nwd_call_chain_interrupt(current_vcpu);
 #else
-	return irq_lower();
+	exit_stats_fiq(current()->cpu);
+
+	return lower_interrupt();
 #endif
 }
 
@@ -1123,6 +1197,23 @@ static struct vcpu_fault_info fault_info_init(uintreg_t esr,
 	return r;
 }
 
+/**
+ * Handles an HVC, SVC or SMC with the given handler, counting the call and the
+ * time it took in the exit statistics of the CPU.
+ */
+static struct vcpu *timed_call_handler(
+	struct vcpu *vcpu, struct vcpu *(*handler)(struct vcpu *vcpu))
+{
+	struct cpu *c = vcpu->cpu;
+	uint32_t func = vcpu->regs.r[0];
+	uint64_t begin = exit_stats_now();
+	struct vcpu *next = handler(vcpu);
+
+	exit_stats_call(c, func, exit_stats_now() - begin);
+
+	return next;
+}
+
 struct vcpu *sync_lower_exception(uintreg_t esr, uintreg_t far)
 {
 	struct vcpu *vcpu = current();
@@ -1132,6 +1223,8 @@ struct vcpu *sync_lower_exception(uintreg_t esr, uintreg_t far)
 	bool is_el0_partition = vcpu->vm->el0_partition;
 	bool resume = false;
 
+	exit_stats_sync(vcpu->cpu, ec);
+
 	switch (ec) {
 	case EC_WFI_WFE:
 		/* Skip the instruction. */
@@ -1162,6 +1255,14 @@ struct vcpu *sync_lower_exception(uintreg_t esr, uintreg_t far)
 		/* WFI */
 		return api_wait_for_interrupt(vcpu);
 
+#if ENABLE_LAZY_FP
+	case EC_FP_ASIMD:
+	case EC_SVE:
+		/* Retry the access once the registers are loaded. */
+		fp_handle_trap(vcpu);
+		return NULL;
+#endif
+
 	case EC_DATA_ABORT_LOWER_EL:
 		info = fault_info_init(
 			esr, vcpu, (esr & (1U << 6)) ? MM_MODE_W : MM_MODE_R);
@@ -1211,17 +1312,17 @@ struct vcpu *sync_lower_exception(uintreg_t esr, uintreg_t far)
 		return NULL;
 	case EC_SVC:
 		CHECK(is_el0_partition);
-		return hvc_handler(vcpu);
+		return timed_call_handler(vcpu, hvc_handler);
 	case EC_HVC:
 		if (is_el0_partition) {
 			dlog_warning("Unexpected HVC Trap on EL0 partition\n");
 			return api_abort(vcpu);
 		}
-		return hvc_handler(vcpu);
+		return timed_call_handler(vcpu, hvc_handler);
 
 	case EC_SMC: {
 		uintreg_t smc_pc = vcpu->regs.pc;
-		struct vcpu *next = smc_handler(vcpu);
+		struct vcpu *next = timed_call_handler(vcpu, smc_handler);
 
 		/* Skip the SMC instruction. */
 		vcpu->regs.pc = smc_pc + GET_NEXT_PC_INC(esr);
@@ -1238,8 +1339,8 @@ struct vcpu *sync_lower_exception(uintreg_t esr, uintreg_t far)
 
 	default:
 		dlog_notice(
-			"Unknown lower sync exception pc=%#x, esr=%#x, "
-			"ec=%#x\n",
+			"Unknown lower sync exception pc=%#lx, esr=%#lx, "
+			"ec=%#lx\n",
 			vcpu->regs.pc, esr, ec);
 		break;
 	}
@@ -1269,6 +1370,8 @@ void handle_system_register_access(uintreg_t esr_el2)
 	uintreg_t ec = GET_ESR_EC(esr_el2);
 
 	CHECK(ec == EC_MSR);
+	exit_stats_sync(vcpu->cpu, ec);
+
 	/*
 	 * Handle accesses to debug and performance monitor registers.
 	 * Inject an exception for unhandled/unsupported registers.
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "lazy_regs.h"
+
+#include "sysregs_defs.h"
+
+#if ENABLE_LAZY_REGS
+
+/*
+ * The lazy registers of a vCPU are saved whenever it stops running, but the
+ * CPU keeps holding them until another vCPU's are restored. They don't need
+ * restoring if the same vCPU runs on the CPU again before then.
+ */
+
+/** The vCPU whose lazy registers each CPU holds, if any. */
+static struct vcpu *lazy_regs_owner[MAX_CPUS];
+
+/**
+ * Returns whether accesses to all of the debug and performance monitor
+ * registers saved with the lazy registers trap to EL2.
+ */
+static bool lazy_regs_trapped(struct vcpu *vcpu)
+{
+	uintreg_t traps = MDCR_EL2_TDA | MDCR_EL2_TPM;
+
+	return (vcpu->regs.lazy.mdcr_el2 & traps) == traps;
+}
+
+/**
+ * Forgets the lazy registers the CPU held, as it is powered on.
+ */
+void lazy_regs_cpu_init(struct cpu *c)
+{
+	lazy_regs_owner[cpu_index(c)] = NULL;
+}
+
+/**
+ * Prepares for the vCPU to run on its CPU, returning whether its lazy registers
+ * need to be restored.
+ */
+bool lazy_regs_begin_restoring(struct vcpu *vcpu)
+{
+	struct vcpu **owner = &lazy_regs_owner[cpu_index(vcpu->cpu)];
+	bool loaded = *owner == vcpu && vcpu->regs.lazy_cpu == vcpu->cpu;
+
+	/*
+	 * Whichever way the registers get loaded, they match the vCPU's copy
+	 * until it writes them.
+	 */
+	vcpu->regs.lazy_save_trapped = !lazy_regs_trapped(vcpu);
+
+	if (loaded) {
+		return false;
+	}
+
+	*owner = vcpu;
+	vcpu->regs.lazy_cpu = vcpu->cpu;
+
+	return true;
+}
+
+/**
+ * Forgets the lazy registers the CPU held as the other world is about to run,
+ * since they aren't preserved for this world when it does.
+ */
+void lazy_regs_enter_other_world(struct vcpu *vcpu)
+{
+	lazy_regs_owner[cpu_index(vcpu->cpu)] = NULL;
+}
+
+#else
+
+/*
+ * The lazy registers are all saved and restored on every switch by
+ * exceptions.S, so there is nothing to track.
+ */
+
+void lazy_regs_cpu_init(struct cpu *c)
+{
+	(void)c;
+}
+
+bool lazy_regs_begin_restoring(struct vcpu *vcpu)
+{
+	(void)vcpu;
+
+	return true;
+}
+
+void lazy_regs_enter_other_world(struct vcpu *vcpu)
+{
+	(void)vcpu;
+}
+
+#endif
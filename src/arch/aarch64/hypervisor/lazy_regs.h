@@ -0,0 +1,17 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include "hf/cpu.h"
+
+void lazy_regs_cpu_init(struct cpu *c);
+
+bool lazy_regs_begin_restoring(struct vcpu *vcpu);
+
+void lazy_regs_enter_other_world(struct vcpu *vcpu);
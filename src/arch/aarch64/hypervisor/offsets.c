@@ -20,6 +20,9 @@ DEFINE_OFFSETOF(VCPU_VM, struct vcpu, vm)
 DEFINE_OFFSETOF(VCPU_CPU, struct vcpu, cpu)
 DEFINE_OFFSETOF(VCPU_REGS, struct vcpu, regs)
 DEFINE_OFFSETOF(VCPU_LAZY, struct vcpu, regs.lazy)
+#if ENABLE_LAZY_REGS
+DEFINE_OFFSETOF(VCPU_LAZY_SAVE_TRAPPED, struct vcpu, regs.lazy_save_trapped)
+#endif
 DEFINE_OFFSETOF(VCPU_FREGS, struct vcpu, regs.fp)
 DEFINE_OFFSETOF(VCPU_FPSR, struct vcpu, regs.fpsr)
 #if BRANCH_PROTECTION
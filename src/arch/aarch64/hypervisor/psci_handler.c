@@ -387,3 +387,72 @@ bool psci_handler(struct vcpu *vcpu, uint32_t func, uintreg_t arg0,
 	return psci_secondary_vm_handler(vcpu, func, arg0, arg1, arg2, ret,
 					 next);
 }
+
+/** The functions the CPUs powered on to help the boot CPU are to run. */
+static struct {
+	void (*fn)(void *arg);
+	void *arg;
+} cpu_helpers[MAX_CPUS];
+
+bool arch_cpu_start_helper(struct cpu *c, void (*fn)(void *arg), void *arg)
+{
+#if SECURE_WORLD == 1
+	/* CPUs are powered on by the normal world, not by the SPMC. */
+	(void)c;
+	(void)fn;
+	(void)arg;
+
+	return false;
+#else
+	size_t index = cpu_index(c);
+	struct ffa_value smc_res;
+
+	cpu_helpers[index].arg = arg;
+	__atomic_store_n(&cpu_helpers[index].fn, fn, __ATOMIC_RELEASE);
+
+	smc_res = smc64(PSCI_CPU_ON, c->id, (uintreg_t)&cpu_entry,
+			(uintreg_t)c, 0, 0, 0, SMCCC_CALLER_HYPERVISOR);
+	if (smc_res.func != PSCI_RETURN_SUCCESS) {
+		__atomic_store_n(&cpu_helpers[index].fn, NULL,
+				 __ATOMIC_RELAXED);
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+void arch_cpu_join_helper(struct cpu *c)
+{
+#if SECURE_WORLD == 1
+	(void)c;
+#else
+	struct ffa_value smc_res;
+
+	do {
+		smc_res = smc64(PSCI_AFFINITY_INFO, c->id, 0, 0, 0, 0, 0,
+				SMCCC_CALLER_HYPERVISOR);
+	} while (smc_res.func != PSCI_RETURN_OFF &&
+		 (int32_t)smc_res.func >= 0);
+#endif
+}
+
+void arch_cpu_run_helper(struct cpu *c)
+{
+	size_t index = cpu_index(c);
+	void (*fn)(void *arg) = __atomic_exchange_n(&cpu_helpers[index].fn,
+						    NULL, __ATOMIC_ACQUIRE);
+
+	if (fn == NULL) {
+		return;
+	}
+
+	fn(cpu_helpers[index].arg);
+
+	/*
+	 * The CPU was never marked as on, so the primary VM can power it on
+	 * again as usual once it has turned off.
+	 */
+	smc32(PSCI_CPU_OFF, 0, 0, 0, 0, 0, 0, SMCCC_CALLER_HYPERVISOR);
+	panic("CPU off failed");
+}
@@ -50,3 +50,20 @@ void arch_vm_features_set(struct vm *vm)
 		vm->arch.trapped_features |= HF_FEATURE_PAUTH;
 	}
 }
+
+uint64_t arch_vm_tlb_invalidations_get(const struct vm *vm, bool skipped)
+{
+	uint64_t count = 0;
+	size_t i;
+
+	/*
+	 * The counters are updated by their CPU without a lock, so a count
+	 * read while the VM runs may be slightly out of date.
+	 */
+	for (i = 0; i < MAX_CPUS; i++) {
+		count += skipped ? vm->arch.tlb_invalidations[i].skipped
+				 : vm->arch.tlb_invalidations[i].issued;
+	}
+
+	return count;
+}
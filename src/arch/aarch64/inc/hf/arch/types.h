@@ -9,6 +9,7 @@
 #pragma once
 
 #include <stdalign.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "hf/ffa.h"
@@ -20,6 +21,8 @@
 #define FLOAT_REG_BYTES 16
 #define NUM_GP_REGS 31
 
+struct cpu;
+
 /** The type of a page table entry (PTE). */
 typedef uint64_t pte_t;
 
@@ -60,6 +63,18 @@ struct arch_vm {
 	 * access this field.
 	 */
 	ffa_vcpu_index_t last_vcpu_on_cpu[MAX_CPUS];
+
+	/**
+	 * The number of TLB invalidations issued, or skipped as the VM uses
+	 * consistent ASIDs, on each pCPU because a different vCPU of this VM
+	 * than the last ran on it. Only updated by code running on that CPU,
+	 * like `last_vcpu_on_cpu`.
+	 */
+	struct {
+		uint32_t issued;
+		uint32_t skipped;
+	} tlb_invalidations[MAX_CPUS];
+
 	arch_features_t trapped_features;
 
 	/*
@@ -92,7 +107,9 @@ struct arch_regs {
 	 * NOTE: Ordering is important. If adding to or reordering registers
 	 * below, make sure to update src/arch/aarch64/hypervisor/exceptions.S.
 	 * Registers affected by VHE are grouped together followed by other
-	 * registers.
+	 * registers. With ENABLE_LAZY_REGS, EL1 registers whose accesses may
+	 * trap to EL2, and then EL2 registers, come last as they aren't always
+	 * saved.
 	 *
 	 */
 	struct {
@@ -113,6 +130,32 @@ struct arch_regs {
 		uintreg_t elr_el1;
 		uintreg_t spsr_el1; /* End VHE affected registers */
 
+#if ENABLE_LAZY_REGS
+		uintreg_t csselr_el1;
+		uintreg_t actlr_el1;
+		uintreg_t tpidr_el0;
+		uintreg_t tpidrro_el0;
+		uintreg_t tpidr_el1;
+		uintreg_t sp_el0;
+		uintreg_t sp_el1;
+		uintreg_t par_el1;
+
+		/* Start EL1 registers saved only if not trapped, see below. */
+		uintreg_t mdscr_el1;
+		uintreg_t pmccfiltr_el0;
+		uintreg_t pmcr_el0;
+		uintreg_t pmcntenset_el0;
+		uintreg_t pmintenset_el1;
+
+		/* Start EL2 registers, not saved as only Hafnium sets them. */
+		uintreg_t vmpidr_el2;
+		uintreg_t vtcr_el2;
+		uintreg_t vttbr_el2;
+		uintreg_t vstcr_el2;
+		uintreg_t vsttbr_el2;
+		uintreg_t mdcr_el2;
+		uintreg_t cnthctl_el2;
+#else
 		uintreg_t vmpidr_el2;
 		uintreg_t csselr_el1;
 		uintreg_t actlr_el1;
@@ -133,13 +176,35 @@ struct arch_regs {
 		uintreg_t pmintenset_el1;
 		uintreg_t cnthctl_el2;
 		uintreg_t par_el1;
+#endif
 	} lazy;
 
+#if ENABLE_LAZY_REGS
+	/*
+	 * The CPU whose registers were last loaded with the lazy registers
+	 * above, and so may still hold them.
+	 */
+	struct cpu *lazy_cpu;
+
+	/*
+	 * Whether the debug and performance monitor registers in `lazy` need
+	 * saving when the vCPU stops running. They don't while accesses to
+	 * them trap to EL2, unless a trapped write was performed.
+	 */
+	bool lazy_save_trapped;
+#endif
+
 	/* Floating point registers. */
 	struct float_reg fp[32];
 	uintreg_t fpsr;
 	uintreg_t fpcr;
 
+	/*
+	 * The CPU whose registers were last loaded with the floating point
+	 * registers above, and so may still hold them.
+	 */
+	struct cpu *fp_cpu;
+
 #if GIC_VERSION == 3 || GIC_VERSION == 4
 	struct {
 		uintreg_t ich_hcr_el2;
@@ -235,9 +235,9 @@ bool plat_ffa_direct_request_forward(ffa_vm_id_t receiver_vm_id,
 	 * VM's requests should be forwarded to the SPMC, if receiver is an SP.
 	 */
 	if (!vm_id_is_current_world(receiver_vm_id)) {
-		dlog_verbose("%s calling SPMC %#x %#x %#x %#x %#x\n", __func__,
-			     args.func, args.arg1, args.arg2, args.arg3,
-			     args.arg4);
+		dlog_verbose("%s calling SPMC %#lx %#lx %#lx %#lx %#lx\n",
+			     __func__, args.func, args.arg1, args.arg2,
+			     args.arg3, args.arg4);
 		*ret = arch_other_world_call(args);
 		return true;
 	}
@@ -338,7 +338,7 @@ bool plat_ffa_msg_send2_forward(ffa_vm_id_t receiver_vm_id,
 		if (ffa_func_id(*ret) != FFA_SUCCESS_32) {
 			dlog_verbose(
 				"Failed forwarding FFA_MSG_SEND2_32 to the "
-				"SPMC, got error (%d).\n",
+				"SPMC, got error (%ld).\n",
 				ret->arg2);
 		}
 
@@ -732,9 +732,9 @@ void plat_ffa_rxtx_unmap_forward(ffa_vm_id_t id)
 	if (ret.func == SMCCC_ERROR_UNKNOWN) {
 		panic("Unknown error forwarding RXTX_UNMAP.\n");
 	} else if (func == FFA_ERROR_32) {
-		panic("Error %d forwarding RX/TX buffers.\n", ret.arg2);
+		panic("Error %ld forwarding RX/TX buffers.\n", ret.arg2);
 	} else if (func != FFA_SUCCESS_32) {
-		panic("Unexpected function %#x returned forwarding RX/TX "
+		panic("Unexpected function %#lx returned forwarding RX/TX "
 		      "buffers.",
 		      ret.func);
 	}
@@ -814,6 +814,16 @@ void plat_ffa_sri_trigger_not_delayed(struct cpu *cpu)
 	(void)cpu;
 }
 
+void plat_ffa_sri_set_draining(bool draining)
+{
+	(void)draining;
+}
+
+void plat_ffa_sri_stats_get(struct plat_ffa_sri_stats *stats)
+{
+	*stats = (struct plat_ffa_sri_stats){0};
+}
+
 void plat_ffa_sri_init(struct cpu *cpu)
 {
 	(void)cpu;
@@ -6,11 +6,15 @@
  * https://opensource.org/licenses/BSD-3-Clause.
  */
 
+/* Logs of this file are limited by DLOG_LEVEL_spmc. */
+#define DLOG_SUBSYSTEM spmc
+
 #include "hf/arch/ffa.h"
 #include "hf/arch/mmu.h"
 #include "hf/arch/other_world.h"
 #include "hf/arch/plat/ffa.h"
 #include "hf/arch/sve.h"
+#include "hf/arch/timer.h"
 
 #include "hf/api.h"
 #include "hf/dlog.h"
@@ -18,6 +22,7 @@
 #include "hf/ffa_internal.h"
 #include "hf/interrupt_desc.h"
 #include "hf/plat/interrupts.h"
+#include "hf/plat/iommu.h"
 #include "hf/std.h"
 #include "hf/vcpu.h"
 #include "hf/vm.h"
@@ -26,11 +31,28 @@
 
 #include "msr.h"
 #include "smc.h"
+#include "sri_coalesce.h"
 #include "sysregs.h"
 
 /** Interrupt priority for the Schedule Receiver Interrupt. */
 #define SRI_PRIORITY 0x10U
 
+/*
+ * Time window, in nanoseconds, within which SRIs that follow a previously sent
+ * one are coalesced. Zero disables coalescing.
+ */
+#ifndef SRI_COALESCE_WINDOW_NS
+#define SRI_COALESCE_WINDOW_NS 0
+#endif
+
+/*
+ * Number of coalesced notification sets after which the SRI is sent even if
+ * the coalescing window hasn't expired. Zero means no limit.
+ */
+#ifndef SRI_COALESCE_THRESHOLD
+#define SRI_COALESCE_THRESHOLD 0
+#endif
+
 /** Encapsulates `sri_state` while the `sri_state_lock` is held. */
 struct sri_state_locked {
 	enum plat_ffa_sri_state *sri_state;
@@ -39,6 +61,15 @@ struct sri_state_locked {
 /** To globally keep track of the SRI handling. */
 static enum plat_ffa_sri_state sri_state = HANDLED;
 
+/*
+ * Coalescing and suppression bookkeeping of the SRI, guarded by
+ * `sri_state_lock_instance`.
+ */
+static struct sri_coalesce sri_coalesce = {
+	.window_ns = SRI_COALESCE_WINDOW_NS,
+	.threshold = SRI_COALESCE_THRESHOLD,
+};
+
 /** Lock to guard access to `sri_state`. */
 static struct spinlock sri_state_lock_instance = SPINLOCK_INIT;
 
@@ -500,7 +531,7 @@ bool plat_ffa_check_runtime_state_transition(struct vcpu *current,
 		allowed = plat_ffa_check_rtm_sp_init(vcpu, func, next_state);
 		break;
 	default:
-		panic("Illegal Runtime Model specified by SP%x on CPU%x\n",
+		panic("Illegal Runtime Model specified by SP%x on CPU%zx\n",
 		      current->vm->id, cpu_index(current->cpu));
 		allowed = false;
 		break;
@@ -1076,7 +1107,7 @@ bool plat_ffa_run_checks(struct vcpu *current, ffa_vm_id_t target_vm_id,
 	}
 
 	if (vm->vcpu_count > 1 && vcpu_idx != cpu_index(current->cpu)) {
-		dlog_verbose("vcpu_idx (%d) != pcpu index (%d)\n", vcpu_idx,
+		dlog_verbose("vcpu_idx (%d) != pcpu index (%zd)\n", vcpu_idx,
 			     cpu_index(current->cpu));
 		return false;
 	}
@@ -1244,8 +1275,15 @@ int64_t plat_ffa_interrupt_deactivate(uint32_t pint_id, uint32_t vint_id,
 	}
 
 	if (!current->secure_interrupt_deactivated) {
+		struct vcpu_locked current_locked;
+
 		plat_interrupts_end_of_interrupt(pint_id);
 		current->secure_interrupt_deactivated = true;
+
+		/* Interrupts it preempted may be preempted again now. */
+		current_locked = vcpu_lock(current);
+		vcpu_virt_interrupt_priority_drop(&current->interrupts);
+		vcpu_unlock(&current_locked);
 	}
 
 	if (current->implicit_completion_signal) {
@@ -1313,6 +1351,8 @@ out:
  * secure interrupt triggered. The target vCPU has to be resumed on the current
  * CPU in order for it to service the virtual interrupt. This design limitation
  * simplifies the interrupt management implementation in SPMC.
+ *
+ * Returns with no vCPU if the interrupt was handled by the SPMC itself.
  */
 static struct vcpu_locked plat_ffa_secure_interrupt_prepare(
 	struct vcpu *current, uint32_t *int_id)
@@ -1325,6 +1365,16 @@ static struct vcpu_locked plat_ffa_secure_interrupt_prepare(
 
 	/* Find pending interrupt id. This also activates the interrupt. */
 	id = plat_interrupts_get_pending_interrupt_id();
+	*int_id = id;
+
+	/*
+	 * Interrupts of the IOMMU are handled by the SPMC itself, leaving no
+	 * vCPU to signal.
+	 */
+	if (plat_iommu_handle_interrupt(id, current)) {
+		plat_interrupts_end_of_interrupt(id);
+		return (struct vcpu_locked){.vcpu = NULL};
+	}
 
 	target_vcpu = plat_ffa_find_target_vcpu(current, id);
 
@@ -1365,7 +1415,6 @@ static struct vcpu_locked plat_ffa_secure_interrupt_prepare(
 	/* TODO: check api_interrupt_inject_locked return value. */
 	(void)api_interrupt_inject_locked(target_vcpu_locked, id, current,
 					  NULL);
-	*int_id = id;
 	return target_vcpu_locked;
 }
 
@@ -1526,6 +1575,12 @@ static struct ffa_value plat_ffa_handle_secure_interrupt_secure_world(
 	CHECK((current->vm->id & HF_VM_ID_WORLD_MASK) != 0);
 	target_vcpu_locked = plat_ffa_secure_interrupt_prepare(current, &id);
 
+	if (target_vcpu_locked.vcpu == NULL) {
+		/* Resume the current vCPU. */
+		*next = NULL;
+		return ffa_ret;
+	}
+
 	if (current == target_vcpu_locked.vcpu) {
 		/*
 		 * A scenario where target vCPU is the current vCPU in secure
@@ -1589,6 +1644,13 @@ static struct ffa_value plat_ffa_handle_secure_interrupt_from_normal_world(
 	}
 
 	target_vcpu_locked = plat_ffa_secure_interrupt_prepare(current, &id);
+
+	if (target_vcpu_locked.vcpu == NULL) {
+		/* Resume the normal world. */
+		*next = NULL;
+		return (struct ffa_value){.func = FFA_NORMAL_WORLD_RESUME};
+	}
+
 	plat_ffa_signal_secure_interrupt_sel1(current, target_vcpu_locked, id,
 					      next, true);
 
@@ -1764,12 +1826,18 @@ void plat_ffa_sri_state_set(enum plat_ffa_sri_state state)
 	struct sri_state_locked sri_state_locked = sri_state_lock();
 
 	sri_state_set(sri_state_locked, state);
+
+	if (state == HANDLED) {
+		/* The scheduler got all info, so start coalescing afresh. */
+		sri_coalesce_handled(&sri_coalesce);
+	}
+
 	sri_state_unlock(sri_state_locked);
 }
 
 static void plat_ffa_send_schedule_receiver_interrupt(struct cpu *cpu)
 {
-	dlog_verbose("Setting Schedule Receiver SGI %u on core: %u\n",
+	dlog_verbose("Setting Schedule Receiver SGI %u on core: %zu\n",
 		     HF_SCHEDULE_RECEIVER_INTID, cpu_index(cpu));
 
 	plat_interrupts_send_sgi(HF_SCHEDULE_RECEIVER_INTID, cpu, false);
@@ -1779,7 +1847,12 @@ void plat_ffa_sri_trigger_if_delayed(struct cpu *cpu)
 {
 	struct sri_state_locked sri_state_locked = sri_state_lock();
 
-	if (*(sri_state_locked.sri_state) == DELAYED) {
+	/*
+	 * SRIs deferred by coalescing are sent before the normal world runs,
+	 * unless the scheduler is draining the info.
+	 */
+	if (*(sri_state_locked.sri_state) == DELAYED &&
+	    sri_coalesce_flush(&sri_coalesce, arch_timer_now_ns())) {
 		plat_ffa_send_schedule_receiver_interrupt(cpu);
 		sri_state_set(sri_state_locked, TRIGGERED);
 	}
@@ -1791,18 +1864,51 @@ void plat_ffa_sri_trigger_not_delayed(struct cpu *cpu)
 {
 	struct sri_state_locked sri_state_locked = sri_state_lock();
 
-	if (*(sri_state_locked.sri_state) == HANDLED) {
+	switch (sri_coalesce_request(&sri_coalesce,
+				     *(sri_state_locked.sri_state),
+				     arch_timer_now_ns())) {
+	case SRI_COALESCE_SEND:
 		/*
-		 * If flag to delay SRI isn't set, trigger SRI such that the
-		 * receiver scheduler is aware there are pending notifications.
+		 * Trigger SRI such that the receiver scheduler is aware there
+		 * are pending notifications.
 		 */
 		plat_ffa_send_schedule_receiver_interrupt(cpu);
 		sri_state_set(sri_state_locked, TRIGGERED);
+		break;
+	case SRI_COALESCE_DEFER:
+		/*
+		 * Defer the SRI to a later context switch to the receiver
+		 * scheduler, such that it covers all notifications set in
+		 * the meantime.
+		 */
+		sri_state_set(sri_state_locked, DELAYED);
+		break;
+	case SRI_COALESCE_SUPPRESS:
+		break;
 	}
 
 	sri_state_unlock(sri_state_locked);
 }
 
+void plat_ffa_sri_set_draining(bool draining)
+{
+	struct sri_state_locked sri_state_locked = sri_state_lock();
+
+	sri_coalesce_set_draining(&sri_coalesce, draining,
+				  arch_timer_now_ns());
+
+	sri_state_unlock(sri_state_locked);
+}
+
+void plat_ffa_sri_stats_get(struct plat_ffa_sri_stats *stats)
+{
+	struct sri_state_locked sri_state_locked = sri_state_lock();
+
+	*stats = sri_coalesce.stats;
+
+	sri_state_unlock(sri_state_locked);
+}
+
 void plat_ffa_sri_init(struct cpu *cpu)
 {
 	struct interrupt_descriptor sri_desc;
@@ -2019,6 +2125,12 @@ struct vcpu *plat_ffa_unwind_nwd_call_chain_interrupt(struct vcpu *current_vcpu)
 				current_vcpu->mask_ns_interrupts);
 		}
 
+		/*
+		 * The normal world runs next, so a delayed SRI mustn't be left
+		 * pending.
+		 */
+		plat_ffa_sri_trigger_if_delayed(current_vcpu->cpu);
+
 		return api_preempt(current_vcpu);
 	}
 
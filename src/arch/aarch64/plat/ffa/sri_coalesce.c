@@ -0,0 +1,119 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "sri_coalesce.h"
+
+void sri_coalesce_init(struct sri_coalesce *c, uint64_t window_ns,
+		       uint32_t threshold)
+{
+	*c = (struct sri_coalesce){
+		.window_ns = window_ns,
+		.threshold = threshold,
+	};
+}
+
+/**
+ * Checks if the scheduler is still retrieving the notifications info, in which
+ * case there is no need to signal it. The draining state is dropped if the
+ * scheduler hasn't called back within `SRI_DRAIN_TIMEOUT_NS`.
+ */
+static bool sri_coalesce_is_draining(struct sri_coalesce *c, uint64_t now_ns)
+{
+	if (c->draining &&
+	    now_ns - c->draining_since_ns >= SRI_DRAIN_TIMEOUT_NS) {
+		c->draining = false;
+	}
+
+	return c->draining;
+}
+
+/** Checks if the coalescing window of the last SRI sent is still open. */
+static bool sri_coalesce_in_window(const struct sri_coalesce *c,
+				   uint64_t now_ns)
+{
+	return c->window_ns > 0 && c->sent_once &&
+	       now_ns - c->last_sent_ns < c->window_ns;
+}
+
+/** Checks if as many requests as allowed have already been deferred. */
+static bool sri_coalesce_threshold_reached(const struct sri_coalesce *c)
+{
+	return c->threshold > 0 && c->deferred >= c->threshold;
+}
+
+static void sri_coalesce_sent(struct sri_coalesce *c, uint64_t now_ns)
+{
+	c->sent_once = true;
+	c->last_sent_ns = now_ns;
+	c->deferred = 0;
+	c->stats.sent++;
+}
+
+/**
+ * Decides what to do about a notification set that didn't ask for the SRI to
+ * be delayed, given the current state of the SRI. Sending is accounted for,
+ * so the caller must send the SRI if told to.
+ */
+enum sri_coalesce_action sri_coalesce_request(struct sri_coalesce *c,
+					      enum plat_ffa_sri_state state,
+					      uint64_t now_ns)
+{
+	/*
+	 * An SRI is outstanding, or the scheduler is bound to call
+	 * FFA_NOTIFICATION_INFO_GET again: either way it will see the info.
+	 */
+	if (state == TRIGGERED || sri_coalesce_is_draining(c, now_ns)) {
+		c->stats.suppressed++;
+		return SRI_COALESCE_SUPPRESS;
+	}
+
+	if (sri_coalesce_in_window(c, now_ns) &&
+	    !sri_coalesce_threshold_reached(c)) {
+		c->deferred++;
+		c->stats.coalesced++;
+		return SRI_COALESCE_DEFER;
+	}
+
+	sri_coalesce_sent(c, now_ns);
+
+	return SRI_COALESCE_SEND;
+}
+
+/**
+ * Decides whether the delayed SRI is to be sent at a world switch to the normal
+ * world. It always is, even if the coalescing window of deferred requests
+ * hasn't expired, as nothing would send it later if no further notifications
+ * were set. Nothing is sent while the scheduler is draining, as it will
+ * retrieve the info anyway, and the SRI stays delayed in case it stops doing so
+ * without retrieving all of it.
+ */
+bool sri_coalesce_flush(struct sri_coalesce *c, uint64_t now_ns)
+{
+	if (sri_coalesce_is_draining(c, now_ns)) {
+		return false;
+	}
+
+	sri_coalesce_sent(c, now_ns);
+
+	return true;
+}
+
+/** Records that the scheduler retrieved all notifications info. */
+void sri_coalesce_handled(struct sri_coalesce *c)
+{
+	c->deferred = 0;
+}
+
+void sri_coalesce_set_draining(struct sri_coalesce *c, bool draining,
+			       uint64_t now_ns)
+{
+	c->draining = draining;
+	if (draining) {
+		c->draining_since_ns = now_ns;
+	}
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include "hf/arch/plat/ffa.h"
+
+#include "hf/types.h"
+
+/**
+ * Upper bound on how long SRIs are suppressed after the scheduler reported it
+ * would keep draining notifications info, in case it never calls back.
+ */
+#define SRI_DRAIN_TIMEOUT_NS (10 * 1000 * 1000)
+
+/** What to do about a request to signal the receiver scheduler. */
+enum sri_coalesce_action {
+	/* Send the SRI now. */
+	SRI_COALESCE_SEND,
+	/* Defer the SRI to a later world switch to the normal world. */
+	SRI_COALESCE_DEFER,
+	/* Don't send an SRI, as the scheduler will retrieve the info anyway. */
+	SRI_COALESCE_SUPPRESS,
+};
+
+/**
+ * Coalescing and suppression bookkeeping of the SRI.
+ *
+ * SRIs requested within `window_ns` of the last one sent are deferred, and
+ * all of them are covered by a single SRI sent at the next world switch to the
+ * normal world, or as soon as `threshold` requests have been deferred. A zero
+ * window disables coalescing, and a zero threshold means no limit.
+ */
+struct sri_coalesce {
+	uint64_t window_ns;
+	uint32_t threshold;
+
+	/* Whether an SRI was ever sent, and the time at which the last was. */
+	bool sent_once;
+	uint64_t last_sent_ns;
+
+	/* Requests deferred since the last SRI was sent. */
+	uint32_t deferred;
+
+	/* Whether, and since when, the scheduler is retrieving the info. */
+	bool draining;
+	uint64_t draining_since_ns;
+
+	struct plat_ffa_sri_stats stats;
+};
+
+void sri_coalesce_init(struct sri_coalesce *c, uint64_t window_ns,
+		       uint32_t threshold);
+enum sri_coalesce_action sri_coalesce_request(struct sri_coalesce *c,
+					      enum plat_ffa_sri_state state,
+					      uint64_t now_ns);
+bool sri_coalesce_flush(struct sri_coalesce *c, uint64_t now_ns);
+void sri_coalesce_handled(struct sri_coalesce *c);
+void sri_coalesce_set_draining(struct sri_coalesce *c, bool draining,
+			       uint64_t now_ns);
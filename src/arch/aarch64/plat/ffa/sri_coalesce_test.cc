@@ -0,0 +1,193 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "sri_coalesce.h"
+}
+
+namespace
+{
+using ::testing::Eq;
+
+constexpr uint64_t WINDOW_NS = 1000;
+constexpr uint32_t THRESHOLD = 3;
+
+/** Requests and sends SRIs as the SPMC does, tracking the SRI state. */
+class sri_coalescing : public ::testing::Test
+{
+       protected:
+	void SetUp() override
+	{
+		sri_coalesce_init(&c, WINDOW_NS, THRESHOLD);
+	}
+
+	enum sri_coalesce_action request(uint64_t now_ns)
+	{
+		enum sri_coalesce_action action =
+			sri_coalesce_request(&c, state, now_ns);
+
+		if (action == SRI_COALESCE_SEND) {
+			state = TRIGGERED;
+		} else if (action == SRI_COALESCE_DEFER) {
+			state = DELAYED;
+		}
+
+		return action;
+	}
+
+	bool flush(uint64_t now_ns)
+	{
+		if (state != DELAYED || !sri_coalesce_flush(&c, now_ns)) {
+			return false;
+		}
+
+		state = TRIGGERED;
+
+		return true;
+	}
+
+	void handled()
+	{
+		state = HANDLED;
+		sri_coalesce_handled(&c);
+	}
+
+	struct ::sri_coalesce c;
+	enum plat_ffa_sri_state state = HANDLED;
+};
+
+/** Without a window every request is sent, unless one is outstanding. */
+TEST_F(sri_coalescing, disabled)
+{
+	sri_coalesce_init(&c, 0, 0);
+
+	EXPECT_THAT(request(0), Eq(SRI_COALESCE_SEND));
+	EXPECT_THAT(request(1), Eq(SRI_COALESCE_SUPPRESS));
+	handled();
+	EXPECT_THAT(request(2), Eq(SRI_COALESCE_SEND));
+	handled();
+	EXPECT_THAT(request(3), Eq(SRI_COALESCE_SEND));
+
+	EXPECT_THAT(c.stats.sent, Eq(3));
+	EXPECT_THAT(c.stats.coalesced, Eq(0));
+	EXPECT_THAT(c.stats.suppressed, Eq(1));
+}
+
+/**
+ * Requests within the window are deferred, and all sent together at the next
+ * world switch to the normal world, whether or not the window expired.
+ */
+TEST_F(sri_coalescing, window)
+{
+	EXPECT_THAT(request(0), Eq(SRI_COALESCE_SEND));
+	handled();
+
+	EXPECT_THAT(request(10), Eq(SRI_COALESCE_DEFER));
+	EXPECT_THAT(request(20), Eq(SRI_COALESCE_DEFER));
+	EXPECT_TRUE(flush(30));
+	EXPECT_FALSE(flush(40));
+
+	EXPECT_THAT(c.stats.sent, Eq(2));
+	EXPECT_THAT(c.stats.coalesced, Eq(2));
+	EXPECT_THAT(c.stats.suppressed, Eq(0));
+
+	/* The window restarts from the SRI sent at the switch. */
+	handled();
+	EXPECT_THAT(request(WINDOW_NS + 10), Eq(SRI_COALESCE_DEFER));
+	EXPECT_THAT(request(WINDOW_NS + 40), Eq(SRI_COALESCE_SEND));
+}
+
+/**
+ * A deferred request isn't left pending if no further requests are made: it is
+ * sent at the first world switch, well within the window.
+ */
+TEST_F(sri_coalescing, deferred_then_idle)
+{
+	EXPECT_THAT(request(0), Eq(SRI_COALESCE_SEND));
+	handled();
+
+	EXPECT_THAT(request(10), Eq(SRI_COALESCE_DEFER));
+	EXPECT_TRUE(flush(11));
+	EXPECT_THAT(state, Eq(TRIGGERED));
+	EXPECT_THAT(c.deferred, Eq(0));
+	EXPECT_THAT(c.stats.sent, Eq(2));
+}
+
+/** A request once the window expired is sent straight away. */
+TEST_F(sri_coalescing, window_expired)
+{
+	EXPECT_THAT(request(0), Eq(SRI_COALESCE_SEND));
+	handled();
+	EXPECT_THAT(request(10), Eq(SRI_COALESCE_DEFER));
+	EXPECT_THAT(request(WINDOW_NS + 10), Eq(SRI_COALESCE_SEND));
+	EXPECT_THAT(c.deferred, Eq(0));
+}
+
+/**
+ * Requests are coalesced up to the threshold, after which the next one is sent
+ * within the window.
+ */
+TEST_F(sri_coalescing, threshold)
+{
+	EXPECT_THAT(request(0), Eq(SRI_COALESCE_SEND));
+	handled();
+
+	for (uint32_t i = 0; i < THRESHOLD; i++) {
+		EXPECT_THAT(request(1 + i), Eq(SRI_COALESCE_DEFER));
+		EXPECT_THAT(c.deferred, Eq(i + 1));
+	}
+
+	EXPECT_THAT(request(10), Eq(SRI_COALESCE_SEND));
+	EXPECT_THAT(c.deferred, Eq(0));
+	EXPECT_THAT(c.stats.sent, Eq(2));
+	EXPECT_THAT(c.stats.coalesced, Eq(THRESHOLD));
+
+	/* The window restarts from the SRI sent on reaching the threshold. */
+	handled();
+	EXPECT_THAT(request(20), Eq(SRI_COALESCE_DEFER));
+	EXPECT_THAT(request(WINDOW_NS + 5), Eq(SRI_COALESCE_DEFER));
+	EXPECT_THAT(request(WINDOW_NS + 10), Eq(SRI_COALESCE_SEND));
+}
+
+/** A sender asking for the SRI to be delayed has it sent at the next switch. */
+TEST_F(sri_coalescing, delay_requested)
+{
+	EXPECT_THAT(request(0), Eq(SRI_COALESCE_SEND));
+	handled();
+
+	state = DELAYED;
+	EXPECT_TRUE(flush(20));
+	EXPECT_THAT(c.stats.sent, Eq(2));
+}
+
+/**
+ * Nothing is sent while the scheduler is draining the info, until it stops or
+ * the drain times out.
+ */
+TEST_F(sri_coalescing, draining)
+{
+	sri_coalesce_set_draining(&c, true, 0);
+	EXPECT_THAT(request(10), Eq(SRI_COALESCE_SUPPRESS));
+	EXPECT_THAT(c.stats.suppressed, Eq(1));
+
+	state = DELAYED;
+	EXPECT_FALSE(flush(20));
+	EXPECT_TRUE(flush(SRI_DRAIN_TIMEOUT_NS));
+
+	handled();
+	sri_coalesce_set_draining(&c, true, SRI_DRAIN_TIMEOUT_NS + WINDOW_NS);
+	EXPECT_THAT(request(SRI_DRAIN_TIMEOUT_NS + WINDOW_NS + 1),
+		    Eq(SRI_COALESCE_SUPPRESS));
+	sri_coalesce_set_draining(&c, false, 0);
+	EXPECT_THAT(request(SRI_DRAIN_TIMEOUT_NS + WINDOW_NS + 2),
+		    Eq(SRI_COALESCE_SEND));
+}
+
+} /* namespace */
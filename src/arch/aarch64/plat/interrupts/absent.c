@@ -82,3 +82,13 @@ void plat_interrupts_send_sgi(uint32_t id, struct cpu *cpu,
 	(void)cpu;
 	(void)to_this_security_state;
 }
+
+void plat_interrupts_send_sgi_multicast(uint32_t id, struct cpu **cpus,
+					uint32_t cpu_count,
+					bool to_this_security_state)
+{
+	(void)id;
+	(void)cpus;
+	(void)cpu_count;
+	(void)to_this_security_state;
+}
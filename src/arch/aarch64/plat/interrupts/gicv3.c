@@ -420,61 +420,62 @@ void gicv3_cpuif_enable(uint32_t core_pos)
 	(void)core_pos;
 }
 
+/**
+ * Writes the SGI generation register values built by `gicv3_sgi_target_lists`,
+ * synchronising once after the last of them.
+ */
+static void gicv3_write_sgirs(const uint64_t *sgirs, uint32_t count,
+			      bool to_this_security_state)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		if (to_this_security_state) {
+			write_msr(ICC_SGI1R_EL1, sgirs[i]);
+		} else {
+			write_msr(ICC_ASGI1R_EL1, sgirs[i]);
+		}
+	}
+
+	isb();
+}
+
 void gicv3_send_sgi(uint32_t sgi_id, bool send_to_all, uint64_t mpidr_target,
 		    bool to_this_security_state)
 {
 	uint64_t sgir;
-	uint64_t irm;
 
 	CHECK(is_sgi_ppi(sgi_id));
 
-	sgir = (sgi_id & SGIR_INTID_MASK) << SGIR_INTID_SHIFT;
-
-	/* Check the interrupt routing mode. */
 	if (send_to_all) {
-		irm = 1;
+		/* Route to all PEs but this one. */
+		sgir = (sgi_id & SGIR_INTID_MASK) << SGIR_INTID_SHIFT;
+		sgir |= (1ULL & SGIR_IRM_MASK) << SGIR_IRM_SHIFT;
 	} else {
-		irm = 0;
-
-		/*
-		 * Find the affinity path of the PE for which SGI will be
-		 * generated.
-		 */
-
-		uint64_t aff0;
-		uint64_t aff1;
-		uint64_t aff2;
-		uint64_t aff3;
-
-		/*
-		 * Target List is a one hot encoding representing which cores
-		 * will be delivered the interrupt. At least one has to be
-		 * enabled.
-		 */
-		aff3 = (mpidr_target >> MPIDR_AFF3_SHIFT) & (0xff);
-		aff2 = (mpidr_target >> MPIDR_AFF2_SHIFT) & (0xff);
-		aff1 = (mpidr_target >> MPIDR_AFF1_SHIFT) & (0xff);
-		aff0 = (mpidr_target >> MPIDR_AFF0_SHIFT) & (0xff);
-
-		/* Populate the various affinity fields. */
-		sgir |= ((aff3 & SGIR_AFF_MASK) << SGIR_AFF3_SHIFT) |
-			((aff2 & SGIR_AFF_MASK) << SGIR_AFF2_SHIFT) |
-			((aff1 & SGIR_AFF_MASK) << SGIR_AFF1_SHIFT);
-
-		/* Construct the SGI target affinity. */
-		sgir |= ((1U << aff0) & SGIR_TGT_MASK) << SGIR_TGT_SHIFT;
+		/* Target the single PE through its affinity path. */
+		CHECK(gicv3_sgi_target_lists(sgi_id, &mpidr_target, 1,
+					     &sgir) == 1);
 	}
 
-	/* Populate the Interrupt Routing Mode field. */
-	sgir |= (irm & SGIR_IRM_MASK) << SGIR_IRM_SHIFT;
+	gicv3_write_sgirs(&sgir, 1, to_this_security_state);
+}
 
-	if (to_this_security_state) {
-		write_msr(ICC_SGI1R_EL1, sgir);
-	} else {
-		write_msr(ICC_ASGI1R_EL1, sgir);
-	}
+/**
+ * Sends the SGI to each of the PEs with the given MPIDRs, with a single write
+ * per cluster of targets rather than one per target.
+ */
+void gicv3_send_sgi_multicast(uint32_t sgi_id, const uint64_t *mpidr_targets,
+			      uint32_t count, bool to_this_security_state)
+{
+	uint64_t sgirs[MAX_CPUS];
 
-	isb();
+	CHECK(is_sgi_ppi(sgi_id));
+	CHECK(count <= MAX_CPUS);
+
+	gicv3_write_sgirs(
+		sgirs,
+		gicv3_sgi_target_lists(sgi_id, mpidr_targets, count, sgirs),
+		to_this_security_state);
 }
 
 #if GIC_EXT_INTID
@@ -676,3 +677,20 @@ void plat_interrupts_send_sgi(uint32_t id, struct cpu *cpu,
 {
 	gicv3_send_sgi(id, false, cpu->id, to_this_security_state);
 }
+
+void plat_interrupts_send_sgi_multicast(uint32_t id, struct cpu **cpus,
+					uint32_t cpu_count,
+					bool to_this_security_state)
+{
+	uint64_t mpidrs[MAX_CPUS];
+	uint32_t i;
+
+	CHECK(cpu_count <= MAX_CPUS);
+
+	for (i = 0; i < cpu_count; i++) {
+		mpidrs[i] = cpus[i]->id;
+	}
+
+	gicv3_send_sgi_multicast(id, mpidrs, cpu_count,
+				 to_this_security_state);
+}
@@ -14,16 +14,11 @@
 #include "hf/static_assert.h"
 #include "hf/types.h"
 
+#include "gicv3_sgi.h"
 #include "msr.h"
 
 #define BIT_32(nr) (UINT32_C(1) << (nr))
 
-#define MPIDR_AFFINITY_MASK (0xff00ffffff)
-#define MPIDR_AFFLVL_MASK (0xff)
-#define MPIDR_AFF0_SHIFT (0)
-#define MPIDR_AFF1_SHIFT (8)
-#define MPIDR_AFF2_SHIFT (16)
-#define MPIDR_AFF3_SHIFT (32)
 #define RDIST_AFF3_SHIFT (56)
 #define RDIST_AFF2_SHIFT (48)
 #define RDIST_AFF1_SHIFT (40)
@@ -230,20 +225,6 @@
 #define IAR1_EL1_INTID_SHIFT 0
 #define IAR1_EL1_INTID_MASK (0xffffff)
 
-/* ICC SGI macros */
-#define SGIR_TGT_SHIFT 0
-#define SGIR_TGT_MASK 0xffff
-#define SGIR_AFF1_SHIFT 16
-#define SGIR_INTID_SHIFT 24
-#define SGIR_INTID_MASK 0xf
-#define SGIR_AFF2_SHIFT 32
-#define SGIR_IRM_SHIFT 40
-#define SGIR_IRM_MASK 0x1
-#define SGIR_AFF3_SHIFT 48
-#define SGIR_AFF_MASK 0xff
-
-#define SGIR_IRM_TO_AFF (0)
-
 /**
  * GICv3 and 3.1 miscellaneous definitions
  */
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/check.h"
+
+#include "gicv3_sgi.h"
+
+/**
+ * Returns the ICC_SGI1R_EL1 value sending the SGI to the PEs of the given
+ * MPIDR's cluster, with an empty target list.
+ *
+ * The target list covers the PEs whose Aff0 is within the 16 selected by the
+ * range selector, which is only non-zero on systems with more than 16 PEs per
+ * cluster and so supporting it.
+ */
+static uint64_t sgir_cluster(uint32_t sgi_id, uint64_t mpidr)
+{
+	uint64_t aff3 = (mpidr >> MPIDR_AFF3_SHIFT) & MPIDR_AFFLVL_MASK;
+	uint64_t aff2 = (mpidr >> MPIDR_AFF2_SHIFT) & MPIDR_AFFLVL_MASK;
+	uint64_t aff1 = (mpidr >> MPIDR_AFF1_SHIFT) & MPIDR_AFFLVL_MASK;
+	uint64_t aff0 = (mpidr >> MPIDR_AFF0_SHIFT) & MPIDR_AFFLVL_MASK;
+
+	return ((uint64_t)(sgi_id & SGIR_INTID_MASK) << SGIR_INTID_SHIFT) |
+	       ((aff3 & SGIR_AFF_MASK) << SGIR_AFF3_SHIFT) |
+	       ((aff2 & SGIR_AFF_MASK) << SGIR_AFF2_SHIFT) |
+	       ((aff1 & SGIR_AFF_MASK) << SGIR_AFF1_SHIFT) |
+	       (((aff0 / SGIR_TGT_COUNT) & SGIR_RS_MASK) << SGIR_RS_SHIFT);
+}
+
+/**
+ * Builds the ICC_SGI1R_EL1 values sending the SGI to each of the PEs with the
+ * given MPIDRs, grouping the PEs by cluster so that a single write covers all
+ * the targets in each.
+ *
+ * `sgirs` must have room for `count` values, which is the most needed if each
+ * target is in a cluster of its own.
+ *
+ * Returns the number of values written to `sgirs`.
+ */
+uint32_t gicv3_sgi_target_lists(uint32_t sgi_id, const uint64_t *mpidrs,
+				uint32_t count, uint64_t *sgirs)
+{
+	uint32_t sgir_count = 0;
+	uint32_t i;
+
+	CHECK(sgi_id <= SGIR_INTID_MASK);
+
+	for (i = 0; i < count; i++) {
+		uint64_t sgir = sgir_cluster(sgi_id, mpidrs[i]);
+		uint64_t aff0 =
+			(mpidrs[i] >> MPIDR_AFF0_SHIFT) & MPIDR_AFFLVL_MASK;
+		uint32_t j;
+
+		for (j = 0; j < sgir_count; j++) {
+			if ((sgirs[j] & ~(uint64_t)SGIR_TGT_MASK) == sgir) {
+				break;
+			}
+		}
+
+		if (j == sgir_count) {
+			sgirs[sgir_count++] = sgir;
+		}
+
+		sgirs[j] |= ((1U << (aff0 % SGIR_TGT_COUNT)) & SGIR_TGT_MASK)
+			    << SGIR_TGT_SHIFT;
+	}
+
+	return sgir_count;
+}
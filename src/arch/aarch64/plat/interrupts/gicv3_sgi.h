@@ -0,0 +1,40 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#pragma once
+
+#include "hf/types.h"
+
+#define MPIDR_AFFINITY_MASK (0xff00ffffff)
+#define MPIDR_AFFLVL_MASK (0xff)
+#define MPIDR_AFF0_SHIFT (0)
+#define MPIDR_AFF1_SHIFT (8)
+#define MPIDR_AFF2_SHIFT (16)
+#define MPIDR_AFF3_SHIFT (32)
+
+/* ICC SGI macros */
+#define SGIR_TGT_SHIFT 0
+#define SGIR_TGT_MASK 0xffff
+#define SGIR_AFF1_SHIFT 16
+#define SGIR_INTID_SHIFT 24
+#define SGIR_INTID_MASK 0xf
+#define SGIR_AFF2_SHIFT 32
+#define SGIR_IRM_SHIFT 40
+#define SGIR_IRM_MASK 0x1
+#define SGIR_RS_SHIFT 44
+#define SGIR_RS_MASK 0xf
+#define SGIR_AFF3_SHIFT 48
+#define SGIR_AFF_MASK 0xff
+
+#define SGIR_IRM_TO_AFF (0)
+
+/* Number of PEs a single SGI register write can target. */
+#define SGIR_TGT_COUNT 16
+
+uint32_t gicv3_sgi_target_lists(uint32_t sgi_id, const uint64_t *mpidrs,
+				uint32_t count, uint64_t *sgirs);
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <set>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "gicv3_sgi.h"
+}
+
+namespace
+{
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::SizeIs;
+
+constexpr uint32_t SGI_ID = 9;
+
+uint64_t mpidr(uint64_t aff3, uint64_t aff2, uint64_t aff1, uint64_t aff0)
+{
+	return (aff3 << MPIDR_AFF3_SHIFT) | (aff2 << MPIDR_AFF2_SHIFT) |
+	       (aff1 << MPIDR_AFF1_SHIFT) | (aff0 << MPIDR_AFF0_SHIFT);
+}
+
+/** Builds the SGI register values targeting the PEs. */
+std::vector<uint64_t> target_lists(const std::vector<uint64_t> &mpidrs)
+{
+	std::vector<uint64_t> sgirs(mpidrs.size());
+
+	sgirs.resize(gicv3_sgi_target_lists(SGI_ID, mpidrs.data(),
+					    mpidrs.size(), sgirs.data()));
+
+	return sgirs;
+}
+
+/**
+ * Returns the MPIDRs of the PEs the GIC delivers the SGIs to for the register
+ * values, checking they all generate the expected SGI.
+ */
+std::set<uint64_t> model_targets(const std::vector<uint64_t> &sgirs)
+{
+	std::set<uint64_t> targets;
+
+	for (uint64_t sgir : sgirs) {
+		uint64_t rs = (sgir >> SGIR_RS_SHIFT) & SGIR_RS_MASK;
+
+		EXPECT_THAT((sgir >> SGIR_INTID_SHIFT) & SGIR_INTID_MASK,
+			    Eq(SGI_ID));
+		EXPECT_THAT((sgir >> SGIR_IRM_SHIFT) & SGIR_IRM_MASK,
+			    Eq(SGIR_IRM_TO_AFF));
+		EXPECT_THAT(sgir & SGIR_TGT_MASK, Ne(0));
+
+		for (uint64_t bit = 0; bit < SGIR_TGT_COUNT; bit++) {
+			if ((sgir & (1ULL << (SGIR_TGT_SHIFT + bit))) == 0) {
+				continue;
+			}
+
+			targets.insert(mpidr(
+				(sgir >> SGIR_AFF3_SHIFT) & SGIR_AFF_MASK,
+				(sgir >> SGIR_AFF2_SHIFT) & SGIR_AFF_MASK,
+				(sgir >> SGIR_AFF1_SHIFT) & SGIR_AFF_MASK,
+				rs * SGIR_TGT_COUNT + bit));
+		}
+	}
+
+	return targets;
+}
+
+/** A single target gets a single bit in its cluster's target list. */
+TEST(gicv3_sgi, single)
+{
+	auto sgirs = target_lists({mpidr(0, 0, 1, 3)});
+
+	ASSERT_THAT(sgirs, SizeIs(1));
+	EXPECT_THAT(sgirs[0], Eq(((uint64_t)SGI_ID << SGIR_INTID_SHIFT) |
+				 (1ULL << SGIR_AFF1_SHIFT) |
+				 (1ULL << (SGIR_TGT_SHIFT + 3))));
+}
+
+/** Targets in the same cluster share a single register write. */
+TEST(gicv3_sgi, same_cluster)
+{
+	std::vector<uint64_t> mpidrs = {mpidr(0, 0, 0, 0), mpidr(0, 0, 0, 2),
+					mpidr(0, 0, 0, 3), mpidr(0, 0, 0, 15)};
+	auto sgirs = target_lists(mpidrs);
+
+	ASSERT_THAT(sgirs, SizeIs(1));
+	EXPECT_THAT(sgirs[0] & SGIR_TGT_MASK, Eq(0x800d));
+	EXPECT_THAT(model_targets(sgirs),
+		    Eq(std::set<uint64_t>(mpidrs.begin(), mpidrs.end())));
+}
+
+/**
+ * Targets are grouped by each level of affinity above Aff0, whatever order
+ * they are given in, and repeated targets are only sent the SGI once.
+ */
+TEST(gicv3_sgi, clusters)
+{
+	std::vector<uint64_t> mpidrs = {
+		mpidr(0, 0, 0, 1), mpidr(0, 0, 1, 1), mpidr(0, 0, 0, 2),
+		mpidr(0, 1, 0, 1), mpidr(1, 0, 0, 1), mpidr(0, 0, 1, 0),
+		mpidr(1, 0, 0, 4), mpidr(0, 0, 0, 1),
+	};
+	auto sgirs = target_lists(mpidrs);
+
+	EXPECT_THAT(sgirs, SizeIs(4));
+	EXPECT_THAT(model_targets(sgirs),
+		    Eq(std::set<uint64_t>(mpidrs.begin(), mpidrs.end())));
+}
+
+/**
+ * PEs with an Aff0 beyond what a target list covers are reached through the
+ * range selector, with a write per range.
+ */
+TEST(gicv3_sgi, range_selector)
+{
+	std::vector<uint64_t> mpidrs = {
+		mpidr(0, 0, 2, 1),
+		mpidr(0, 0, 2, 17),
+		mpidr(0, 0, 2, 31),
+		mpidr(0, 0, 2, 255),
+	};
+	auto sgirs = target_lists(mpidrs);
+
+	ASSERT_THAT(sgirs, SizeIs(3));
+	EXPECT_THAT((sgirs[0] >> SGIR_RS_SHIFT) & SGIR_RS_MASK, Eq(0));
+	EXPECT_THAT((sgirs[1] >> SGIR_RS_SHIFT) & SGIR_RS_MASK, Eq(1));
+	EXPECT_THAT(sgirs[1] & SGIR_TGT_MASK, Eq(0x8002));
+	EXPECT_THAT((sgirs[2] >> SGIR_RS_SHIFT) & SGIR_RS_MASK, Eq(15));
+	EXPECT_THAT(model_targets(sgirs),
+		    Eq(std::set<uint64_t>(mpidrs.begin(), mpidrs.end())));
+}
+
+/** Nothing is written if there are no targets. */
+TEST(gicv3_sgi, empty)
+{
+	EXPECT_THAT(target_lists({}), SizeIs(0));
+}
+
+} /* namespace */
@@ -56,6 +56,6 @@ void plat_psci_cpu_resume(struct cpu *c, ipaddr_t entry_point)
 		 * This is the boot time PSCI cold reset path (svc_cpu_on_finish
 		 * handler relayed by SPMD) on secondary cores.
 		 */
-		dlog_verbose("%s: cpu mpidr 0x%x ON\n", __func__, c->id);
+		dlog_verbose("%s: cpu mpidr 0x%lx ON\n", __func__, c->id);
 	}
 }
@@ -94,7 +94,7 @@ noreturn void kmain(struct fdt_header *fdt)
 	uintptr_t initrd_start = align_up(pa_addr(image_end), LINUX_ALIGNMENT);
 	uint32_t initrd_size = fw_cfg_read_uint32(FW_CFG_INITRD_SIZE);
 
-	dlog_info("Initrd start %#x, size %#x\n", initrd_start, initrd_size);
+	dlog_info("Initrd start %#lx, size %#x\n", initrd_start, initrd_size);
 	/* Since the address was calculated from pa_addr above allow the cast */
 	// NOLINTNEXTLINE(performance-no-int-to-ptr)
 	fw_cfg_read_bytes(FW_CFG_INITRD_DATA, (uint8_t *)initrd_start,
@@ -107,7 +107,7 @@ noreturn void kmain(struct fdt_header *fdt)
 	kernel_start = align_up(initrd_start + initrd_size, LINUX_ALIGNMENT) +
 		       LINUX_OFFSET;
 	kernel_size = fw_cfg_read_uint32(FW_CFG_KERNEL_SIZE);
-	dlog_info("Kernel start %#x, size %#x\n", kernel_start, kernel_size);
+	dlog_info("Kernel start %#lx, size %#x\n", kernel_start, kernel_size);
 	/* Since the address was calculated from pa_addr above allow the cast */
 	// NOLINTNEXTLINE(performance-no-int-to-ptr)
 	fw_cfg_read_bytes(FW_CFG_KERNEL_DATA, (uint8_t *)kernel_start,
@@ -113,6 +113,18 @@
  */
 #define EC_WFI_WFE UINT64_C(0x1)
 
+/**
+ * ESR code for an access to SVE, Advanced SIMD or floating-point functionality
+ * trapped by CPTR_EL2.
+ */
+#define EC_FP_ASIMD UINT64_C(0x7)
+
+/**
+ * ESR code for an access to SVE functionality trapped by CPTR_EL2.TZ or
+ * CPTR_EL2.ZEN.
+ */
+#define EC_SVE UINT64_C(0x19)
+
 /**
  * ESR code for SVC instruction execution.
  */
@@ -494,6 +506,19 @@
 #define CPTR_EL2_TTA (UINT64_C(0x1) << 20)
 #define CPTR_EL2_VHE_TTA (UINT64_C(0x1) << 28)
 
+/**
+ * Trap accesses to SVE, Advanced SIMD and floating-point functionality, from
+ * EL0, EL1 and EL2, when HCR_EL2.E2H=0 (ARMv8.1-VHE disabled).
+ */
+#define CPTR_EL2_TFP (UINT64_C(0x1) << 10)
+
+/**
+ * Trap SVE instructions and accesses to the SVE registers at EL0, EL1 and EL2,
+ * when HCR_EL2.E2H=0 (ARMv8.1-VHE disabled). Only defined if SVE is
+ * implemented.
+ */
+#define CPTR_EL2_TZ (UINT64_C(0x1) << 8)
+
 /**
  * When HCR_EL2.E2H=1 (ARMv8.1-VHE enabled), CPTR_EL2 contains control bits to
  * enable and disable access to Floating Point, Advanced SIMD and SVE
@@ -158,3 +158,17 @@ uint64_t arch_timer_remaining_ns_current(void)
 {
 	return ticks_to_ns(arch_timer_remaining_ticks_current());
 }
+
+/**
+ * Returns the current value of the physical system counter, converted to
+ * nanoseconds. The conversion is split so that it does not overflow for large
+ * counter values.
+ */
+uint64_t arch_timer_now_ns(void)
+{
+	uint64_t ticks = read_msr(cntpct_el0);
+	uint64_t freq = read_msr(cntfrq_el0);
+
+	return (ticks / freq) * NANOS_PER_UNIT +
+	       ((ticks % freq) * NANOS_PER_UNIT) / freq;
+}
@@ -12,6 +12,12 @@
 #include "hf/ffa.h"
 #include "hf/plat/interrupts.h"
 
+/**
+ * The CPU the calling host thread stands in for, as last initialised by it, or
+ * NULL if it is the boot CPU.
+ */
+static _Thread_local const struct cpu *fake_cpu_current;
+
 void arch_irq_disable(void)
 {
 	/* TODO */
@@ -62,8 +68,52 @@ void arch_regs_set_retval(struct arch_regs *r, struct ffa_value v)
 
 void arch_cpu_init(struct cpu *c, ipaddr_t entry_point)
 {
-	(void)c;
 	(void)entry_point;
 
+	/* The CPU is initialised by the thread which runs it. */
+	fake_cpu_current = c;
+
 	plat_interrupts_controller_hw_init(c);
 }
+
+cpu_id_t arch_cpu_current_id(void)
+{
+	const struct cpu *c = fake_cpu_current;
+
+	if (c == NULL) {
+		/* Threads which didn't initialise a CPU run the boot CPU. */
+		c = cpu_find_index(0);
+	}
+
+	return c->id;
+}
+
+bool arch_cpu_start_helper(struct cpu *c, void (*fn)(void *arg), void *arg)
+{
+	(void)c;
+	(void)fn;
+	(void)arg;
+
+	return false;
+}
+
+void arch_cpu_join_helper(struct cpu *c)
+{
+	(void)c;
+}
+
+void arch_cpu_run_helper(struct cpu *c)
+{
+	(void)c;
+}
+
+bool arch_cpu_exit_stat_get(size_t cpu_index, uint32_t stat, uint32_t key,
+			    uint64_t *value)
+{
+	(void)cpu_index;
+	(void)stat;
+	(void)key;
+	(void)value;
+
+	return false;
+}
@@ -289,6 +289,15 @@ struct ffa_value plat_ffa_notifications_bitmap_create(
 	return ffa_error(FFA_NOT_SUPPORTED);
 }
 
+bool plat_ffa_notifications_bitmap_create_call(ffa_vm_id_t vm_id,
+					       ffa_vcpu_count_t vcpu_count)
+{
+	(void)vm_id;
+	(void)vcpu_count;
+
+	return false;
+}
+
 struct ffa_value plat_ffa_notifications_bitmap_destroy(ffa_vm_id_t vm_id)
 {
 	(void)vm_id;
@@ -382,6 +391,16 @@ void plat_ffa_sri_trigger_not_delayed(struct cpu *cpu)
 	(void)cpu;
 }
 
+void plat_ffa_sri_set_draining(bool draining)
+{
+	(void)draining;
+}
+
+void plat_ffa_sri_stats_get(struct plat_ffa_sri_stats *stats)
+{
+	*stats = (struct plat_ffa_sri_stats){0};
+}
+
 void plat_ffa_sri_init(struct cpu *cpu)
 {
 	(void)cpu;
@@ -471,3 +490,16 @@ void plat_ffa_enable_virtual_maintenance_interrupts(
 {
 	(void)current_locked;
 }
+
+void plat_ffa_parse_partition_manifest(struct mm_stage1_locked stage1_locked,
+				       paddr_t fdt_addr,
+				       size_t fdt_allocated_size,
+				       const struct manifest_vm *manifest_vm,
+				       struct mpool *ppool)
+{
+	(void)stage1_locked;
+	(void)fdt_addr;
+	(void)fdt_allocated_size;
+	(void)manifest_vm;
+	(void)ppool;
+}
@@ -20,3 +20,8 @@ void plat_interrupts_controller_hw_init(struct cpu *c)
 {
 	(void)c;
 }
+
+void plat_interrupts_configure_interrupt(struct interrupt_descriptor int_desc)
+{
+	(void)int_desc;
+}
@@ -12,8 +12,16 @@
 #include "hf/ffa.h"
 #include "hf/ffa_internal.h"
 
+bool arch_other_world_vm_init(struct vm *other_world_vm, struct mpool *ppool)
+{
+	(void)other_world_vm;
+	(void)ppool;
+
+	return true;
+}
+
 struct ffa_value arch_other_world_call(struct ffa_value args)
 {
-	dlog_error("Attempted to call TEE function %#x\n", args.func);
+	dlog_error("Attempted to call TEE function %#lx\n", args.func);
 	return ffa_error(FFA_NOT_SUPPORTED);
 }
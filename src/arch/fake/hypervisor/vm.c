@@ -0,0 +1,22 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/arch/vm.h"
+
+void arch_vm_features_set(struct vm *vm)
+{
+	(void)vm;
+}
+
+uint64_t arch_vm_tlb_invalidations_get(const struct vm *vm, bool skipped)
+{
+	(void)vm;
+	(void)skipped;
+
+	return 0;
+}
@@ -46,4 +46,5 @@ struct arch_regs {
 /** Type of interrupts */
 enum interrupt_type {
 	INTERRUPT_TYPE_IRQ,
+	INTERRUPT_TYPE_FIQ,
 };
@@ -0,0 +1,398 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+/*
+ * Measures where the boot time goes on the fake architecture, by parsing a
+ * synthetic manifest and loading its VMs from a synthetic initrd, as
+ * `one_time_init` does, and reporting the phases of the boot timeline.
+ *
+ * The manifest and the kernels are generated from fixed seeds, so that runs
+ * are reproducible. Each run boots in a child process, as VMs can only be
+ * loaded once per process.
+ *
+ * Usage: boot_benchmark [--vms N] [--kernel-size BYTES] [--mem-size BYTES]
+ *                       [--runs N] [--verbose]
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libfdt.h>
+
+#include "hf/arch/std.h"
+
+#include "hf/boot_params.h"
+#include "hf/boot_timeline.h"
+#include "hf/cpio.h"
+#include "hf/load.h"
+#include "hf/manifest.h"
+#include "hf/mm.h"
+#include "hf/mpool.h"
+}
+
+namespace
+{
+using struct_manifest = struct manifest;
+
+/*
+ * Where the memory given to the VMs is mapped in the benchmark, for it to be
+ * within the range of the fake architecture's page tables.
+ */
+constexpr uintptr_t kMemBegin = UINT64_C(0x4000000000);
+
+/* Device memory given to the primary VM, below the normal memory. */
+constexpr uintptr_t kDeviceMemEnd = UINT64_C(0x40000000);
+
+constexpr size_t kPageTablePoolSize = 64 * 1024 * 1024;
+constexpr size_t kManifestMaxSize = 64 * 1024;
+
+struct options {
+	size_t vms = 8;
+	size_t kernel_size = 4 * 1024 * 1024;
+	size_t mem_size = 16 * 1024 * 1024;
+	size_t runs = 10;
+	bool verbose = false;
+};
+
+void usage(const char *program)
+{
+	fprintf(stderr,
+		"Usage: %s [--vms N] [--kernel-size BYTES] [--mem-size BYTES] "
+		"[--runs N] [--verbose]\n",
+		program);
+	exit(EXIT_FAILURE);
+}
+
+bool parse_options(int argc, char *argv[], struct options *opts)
+{
+	for (int i = 1; i < argc; i++) {
+		size_t *value;
+		char *end;
+
+		if (strcmp(argv[i], "--verbose") == 0) {
+			opts->verbose = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--vms") == 0) {
+			value = &opts->vms;
+		} else if (strcmp(argv[i], "--kernel-size") == 0) {
+			value = &opts->kernel_size;
+		} else if (strcmp(argv[i], "--mem-size") == 0) {
+			value = &opts->mem_size;
+		} else if (strcmp(argv[i], "--runs") == 0) {
+			value = &opts->runs;
+		} else {
+			return false;
+		}
+
+		if (++i == argc) {
+			return false;
+		}
+
+		*value = strtoull(argv[i], &end, 0);
+		if (*end != '\0') {
+			return false;
+		}
+	}
+
+	/* The first VM is the primary, and the primary needs a kernel. */
+	return opts->vms > 0 && opts->vms < MAX_VMS && opts->runs > 0 &&
+	       opts->kernel_size > 0 && opts->kernel_size <= opts->mem_size;
+}
+
+/**
+ * Builds a hypervisor manifest with a primary VM loaded at `primary_begin` and
+ * secondary VMs for the rest, each with a kernel named after the VM.
+ */
+std::vector<char> build_manifest(const struct options &opts,
+				 uintptr_t primary_begin)
+{
+	std::vector<char> dtb(kManifestMaxSize);
+	void *fdt = dtb.data();
+	int ret = 0;
+
+	ret |= fdt_create(fdt, dtb.size());
+	ret |= fdt_finish_reservemap(fdt);
+	ret |= fdt_begin_node(fdt, "");
+	ret |= fdt_begin_node(fdt, "hypervisor");
+	ret |= fdt_property_string(fdt, "compatible", "hafnium,hafnium");
+
+	for (size_t i = 1; i <= opts.vms; i++) {
+		std::string name = "vm" + std::to_string(i);
+
+		ret |= fdt_begin_node(fdt, name.c_str());
+		ret |= fdt_property_string(fdt, "debug_name", name.c_str());
+		ret |= fdt_property_string(fdt, "kernel_filename",
+					   name.c_str());
+		if (i == 1) {
+			ret |= fdt_property_u64(fdt, "boot_address",
+						primary_begin);
+		} else {
+			ret |= fdt_property_u64(fdt, "mem_size", opts.mem_size);
+			ret |= fdt_property_u32(fdt, "vcpu_count", 1);
+		}
+		ret |= fdt_end_node(fdt);
+	}
+
+	ret |= fdt_end_node(fdt);
+	ret |= fdt_end_node(fdt);
+	ret |= fdt_finish(fdt);
+
+	if (ret != 0) {
+		fprintf(stderr, "Unable to build the manifest.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	dtb.resize(fdt_totalsize(fdt));
+	return dtb;
+}
+
+void append_cpio_file(std::vector<char> &cpio, const std::string &name,
+		      const std::vector<char> &contents)
+{
+	uint16_t header[13] = {};
+
+	/* The magic, mode and link count of the old binary format. */
+	header[0] = 070707;
+	header[3] = 0100644;
+	header[6] = 1;
+	header[10] = (uint16_t)(name.size() + 1);
+	header[11] = (uint16_t)(contents.size() >> 16);
+	header[12] = (uint16_t)contents.size();
+
+	cpio.insert(cpio.end(), (const char *)header,
+		    (const char *)header + sizeof(header));
+	cpio.insert(cpio.end(), name.c_str(), name.c_str() + name.size() + 1);
+	cpio.resize(align_up(cpio.size(), 2));
+	cpio.insert(cpio.end(), contents.begin(), contents.end());
+	cpio.resize(align_up(cpio.size(), 2));
+}
+
+/**
+ * Builds an initrd with the manifest and a kernel of random bytes for each VM.
+ */
+std::vector<char> build_initrd(const struct options &opts,
+			       const std::vector<char> &manifest)
+{
+	std::vector<char> cpio;
+
+	append_cpio_file(cpio, "manifest.dtb", manifest);
+
+	for (size_t i = 1; i <= opts.vms; i++) {
+		std::mt19937 rng(i);
+		std::vector<char> kernel(opts.kernel_size);
+
+		std::generate(kernel.begin(), kernel.end(),
+			      [&rng] { return (char)rng(); });
+		append_cpio_file(cpio, "vm" + std::to_string(i), kernel);
+	}
+
+	append_cpio_file(cpio, "TRAILER!!!", {});
+
+	return cpio;
+}
+
+/**
+ * Boots the VMs of the initrd, writing the spans of the boot timeline to `fd`.
+ * Returns false if the VMs couldn't be booted.
+ */
+bool boot(const std::vector<char> &initrd, size_t mem_size, int fd)
+{
+	static struct_manifest manifest;
+	struct string manifest_fname = STRING_INIT("manifest.dtb");
+	struct mm_stage1_locked stage1_locked;
+	struct boot_params params = {};
+	struct boot_params_update update = {};
+	const struct boot_timeline_span *spans;
+	struct memiter manifest_it;
+	struct mpool ppool;
+	struct cpio cpio;
+	void *pool;
+	size_t span;
+	size_t count;
+	bool ret;
+
+	pool = mmap(NULL, kPageTablePoolSize, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pool == MAP_FAILED ||
+	    mmap((void *)kMemBegin, mem_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE |
+			 MAP_NORESERVE,
+		 -1, 0) != (void *)kMemBegin) {
+		fprintf(stderr, "Unable to map memory.\n");
+		return false;
+	}
+
+	mpool_init(&ppool, MM_PPOOL_ENTRY_SIZE);
+	mpool_add_chunk(&ppool, pool, kPageTablePoolSize);
+
+	boot_timeline_reset();
+
+	span = boot_timeline_begin("mm_init", 0);
+	ret = mm_init(&ppool);
+	boot_timeline_end(span);
+	if (!ret) {
+		fprintf(stderr, "mm_init failed.\n");
+		return false;
+	}
+
+	stage1_locked = mm_lock_stage1();
+
+	if (!cpio_init(&cpio, initrd.data(), initrd.size()) ||
+	    !cpio_get_file(&cpio, &manifest_fname, &manifest_it)) {
+		fprintf(stderr, "Malformed initrd.\n");
+		return false;
+	}
+
+	span = boot_timeline_begin("manifest_init", 0);
+	ret = manifest_init(stage1_locked, &manifest, &manifest_it, &ppool) ==
+	      MANIFEST_SUCCESS;
+	boot_timeline_end(span);
+	if (!ret) {
+		fprintf(stderr, "Could not parse manifest.\n");
+		return false;
+	}
+
+	params.cpu_count = 1;
+	params.mem_ranges[0].begin = pa_init(kMemBegin);
+	params.mem_ranges[0].end = pa_init(kMemBegin + mem_size);
+	params.mem_ranges_count = 1;
+	params.device_mem_ranges[0].begin = pa_init(0);
+	params.device_mem_ranges[0].end = pa_init(kDeviceMemEnd);
+	params.device_mem_ranges_count = 1;
+
+	ret = load_vms(stage1_locked, &manifest, &cpio, &params, &update,
+		       &ppool);
+	manifest_deinit(&ppool);
+	mm_unlock_stage1(&stage1_locked);
+	if (!ret) {
+		fprintf(stderr, "Unable to load VMs.\n");
+		return false;
+	}
+
+	/* The names are literals, at the same address in the parent. */
+	spans = boot_timeline_get(&count);
+	return write(fd, spans, count * sizeof(*spans)) ==
+	       (ssize_t)(count * sizeof(*spans));
+}
+
+/**
+ * Boots in a child process, returning the spans of its boot timeline or
+ * nothing if it failed.
+ */
+std::vector<struct boot_timeline_span> run(const struct options &opts,
+					   const std::vector<char> &initrd,
+					   size_t mem_size)
+{
+	std::vector<struct boot_timeline_span> spans(BOOT_TIMELINE_MAX_SPANS);
+	size_t size = 0;
+	ssize_t n;
+	int status;
+	int fds[2];
+	pid_t pid;
+
+	if (pipe(fds) != 0) {
+		return {};
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		return {};
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		if (!opts.verbose) {
+			dup2(open("/dev/null", O_WRONLY), STDOUT_FILENO);
+		}
+		_exit(boot(initrd, mem_size, fds[1]) ? EXIT_SUCCESS
+						     : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	while ((n = read(fds[0], (char *)spans.data() + size,
+			 spans.size() * sizeof(spans[0]) - size)) > 0) {
+		size += n;
+	}
+	close(fds[0]);
+
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != EXIT_SUCCESS) {
+		return {};
+	}
+
+	spans.resize(size / sizeof(spans[0]));
+	return spans;
+}
+
+double span_ms(const struct boot_timeline_span &span)
+{
+	return (double)(span.end_ns - span.begin_ns) / 1000000;
+}
+
+} /* namespace */
+
+int main(int argc, char *argv[])
+{
+	struct options opts;
+	std::vector<std::vector<struct boot_timeline_span>> runs;
+	size_t mem_size;
+
+	if (!parse_options(argc, argv, &opts)) {
+		usage(argv[0]);
+	}
+
+	/* The primary's kernel goes first, the secondaries are carved out. */
+	mem_size = align_up(opts.kernel_size, PAGE_SIZE) +
+		   (opts.vms - 1) * align_up(opts.mem_size, PAGE_SIZE);
+
+	std::vector<char> initrd =
+		build_initrd(opts, build_manifest(opts, kMemBegin));
+
+	for (size_t i = 0; i < opts.runs; i++) {
+		runs.push_back(run(opts, initrd, mem_size));
+		if (runs.back().empty() ||
+		    runs.back().size() != runs.front().size()) {
+			fprintf(stderr, "Run %zu failed.\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("Boot of %zu VMs with %zu byte kernels, over %zu runs:\n",
+	       opts.vms, opts.kernel_size, opts.runs);
+	printf("%-32s %6s %10s %10s\n", "phase", "id", "min ms", "median ms");
+
+	for (size_t i = 0; i < runs.front().size(); i++) {
+		const struct boot_timeline_span &span = runs.front()[i];
+		std::vector<double> times;
+		std::string name(2 * span.depth, ' ');
+
+		for (const auto &spans : runs) {
+			times.push_back(span_ms(spans[i]));
+		}
+		std::sort(times.begin(), times.end());
+
+		name += span.name;
+		printf("%-32s %#6x %10.3f %10.3f\n", name.c_str(), span.id,
+		       times.front(), times[times.size() / 2]);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -53,7 +53,7 @@ bool plat_boot_flow_get_initrd_range(const struct fdt *fdt, paddr_t *begin,
 bool plat_boot_flow_update(struct mm_stage1_locked stage1_locked,
 			   const struct manifest *manifest,
 			   struct boot_params_update *update,
-			   struct memiter *cpio, struct mpool *ppool)
+			   struct cpio *cpio, struct mpool *ppool)
 {
 	(void)stage1_locked;
 	(void)manifest;
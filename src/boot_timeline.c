@@ -0,0 +1,122 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+/* Logs of this file are limited by DLOG_LEVEL_boot. */
+#define DLOG_SUBSYSTEM boot
+
+#include "hf/boot_timeline.h"
+
+#include "hf/arch/timer.h"
+
+#include "hf/check.h"
+#include "hf/dlog.h"
+
+/*
+ * Spans are only recorded by the boot CPU while it initialises Hafnium, so the
+ * timeline isn't locked.
+ */
+static struct boot_timeline_span boot_timeline_spans[BOOT_TIMELINE_MAX_SPANS];
+static size_t boot_timeline_count;
+static uint16_t boot_timeline_depth;
+
+/**
+ * Records the beginning of a phase of the boot, nested in the phases which
+ * have begun but not ended yet. Returns the span to end the phase with.
+ */
+size_t boot_timeline_begin(const char *name, uint16_t id)
+{
+	uint16_t depth = boot_timeline_depth++;
+
+	if (boot_timeline_count == BOOT_TIMELINE_MAX_SPANS) {
+		return BOOT_TIMELINE_NONE;
+	}
+
+	boot_timeline_spans[boot_timeline_count] = (struct boot_timeline_span){
+		.name = name,
+		.id = id,
+		.depth = depth,
+		.begin_ns = arch_timer_now_ns(),
+	};
+
+	return boot_timeline_count++;
+}
+
+/**
+ * Records the end of the phase of the given span, which must be the last one
+ * to have begun and not ended yet.
+ */
+void boot_timeline_end(size_t span)
+{
+	uint64_t now_ns = arch_timer_now_ns();
+
+	CHECK(boot_timeline_depth > 0);
+	boot_timeline_depth--;
+
+	if (span != BOOT_TIMELINE_NONE) {
+		CHECK(boot_timeline_spans[span].depth == boot_timeline_depth);
+		boot_timeline_spans[span].end_ns = now_ns;
+	}
+}
+
+/**
+ * Returns the spans recorded so far, in the order in which they began.
+ */
+const struct boot_timeline_span *boot_timeline_get(size_t *count)
+{
+	*count = boot_timeline_count;
+	return boot_timeline_spans;
+}
+
+/**
+ * Forgets the spans recorded so far.
+ */
+void boot_timeline_reset(void)
+{
+	boot_timeline_count = 0;
+	boot_timeline_depth = 0;
+}
+
+/**
+ * Logs each span with when it began relative to the first, and how long it
+ * took, indented by how deeply it is nested.
+ */
+void boot_timeline_dump(void)
+{
+	static const char indent[] = "                ";
+	size_t i;
+
+	if (boot_timeline_count == 0) {
+		return;
+	}
+
+	dlog_info("Boot timeline, from %lu ns:\n",
+		  boot_timeline_spans[0].begin_ns);
+
+	for (i = 0; i < boot_timeline_count; ++i) {
+		const struct boot_timeline_span *span = &boot_timeline_spans[i];
+		size_t depth = span->depth + 1;
+		uint64_t begin_us;
+		uint64_t took_us;
+
+		if (depth > (sizeof(indent) - 1) / 2) {
+			depth = (sizeof(indent) - 1) / 2;
+		}
+
+		begin_us = (span->begin_ns - boot_timeline_spans[0].begin_ns) /
+			   1000;
+		took_us = span->end_ns < span->begin_ns
+				  ? 0
+				  : (span->end_ns - span->begin_ns) / 1000;
+
+		dlog_info("%s%s %#x: at %lu.%03lu ms, took %lu.%03lu ms%s\n",
+			  &indent[sizeof(indent) - 1 - 2 * depth], span->name,
+			  span->id, begin_us / 1000, begin_us % 1000,
+			  took_us / 1000, took_us % 1000,
+			  span->end_ns == 0 ? " (not ended)" : "");
+	}
+}
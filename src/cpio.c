@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 
+#include "hf/check.h"
 #include "hf/std.h"
 
 #pragma pack(push, 1)
@@ -28,65 +29,260 @@ struct cpio_header {
 };
 #pragma pack(pop)
 
+/** The magic number of the old binary format, as written by `cpio --create`. */
+#define CPIO_MAGIC 070707
+
+/** The name of the file marking the end of the archive. */
+static const char cpio_trailer[] = "TRAILER!!!";
+
+enum cpio_next_result {
+	CPIO_NEXT_FILE,
+	CPIO_NEXT_END,
+	CPIO_NEXT_MALFORMED,
+};
+
 /**
- * Retrieves the next file stored in the cpio archive stored in the cpio, and
- * advances the iterator such that another call to this function would return
- * the following file.
+ * Retrieves the next file stored in the cpio archive, and advances the iterator
+ * such that another call to this function would return the following file.
+ *
+ * Returns CPIO_NEXT_END at the end marker or at the end of the archive, or
+ * CPIO_NEXT_MALFORMED if the next header is invalid or the file doesn't fit in
+ * the archive.
  */
-static bool cpio_next(struct memiter *iter, const char **name,
-		      const void **contents, size_t *size)
+static enum cpio_next_result cpio_next(struct memiter *iter, const char **name,
+				       const void **contents, size_t *size)
 {
-	static const char trailer[] = "TRAILER!!!";
 	size_t len;
 	struct memiter lit = *iter;
 	const struct cpio_header *h = (const struct cpio_header *)lit.next;
 
-	if (!memiter_advance(&lit, sizeof(struct cpio_header))) {
-		return false;
+	if (memiter_size(&lit) == 0) {
+		return CPIO_NEXT_END;
 	}
 
-	*name = lit.next;
+	if (!memiter_advance(&lit, sizeof(struct cpio_header)) ||
+	    h->magic != CPIO_MAGIC || h->namesize == 0) {
+		return CPIO_NEXT_MALFORMED;
+	}
 
-	/* TODO: Check magic. */
+	*name = lit.next;
 
 	len = (h->namesize + 1) & ~1;
 	if (!memiter_advance(&lit, len)) {
-		return false;
+		return CPIO_NEXT_MALFORMED;
+	}
+
+	/* The name size includes its null terminator. */
+	if ((*name)[h->namesize - 1] != '\0') {
+		return CPIO_NEXT_MALFORMED;
 	}
 
 	*contents = lit.next;
 
 	len = (size_t)h->filesize[0] << 16 | h->filesize[1];
 	if (!memiter_advance(&lit, (len + 1) & ~1)) {
-		return false;
+		return CPIO_NEXT_MALFORMED;
 	}
 
-	/* TODO: Check that string is null-terminated. */
-
 	/* Stop enumerating files when we hit the end marker. */
-	if (!strncmp(*name, trailer, sizeof(trailer))) {
-		return false;
+	if (!strncmp(*name, cpio_trailer, sizeof(cpio_trailer))) {
+		return CPIO_NEXT_END;
 	}
 
 	*size = len;
 	*iter = lit;
 
+	return CPIO_NEXT_FILE;
+}
+
+/**
+ * Initialises the cpio archive in the given buffer, checking the header of each
+ * file in it. The archive is searched from the start for each file until it is
+ * indexed with `cpio_index_init`.
+ *
+ * Returns false if the archive is malformed.
+ */
+bool cpio_init(struct cpio *cpio, const void *buf, size_t size)
+{
+	const char *fname;
+	const void *fcontents;
+	size_t fsize;
+	struct memiter iter;
+	enum cpio_next_result ret;
+
+	memiter_init(&cpio->archive, buf, size);
+	cpio->file_count = 0;
+	cpio->index = NULL;
+
+	iter = cpio->archive;
+	while ((ret = cpio_next(&iter, &fname, &fcontents, &fsize)) ==
+	       CPIO_NEXT_FILE) {
+		cpio->file_count++;
+	}
+
+	return ret == CPIO_NEXT_END;
+}
+
+/**
+ * Returns the FNV-1a hash of the null-terminated name.
+ */
+static uint32_t cpio_hash(const char *name)
+{
+	uint32_t hash = UINT32_C(2166136261);
+
+	while (*name != '\0') {
+		hash ^= (uint8_t)*name++;
+		hash *= UINT32_C(16777619);
+	}
+
+	return hash;
+}
+
+/**
+ * Returns the number of buckets of the index of an archive of the given number
+ * of files: the least power of two no smaller than it, for chains of one file
+ * on average.
+ */
+static size_t cpio_index_bucket_count(size_t file_count)
+{
+	size_t bucket_count = 1;
+
+	while (bucket_count < file_count) {
+		bucket_count <<= 1;
+	}
+
+	return bucket_count;
+}
+
+/**
+ * Returns the bucket heads, which follow the entries of the index.
+ */
+static uint32_t *cpio_index_buckets(const struct cpio_index *index)
+{
+	return (uint32_t *)&index->entries[index->count];
+}
+
+/**
+ * Returns the size of the buffer needed to index the files of the archive.
+ */
+size_t cpio_index_size(const struct cpio *cpio)
+{
+	return sizeof(struct cpio_index) +
+	       cpio->file_count * sizeof(struct cpio_index_entry) +
+	       cpio_index_bucket_count(cpio->file_count) * sizeof(uint32_t);
+}
+
+/**
+ * Indexes the files of the archive in the given buffer, in a single pass over
+ * it, and attaches the index to `cpio` so that it is used to look up files from
+ * then on. The buffer must remain valid until it is detached again with
+ * `cpio_index_fini`.
+ *
+ * Returns false, leaving the archive without an index, if the buffer is too
+ * small.
+ */
+bool cpio_index_init(struct cpio *cpio, void *buf, size_t size)
+{
+	struct cpio_index *index = buf;
+	struct memiter iter = cpio->archive;
+	uint32_t *buckets;
+	uint32_t i;
+
+	cpio->index = NULL;
+
+	if (size < cpio_index_size(cpio) || cpio->file_count >= UINT32_MAX) {
+		return false;
+	}
+
+	index->count = (uint32_t)cpio->file_count;
+	index->bucket_count =
+		(uint32_t)cpio_index_bucket_count(cpio->file_count);
+	buckets = cpio_index_buckets(index);
+
+	for (i = 0; i < index->bucket_count; i++) {
+		buckets[i] = CPIO_INDEX_NONE;
+	}
+
+	for (i = 0; i < index->count; i++) {
+		struct cpio_index_entry *entry = &index->entries[i];
+
+		/* The archive was checked by `cpio_init`. */
+		CHECK(cpio_next(&iter, &entry->name, &entry->contents,
+				&entry->size) == CPIO_NEXT_FILE);
+		entry->hash = cpio_hash(entry->name);
+	}
+
+	/*
+	 * Chain the entries in reverse, so that the first of several files
+	 * with the same name is found first, as when scanning the archive.
+	 */
+	for (i = index->count; i > 0; i--) {
+		struct cpio_index_entry *entry = &index->entries[i - 1];
+		uint32_t *bucket =
+			&buckets[entry->hash & (index->bucket_count - 1)];
+
+		entry->next = *bucket;
+		*bucket = i - 1;
+	}
+
+	cpio->index = index;
 	return true;
 }
 
+/**
+ * Detaches the index from the archive, returning the buffer it was built in or
+ * NULL if the archive had no index.
+ */
+void *cpio_index_fini(struct cpio *cpio)
+{
+	void *buf = (void *)cpio->index;
+
+	cpio->index = NULL;
+	return buf;
+}
+
+/**
+ * Looks for a file in the index of the archive.
+ */
+static bool cpio_index_get_file(const struct cpio_index *index,
+				const struct string *name, struct memiter *it)
+{
+	uint32_t hash = cpio_hash(string_data(name));
+	uint32_t bucket = hash & (index->bucket_count - 1);
+	uint32_t i;
+
+	for (i = cpio_index_buckets(index)[bucket]; i != CPIO_INDEX_NONE;
+	     i = index->entries[i].next) {
+		const struct cpio_index_entry *entry = &index->entries[i];
+
+		if (entry->hash == hash &&
+		    !strncmp(entry->name, string_data(name), STRING_MAX_SIZE)) {
+			memiter_init(it, entry->contents, entry->size);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /**
  * Looks for a file in the given cpio archive. The file, if found, is returned
  * in the "it" argument.
  */
-bool cpio_get_file(const struct memiter *cpio, const struct string *name,
+bool cpio_get_file(const struct cpio *cpio, const struct string *name,
 		   struct memiter *it)
 {
 	const char *fname;
 	const void *fcontents;
 	size_t fsize;
-	struct memiter iter = *cpio;
+	struct memiter iter = cpio->archive;
+
+	if (cpio->index != NULL) {
+		return cpio_index_get_file(cpio->index, name, it);
+	}
 
-	while (cpio_next(&iter, &fname, &fcontents, &fsize)) {
+	while (cpio_next(&iter, &fname, &fcontents, &fsize) ==
+	       CPIO_NEXT_FILE) {
 		if (!strncmp(fname, string_data(name), STRING_MAX_SIZE)) {
 			memiter_init(it, fcontents, fsize);
 			return true;
@@ -95,3 +291,58 @@ bool cpio_get_file(const struct memiter *cpio, const struct string *name,
 
 	return false;
 }
+
+/**
+ * Returns whether the file with the given contents is one to report as
+ * overlapping the memory from `begin` to `end`.
+ */
+static bool cpio_file_overlaps(const void *contents, size_t size,
+			       const void *begin, const void *end,
+			       const void *skip)
+{
+	const char *fbegin = contents;
+
+	return contents != skip && size != 0 &&
+	       (const char *)begin < fbegin + size &&
+	       fbegin < (const char *)end;
+}
+
+/**
+ * Looks for a file in the given cpio archive, other than the one whose contents
+ * are at `skip`, whose contents overlap the memory from `begin` to `end`. The
+ * name of the first such file, if any, is returned in `name`.
+ */
+bool cpio_find_overlapping(const struct cpio *cpio, const void *begin,
+			   const void *end, const void *skip, const char **name)
+{
+	const char *fname;
+	const void *fcontents;
+	size_t fsize;
+	struct memiter iter = cpio->archive;
+	uint32_t i;
+
+	if (cpio->index != NULL) {
+		for (i = 0; i < cpio->index->count; i++) {
+			const struct cpio_index_entry *entry =
+				&cpio->index->entries[i];
+
+			if (cpio_file_overlaps(entry->contents, entry->size,
+					       begin, end, skip)) {
+				*name = entry->name;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	while (cpio_next(&iter, &fname, &fcontents, &fsize) ==
+	       CPIO_NEXT_FILE) {
+		if (cpio_file_overlaps(fcontents, fsize, begin, end, skip)) {
+			*name = fname;
+			return true;
+		}
+	}
+
+	return false;
+}
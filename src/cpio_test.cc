@@ -0,0 +1,323 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "hf/cpio.h"
+}
+
+namespace
+{
+using ::testing::ElementsAreArray;
+using ::testing::Eq;
+
+/**
+ * Builds an archive in the old binary format written by `cpio --create`.
+ */
+class CpioBuilder
+{
+       public:
+	CpioBuilder &File(const std::string &name, const std::string &contents)
+	{
+		Entry(name, name.size() + 1, contents);
+		return *this;
+	}
+
+	/** Appends a header with the given name size, as found in the file. */
+	CpioBuilder &Entry(const std::string &name, uint16_t namesize,
+			   const std::string &contents, uint16_t magic = 070707)
+	{
+		uint32_t filesize = contents.size();
+		uint16_t header[] = {
+			magic,
+			0,
+			0,
+			0100644,
+			0,
+			0,
+			1,
+			0,
+			0,
+			0,
+			namesize,
+			(uint16_t)(filesize >> 16),
+			(uint16_t)filesize,
+		};
+
+		Append(header, sizeof(header));
+		Append(name.c_str(), name.size() + 1);
+		Pad();
+		Append(contents.data(), contents.size());
+		Pad();
+		return *this;
+	}
+
+	std::vector<char> Build()
+	{
+		File("TRAILER!!!", "");
+		return archive_;
+	}
+
+       private:
+	void Append(const void *data, size_t size)
+	{
+		const char *bytes = static_cast<const char *>(data);
+
+		archive_.insert(archive_.end(), bytes, bytes + size);
+	}
+
+	void Pad()
+	{
+		if (archive_.size() % 2 != 0) {
+			archive_.push_back('\0');
+		}
+	}
+
+	std::vector<char> archive_;
+};
+
+/**
+ * Returns the contents of the named file in the archive, or "<missing>".
+ */
+std::string get_file(const struct cpio *cpio, const std::string &name)
+{
+	struct string str;
+	struct memiter it;
+
+	memiter_init(&it, name.c_str(), name.size() + 1);
+	EXPECT_THAT(string_init(&str, &it), Eq(STRING_SUCCESS));
+
+	if (!cpio_get_file(cpio, &str, &it)) {
+		return "<missing>";
+	}
+
+	return std::string(it.next, it.limit);
+}
+
+/**
+ * Returns the contents of the named file in the archive, which must exist.
+ */
+struct memiter find_file(const struct cpio *cpio, const std::string &name)
+{
+	struct string str;
+	struct memiter it;
+
+	memiter_init(&it, name.c_str(), name.size() + 1);
+	EXPECT_THAT(string_init(&str, &it), Eq(STRING_SUCCESS));
+	EXPECT_TRUE(cpio_get_file(cpio, &str, &it));
+
+	return it;
+}
+
+/**
+ * Indexes the archive in a buffer of the size it asks for.
+ */
+std::vector<char> index_archive(struct cpio *cpio)
+{
+	std::vector<char> buf(cpio_index_size(cpio));
+
+	EXPECT_TRUE(cpio_index_init(cpio, buf.data(), buf.size()));
+	return buf;
+}
+
+TEST(cpio, empty)
+{
+	struct cpio cpio;
+	std::vector<char> archive = CpioBuilder().Build();
+
+	ASSERT_TRUE(cpio_init(&cpio, nullptr, 0));
+	EXPECT_THAT(cpio.file_count, Eq(0));
+	EXPECT_THAT(get_file(&cpio, "manifest.dtb"), Eq("<missing>"));
+
+	ASSERT_TRUE(cpio_init(&cpio, archive.data(), archive.size()));
+	EXPECT_THAT(cpio.file_count, Eq(0));
+	EXPECT_THAT(get_file(&cpio, "TRAILER!!!"), Eq("<missing>"));
+
+	std::vector<char> buf = index_archive(&cpio);
+	EXPECT_THAT(get_file(&cpio, "manifest.dtb"), Eq("<missing>"));
+}
+
+/**
+ * Files are found with and without an index, including files of odd sizes and
+ * names which are padded in the archive.
+ */
+TEST(cpio, get_file)
+{
+	struct cpio cpio;
+	std::vector<char> archive = CpioBuilder()
+					    .File("manifest.dtb", "manifest")
+					    .File("vm1", "kernel")
+					    .File("vm1.dtb", "fdt")
+					    .File("empty", "")
+					    .Build();
+
+	ASSERT_TRUE(cpio_init(&cpio, archive.data(), archive.size()));
+	EXPECT_THAT(cpio.file_count, Eq(4));
+
+	for (int indexed = 0; indexed < 2; indexed++) {
+		std::vector<char> buf;
+
+		if (indexed) {
+			buf = index_archive(&cpio);
+		}
+
+		EXPECT_THAT(get_file(&cpio, "manifest.dtb"), Eq("manifest"));
+		EXPECT_THAT(get_file(&cpio, "vm1"), Eq("kernel"));
+		EXPECT_THAT(get_file(&cpio, "vm1.dtb"), Eq("fdt"));
+		EXPECT_THAT(get_file(&cpio, "empty"), Eq(""));
+		EXPECT_THAT(get_file(&cpio, "vm"), Eq("<missing>"));
+		EXPECT_THAT(get_file(&cpio, "vm1.dt"), Eq("<missing>"));
+	}
+
+	EXPECT_THAT(cpio_index_fini(&cpio), ::testing::NotNull());
+	EXPECT_THAT(cpio_index_fini(&cpio), ::testing::IsNull());
+}
+
+/**
+ * The index finds the same file as scanning an archive of many files, with
+ * the first of several files of the same name taking precedence.
+ */
+TEST(cpio, index_many_files)
+{
+	constexpr int file_count = 500;
+	struct cpio cpio;
+	CpioBuilder builder;
+	std::vector<std::string> names;
+
+	for (int i = 0; i < file_count; i++) {
+		names.push_back("vm" + std::to_string(i % (file_count / 2)));
+		builder.File(names.back(), std::to_string(i));
+	}
+	std::vector<char> archive = builder.Build();
+
+	ASSERT_TRUE(cpio_init(&cpio, archive.data(), archive.size()));
+	EXPECT_THAT(cpio.file_count, Eq(file_count));
+
+	std::vector<std::string> scanned;
+	std::vector<std::string> indexed;
+
+	for (const auto &name : names) {
+		scanned.push_back(get_file(&cpio, name));
+	}
+
+	std::vector<char> buf = index_archive(&cpio);
+	for (const auto &name : names) {
+		indexed.push_back(get_file(&cpio, name));
+	}
+
+	EXPECT_THAT(indexed, ElementsAreArray(scanned));
+	EXPECT_THAT(indexed[0], Eq("0"));
+	EXPECT_THAT(indexed[file_count / 2], Eq("0"));
+	EXPECT_THAT(get_file(&cpio, "vm" + std::to_string(file_count)),
+		    Eq("<missing>"));
+}
+
+/**
+ * An index can't be built in a buffer which is too small, and the archive is
+ * then still scanned for each file.
+ */
+TEST(cpio, index_buffer_too_small)
+{
+	struct cpio cpio;
+	std::vector<char> archive =
+		CpioBuilder().File("vm1", "kernel").File("vm2", "").Build();
+
+	ASSERT_TRUE(cpio_init(&cpio, archive.data(), archive.size()));
+
+	std::vector<char> buf(cpio_index_size(&cpio) - 1);
+	EXPECT_FALSE(cpio_index_init(&cpio, buf.data(), buf.size()));
+	EXPECT_THAT(cpio.index, ::testing::IsNull());
+	EXPECT_THAT(get_file(&cpio, "vm1"), Eq("kernel"));
+}
+
+/**
+ * Archives with an invalid header or a file which doesn't fit are rejected.
+ */
+TEST(cpio, malformed)
+{
+	struct cpio cpio;
+	std::vector<char> archive;
+
+	/* Wrong magic, such as that of a byte-swapped archive. */
+	archive = CpioBuilder().Entry("vm1", 4, "kernel", 0xc771).Build();
+	EXPECT_FALSE(cpio_init(&cpio, archive.data(), archive.size()));
+
+	/* Name not null-terminated within its size. */
+	archive = CpioBuilder().Entry("vm1", 3, "kernel").Build();
+	EXPECT_FALSE(cpio_init(&cpio, archive.data(), archive.size()));
+
+	/* Empty name. */
+	archive = CpioBuilder().Entry("", 0, "kernel").Build();
+	EXPECT_FALSE(cpio_init(&cpio, archive.data(), archive.size()));
+
+	/* Truncated in the middle of a file or of a header. */
+	archive = CpioBuilder().File("vm1", "kernel").Build();
+	for (size_t size : {archive.size() - 1, (size_t)10}) {
+		EXPECT_FALSE(cpio_init(&cpio, archive.data(), size));
+	}
+}
+
+/**
+ * Files overlapping a range of memory are found, other than the one skipped,
+ * and empty files overlap nothing, with and without an index.
+ */
+TEST(cpio, find_overlapping)
+{
+	struct cpio cpio;
+	const char *name = nullptr;
+	std::vector<char> archive = CpioBuilder()
+					    .File("vm1", "kernel1")
+					    .File("empty", "")
+					    .File("vm2", "kernel2")
+					    .Build();
+
+	ASSERT_TRUE(cpio_init(&cpio, archive.data(), archive.size()));
+
+	struct memiter vm1 = find_file(&cpio, "vm1");
+	struct memiter vm2 = find_file(&cpio, "vm2");
+
+	for (int indexed = 0; indexed < 2; indexed++) {
+		std::vector<char> buf;
+
+		if (indexed) {
+			buf = index_archive(&cpio);
+		}
+
+		/* The last byte of vm1 only overlaps vm1. */
+		EXPECT_FALSE(cpio_find_overlapping(&cpio, vm1.limit - 1,
+						   vm1.limit, vm1.next, &name));
+		EXPECT_TRUE(cpio_find_overlapping(&cpio, vm1.limit - 1,
+						  vm1.limit, nullptr, &name));
+		EXPECT_THAT(std::string(name), Eq("vm1"));
+
+		/* From the end of vm1 to the first byte of vm2. */
+		EXPECT_TRUE(cpio_find_overlapping(&cpio, vm1.limit,
+						  vm2.next + 1, vm1.next,
+						  &name));
+		EXPECT_THAT(std::string(name), Eq("vm2"));
+
+		/* Between the files, only headers and the empty file. */
+		EXPECT_FALSE(cpio_find_overlapping(&cpio, vm1.limit, vm2.next,
+						   nullptr, &name));
+
+		/* Beyond the archive. */
+		EXPECT_FALSE(cpio_find_overlapping(&cpio, vm2.limit,
+						   vm2.limit + 100, nullptr,
+						   &name));
+	}
+
+	cpio_index_fini(&cpio);
+}
+
+} /* namespace */
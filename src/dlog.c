@@ -8,8 +8,10 @@
 
 #include "hf/dlog.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "hf/ffa.h"
 #include "hf/spinlock.h"
@@ -26,11 +28,30 @@
 #define FLAG_ALT   0x10
 #define FLAG_UPPER 0x20
 #define FLAG_NEG   0x40
+#define FLAG_LONG  0x80
 
 #define DLOG_MAX_STRING_LENGTH 64
 
 /* clang-format on */
 
+/* The number of records in the binary log ring of each CPU. */
+#define DLOG_BINARY_RING_SIZE 64
+
+/*
+ * The number of records in a ring from which the CPU logging them drains all
+ * rings, so that records aren't dropped while waiting for another drain.
+ */
+#define DLOG_BINARY_HIGH_WATER (DLOG_BINARY_RING_SIZE * 3 / 4)
+
+/* The maximum number of arguments stored in a binary log record. */
+#define DLOG_BINARY_MAX_ARGS 8
+
+/*
+ * The number of bytes of a binary log record holding the string arguments,
+ * including their terminating null characters.
+ */
+#define DLOG_BINARY_STRINGS_SIZE 64
+
 static bool dlog_lock_enabled = false;
 static struct spinlock sl = SPINLOCK_INIT;
 
@@ -217,6 +238,373 @@ static const char *parse_flags(const char *p, int *flags)
 	}
 }
 
+/**
+ * Parses the optional length modifier of a printf-style format, setting
+ * FLAG_LONG if the argument is 64 bits wide rather than an int. It returns the
+ * spot on the string where the conversion specifier was found.
+ */
+static const char *parse_length(const char *p, int *flags)
+{
+	for (;;) {
+		switch (*p) {
+		case 'l':
+		case 'j':
+		case 'z':
+		case 't':
+			*flags |= FLAG_LONG;
+			break;
+
+		case 'h':
+			/* Narrower arguments are promoted to int. */
+			break;
+
+		default:
+			return p;
+		}
+		p++;
+	}
+}
+
+#if DLOG_BINARY
+
+/**
+ * A message logged in binary form: the address of its format string and the
+ * raw values of its arguments, to be formatted on the host. String arguments
+ * are copied into the record, as they may not outlive the call to dlog, and
+ * their argument is the offset of the copy.
+ */
+struct dlog_binary_record {
+	/* Global sequence number, to merge the records of all CPUs. */
+	uint64_t seq;
+	const char *fmt;
+	uint32_t nargs;
+	uint64_t args[DLOG_BINARY_MAX_ARGS];
+
+	/* Bitmap of the arguments which are strings. */
+	uint32_t string_args;
+	uint32_t strings_size;
+	char strings[DLOG_BINARY_STRINGS_SIZE];
+};
+
+/**
+ * Ring of records written only by the CPU it belongs to, so it is written
+ * without a lock. Records are only removed while holding the log lock.
+ */
+struct dlog_binary_ring {
+	_Atomic(uint32_t) head;
+	_Atomic(uint32_t) tail;
+	_Atomic(uint32_t) dropped;
+	struct dlog_binary_record records[DLOG_BINARY_RING_SIZE];
+};
+
+static size_t (*dlog_binary_cpu_index_get)(void);
+static _Atomic(uint64_t) dlog_binary_seq;
+static struct dlog_binary_ring dlog_binary_rings[MAX_CPUS];
+
+/**
+ * Switches to logging in binary form. The given function returns the index of
+ * the CPU it is called on, or a value not less than MAX_CPUS if unknown, in
+ * which case messages are formatted as text as before.
+ */
+void dlog_binary_enable(size_t (*cpu_index_get)(void))
+{
+	dlog_binary_cpu_index_get = cpu_index_get;
+}
+
+/**
+ * Copies the string argument into the record, returning its offset in the
+ * record's strings in `offset`. Returns false if it doesn't fit.
+ */
+static bool dlog_binary_copy_string(struct dlog_binary_record *record,
+				    const char *str, uint64_t *offset)
+{
+	size_t len = strnlen_s(str, DLOG_BINARY_STRINGS_SIZE);
+
+	if (len >= DLOG_BINARY_STRINGS_SIZE - record->strings_size) {
+		return false;
+	}
+
+	*offset = record->strings_size;
+	memcpy_s(&record->strings[record->strings_size],
+		 DLOG_BINARY_STRINGS_SIZE - record->strings_size, str, len);
+	record->strings[record->strings_size + len] = '\0';
+	record->strings_size += len + 1;
+
+	return true;
+}
+
+/**
+ * Collects the arguments of the message according to the conversions in its
+ * format string, as vdlog would consume them. Returns false if there are too
+ * many, or their strings are too long, for a single record.
+ */
+static bool dlog_binary_collect_args(struct dlog_binary_record *record,
+				     const char *fmt, va_list args)
+{
+	const char *p;
+
+	record->nargs = 0;
+	record->string_args = 0;
+	record->strings_size = 0;
+	for (p = fmt; *p; p++) {
+		uint64_t value;
+		int flags;
+
+		if (*p != '%') {
+			continue;
+		}
+
+		/* Skip the flags and minimum width. */
+		do {
+			p++;
+		} while (*p == ' ' || *p == '0' || *p == '-' || *p == '+' ||
+			 *p == '#' || (*p >= '1' && *p <= '9'));
+
+		if (*p == '*') {
+			if (record->nargs == DLOG_BINARY_MAX_ARGS) {
+				return false;
+			}
+			record->args[record->nargs++] =
+				(uint64_t)va_arg(args, int);
+			p++;
+		}
+
+		flags = 0;
+		p = parse_length(p, &flags);
+
+		switch (*p) {
+		case '\0':
+			return true;
+
+		case 'd':
+		case 'i':
+			value = (flags & FLAG_LONG)
+					? (uint64_t)va_arg(args, int64_t)
+					: (uint64_t)va_arg(args, int);
+			break;
+
+		case 'c':
+			value = (uint64_t)va_arg(args, int);
+			break;
+
+		case 'x':
+		case 'X':
+		case 'u':
+		case 'o':
+			value = (flags & FLAG_LONG)
+					? va_arg(args, uint64_t)
+					: va_arg(args, unsigned int);
+			break;
+
+		case 's':
+			if (record->nargs == DLOG_BINARY_MAX_ARGS ||
+			    !dlog_binary_copy_string(
+				    record, va_arg(args, const char *),
+				    &value)) {
+				return false;
+			}
+			record->string_args |= 1U << record->nargs;
+			break;
+
+		case 'p':
+			value = (uintptr_t)va_arg(args, const void *);
+			break;
+
+		default:
+			continue;
+		}
+
+		if (record->nargs == DLOG_BINARY_MAX_ARGS) {
+			return false;
+		}
+		record->args[record->nargs++] = value;
+	}
+
+	return true;
+}
+
+/**
+ * Records the message in the ring of the current CPU, without formatting it.
+ * Returns false if it must be logged as text instead. `drain` is set if the
+ * ring is filling up and the caller must drain the rings.
+ */
+static bool dlog_binary_record(const char *fmt, va_list args, bool *drain)
+{
+	struct dlog_binary_ring *ring;
+	struct dlog_binary_record *record;
+	size_t cpu;
+	uint32_t head;
+	uint32_t tail;
+
+	if (dlog_binary_cpu_index_get == NULL) {
+		return false;
+	}
+
+	cpu = dlog_binary_cpu_index_get();
+	if (cpu >= MAX_CPUS) {
+		return false;
+	}
+
+	ring = &dlog_binary_rings[cpu];
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	if (head - tail == DLOG_BINARY_RING_SIZE) {
+		atomic_fetch_add_explicit(&ring->dropped, 1,
+					  memory_order_relaxed);
+		*drain = true;
+		return true;
+	}
+
+	record = &ring->records[head % DLOG_BINARY_RING_SIZE];
+	if (!dlog_binary_collect_args(record, fmt, args)) {
+		return false;
+	}
+
+	record->fmt = fmt;
+	record->seq = atomic_fetch_add_explicit(&dlog_binary_seq, 1,
+						memory_order_relaxed);
+
+	/* Publish the record to the drain. */
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	*drain = head + 1 - tail >= DLOG_BINARY_HIGH_WATER;
+
+	return true;
+}
+
+/**
+ * Prints a binary record to the log as a line of hexadecimal values, prefixed
+ * with "#DLOG", for build/dlog_decode.py to format on the host.
+ */
+static void dlog_binary_print_record(size_t cpu,
+				     const struct dlog_binary_record *record)
+{
+	print_raw_string("#DLOG ");
+	print_num(cpu, 16, 0, 0);
+	dlog_putchar(' ');
+	print_num(record->seq, 16, 0, 0);
+	dlog_putchar(' ');
+	print_num((uintptr_t)record->fmt, 16, 0, 0);
+
+	for (uint32_t i = 0; i < record->nargs; i++) {
+		dlog_putchar(' ');
+
+		if (!(record->string_args & (1U << i))) {
+			print_num(record->args[i], 16, 0, 0);
+			continue;
+		}
+
+		/* Strings are printed as their bytes in hexadecimal. */
+		dlog_putchar('s');
+		for (const char *c = &record->strings[record->args[i]]; *c;
+		     c++) {
+			print_num((uint8_t)*c, 16, 2, FLAG_ZERO);
+		}
+	}
+
+	dlog_putchar('\n');
+}
+
+/**
+ * Writes out the records of all CPUs to the log, emptying their rings. The log
+ * lock must be held.
+ *
+ * The rings are drained in turn rather than merged, the decoder orders the
+ * records by sequence number. The address of dlog_binary_drain is printed
+ * first, so that the decoder can relate format string addresses to the image.
+ */
+static void dlog_binary_drain_locked(void)
+{
+	bool base_printed = false;
+
+	for (size_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+		struct dlog_binary_ring *ring = &dlog_binary_rings[cpu];
+		uint32_t tail =
+			atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		uint32_t head =
+			atomic_load_explicit(&ring->head, memory_order_acquire);
+		uint32_t dropped = atomic_exchange_explicit(
+			&ring->dropped, 0, memory_order_relaxed);
+
+		if (tail == head && dropped == 0) {
+			continue;
+		}
+
+		if (!base_printed) {
+			print_raw_string("#DLOG-BASE ");
+			print_num((uintptr_t)&dlog_binary_drain, 16, 0, 0);
+			dlog_putchar('\n');
+			base_printed = true;
+		}
+
+		for (; tail != head; tail++) {
+			dlog_binary_print_record(
+				cpu,
+				&ring->records[tail % DLOG_BINARY_RING_SIZE]);
+		}
+
+		/* Release the records to the CPU logging them. */
+		atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+		if (dropped != 0) {
+			print_raw_string("#DLOG-DROPPED ");
+			print_num(cpu, 16, 0, 0);
+			dlog_putchar(' ');
+			print_num(dropped, 16, 0, 0);
+			dlog_putchar('\n');
+		}
+	}
+}
+
+/**
+ * Checks, without taking the log lock, if any CPU has records to write out.
+ */
+static bool dlog_binary_pending(void)
+{
+	for (size_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+		struct dlog_binary_ring *ring = &dlog_binary_rings[cpu];
+
+		if (atomic_load_explicit(&ring->head, memory_order_relaxed) !=
+			    atomic_load_explicit(&ring->tail,
+						 memory_order_relaxed) ||
+		    atomic_load_explicit(&ring->dropped,
+					 memory_order_relaxed) != 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Writes out the records of all CPUs to the log, emptying their rings. This
+ * is cheap if there are none, so it can be called whenever the CPU is about to
+ * leave Hafnium.
+ */
+void dlog_binary_drain(void)
+{
+	if (!dlog_binary_pending()) {
+		return;
+	}
+
+	lock();
+	dlog_binary_drain_locked();
+	unlock();
+}
+
+#else
+
+void dlog_binary_enable(size_t (*cpu_index_get)(void))
+{
+	(void)cpu_index_get;
+}
+
+void dlog_binary_drain(void)
+{
+}
+
+#endif
+
 /**
  * Send the contents of the given VM's log buffer to the log, preceded by the VM
  * ID and followed by a newline.
@@ -225,6 +613,11 @@ void dlog_flush_vm_buffer(ffa_vm_id_t id, char buffer[], size_t length)
 {
 	lock();
 
+#if DLOG_BINARY
+	/* The console is being written anyway, keep the logs in order. */
+	dlog_binary_drain_locked();
+#endif
+
 	print_raw_string("VM ");
 	print_num(id, 16, 0, 0);
 	print_raw_string(": ");
@@ -248,6 +641,22 @@ void vdlog(const char *fmt, va_list args)
 	int flags;
 	char buf[2];
 
+#if DLOG_BINARY
+	va_list binary_args;
+	bool recorded;
+	bool drain = false;
+
+	va_copy(binary_args, args);
+	recorded = dlog_binary_record(fmt, binary_args, &drain);
+	va_end(binary_args);
+	if (drain) {
+		dlog_binary_drain();
+	}
+	if (recorded) {
+		return;
+	}
+#endif
+
 	lock();
 
 	for (p = fmt; *p; p++) {
@@ -281,6 +690,9 @@ void vdlog(const char *fmt, va_list args)
 				p++;
 			}
 
+			/* Read the length of the argument. */
+			p = parse_length(p + 1, &flags) - 1;
+
 			/* Handle the format specifier. */
 			switch (p[1]) {
 			case 's': {
@@ -292,43 +704,47 @@ void vdlog(const char *fmt, va_list args)
 
 			case 'd':
 			case 'i': {
-				int v = va_arg(args, int);
+				int64_t v = (flags & FLAG_LONG)
+						    ? va_arg(args, int64_t)
+						    : va_arg(args, int);
+				uint64_t u = (uint64_t)v;
 
 				if (v < 0) {
 					flags |= FLAG_NEG;
-					v = -v;
+					u = -u;
 				}
 
-				print_num((size_t)v, 10, w, flags);
+				print_num(u, 10, w, flags);
 				p++;
 			} break;
 
-			case 'X':
-				flags |= FLAG_UPPER;
-				print_num(va_arg(args, size_t), 16, w, flags);
-				p++;
-				break;
-
 			case 'p':
-				print_num(va_arg(args, size_t), 16,
+				print_num((size_t)va_arg(args, void *), 16,
 					  sizeof(size_t) * 2, FLAG_ZERO);
 				p++;
 				break;
 
+			case 'X':
+				flags |= FLAG_UPPER;
+				/* Fall through. */
 			case 'x':
-				print_num(va_arg(args, size_t), 16, w, flags);
-				p++;
-				break;
-
 			case 'u':
-				print_num(va_arg(args, size_t), 10, w, flags);
-				p++;
-				break;
+			case 'o': {
+				uint64_t v =
+					(flags & FLAG_LONG)
+						? va_arg(args, uint64_t)
+						: va_arg(args, unsigned int);
+				size_t base = 16;
+
+				if (p[1] == 'u') {
+					base = 10;
+				} else if (p[1] == 'o') {
+					base = 8;
+				}
 
-			case 'o':
-				print_num(va_arg(args, size_t), 8, w, flags);
+				print_num(v, base, w, flags);
 				p++;
-				break;
+			} break;
 
 			case 'c':
 				buf[1] = 0;
@@ -10,6 +10,7 @@
 
 #include <libfdt.h>
 
+#include "hf/fdt_index.h"
 #include "hf/static_assert.h"
 
 /** Returns pointer to the FDT buffer. */
@@ -49,6 +50,7 @@ bool fdt_init_from_ptr(struct fdt *fdt, const void *ptr, size_t len)
 	}
 
 	memiter_init(&fdt->buf, ptr, len);
+	fdt->index = NULL;
 	return true;
 }
 
@@ -68,6 +70,7 @@ bool fdt_init_from_memiter(struct fdt *fdt, const struct memiter *it)
 void fdt_fini(struct fdt *fdt)
 {
 	memiter_init(&fdt->buf, NULL, 0);
+	fdt->index = NULL;
 }
 
 /**
@@ -135,6 +138,10 @@ bool fdt_read_property(const struct fdt_node *node, const char *name,
 	const void *ptr;
 	int lenp;
 
+	if (node->fdt.index != NULL) {
+		return fdt_index_read_property(node, name, data);
+	}
+
 	ptr = fdt_getprop(fdt_base(&node->fdt), node->offset, name, &lenp);
 	if (ptr == NULL) {
 		return false;
@@ -204,8 +211,13 @@ bool fdt_parse_number(struct memiter *data, size_t size, uint64_t *val)
  */
 bool fdt_first_child(struct fdt_node *node)
 {
-	int child_off = fdt_first_subnode(fdt_base(&node->fdt), node->offset);
+	int child_off;
+
+	if (node->fdt.index != NULL) {
+		return fdt_index_first_child(node);
+	}
 
+	child_off = fdt_first_subnode(fdt_base(&node->fdt), node->offset);
 	if (child_off < 0) {
 		return false;
 	}
@@ -221,8 +233,13 @@ bool fdt_first_child(struct fdt_node *node)
  */
 bool fdt_next_sibling(struct fdt_node *node)
 {
-	int sib_off = fdt_next_subnode(fdt_base(&node->fdt), node->offset);
+	int sib_off;
+
+	if (node->fdt.index != NULL) {
+		return fdt_index_next_sibling(node);
+	}
 
+	sib_off = fdt_next_subnode(fdt_base(&node->fdt), node->offset);
 	if (sib_off < 0) {
 		return false;
 	}
@@ -240,6 +257,10 @@ bool fdt_find_child(struct fdt_node *node, const struct string *name)
 	struct fdt_node child = *node;
 	const void *base = fdt_base(&node->fdt);
 
+	if (node->fdt.index != NULL) {
+		return fdt_index_find_child(node, name);
+	}
+
 	if (!fdt_first_child(&child)) {
 		return false;
 	}
@@ -255,8 +276,12 @@ bool fdt_find_child(struct fdt_node *node, const struct string *name)
 			return false;
 		}
 
+		/*
+		 * Include the terminating null so that the name isn't matched
+		 * by a node whose name it is a prefix of, e.g. "vm1" by "vm10".
+		 */
 		CHECK(lenp >= 0);
-		memiter_init(&it, child_name, (size_t)lenp);
+		memiter_init(&it, child_name, (size_t)lenp + 1);
 		if (string_eq(name, &it)) {
 			node->offset = child.offset;
 			return true;
@@ -273,6 +298,15 @@ bool fdt_find_child(struct fdt_node *node, const struct string *name)
  */
 bool fdt_is_compatible(struct fdt_node *node, const char *compat)
 {
+	struct memiter data;
+
+	if (node->fdt.index != NULL) {
+		return fdt_index_read_property(node, "compatible", &data) &&
+		       fdt_stringlist_contains(memiter_base(&data),
+					       (int)memiter_size(&data),
+					       compat) != 0;
+	}
+
 	return fdt_node_check_compatible(fdt_base(&node->fdt), node->offset,
 					 compat) == 0;
 }
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/fdt_index.h"
+
+#include <libfdt.h>
+
+#include "hf/check.h"
+#include "hf/std.h"
+
+/**
+ * The least space a node or property takes in the structure block: a tag and
+ * a padded name for a node, followed by its end tag, or a tag, length and name
+ * offset for a property.
+ */
+#define FDT_INDEX_MIN_ENTRY_SIZE (3 * FDT_TAGSIZE)
+
+/**
+ * Returns the FNV-1a hash of the null-terminated name.
+ */
+static uint32_t fdt_index_hash(const char *name)
+{
+	uint32_t hash = UINT32_C(2166136261);
+
+	while (*name != '\0') {
+		hash ^= (uint8_t)*name++;
+		hash *= UINT32_C(16777619);
+	}
+
+	return hash;
+}
+
+/**
+ * Returns the size of the buffer needed to index the given FDT, which is
+ * bounded by the size of its structure block.
+ */
+size_t fdt_index_size(const struct fdt *fdt)
+{
+	size_t max_entries = fdt_size_dt_struct(fdt_base(fdt)) /
+			     FDT_INDEX_MIN_ENTRY_SIZE;
+
+	return sizeof(struct fdt_index) +
+	       max_entries * sizeof(struct fdt_index_entry);
+}
+
+/**
+ * Indexes the nodes and properties of the FDT in the given buffer, in a single
+ * pass over its structure block, and attaches the index to `fdt` so that it is
+ * used to look up nodes and properties from then on. The buffer must remain
+ * valid until it is detached again with `fdt_index_fini`.
+ *
+ * Returns false, leaving the FDT without an index, if the buffer is too small
+ * or the FDT has a shape which can't be indexed.
+ */
+bool fdt_index_init(struct fdt *fdt, void *buf, size_t size)
+{
+	const void *base = fdt_base(fdt);
+	struct fdt_index *index = buf;
+	/* The entries of the nodes enclosing the current position. */
+	uint32_t parents[FDT_INDEX_MAX_DEPTH];
+	/* The entries of the last child seen of each of the `parents`. */
+	uint32_t last_children[FDT_INDEX_MAX_DEPTH];
+	size_t depth = 0;
+	int offset;
+	int next_offset = 0;
+	uint32_t tag;
+
+	fdt->index = NULL;
+
+	if (size < sizeof(struct fdt_index)) {
+		return false;
+	}
+
+	index->count = 0;
+	index->capacity = (size - sizeof(struct fdt_index)) /
+			  sizeof(struct fdt_index_entry);
+
+	do {
+		struct fdt_index_entry *parent = NULL;
+		uint32_t *last_child = NULL;
+		const char *name = NULL;
+		int len;
+
+		if (depth > 0) {
+			parent = &index->entries[parents[depth - 1]];
+			last_child = &last_children[depth - 1];
+		}
+
+		offset = next_offset;
+		tag = fdt_next_tag(base, offset, &next_offset);
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			/* There must be one root, and a limited depth. */
+			if (depth == FDT_INDEX_MAX_DEPTH ||
+			    (parent == NULL && index->count != 0)) {
+				return false;
+			}
+
+			if (parent != NULL) {
+				if (parent->child_count == UINT16_MAX) {
+					return false;
+				}
+				parent->child_count++;
+
+				if (*last_child != FDT_INDEX_NONE) {
+					index->entries[*last_child]
+						.next_sibling = index->count;
+				}
+				*last_child = index->count;
+			}
+
+			name = fdt_get_name(base, offset, &len);
+			parents[depth] = index->count;
+			last_children[depth] = FDT_INDEX_NONE;
+			depth++;
+			break;
+
+		case FDT_PROP:
+			/*
+			 * A node's properties must come before its children
+			 * for them to follow its entry.
+			 */
+			if (parent == NULL || *last_child != FDT_INDEX_NONE ||
+			    parent->prop_count == UINT16_MAX) {
+				return false;
+			}
+
+			parent->prop_count++;
+			fdt_getprop_by_offset(base, offset, &name, &len);
+			break;
+
+		case FDT_END_NODE:
+			if (depth == 0) {
+				return false;
+			}
+			depth--;
+			continue;
+
+		case FDT_NOP:
+		case FDT_END:
+			continue;
+
+		default:
+			return false;
+		}
+
+		if (name == NULL || index->count == index->capacity) {
+			return false;
+		}
+
+		index->entries[index->count++] = (struct fdt_index_entry){
+			.offset = (uint32_t)offset,
+			.hash = fdt_index_hash(name),
+			.next_sibling = FDT_INDEX_NONE,
+		};
+	} while (tag != FDT_END);
+
+	/* A truncated structure block also ends with FDT_END. */
+	if (next_offset < 0 || depth != 0 || index->count == 0) {
+		return false;
+	}
+
+	fdt->index = index;
+	return true;
+}
+
+/**
+ * Detaches the index from the FDT, returning the buffer it was built in or
+ * NULL if the FDT had no index.
+ */
+void *fdt_index_fini(struct fdt *fdt)
+{
+	void *buf = (void *)fdt->index;
+
+	fdt->index = NULL;
+	return buf;
+}
+
+/**
+ * Returns the index of the entry of the given node.
+ */
+static uint32_t fdt_index_find_node(const struct fdt_node *node)
+{
+	const struct fdt_index *index = node->fdt.index;
+	uint32_t offset = (uint32_t)node->offset;
+	uint32_t low = 0;
+	uint32_t high = index->count;
+
+	/* The entries are sorted by offset, being in the order of the FDT. */
+	while (low < high) {
+		uint32_t mid = low + (high - low) / 2;
+
+		if (index->entries[mid].offset < offset) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	CHECK(low < index->count && index->entries[low].offset == offset);
+	return low;
+}
+
+/**
+ * Retrieves the buffer with value of property `name` at `node` from the index.
+ * Returns true on success, false if not found.
+ */
+bool fdt_index_read_property(const struct fdt_node *node, const char *name,
+			     struct memiter *data)
+{
+	const struct fdt_index *index = node->fdt.index;
+	const void *base = fdt_base(&node->fdt);
+	uint32_t i = fdt_index_find_node(node);
+	uint32_t end = i + 1 + index->entries[i].prop_count;
+	uint32_t hash = fdt_index_hash(name);
+	size_t name_size = strnlen_s(name, RSIZE_MAX) + 1;
+
+	for (i++; i < end; i++) {
+		const char *prop_name;
+		const void *ptr;
+		int lenp;
+
+		if (index->entries[i].hash != hash) {
+			continue;
+		}
+
+		ptr = fdt_getprop_by_offset(base, (int)index->entries[i].offset,
+					    &prop_name, &lenp);
+		if (ptr != NULL &&
+		    strncmp(prop_name, name, name_size) == 0) {
+			CHECK(lenp >= 0);
+			memiter_init(data, ptr, (size_t)lenp);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Finds the first child of `node` from the index.
+ * If found, makes `node` point to the child and returns true.
+ */
+bool fdt_index_first_child(struct fdt_node *node)
+{
+	const struct fdt_index *index = node->fdt.index;
+	uint32_t i = fdt_index_find_node(node);
+
+	if (index->entries[i].child_count == 0) {
+		return false;
+	}
+
+	/* The first child follows the node's properties. */
+	i += 1 + index->entries[i].prop_count;
+	node->offset = (int)index->entries[i].offset;
+	return true;
+}
+
+/**
+ * Finds the next sibling of `node` from the index.
+ * If found, makes `node` point to the sibling and returns true.
+ */
+bool fdt_index_next_sibling(struct fdt_node *node)
+{
+	const struct fdt_index *index = node->fdt.index;
+	uint32_t i = fdt_index_find_node(node);
+
+	i = index->entries[i].next_sibling;
+	if (i == FDT_INDEX_NONE) {
+		return false;
+	}
+
+	node->offset = (int)index->entries[i].offset;
+	return true;
+}
+
+/**
+ * Finds the child of `node` named `name` from the index.
+ * If found, makes `node` point to the child and returns true.
+ */
+bool fdt_index_find_child(struct fdt_node *node, const struct string *name)
+{
+	const struct fdt_index *index = node->fdt.index;
+	const void *base = fdt_base(&node->fdt);
+	uint32_t i = fdt_index_find_node(node);
+	uint32_t hash = fdt_index_hash(string_data(name));
+
+	if (index->entries[i].child_count == 0) {
+		return false;
+	}
+
+	for (i += 1 + index->entries[i].prop_count; i != FDT_INDEX_NONE;
+	     i = index->entries[i].next_sibling) {
+		int offset = (int)index->entries[i].offset;
+		const char *child_name;
+
+		if (index->entries[i].hash != hash) {
+			continue;
+		}
+
+		child_name = fdt_get_name(base, offset, NULL);
+		if (child_name != NULL &&
+		    strncmp(child_name, string_data(name), STRING_MAX_SIZE) ==
+			    0) {
+			node->offset = offset;
+			return true;
+		}
+	}
+
+	return false;
+}
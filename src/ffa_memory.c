@@ -6,6 +6,9 @@
  * https://opensource.org/licenses/BSD-3-Clause.
  */
 
+/* Logs of this file are limited by DLOG_LEVEL_ffa_mem. */
+#define DLOG_SUBSYSTEM ffa_mem
+
 #include "hf/ffa_memory.h"
 
 #include "hf/arch/mm.h"
@@ -333,15 +336,13 @@ static uint32_t share_state_next_fragment_offset(
 	return next_fragment_offset;
 }
 
+#if DLOG_SUBSYS(ffa_mem, VERBOSE)
+
 static void dump_memory_region(struct ffa_memory_region *memory_region)
 {
 	uint32_t i;
 
-	if (LOG_LEVEL < LOG_LEVEL_VERBOSE) {
-		return;
-	}
-
-	dlog("from VM %#x, attributes %#x, flags %#x, tag %u, to "
+	dlog("from VM %#x, attributes %#x, flags %#x, tag %lu, to "
 	     "%u "
 	     "recipients [",
 	     memory_region->sender, memory_region->attributes,
@@ -365,10 +366,6 @@ static void dump_share_states(void)
 {
 	uint32_t i;
 
-	if (LOG_LEVEL < LOG_LEVEL_VERBOSE) {
-		return;
-	}
-
 	dlog("Current share states:\n");
 	sl_lock(&share_states_lock_instance);
 	for (i = 0; i < MAX_MEM_SHARES; ++i) {
@@ -387,7 +384,7 @@ static void dump_share_states(void)
 				dlog("invalid share_func %#x",
 				     share_states[i].share_func);
 			}
-			dlog(" %#x (", share_states[i].memory_region->handle);
+			dlog(" %#lx (", share_states[i].memory_region->handle);
 			dump_memory_region(share_states[i].memory_region);
 			if (share_states[i].sending_complete) {
 				dlog("): fully sent");
@@ -404,6 +401,14 @@ static void dump_share_states(void)
 	sl_unlock(&share_states_lock_instance);
 }
 
+#else
+
+static void dump_share_states(void)
+{
+}
+
+#endif
+
 /* TODO: Add device attributes: GRE, cacheability, shareability. */
 static inline uint32_t ffa_memory_permissions_to_mode(
 	ffa_memory_access_permissions_t permissions, uint32_t default_mode)
@@ -491,7 +496,7 @@ static struct ffa_value constituents_get_mode(
 			} else if (current_mode != *orig_mode) {
 				dlog_verbose(
 					"Expected mode %#x but was %#x for %d "
-					"pages at %#x.\n",
+					"pages at %#lx.\n",
 					*orig_mode, current_mode,
 					fragments[i][j].page_count,
 					ipa_addr(begin));
@@ -1181,8 +1186,8 @@ static struct ffa_value ffa_tee_reclaim_check_update(
 
 	if (ret.func != FFA_SUCCESS_32) {
 		dlog_verbose(
-			"Got %#x (%d) from TEE in response to FFA_MEM_RECLAIM, "
-			"expected FFA_SUCCESS.\n",
+			"Got %#lx (%ld) from TEE in response to "
+			"FFA_MEM_RECLAIM, expected FFA_SUCCESS.\n",
 			ret.func, ret.arg2);
 		goto out;
 	}
@@ -1633,7 +1638,7 @@ static struct ffa_value ffa_memory_send_continue_validate(
 	 */
 	if (!get_share_state(share_states, handle, &share_state)) {
 		dlog_verbose(
-			"Invalid handle %#x for memory send continuation.\n",
+			"Invalid handle %#lx for memory send continuation.\n",
 			handle);
 		return ffa_error(FFA_INVALID_PARAMETERS);
 	}
@@ -1646,7 +1651,7 @@ static struct ffa_value ffa_memory_send_continue_validate(
 
 	if (share_state->sending_complete) {
 		dlog_verbose(
-			"Sending of memory handle %#x is already complete.\n",
+			"Sending of memory handle %#lx is already complete.\n",
 			handle);
 		return ffa_error(FFA_INVALID_PARAMETERS);
 	}
@@ -1657,7 +1662,7 @@ static struct ffa_value ffa_memory_send_continue_validate(
 		 * probably be increased.
 		 */
 		dlog_warning(
-			"Too many fragments for memory share with handle %#x; "
+			"Too many fragments for memory share with handle %#lx; "
 			"only %d supported.\n",
 			handle, MAX_FRAGMENTS);
 		/* Free share state, as it's not possible to complete it. */
@@ -1854,7 +1859,8 @@ struct ffa_value ffa_memory_tee_send(
 		if (ret.func != FFA_SUCCESS_32) {
 			dlog_verbose(
 				"TEE didn't successfully complete memory send "
-				"operation; returned %#x (%d). Rolling back.\n",
+				"operation; returned %#lx (%ld). Rolling "
+				"back.\n",
 				ret.func, ret.arg2);
 
 			/*
@@ -1889,7 +1895,7 @@ struct ffa_value ffa_memory_tee_send(
 			goto out_unlock;
 		} else if (ret.func != FFA_MEM_FRAG_RX_32) {
 			dlog_warning(
-				"Got %#x from TEE in response to %#x for "
+				"Got %#lx from TEE in response to %#x for "
 				"fragment with %d/%d, expected "
 				"FFA_MEM_FRAG_RX.\n",
 				ret.func, share_func, fragment_length,
@@ -1900,7 +1906,7 @@ struct ffa_value ffa_memory_tee_send(
 		handle = ffa_frag_handle(ret);
 		if (ret.arg3 != fragment_length) {
 			dlog_warning(
-				"Got unexpected fragment offset %d for "
+				"Got unexpected fragment offset %ld for "
 				"FFA_MEM_FRAG_RX from TEE (expected %d).\n",
 				ret.arg3, fragment_length);
 			ret = ffa_error(FFA_INVALID_PARAMETERS);
@@ -2103,8 +2109,8 @@ struct ffa_value ffa_memory_tee_send_continue(struct vm_locked from_locked,
 				 */
 				dlog_verbose(
 					"TEE didn't successfully complete "
-					"memory send operation; returned %#x "
-					"(%d). Rolling back.\n",
+					"memory send operation; returned %#lx "
+					"(%ld). Rolling back.\n",
 					ret.func, ret.arg2);
 
 				/*
@@ -2142,8 +2148,8 @@ struct ffa_value ffa_memory_tee_send_continue(struct vm_locked from_locked,
 				 */
 				dlog_verbose(
 					"TEE didn't successfully abort failed "
-					"memory send operation; returned %#x "
-					"(%d).\n",
+					"memory send operation; returned %#lx "
+					"(%ld).\n",
 					tee_ret.func, tee_ret.arg2);
 			}
 			/*
@@ -2168,9 +2174,9 @@ struct ffa_value ffa_memory_tee_send_continue(struct vm_locked from_locked,
 		    ffa_frag_sender(ret) != from_locked.vm->id) {
 			dlog_verbose(
 				"Got unexpected result from forwarding "
-				"FFA_MEM_FRAG_TX to TEE: %#x (handle %#x, "
-				"offset %d, sender %d); expected "
-				"FFA_MEM_FRAG_RX (handle %#x, offset %d, "
+				"FFA_MEM_FRAG_TX to TEE: %#lx (handle %#lx, "
+				"offset %ld, sender %d); expected "
+				"FFA_MEM_FRAG_RX (handle %#lx, offset %d, "
 				"sender %d).\n",
 				ret.func, ffa_frag_handle(ret), ret.arg3,
 				ffa_frag_sender(ret), handle,
@@ -2468,7 +2474,7 @@ struct ffa_value ffa_memory_retrieve(struct vm_locked to_locked,
 
 	share_states = share_states_lock();
 	if (!get_share_state(share_states, handle, &share_state)) {
-		dlog_verbose("Invalid handle %#x for FFA_MEM_RETRIEVE_REQ.\n",
+		dlog_verbose("Invalid handle %#lx for FFA_MEM_RETRIEVE_REQ.\n",
 			     handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
 		goto out;
@@ -2476,7 +2482,7 @@ struct ffa_value ffa_memory_retrieve(struct vm_locked to_locked,
 
 	if (!share_state->sending_complete) {
 		dlog_verbose(
-			"Memory with handle %#x not fully sent, can't "
+			"Memory with handle %#lx not fully sent, can't "
 			"retrieve.\n",
 			handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
@@ -2495,14 +2501,14 @@ struct ffa_value ffa_memory_retrieve(struct vm_locked to_locked,
 	if (receiver_index == memory_region->receiver_count) {
 		dlog_verbose(
 			"Incorrect receiver VM ID %x for FFA_MEM_RETRIEVE_REQ, "
-			"for handle %#x.\n",
+			"for handle %#lx.\n",
 			to_locked.vm->id, handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
 		goto out;
 	}
 
 	if (share_state->retrieved_fragment_count[receiver_index] != 0U) {
-		dlog_verbose("Memory with handle %#x already retrieved.\n",
+		dlog_verbose("Memory with handle %#lx already retrieved.\n",
 			     handle);
 		ret = ffa_error(FFA_DENIED);
 		goto out;
@@ -2518,7 +2524,7 @@ struct ffa_value ffa_memory_retrieve(struct vm_locked to_locked,
 				 FFA_MEMORY_REGION_TRANSACTION_TYPE_MASK)) {
 		dlog_verbose(
 			"Incorrect transaction type %#x for "
-			"FFA_MEM_RETRIEVE_REQ, expected %#x for handle %#x.\n",
+			"FFA_MEM_RETRIEVE_REQ, expected %#x for handle %#lx.\n",
 			transaction_type,
 			memory_region->flags &
 				FFA_MEMORY_REGION_TRANSACTION_TYPE_MASK,
@@ -2530,7 +2536,7 @@ struct ffa_value ffa_memory_retrieve(struct vm_locked to_locked,
 	if (retrieve_request->sender != memory_region->sender) {
 		dlog_verbose(
 			"Incorrect sender ID %d for FFA_MEM_RETRIEVE_REQ, "
-			"expected %d for handle %#x.\n",
+			"expected %d for handle %#lx.\n",
 			retrieve_request->sender, memory_region->sender,
 			handle);
 		ret = ffa_error(FFA_DENIED);
@@ -2539,8 +2545,8 @@ struct ffa_value ffa_memory_retrieve(struct vm_locked to_locked,
 
 	if (retrieve_request->tag != memory_region->tag) {
 		dlog_verbose(
-			"Incorrect tag %d for FFA_MEM_RETRIEVE_REQ, expected "
-			"%d for handle %#x.\n",
+			"Incorrect tag %ld for FFA_MEM_RETRIEVE_REQ, expected "
+			"%ld for handle %#lx.\n",
 			retrieve_request->tag, memory_region->tag, handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
 		goto out;
@@ -2690,7 +2696,7 @@ struct ffa_value ffa_memory_retrieve_continue(struct vm_locked to_locked,
 
 	share_states = share_states_lock();
 	if (!get_share_state(share_states, handle, &share_state)) {
-		dlog_verbose("Invalid handle %#x for FFA_MEM_FRAG_RX.\n",
+		dlog_verbose("Invalid handle %#lx for FFA_MEM_FRAG_RX.\n",
 			     handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
 		goto out;
@@ -2705,7 +2711,7 @@ struct ffa_value ffa_memory_retrieve_continue(struct vm_locked to_locked,
 	if (receiver_index == memory_region->receiver_count) {
 		dlog_verbose(
 			"Caller of FFA_MEM_FRAG_RX (%x) is not a borrower to "
-			"memory sharing transaction (%x)\n",
+			"memory sharing transaction (%lx)\n",
 			to_locked.vm->id, handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
 		goto out;
@@ -2713,7 +2719,7 @@ struct ffa_value ffa_memory_retrieve_continue(struct vm_locked to_locked,
 
 	if (!share_state->sending_complete) {
 		dlog_verbose(
-			"Memory with handle %#x not fully sent, can't "
+			"Memory with handle %#lx not fully sent, can't "
 			"retrieve.\n",
 			handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
@@ -2724,7 +2730,7 @@ struct ffa_value ffa_memory_retrieve_continue(struct vm_locked to_locked,
 	    share_state->retrieved_fragment_count[receiver_index] >=
 		    share_state->fragment_count) {
 		dlog_verbose(
-			"Retrieval of memory with handle %#x not yet started "
+			"Retrieval of memory with handle %#lx not yet started "
 			"or already completed (%d/%d fragments retrieved).\n",
 			handle,
 			share_state->retrieved_fragment_count[receiver_index],
@@ -2821,7 +2827,7 @@ struct ffa_value ffa_memory_relinquish(
 
 	share_states = share_states_lock();
 	if (!get_share_state(share_states, handle, &share_state)) {
-		dlog_verbose("Invalid handle %#x for FFA_MEM_RELINQUISH.\n",
+		dlog_verbose("Invalid handle %#lx for FFA_MEM_RELINQUISH.\n",
 			     handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
 		goto out;
@@ -2829,7 +2835,7 @@ struct ffa_value ffa_memory_relinquish(
 
 	if (!share_state->sending_complete) {
 		dlog_verbose(
-			"Memory with handle %#x not fully sent, can't "
+			"Memory with handle %#lx not fully sent, can't "
 			"relinquish.\n",
 			handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
@@ -2845,7 +2851,7 @@ struct ffa_value ffa_memory_relinquish(
 	if (receiver_index == memory_region->receiver_count) {
 		dlog_verbose(
 			"VM ID %d tried to relinquish memory region with "
-			"handle %#x and it is not a valid borrower.\n",
+			"handle %#lx and it is not a valid borrower.\n",
 			from_locked.vm->id, handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
 		goto out;
@@ -2854,7 +2860,7 @@ struct ffa_value ffa_memory_relinquish(
 	if (share_state->retrieved_fragment_count[receiver_index] !=
 	    share_state->fragment_count) {
 		dlog_verbose(
-			"Memory with handle %#x not yet fully retrieved, "
+			"Memory with handle %#lx not yet fully retrieved, "
 			"receiver %x can't relinquish.\n",
 			handle, from_locked.vm->id);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
@@ -2911,7 +2917,7 @@ struct ffa_value ffa_memory_reclaim(struct vm_locked to_locked,
 
 	share_states = share_states_lock();
 	if (!get_share_state(share_states, handle, &share_state)) {
-		dlog_verbose("Invalid handle %#x for FFA_MEM_RECLAIM.\n",
+		dlog_verbose("Invalid handle %#lx for FFA_MEM_RECLAIM.\n",
 			     handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
 		goto out;
@@ -2922,7 +2928,7 @@ struct ffa_value ffa_memory_reclaim(struct vm_locked to_locked,
 
 	if (to_locked.vm->id != memory_region->sender) {
 		dlog_verbose(
-			"VM %#x attempted to reclaim memory handle %#x "
+			"VM %#x attempted to reclaim memory handle %#lx "
 			"originally sent by VM %#x.\n",
 			to_locked.vm->id, handle, memory_region->sender);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
@@ -2931,7 +2937,7 @@ struct ffa_value ffa_memory_reclaim(struct vm_locked to_locked,
 
 	if (!share_state->sending_complete) {
 		dlog_verbose(
-			"Memory with handle %#x not fully sent, can't "
+			"Memory with handle %#lx not fully sent, can't "
 			"reclaim.\n",
 			handle);
 		ret = ffa_error(FFA_INVALID_PARAMETERS);
@@ -2941,7 +2947,7 @@ struct ffa_value ffa_memory_reclaim(struct vm_locked to_locked,
 	for (uint32_t i = 0; i < memory_region->receiver_count; i++) {
 		if (share_state->retrieved_fragment_count[i] != 0) {
 			dlog_verbose(
-				"Tried to reclaim memory handle %#x that has "
+				"Tried to reclaim memory handle %#lx that has "
 				"not been relinquished by all borrowers(%x).\n",
 				handle,
 				memory_region->receivers[i]
@@ -2999,12 +3005,12 @@ struct ffa_value ffa_memory_tee_reclaim(struct vm_locked to_locked,
 				   .arg1 = request_length,
 				   .arg2 = request_length});
 	if (tee_ret.func == FFA_ERROR_32) {
-		dlog_verbose("Got error %d from EL3.\n", tee_ret.arg2);
+		dlog_verbose("Got error %ld from EL3.\n", tee_ret.arg2);
 		return tee_ret;
 	}
 	if (tee_ret.func != FFA_MEM_RETRIEVE_RESP_32) {
 		dlog_verbose(
-			"Got %#x from EL3, expected FFA_MEM_RETRIEVE_RESP.\n",
+			"Got %#lx from EL3, expected FFA_MEM_RETRIEVE_RESP.\n",
 			tee_ret.func);
 		return ffa_error(FFA_INVALID_PARAMETERS);
 	}
@@ -3014,7 +3020,7 @@ struct ffa_value ffa_memory_tee_reclaim(struct vm_locked to_locked,
 
 	if (fragment_length > HF_MAILBOX_SIZE || fragment_length > length ||
 	    length > sizeof(tee_retrieve_buffer)) {
-		dlog_verbose("Invalid fragment length %d/%d (max %d/%d).\n",
+		dlog_verbose("Invalid fragment length %d/%d (max %d/%ld).\n",
 			     fragment_length, length, HF_MAILBOX_SIZE,
 			     sizeof(tee_retrieve_buffer));
 		return ffa_error(FFA_INVALID_PARAMETERS);
@@ -3037,16 +3043,16 @@ struct ffa_value ffa_memory_tee_reclaim(struct vm_locked to_locked,
 					   .arg3 = fragment_offset});
 		if (tee_ret.func != FFA_MEM_FRAG_TX_32) {
 			dlog_verbose(
-				"Got %#x (%d) from TEE in response to "
+				"Got %#lx (%ld) from TEE in response to "
 				"FFA_MEM_FRAG_RX, expected FFA_MEM_FRAG_TX.\n",
 				tee_ret.func, tee_ret.arg2);
 			return tee_ret;
 		}
 		if (ffa_frag_handle(tee_ret) != handle) {
 			dlog_verbose(
-				"Got FFA_MEM_FRAG_TX for unexpected handle %#x "
-				"in response to FFA_MEM_FRAG_RX for handle "
-				"%#x.\n",
+				"Got FFA_MEM_FRAG_TX for unexpected handle "
+				"%#lx in response to FFA_MEM_FRAG_RX for "
+				"handle %#lx.\n",
 				ffa_frag_handle(tee_ret), handle);
 			return ffa_error(FFA_INVALID_PARAMETERS);
 		}
@@ -3087,8 +3093,8 @@ struct ffa_value ffa_memory_tee_reclaim(struct vm_locked to_locked,
 
 	if (memory_region->handle != handle) {
 		dlog_verbose(
-			"Got memory region handle %#x from TEE but requested "
-			"handle %#x.\n",
+			"Got memory region handle %#lx from TEE but requested "
+			"handle %#lx.\n",
 			memory_region->handle, handle);
 		return ffa_error(FFA_INVALID_PARAMETERS);
 	}
@@ -3096,7 +3102,7 @@ struct ffa_value ffa_memory_tee_reclaim(struct vm_locked to_locked,
 	/* The original sender must match the caller. */
 	if (to_locked.vm->id != memory_region->sender) {
 		dlog_verbose(
-			"VM %#x attempted to reclaim memory handle %#x "
+			"VM %#x attempted to reclaim memory handle %#lx "
 			"originally sent by VM %#x.\n",
 			to_locked.vm->id, handle, memory_region->sender);
 		return ffa_error(FFA_INVALID_PARAMETERS);
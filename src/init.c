@@ -11,12 +11,15 @@
 #include <stdalign.h>
 #include <stddef.h>
 
+#include "hf/arch/cpu.h"
 #include "hf/arch/other_world.h"
 #include "hf/arch/plat/ffa.h"
 
 #include "hf/api.h"
 #include "hf/boot_flow.h"
 #include "hf/boot_params.h"
+#include "hf/boot_timeline.h"
+#include "hf/check.h"
 #include "hf/cpio.h"
 #include "hf/cpu.h"
 #include "hf/dlog.h"
@@ -44,6 +47,63 @@ static struct mpool ppool;
  */
 static struct manifest manifest;
 
+/**
+ * Returns the index of the CPU this is called on, for the binary log to use the
+ * ring of the CPU, or MAX_CPUS if it isn't known.
+ */
+static size_t dlog_cpu_index(void)
+{
+	struct cpu *c = cpu_find(arch_cpu_current_id());
+
+	return c == NULL ? MAX_CPUS : cpu_index(c);
+}
+
+/**
+ * Returns the size of the memory allocated from the pool for the index of the
+ * initrd.
+ */
+static size_t initrd_index_size(const struct cpio *cpio)
+{
+	return align_up(cpio_index_size(cpio), MM_PPOOL_ENTRY_SIZE);
+}
+
+/**
+ * Indexes the files of the initrd in memory allocated from the pool, so that
+ * loading each VM doesn't scan the initrd for its files. The initrd is scanned
+ * for each file if it can't be indexed.
+ */
+static void initrd_index_init(struct cpio *cpio)
+{
+	size_t size = initrd_index_size(cpio);
+	void *buf =
+		mpool_alloc_contiguous(&ppool, size / MM_PPOOL_ENTRY_SIZE, 1);
+
+	if (buf == NULL) {
+		dlog_verbose("Not enough memory to index the initrd.\n");
+		return;
+	}
+
+	if (!cpio_index_init(cpio, buf, size)) {
+		dlog_verbose("Unable to index the initrd.\n");
+		mpool_add_chunk(&ppool, buf, size);
+	}
+}
+
+/**
+ * Frees the index of the initrd, if it has one, back to the pool.
+ */
+static void initrd_index_fini(struct cpio *cpio)
+{
+	void *buf = cpio_index_fini(cpio);
+
+	if (buf != NULL) {
+		mpool_add_chunk(&ppool, buf, initrd_index_size(cpio));
+	}
+}
+
+/* The span of the whole one-time initialisation, from memory management on. */
+static size_t init_span;
+
 /**
  * Performs one-time initialisation of memory management for the hypervisor.
  *
@@ -53,17 +113,23 @@ static struct manifest manifest;
  */
 void one_time_init_mm(void)
 {
+	size_t span;
+
 	/* Make sure the console is initialised before calling dlog. */
 	plat_console_init();
 
 	plat_ffa_log_init();
 
+	init_span = boot_timeline_begin("one_time_init", 0);
+
 	mpool_init(&ppool, MM_PPOOL_ENTRY_SIZE);
 	mpool_add_chunk(&ppool, ptable_buf, sizeof(ptable_buf));
 
+	span = boot_timeline_begin("mm_init", 0);
 	if (!mm_init(&ppool)) {
 		panic("mm_init failed");
 	}
+	boot_timeline_end(span);
 }
 
 /**
@@ -76,11 +142,12 @@ void one_time_init(void)
 	enum manifest_return_code manifest_ret;
 	struct boot_params params;
 	struct boot_params_update update;
-	struct memiter cpio;
+	struct cpio cpio;
 	struct memiter manifest_it;
 	void *initrd;
 	size_t i;
 	struct mm_stage1_locked mm_stage1_locked;
+	size_t span;
 
 	arch_one_time_init();
 
@@ -100,7 +167,7 @@ void one_time_init(void)
 	}
 
 	for (i = 0; i < params.mem_ranges_count; ++i) {
-		dlog_info("Memory range:  %#x - %#x\n",
+		dlog_info("Memory range:  %#lx - %#lx\n",
 			  pa_addr(params.mem_ranges[i].begin),
 			  pa_addr(params.mem_ranges[i].end) - 1);
 	}
@@ -113,7 +180,7 @@ void one_time_init(void)
 	 * passed to Hafnium entry point is the manifest address.
 	 */
 	if (pa_addr(params.initrd_begin)) {
-		dlog_info("Ramdisk range: %#x - %#x\n",
+		dlog_info("Ramdisk range: %#lx - %#lx\n",
 			  pa_addr(params.initrd_begin),
 			  pa_addr(params.initrd_end) - 1);
 
@@ -124,19 +191,26 @@ void one_time_init(void)
 			panic("Unable to map initrd.");
 		}
 
-		memiter_init(
-			&cpio, initrd,
-			pa_difference(params.initrd_begin, params.initrd_end));
+		if (!cpio_init(&cpio, initrd,
+			       pa_difference(params.initrd_begin,
+					     params.initrd_end))) {
+			panic("Malformed initrd.");
+		}
+
+		initrd_index_init(&cpio);
 
 		if (!cpio_get_file(&cpio, &manifest_fname, &manifest_it)) {
 			panic("Could not find manifest in initrd.");
 		}
 	} else {
+		CHECK(cpio_init(&cpio, NULL, 0));
 		manifest_it = fdt.buf;
 	}
 
+	span = boot_timeline_begin("manifest_init", 0);
 	manifest_ret = manifest_init(mm_stage1_locked, &manifest, &manifest_it,
 				     &ppool);
+	boot_timeline_end(span);
 
 	if (manifest_ret != MANIFEST_SUCCESS) {
 		panic("Could not parse manifest: %s.",
@@ -145,15 +219,18 @@ void one_time_init(void)
 
 	plat_ffa_set_tee_enabled(manifest.ffa_tee_enabled);
 
+	span = boot_timeline_begin("plat_iommu_init", 0);
 	if (!plat_iommu_init(&fdt, mm_stage1_locked, &ppool)) {
 		panic("Could not initialize IOMMUs.");
 	}
+	boot_timeline_end(span);
 
 	if (!fdt_unmap(&fdt, mm_stage1_locked, &ppool)) {
 		panic("Unable to unmap FDT.");
 	}
 
 	cpu_module_init(params.cpu_ids, params.cpu_count);
+	dlog_binary_enable(dlog_cpu_index);
 
 	if (!plat_interrupts_controller_driver_init(&fdt, mm_stage1_locked,
 						    &ppool)) {
@@ -170,10 +247,14 @@ void one_time_init(void)
 	/* Now manifest parsing has completed free the resourses used. */
 	manifest_deinit(&ppool);
 
+	span = boot_timeline_begin("boot_flow_update", 0);
 	if (!boot_flow_update(mm_stage1_locked, &manifest, &update, &cpio,
 			      &ppool)) {
 		panic("Unable to update boot flow.");
 	}
+	boot_timeline_end(span);
+
+	initrd_index_fini(&cpio);
 
 	mm_unlock_stage1(&mm_stage1_locked);
 
@@ -186,5 +267,8 @@ void one_time_init(void)
 	/* Initialise the API page pool. ppool will be empty from now on. */
 	api_init(&ppool);
 
+	boot_timeline_end(init_span);
+	boot_timeline_dump();
+
 	dlog_info("Hafnium initialisation completed\n");
 }
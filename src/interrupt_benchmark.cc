@@ -0,0 +1,256 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+/*
+ * Measures the latency from injecting a virtual interrupt to its delivery on
+ * the fake architecture, with several threads standing in for the CPUs that
+ * inject into a single vCPU while it acknowledges the interrupts.
+ *
+ * Each injector owns a share of the interrupt IDs, and waits for an interrupt
+ * to be delivered before injecting it again. With `--locked` the injectors
+ * take the lock of the target vCPU around each injection, as was required
+ * before the pending state could be updated atomically, for comparison.
+ *
+ * The threads only contend like CPUs do when the host runs them on separate
+ * cores. On a single core host, injectors are mostly descheduled rather than
+ * spinning, so the results there say little about contention on hardware.
+ *
+ * Usage: interrupt_benchmark [--injectors N] [--rounds N] [--locked]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "hf/api.h"
+#include "hf/vcpu.h"
+#include "hf/vm.h"
+}
+
+namespace
+{
+using struct_vcpu = struct vcpu;
+using struct_vm = struct vm;
+using clock_type = std::chrono::steady_clock;
+
+struct options {
+	size_t injectors = 4;
+	size_t rounds = 10000;
+	bool locked = false;
+};
+
+void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [--injectors N] [--rounds N] [--locked]\n",
+		program);
+	exit(EXIT_FAILURE);
+}
+
+bool parse_options(int argc, char *argv[], struct options *opts)
+{
+	for (int i = 1; i < argc; i++) {
+		size_t *value;
+		char *end;
+
+		if (strcmp(argv[i], "--locked") == 0) {
+			opts->locked = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--injectors") == 0) {
+			value = &opts->injectors;
+		} else if (strcmp(argv[i], "--rounds") == 0) {
+			value = &opts->rounds;
+		} else {
+			return false;
+		}
+
+		if (++i == argc) {
+			return false;
+		}
+
+		*value = strtoull(argv[i], &end, 0);
+		if (*end != '\0') {
+			return false;
+		}
+	}
+
+	/* Each injector needs an interrupt ID of its own. */
+	return opts->injectors > 0 && opts->injectors <= HF_NUM_INTIDS &&
+	       opts->rounds > 0;
+}
+
+uint64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       clock_type::now().time_since_epoch())
+		.count();
+}
+
+/**
+ * The state of an interrupt ID shared between the injector owning it and the
+ * vCPU: when it was last injected, and whether that injection was delivered.
+ */
+struct injection {
+	std::atomic<uint64_t> injected_ns{0};
+	std::atomic<bool> delivered{true};
+};
+
+/** Injects the interrupt as the primary VM does, reporting whether to kick. */
+bool inject(struct_vcpu *target, struct_vcpu *primary, uint32_t intid,
+	    bool locked)
+{
+	struct vcpu_locked target_locked = {.vcpu = target};
+	int64_t ret;
+
+	if (locked) {
+		target_locked = vcpu_lock(target);
+	}
+
+	ret = api_interrupt_inject_locked(target_locked, intid, primary,
+					  nullptr);
+
+	if (locked) {
+		vcpu_unlock(&target_locked);
+	}
+
+	return ret == 1;
+}
+
+/**
+ * The vCPU interrupts are injected into, the primary VM's vCPU injecting them,
+ * and the state of each interrupt ID.
+ */
+struct benchmark {
+	struct options opts;
+	std::unique_ptr<struct_vm> target_vm = std::make_unique<struct_vm>();
+	std::unique_ptr<struct_vm> primary_vm = std::make_unique<struct_vm>();
+	struct_vcpu target;
+	struct_vcpu primary;
+	std::vector<struct injection> injections =
+		std::vector<struct injection>(HF_NUM_INTIDS);
+};
+
+/**
+ * Injects each interrupt ID owned by the given injector, i.e. every
+ * `injectors`th, as many times as there are rounds.
+ */
+void injector(struct benchmark *b, uint32_t first)
+{
+	for (size_t r = 0; r < b->opts.rounds; r++) {
+		for (uint32_t intid = first; intid < HF_NUM_INTIDS;
+		     intid += b->opts.injectors) {
+			struct injection *i = &b->injections[intid];
+
+			while (!i->delivered.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+
+			i->delivered.store(false, std::memory_order_relaxed);
+			i->injected_ns.store(now_ns(),
+					     std::memory_order_relaxed);
+			inject(&b->target, &b->primary, intid, b->opts.locked);
+		}
+	}
+}
+
+/**
+ * Acknowledges interrupts as they become pending, as the vCPU does, until all
+ * have been delivered. Returns the latency of each.
+ */
+std::vector<uint64_t> deliver(struct benchmark *b)
+{
+	std::vector<uint64_t> latencies;
+	size_t count = HF_NUM_INTIDS * b->opts.rounds;
+
+	latencies.reserve(count);
+
+	while (latencies.size() < count) {
+		uint32_t intid = api_interrupt_get(&b->target);
+		struct injection *i;
+
+		if (intid == HF_INVALID_INTID) {
+			continue;
+		}
+
+		i = &b->injections[intid];
+		latencies.push_back(now_ns() -
+				    i->injected_ns.load(
+					    std::memory_order_relaxed));
+		i->delivered.store(true, std::memory_order_release);
+	}
+
+	return latencies;
+}
+
+/** Returns the given percentile of the sorted latencies, in nanoseconds. */
+uint64_t percentile(const std::vector<uint64_t> &sorted, size_t p)
+{
+	return sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)];
+}
+
+} /* namespace */
+
+int main(int argc, char *argv[])
+{
+	struct benchmark b;
+	std::vector<std::thread> threads;
+	std::vector<uint64_t> latencies;
+	uint64_t begin_ns;
+	uint64_t end_ns;
+
+	if (!parse_options(argc, argv, &b.opts)) {
+		usage(argv[0]);
+	}
+
+	vcpu_init(&b.target, b.target_vm.get());
+	b.primary_vm->id = HF_PRIMARY_VM_ID;
+	vcpu_init(&b.primary, b.primary_vm.get());
+
+	for (uint32_t intid = 0; intid < HF_NUM_INTIDS; intid++) {
+		api_interrupt_enable(intid, true, INTERRUPT_TYPE_IRQ,
+				     &b.target);
+	}
+
+	begin_ns = now_ns();
+
+	for (uint32_t t = 0; t < b.opts.injectors; t++) {
+		threads.emplace_back(injector, &b, t);
+	}
+
+	latencies = deliver(&b);
+	end_ns = now_ns();
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("%zu interrupts injected by %zu threads%s, in %.3f ms:\n",
+	       latencies.size(), b.opts.injectors,
+	       b.opts.locked ? " holding the vCPU lock" : "",
+	       (double)(end_ns - begin_ns) / 1000000);
+	printf("%10s %10s %10s %10s %10s\n", "min ns", "median ns", "p90 ns",
+	       "p99 ns", "max ns");
+	printf("%10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+	       " %10" PRIu64 "\n",
+	       latencies.front(), percentile(latencies, 50),
+	       percentile(latencies, 90), percentile(latencies, 99),
+	       latencies.back());
+
+	return EXIT_SUCCESS;
+}
@@ -35,6 +35,26 @@ void plat_iommu_identity_map(struct vm_locked vm_locked, paddr_t begin,
 	(void)mode;
 }
 
+void plat_iommu_sync(struct vm_locked vm_locked)
+{
+	(void)vm_locked;
+}
+
+bool plat_iommu_handle_interrupt(uint32_t intid, struct vcpu *current)
+{
+	(void)intid;
+	(void)current;
+
+	return false;
+}
+
+uint64_t plat_iommu_fault_count(ffa_vm_id_t vm_id)
+{
+	(void)vm_id;
+
+	return 0;
+}
+
 bool plat_iommu_attach_peripheral(struct mm_stage1_locked stage1_locked,
 				  struct vm_locked vm_locked,
 				  const struct manifest_vm *manifest_vm,
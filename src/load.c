@@ -10,6 +10,7 @@
 
 #include <stdbool.h>
 
+#include "hf/arch/barriers.h"
 #include "hf/arch/init.h"
 #include "hf/arch/other_world.h"
 #include "hf/arch/plat/ffa.h"
@@ -17,15 +18,19 @@
 
 #include "hf/api.h"
 #include "hf/boot_params.h"
+#include "hf/boot_timeline.h"
 #include "hf/check.h"
 #include "hf/dlog.h"
 #include "hf/fdt_patch.h"
 #include "hf/layout.h"
+#include "hf/load_queue.h"
+#include "hf/lz4.h"
 #include "hf/memiter.h"
 #include "hf/mm.h"
 #include "hf/plat/console.h"
 #include "hf/plat/interrupts.h"
 #include "hf/plat/iommu.h"
+#include "hf/sp_pkg.h"
 #include "hf/static_assert.h"
 #include "hf/std.h"
 #include "hf/vm.h"
@@ -63,17 +68,217 @@ static bool copy_to_unmapped(struct mm_stage1_locked stage1_locked, paddr_t to,
 }
 
 /**
- * Loads the secondary VM's kernel.
+ * Like copy_to_unmapped, but for an image overlapping the location it is to be
+ * copied to, which is moved in the order that doesn't overwrite any of it
+ * before it is copied. The overlapping part of the image is unmapped along with
+ * the location, so no other file must be stored there.
+ */
+static bool move_to_unmapped(struct mm_stage1_locked stage1_locked, paddr_t to,
+			     struct memiter *from_it, struct mpool *ppool)
+{
+	const void *from = memiter_base(from_it);
+	size_t size = memiter_size(from_it);
+	paddr_t to_end = pa_add(to, size);
+	void *ptr;
+
+	/* The image is read through this mapping where they overlap. */
+	ptr = mm_identity_map(stage1_locked, to, to_end, MM_MODE_R | MM_MODE_W,
+			      ppool);
+	if (!ptr) {
+		return false;
+	}
+
+	memmove_s(ptr, size, from, size);
+	arch_mm_flush_dcache(ptr, size);
+
+	CHECK(mm_unmap(stage1_locked, to, to_end, ppool));
+
+	return true;
+}
+
+/**
+ * Like copy_to_unmapped, but decompresses the LZ4 frame into the location a
+ * block at a time, so that each block is written back to memory while it is
+ * still in the cache.
+ */
+static bool decompress_to_unmapped(struct mm_stage1_locked stage1_locked,
+				   paddr_t to, struct lz4_frame *frame,
+				   struct mpool *ppool)
+{
+	paddr_t to_end = pa_add(to, frame->content_size);
+	void *ptr;
+	bool ret;
+
+	ptr = mm_identity_map(stage1_locked, to, to_end, MM_MODE_W, ppool);
+	if (!ptr) {
+		return false;
+	}
+
+	ret = lz4_frame_decompress(frame, ptr);
+
+	CHECK(mm_unmap(stage1_locked, to, to_end, ppool));
+
+	return ret;
+}
+
+/**
+ * Gets the size of the image once loaded. If it is compressed in an LZ4 frame,
+ * that is the size of its contents and `frame` is initialised to decompress
+ * it. Returns false if the image is a malformed or unsupported LZ4 frame.
+ */
+static bool image_loaded_size(const struct memiter *image,
+			      struct lz4_frame *frame, bool *compressed,
+			      size_t *size)
+{
+	*compressed = lz4_is_frame(image);
+	if (!*compressed) {
+		*size = memiter_size(image);
+		return true;
+	}
+
+	if (!lz4_frame_init(frame, image)) {
+		dlog_error("Unsupported LZ4 frame.\n");
+		return false;
+	}
+
+	*size = frame->content_size;
+	return true;
+}
+
+#if PARALLEL_LOAD
+
+/**
+ * The kernels of VMs being copied by the CPUs working on the queue, and the
+ * ranges of memory mapped to copy them into, to be unmapped once the queue has
+ * been joined.
+ */
+static struct load_queue load_queue;
+static struct mem_range load_queue_ranges[MAX_VMS];
+static size_t load_queue_range_count;
+
+/** The CPUs powered on to work on the queue. */
+static struct cpu *load_queue_helpers[MAX_CPUS];
+static size_t load_queue_helper_count;
+
+static void load_queue_helper(void *arg)
+{
+	load_queue_work((struct load_queue *)arg);
+}
+
+/**
+ * Powers on the other CPUs to copy kernels as they are queued, while the boot
+ * CPU goes on loading VMs.
+ */
+static void load_queue_start(const struct boot_params *params)
+{
+	cpu_id_t boot_cpu_id = arch_cpu_current_id();
+	size_t i;
+
+	load_queue_init(&load_queue);
+	load_queue_range_count = 0;
+	load_queue_helper_count = 0;
+
+	for (i = 0; i < params->cpu_count; ++i) {
+		struct cpu *c = cpu_find(params->cpu_ids[i]);
+
+		if (c != NULL && c->id != boot_cpu_id &&
+		    load_queue_helper_count < ARRAY_SIZE(load_queue_helpers) &&
+		    arch_cpu_start_helper(c, load_queue_helper, &load_queue)) {
+			load_queue_helpers[load_queue_helper_count++] = c;
+		}
+	}
+
+	dlog_info("Loading VMs with %zu helper CPUs.\n",
+		  load_queue_helper_count);
+}
+
+/**
+ * Waits for all the queued kernels to have been copied and for the helper CPUs
+ * to have powered off again, then unmaps the memory they were copied to. The
+ * primary VM can only power the helper CPUs on once they are off.
+ */
+static void load_queue_finish(struct mm_stage1_locked stage1_locked,
+			      struct mpool *ppool)
+{
+	size_t i;
+
+	load_queue_join(&load_queue);
+
+	for (i = 0; i < load_queue_helper_count; ++i) {
+		arch_cpu_join_helper(load_queue_helpers[i]);
+	}
+
+	for (i = 0; i < load_queue_range_count; ++i) {
+		CHECK(mm_unmap(stage1_locked, load_queue_ranges[i].begin,
+			       load_queue_ranges[i].end, ppool));
+	}
+}
+
+/**
+ * Like copy_to_unmapped, but queues the copy for whichever CPU gets to it
+ * first, and leaves the memory mapped until the queue is finished.
+ */
+static bool queue_copy_to_unmapped(struct mm_stage1_locked stage1_locked,
+				   paddr_t to, struct memiter *from_it,
+				   struct mpool *ppool)
+{
+	const void *from = memiter_base(from_it);
+	size_t size = memiter_size(from_it);
+	paddr_t to_end = pa_add(to, size);
+	void *ptr;
+
+	if (load_queue_range_count == ARRAY_SIZE(load_queue_ranges)) {
+		return copy_to_unmapped(stage1_locked, to, from_it, ppool);
+	}
+
+	ptr = mm_identity_map(stage1_locked, to, to_end, MM_MODE_W, ppool);
+	if (!ptr) {
+		return false;
+	}
+
+	/* Make the mapping visible to the table walks of the other CPUs. */
+	data_sync_barrier();
+
+	if (!load_queue_add(&load_queue, ptr, from, size)) {
+		CHECK(mm_unmap(stage1_locked, to, to_end, ppool));
+		return copy_to_unmapped(stage1_locked, to, from_it, ppool);
+	}
+
+	load_queue_ranges[load_queue_range_count++] =
+		(struct mem_range){.begin = to, .end = to_end};
+
+	return true;
+}
+
+#endif
+
+/**
+ * Cleans and invalidates an image which the bootloader already placed where
+ * the partition expects it, so that the partition finds it in memory with its
+ * caches disabled and no stale lines are left once it enables them. The image
+ * is in the initrd, which is already mapped, so nothing is mapped or copied.
+ */
+static void load_in_place(struct memiter *image)
+{
+	arch_mm_flush_dcache((void *)memiter_base(image), memiter_size(image));
+}
+
+/**
+ * Loads the secondary VM's kernel, unless it is already in place.
  * Stores the kernel size in kernel_size (if kernel_size is not NULL).
  * Returns false if it cannot load the kernel.
  */
 static bool load_kernel(struct mm_stage1_locked stage1_locked, paddr_t begin,
 			paddr_t end, const struct manifest_vm *manifest_vm,
-			const struct memiter *cpio, struct mpool *ppool,
+			const struct cpio *cpio, struct mpool *ppool,
 			size_t *kernel_size)
 {
 	struct memiter kernel;
+	struct lz4_frame frame;
+	bool compressed;
+	paddr_t kernel_begin;
 	size_t size;
+	const char *overlapping;
 
 	if (!cpio_get_file(cpio, &manifest_vm->kernel_filename, &kernel)) {
 		dlog_error("Could not find kernel file \"%s\".\n",
@@ -81,17 +286,81 @@ static bool load_kernel(struct mm_stage1_locked stage1_locked, paddr_t begin,
 		return false;
 	}
 
-	size = memiter_size(&kernel);
+	if (!image_loaded_size(&kernel, &frame, &compressed, &size)) {
+		return false;
+	}
+
 	if (pa_difference(begin, end) < size) {
 		dlog_error("Kernel is larger than available memory.\n");
 		return false;
 	}
 
+	/*
+	 * Hafnium's mappings are identity, so the kernel's place in the initrd
+	 * is also its physical address.
+	 */
+	kernel_begin = pa_from_va(va_from_ptr(memiter_base(&kernel)));
+	if (!compressed && pa_addr(kernel_begin) == pa_addr(begin)) {
+		dlog_verbose("Kernel \"%s\" is already in place.\n",
+			     string_data(&manifest_vm->kernel_filename));
+		load_in_place(&kernel);
+		goto out;
+	}
+
+	/*
+	 * Copying over the other files of the initrd would both corrupt them
+	 * and unmap them once copied. Which of them are still to be read, also
+	 * by copies queued to other CPUs, isn't tracked so none may be
+	 * overwritten.
+	 */
+	if (cpio_find_overlapping(cpio, ptr_from_va(va_from_pa(begin)),
+				  ptr_from_va(va_from_pa(pa_add(begin, size))),
+				  memiter_base(&kernel), &overlapping)) {
+		dlog_error("Kernel \"%s\" would overwrite \"%s\" in the "
+			   "initrd.\n",
+			   string_data(&manifest_vm->kernel_filename),
+			   overlapping);
+		return false;
+	}
+
+	/* The kernel may still overlap its own place in memory. */
+	if (pa_addr(kernel_begin) < pa_addr(pa_add(begin, size)) &&
+	    pa_addr(begin) <
+		    pa_addr(pa_add(kernel_begin, memiter_size(&kernel)))) {
+		if (compressed) {
+			dlog_error("Compressed kernel overlaps its place in "
+				   "memory.\n");
+			return false;
+		}
+
+		dlog_verbose("Moving kernel \"%s\" to its place in memory.\n",
+			     string_data(&manifest_vm->kernel_filename));
+		if (!move_to_unmapped(stage1_locked, begin, &kernel, ppool)) {
+			dlog_error("Unable to move kernel.\n");
+			return false;
+		}
+		goto out;
+	}
+
+	if (compressed) {
+		if (!decompress_to_unmapped(stage1_locked, begin, &frame,
+					    ppool)) {
+			dlog_error("Unable to decompress kernel.\n");
+			return false;
+		}
+		goto out;
+	}
+
+#if PARALLEL_LOAD
+	if (!queue_copy_to_unmapped(stage1_locked, begin, &kernel, ppool)) {
+#else
 	if (!copy_to_unmapped(stage1_locked, begin, &kernel, ppool)) {
+#endif
 		dlog_error("Unable to copy kernel.\n");
 		return false;
 	}
 
+out:
 	if (kernel_size) {
 		*kernel_size = size;
 	}
@@ -121,7 +390,7 @@ static bool link_rxtx_to_mailbox(struct mm_stage1_locked stage1_locked,
 		return false;
 	}
 
-	dlog_verbose("  mailbox: send = %#x, recv = %#x\n",
+	dlog_verbose("  mailbox: send = %p, recv = %p\n",
 		     vm_locked.vm->mailbox.send, vm_locked.vm->mailbox.recv);
 
 	return true;
@@ -146,6 +415,29 @@ static void infer_interrupt(struct interrupt_info interrupt,
 	interrupt_desc_set_valid(int_desc, true);
 }
 
+/**
+ * Gives the virtual interrupt matching the given physical interrupt, on all
+ * vCPUs of the VM, the priority specified in the partition manifest.
+ */
+static void load_virtual_interrupt_priority(
+	struct vm_locked vm_locked, struct interrupt_descriptor int_desc)
+{
+	uint32_t intid = interrupt_desc_get_id(int_desc);
+
+	/* Virtual interrupts are mapped one to one to physical interrupts. */
+	if (intid >= HF_NUM_INTIDS) {
+		return;
+	}
+
+	for (ffa_vcpu_index_t i = 0; i < vm_locked.vm->vcpu_count; i++) {
+		struct vcpu *vcpu = vm_get_vcpu(vm_locked.vm, i);
+
+		vcpu_virt_interrupt_set_priority(
+			&vcpu->interrupts, intid,
+			interrupt_desc_get_priority(int_desc));
+	}
+}
+
 /**
  * Performs VM loading activities that are common between the primary and
  * secondaries.
@@ -160,6 +452,7 @@ static bool load_common(struct mm_stage1_locked stage1_locked,
 	uint32_t k = 0;
 
 	vm_locked.vm->smc_whitelist = manifest_vm->smc_whitelist;
+	vm_locked.vm->consistent_asids = manifest_vm->consistent_asids;
 	vm_locked.vm->uuid = manifest_vm->partition.uuid;
 
 	/* Populate the interrupt descriptor for current VM. */
@@ -175,6 +468,7 @@ static bool load_common(struct mm_stage1_locked stage1_locked,
 			interrupt = dev_region.interrupts[j];
 			infer_interrupt(interrupt, &int_desc);
 			vm_locked.vm->interrupt_desc[k] = int_desc;
+			load_virtual_interrupt_priority(vm_locked, int_desc);
 
 			/*
 			 * Configure the physical interrupts allocated for this
@@ -255,7 +549,7 @@ static bool load_common(struct mm_stage1_locked stage1_locked,
  */
 static bool load_primary(struct mm_stage1_locked stage1_locked,
 			 const struct manifest_vm *manifest_vm,
-			 const struct memiter *cpio,
+			 const struct cpio *cpio,
 			 const struct boot_params *params, struct mpool *ppool)
 {
 	paddr_t primary_begin;
@@ -376,7 +670,7 @@ static bool load_primary(struct mm_stage1_locked stage1_locked,
 		goto out;
 	}
 
-	dlog_info("Loaded primary VM with %u vCPUs, entry at %#x.\n",
+	dlog_info("Loaded primary VM with %u vCPUs, entry at %#lx.\n",
 		  vm->vcpu_count, pa_addr(primary_begin));
 
 	/* Mark the primary to be the first booted VM */
@@ -402,11 +696,15 @@ out:
 static bool load_secondary_fdt(struct mm_stage1_locked stage1_locked,
 			       paddr_t end, size_t fdt_max_size,
 			       const struct manifest_vm *manifest_vm,
-			       const struct memiter *cpio, struct mpool *ppool,
+			       const struct cpio *cpio, struct mpool *ppool,
 			       paddr_t *fdt_addr, size_t *fdt_allocated_size)
 {
 	struct memiter fdt;
+	struct lz4_frame frame;
+	bool compressed;
+	size_t fdt_size;
 	size_t allocated_size;
+	const char *overlapping;
 
 	CHECK(!string_is_empty(&manifest_vm->secondary.fdt_filename));
 
@@ -415,16 +713,20 @@ static bool load_secondary_fdt(struct mm_stage1_locked stage1_locked,
 		return false;
 	}
 
+	if (!image_loaded_size(&fdt, &frame, &compressed, &fdt_size)) {
+		return false;
+	}
+
 	/*
 	 * Ensure the FDT has one additional page at the end for patching,
 	 * and align it to the page boundary.
 	 */
-	allocated_size = align_up(memiter_size(&fdt), PAGE_SIZE) + PAGE_SIZE;
+	allocated_size = align_up(fdt_size, PAGE_SIZE) + PAGE_SIZE;
 
 	if (allocated_size > fdt_max_size) {
 		dlog_error(
-			"FDT allocated space (%u) is more than the specified "
-			"maximum to use (%u).\n",
+			"FDT allocated space (%zu) is more than the specified "
+			"maximum to use (%zu).\n",
 			allocated_size, fdt_max_size);
 		return false;
 	}
@@ -432,10 +734,29 @@ static bool load_secondary_fdt(struct mm_stage1_locked stage1_locked,
 	/* Load the FDT to the end of the VM's allocated memory space. */
 	*fdt_addr = pa_init(pa_addr(pa_sub(end, allocated_size)));
 
-	dlog_info("Loading secondary FDT of allocated size %u at 0x%x.\n",
+	/*
+	 * As for kernels, no file of the initrd may be overwritten, including
+	 * the FDT itself as it isn't copied in an order that would preserve it.
+	 */
+	if (cpio_find_overlapping(cpio, ptr_from_va(va_from_pa(*fdt_addr)),
+				  ptr_from_va(va_from_pa(end)), NULL,
+				  &overlapping)) {
+		dlog_error("FDT \"%s\" would overwrite \"%s\" in the initrd.\n",
+			   string_data(&manifest_vm->secondary.fdt_filename),
+			   overlapping);
+		return false;
+	}
+
+	dlog_info("Loading secondary FDT of allocated size %zu at 0x%lx.\n",
 		  allocated_size, pa_addr(*fdt_addr));
 
-	if (!copy_to_unmapped(stage1_locked, *fdt_addr, &fdt, ppool)) {
+	if (compressed) {
+		if (!decompress_to_unmapped(stage1_locked, *fdt_addr, &frame,
+					    ppool)) {
+			dlog_error("Unable to decompress FDT.\n");
+			return false;
+		}
+	} else if (!copy_to_unmapped(stage1_locked, *fdt_addr, &fdt, ppool)) {
 		dlog_error("Unable to copy FDT.\n");
 		return false;
 	}
@@ -507,11 +828,9 @@ static bool load_secondary(struct mm_stage1_locked stage1_locked,
 			   struct vm_locked primary_vm_locked,
 			   paddr_t mem_begin, paddr_t mem_end,
 			   const struct manifest_vm *manifest_vm,
-			   const struct memiter *cpio, struct mpool *ppool)
+			   const struct cpio *cpio, struct mpool *ppool)
 {
-#if LOG_LEVEL >= LOG_LEVEL_WARNING
 	const char *error_string = " region security state ignored for ";
-#endif
 	struct vm *vm;
 	struct vm_locked vm_locked;
 	struct vcpu_locked vcpu_locked;
@@ -523,6 +842,28 @@ static bool load_secondary(struct mm_stage1_locked stage1_locked,
 	size_t kernel_size = 0;
 	const size_t mem_size = pa_difference(mem_begin, mem_end);
 	uint32_t map_mode;
+	size_t span;
+	struct memiter kernel;
+	const void *kernel_file = NULL;
+	const char *overlapping;
+
+	/*
+	 * The VM is given all of its memory, so no file of the initrd other
+	 * than its own kernel, which may already be in place, may be stored
+	 * there.
+	 */
+	if (!string_is_empty(&manifest_vm->kernel_filename) &&
+	    cpio_get_file(cpio, &manifest_vm->kernel_filename, &kernel)) {
+		kernel_file = memiter_base(&kernel);
+	}
+
+	if (cpio_find_overlapping(cpio, ptr_from_va(va_from_pa(mem_begin)),
+				  ptr_from_va(va_from_pa(mem_end)), kernel_file,
+				  &overlapping)) {
+		dlog_error("Memory of VM \"%s\" holds \"%s\" of the initrd.\n",
+			   string_data(&manifest_vm->debug_name), overlapping);
+		return false;
+	}
 
 	/*
 	 * Load the kernel if a filename is specified in the VM manifest.
@@ -536,6 +877,14 @@ static bool load_secondary(struct mm_stage1_locked stage1_locked,
 			dlog_error("Unable to load kernel.\n");
 			return false;
 		}
+	} else if (manifest_vm->is_ffa_partition &&
+		   !manifest_vm->is_hyp_loaded) {
+		/* The package may have been loaded with a compressed image. */
+		if (!sp_pkg_decompress_image(stage1_locked, mem_begin, mem_end,
+					     ppool)) {
+			dlog_error("Unable to decompress partition image.\n");
+			return false;
+		}
 	}
 
 	has_fdt = !string_is_empty(&manifest_vm->secondary.fdt_filename);
@@ -548,6 +897,7 @@ static bool load_secondary(struct mm_stage1_locked stage1_locked,
 			mem_size - align_up(kernel_size, PAGE_SIZE);
 
 		size_t fdt_allocated_size;
+		bool patched;
 
 		if (!load_secondary_fdt(stage1_locked, mem_end, fdt_max_size,
 					manifest_vm, cpio, ppool, &fdt_addr,
@@ -562,8 +912,12 @@ static bool load_secondary(struct mm_stage1_locked stage1_locked,
 				manifest_vm, ppool);
 		}
 
-		if (!fdt_patch_mem(stage1_locked, fdt_addr, fdt_allocated_size,
-				   mem_begin, mem_end, ppool)) {
+		span = boot_timeline_begin("fdt_patch", 0);
+		patched = fdt_patch_mem(stage1_locked, fdt_addr,
+					fdt_allocated_size, mem_begin, mem_end,
+					ppool);
+		boot_timeline_end(span);
+		if (!patched) {
 			dlog_error("Unable to patch FDT.\n");
 			return false;
 		}
@@ -597,10 +951,12 @@ static bool load_secondary(struct mm_stage1_locked stage1_locked,
 		map_mode = MM_MODE_R | MM_MODE_W | MM_MODE_X;
 	}
 
-	if (!vm_identity_map(vm_locked, mem_begin, mem_end, map_mode, ppool,
-			     &secondary_entry)) {
+	span = boot_timeline_begin("stage2", vm->id);
+	ret = vm_identity_map(vm_locked, mem_begin, mem_end, map_mode, ppool,
+			      &secondary_entry);
+	boot_timeline_end(span);
+	if (!ret) {
 		dlog_error("Unable to initialise memory.\n");
-		ret = false;
 		goto out;
 	}
 
@@ -681,8 +1037,10 @@ static bool load_secondary(struct mm_stage1_locked stage1_locked,
 				}
 
 				dlog_verbose(
-					"  Memory region %#x - %#x allocated\n",
-					region_begin, region_end);
+					"  Memory region %#lx - %#lx "
+					"allocated\n",
+					pa_addr(region_begin),
+					pa_addr(region_end));
 			} else {
 				/*
 				 * Identity map memory region for both case,
@@ -836,7 +1194,7 @@ static bool load_secondary(struct mm_stage1_locked stage1_locked,
 		goto out;
 	}
 
-	dlog_info("Loaded with %u vCPUs, entry at %#x.\n",
+	dlog_info("Loaded with %u vCPUs, entry at %#lx.\n",
 		  manifest_vm->secondary.vcpu_count, pa_addr(mem_begin));
 
 	vcpu = vm_get_vcpu(vm, 0);
@@ -971,27 +1329,34 @@ static bool init_other_world_vm(struct mpool *ppool)
 }
 
 /*
- * Loads alls VMs from the manifest.
+ * Loads all VMs from the manifest, one after the other.
  */
-bool load_vms(struct mm_stage1_locked stage1_locked,
-	      const struct manifest *manifest, const struct memiter *cpio,
-	      const struct boot_params *params,
-	      struct boot_params_update *update, struct mpool *ppool)
+static bool load_manifest_vms(struct mm_stage1_locked stage1_locked,
+			      const struct manifest *manifest,
+			      const struct cpio *cpio,
+			      const struct boot_params *params,
+			      struct boot_params_update *update,
+			      struct mpool *ppool)
 {
 	struct vm *primary;
 	struct mem_range mem_ranges_available[MAX_MEM_RANGES];
 	struct vm_locked primary_vm_locked;
 	size_t i;
 	bool success = true;
+	bool loaded;
+	size_t span;
 
 	/**
 	 * Only try to load the primary VM if it is supposed to be in this
 	 * world.
 	 */
 	if (vm_id_is_current_world(HF_PRIMARY_VM_ID)) {
-		if (!load_primary(stage1_locked,
-				  &manifest->vm[HF_PRIMARY_VM_INDEX], cpio,
-				  params, ppool)) {
+		span = boot_timeline_begin("load_primary", HF_PRIMARY_VM_ID);
+		loaded = load_primary(stage1_locked,
+				      &manifest->vm[HF_PRIMARY_VM_INDEX], cpio,
+				      params, ppool);
+		boot_timeline_end(span);
+		if (!loaded) {
 			dlog_error("Unable to load primary VM.\n");
 			return false;
 		}
@@ -1031,7 +1396,7 @@ bool load_vms(struct mm_stage1_locked stage1_locked,
 		}
 
 		dlog_info("Loading VM id %#x: %s.\n", vm_id,
-			  manifest_vm->debug_name);
+			  string_data(&manifest_vm->debug_name));
 
 		mem_size = align_up(manifest_vm->secondary.mem_size, PAGE_SIZE);
 
@@ -1045,13 +1410,17 @@ bool load_vms(struct mm_stage1_locked stage1_locked,
 						params->mem_ranges_count,
 						mem_size, &secondary_mem_begin,
 						&secondary_mem_end)) {
-			dlog_error("Not enough memory (%u bytes).\n", mem_size);
+			dlog_error("Not enough memory (%lu bytes).\n",
+				   mem_size);
 			continue;
 		}
 
-		if (!load_secondary(stage1_locked, primary_vm_locked,
-				    secondary_mem_begin, secondary_mem_end,
-				    manifest_vm, cpio, ppool)) {
+		span = boot_timeline_begin("load_secondary", vm_id);
+		loaded = load_secondary(stage1_locked, primary_vm_locked,
+					secondary_mem_begin, secondary_mem_end,
+					manifest_vm, cpio, ppool);
+		boot_timeline_end(span);
+		if (!loaded) {
 			dlog_error("Unable to load VM.\n");
 			continue;
 		}
@@ -1084,3 +1453,34 @@ bool load_vms(struct mm_stage1_locked stage1_locked,
 				      mem_ranges_available,
 				      params->mem_ranges_count);
 }
+
+/*
+ * Loads all VMs from the manifest.
+ */
+bool load_vms(struct mm_stage1_locked stage1_locked,
+	      const struct manifest *manifest, const struct cpio *cpio,
+	      const struct boot_params *params,
+	      struct boot_params_update *update, struct mpool *ppool)
+{
+	size_t span = boot_timeline_begin("load_vms", 0);
+	bool ret;
+
+#if PARALLEL_LOAD
+	load_queue_start(params);
+#endif
+
+	ret = load_manifest_vms(stage1_locked, manifest, cpio, params, update,
+				ppool);
+
+#if PARALLEL_LOAD
+	/*
+	 * Whether or not loading succeeded, wait for the kernels queued so far
+	 * to have been copied, before any VM boots.
+	 */
+	load_queue_finish(stage1_locked, ppool);
+#endif
+
+	boot_timeline_end(span);
+
+	return ret;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/load_queue.h"
+
+#include "hf/arch/mm.h"
+
+#include "hf/check.h"
+#include "hf/std.h"
+
+/**
+ * Initialises the queue to be empty and open.
+ */
+void load_queue_init(struct load_queue *queue)
+{
+	memset_s(queue, sizeof(*queue), 0, sizeof(*queue));
+}
+
+/**
+ * Queues the image to be copied, in chunks which may each be copied by a
+ * different CPU. Only the boot CPU may add to the queue, before joining it.
+ *
+ * Returns false, queuing nothing, if there isn't room for all of its chunks.
+ */
+bool load_queue_add(struct load_queue *queue, void *to, const void *from,
+		    size_t size)
+{
+	uint32_t count = queue->count;
+	size_t offset;
+
+	CHECK(!queue->closed);
+
+	if (size > (size_t)(LOAD_QUEUE_CAPACITY - count) *
+			   LOAD_QUEUE_CHUNK_SIZE) {
+		return false;
+	}
+
+	for (offset = 0; offset < size; offset += LOAD_QUEUE_CHUNK_SIZE) {
+		size_t chunk_size = size - offset;
+
+		if (chunk_size > LOAD_QUEUE_CHUNK_SIZE) {
+			chunk_size = LOAD_QUEUE_CHUNK_SIZE;
+		}
+
+		queue->chunks[count++] = (struct load_queue_chunk){
+			.to = (char *)to + offset,
+			.from = (const char *)from + offset,
+			.size = chunk_size,
+		};
+	}
+
+	/* Publish the chunks only once they have all been written. */
+	__atomic_store_n(&queue->count, count, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * Claims the next chunk and copies it. Returns false if there was no chunk
+ * left to claim.
+ */
+static bool load_queue_copy_next(struct load_queue *queue)
+{
+	uint32_t count = __atomic_load_n(&queue->count, __ATOMIC_ACQUIRE);
+	uint32_t claimed = __atomic_load_n(&queue->claimed, __ATOMIC_RELAXED);
+	struct load_queue_chunk *chunk;
+
+	do {
+		if (claimed >= count) {
+			return false;
+		}
+	} while (!__atomic_compare_exchange_n(&queue->claimed, &claimed,
+					      claimed + 1, false,
+					      __ATOMIC_RELAXED,
+					      __ATOMIC_RELAXED));
+
+	chunk = &queue->chunks[claimed];
+	memcpy_s(chunk->to, chunk->size, chunk->from, chunk->size);
+
+	/*
+	 * Write the chunk back to memory, where the VM finds it when it starts
+	 * with its caches disabled.
+	 */
+	arch_mm_flush_dcache(chunk->to, chunk->size);
+
+	__atomic_fetch_add(&queue->done, 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * Copies chunks as the boot CPU adds them, until it has joined the queue and
+ * none are left. This is run by the other CPUs helping with loading.
+ */
+void load_queue_work(struct load_queue *queue)
+{
+	bool closed;
+
+	do {
+		/* The last chunks are visible once the queue is closed. */
+		closed = __atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE);
+	} while (load_queue_copy_next(queue) || !closed);
+}
+
+/**
+ * Closes the queue, copies the chunks no other CPU has claimed yet, and waits
+ * for all the chunks to have been copied by whichever CPU claimed them.
+ */
+void load_queue_join(struct load_queue *queue)
+{
+	__atomic_store_n(&queue->closed, true, __ATOMIC_RELEASE);
+
+	while (load_queue_copy_next(queue)) {
+	}
+
+	while (__atomic_load_n(&queue->done, __ATOMIC_ACQUIRE) !=
+	       queue->count) {
+	}
+}
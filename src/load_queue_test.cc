@@ -0,0 +1,179 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "hf/load_queue.h"
+}
+
+namespace
+{
+using ::testing::Eq;
+
+using struct_load_queue = struct load_queue;
+
+/**
+ * The images are copied into a single buffer, as the kernels of VMs are into
+ * memory, by the thread adding them and by threads standing in for the other
+ * CPUs.
+ */
+class load_queue : public ::testing::Test
+{
+	void SetUp() override
+	{
+		queue = std::make_unique<struct_load_queue>();
+		load_queue_init(queue.get());
+	}
+
+       protected:
+	std::unique_ptr<struct_load_queue> queue;
+
+	/** Starts the given number of threads working on the queue. */
+	std::vector<std::thread> start_helpers(int count)
+	{
+		std::vector<std::thread> helpers;
+
+		for (int i = 0; i < count; i++) {
+			helpers.emplace_back(load_queue_work, queue.get());
+		}
+
+		return helpers;
+	}
+
+	/** Joins the queue and the threads which were working on it. */
+	void join(std::vector<std::thread> &helpers)
+	{
+		load_queue_join(queue.get());
+		for (auto &helper : helpers) {
+			helper.join();
+		}
+	}
+
+	/**
+	 * Copies images of random sizes, some spanning several chunks, one
+	 * after the other into memory, with the given number of helpers, and
+	 * returns the memory.
+	 */
+	std::vector<char> load_images(const std::vector<char> &images,
+				      const std::vector<size_t> &sizes,
+				      int helper_count)
+	{
+		std::vector<char> memory(images.size(), 0);
+		std::vector<std::thread> helpers;
+		size_t offset = 0;
+
+		load_queue_init(queue.get());
+		helpers = start_helpers(helper_count);
+		for (size_t size : sizes) {
+			EXPECT_TRUE(load_queue_add(queue.get(),
+						   &memory[offset],
+						   &images[offset], size));
+			offset += size;
+
+			/* Let the helpers start before the next image. */
+			std::this_thread::yield();
+		}
+		join(helpers);
+
+		return memory;
+	}
+};
+
+/**
+ * Without any other CPU, the images are all copied when the queue is joined.
+ */
+TEST_F(load_queue, join_copies)
+{
+	std::vector<char> image(3 * LOAD_QUEUE_CHUNK_SIZE + 1, 'a');
+	std::vector<char> small = {'b', 'c', 'd'};
+	std::vector<char> memory(image.size() + small.size(), 0);
+	std::vector<std::thread> helpers;
+
+	ASSERT_TRUE(load_queue_add(queue.get(), memory.data(), image.data(),
+				   image.size()));
+	ASSERT_TRUE(load_queue_add(queue.get(), &memory[image.size()],
+				   small.data(), small.size()));
+	ASSERT_TRUE(load_queue_add(queue.get(), memory.data(), nullptr, 0));
+	EXPECT_THAT(queue->count, Eq(5));
+	EXPECT_THAT(queue->done, Eq(0));
+
+	join(helpers);
+	EXPECT_THAT(queue->done, Eq(5));
+
+	image.insert(image.end(), small.begin(), small.end());
+	EXPECT_TRUE(memory == image);
+}
+
+/**
+ * An image is queued only if all its chunks fit.
+ */
+TEST_F(load_queue, full)
+{
+	std::vector<char> image(2 * LOAD_QUEUE_CHUNK_SIZE, 'a');
+	std::vector<char> memory(image.size(), 0);
+	std::vector<std::thread> helpers;
+
+	for (int i = 0; i < LOAD_QUEUE_CAPACITY - 1; i++) {
+		ASSERT_TRUE(load_queue_add(queue.get(), memory.data(),
+					   image.data(), 1));
+	}
+
+	EXPECT_FALSE(load_queue_add(queue.get(), memory.data(), image.data(),
+				    image.size()));
+	EXPECT_THAT(queue->count, Eq(LOAD_QUEUE_CAPACITY - 1));
+
+	EXPECT_TRUE(load_queue_add(queue.get(), memory.data(), image.data(),
+				   LOAD_QUEUE_CHUNK_SIZE));
+	EXPECT_THAT(queue->count, Eq(LOAD_QUEUE_CAPACITY));
+
+	join(helpers);
+	EXPECT_THAT(queue->done, Eq(LOAD_QUEUE_CAPACITY));
+}
+
+/**
+ * However many threads help and however the copies are spread among them, the
+ * memory ends up the same as when the boot CPU copies everything itself.
+ */
+TEST_F(load_queue, deterministic_with_helpers)
+{
+	std::mt19937 rng(0);
+	std::vector<size_t> sizes;
+	std::vector<char> images;
+	size_t total = 0;
+
+	for (int i = 0; i < 16; i++) {
+		sizes.push_back(rng() % (3 * LOAD_QUEUE_CHUNK_SIZE));
+		total += sizes.back();
+	}
+
+	images.resize(total);
+	for (auto &byte : images) {
+		byte = (char)rng();
+	}
+
+	std::vector<char> serial = load_images(images, sizes, 0);
+	ASSERT_TRUE(serial == images);
+
+	for (int helper_count : {1, 2, 3, 7}) {
+		for (int run = 0; run < 4; run++) {
+			std::vector<char> parallel =
+				load_images(images, sizes, helper_count);
+
+			ASSERT_TRUE(parallel == serial)
+				<< helper_count << " helpers, run " << run;
+		}
+	}
+}
+
+} /* namespace */
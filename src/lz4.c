@@ -0,0 +1,299 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/lz4.h"
+
+#include "hf/arch/mm.h"
+
+#include "hf/check.h"
+#include "hf/std.h"
+
+/* The flags of the frame descriptor. */
+#define LZ4_FLG_VERSION_MASK 0xc0
+#define LZ4_FLG_VERSION 0x40
+#define LZ4_FLG_BLOCK_CHECKSUM 0x10
+#define LZ4_FLG_CONTENT_SIZE 0x08
+#define LZ4_FLG_RESERVED 0x02
+#define LZ4_FLG_DICT_ID 0x01
+
+/* The block maximum size byte of the frame descriptor. */
+#define LZ4_BD_MAX_SIZE_SHIFT 4
+#define LZ4_BD_MAX_SIZE_MASK 0x70
+#define LZ4_BD_RESERVED 0x8f
+
+/* The magic, descriptor, content size and checksum of the frame header. */
+#define LZ4_FRAME_HEADER_SIZE (4 + 2 + 8 + 1)
+
+/* The bit of the size of a block marking it as stored uncompressed. */
+#define LZ4_BLOCK_UNCOMPRESSED UINT32_C(0x80000000)
+
+#define LZ4_BLOCK_CHECKSUM_SIZE 4
+
+/* The least length of a match, which isn't counted in the encoded length. */
+#define LZ4_MIN_MATCH 4
+
+/* The value of a 4-bit length which continues in the following bytes. */
+#define LZ4_LENGTH_MORE 15
+
+static uint32_t lz4_read_le32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+	       ((uint32_t)p[3] << 24);
+}
+
+static uint64_t lz4_read_le64(const uint8_t *p)
+{
+	return (uint64_t)lz4_read_le32(p) |
+	       ((uint64_t)lz4_read_le32(p + 4) << 32);
+}
+
+/**
+ * Returns whether the image starts with the magic number of an LZ4 frame.
+ */
+bool lz4_is_frame(const struct memiter *image)
+{
+	return memiter_size(image) >= sizeof(uint32_t) &&
+	       lz4_read_le32(memiter_base(image)) == LZ4_FRAME_MAGIC;
+}
+
+/**
+ * Reads the header of the LZ4 frame the image consists of, to decompress its
+ * blocks from then on. Returns false if the image isn't an LZ4 frame, or one
+ * which doesn't record its content size or depends on a dictionary.
+ *
+ * The checksums of the frame aren't verified, the decompressed contents being
+ * bounded by the content size whatever the blocks hold.
+ */
+bool lz4_frame_init(struct lz4_frame *frame, const struct memiter *image)
+{
+	struct memiter it = *image;
+	struct memiter header_it;
+	const uint8_t *header;
+	uint8_t flg;
+	uint8_t bd;
+	uint64_t content_size;
+
+	if (!lz4_is_frame(image) ||
+	    !memiter_consume(&it, LZ4_FRAME_HEADER_SIZE, &header_it)) {
+		return false;
+	}
+
+	header = memiter_base(&header_it);
+	flg = header[4];
+	bd = header[5];
+
+	if ((flg & (LZ4_FLG_VERSION_MASK | LZ4_FLG_RESERVED | LZ4_FLG_DICT_ID |
+		    LZ4_FLG_CONTENT_SIZE)) !=
+		    (LZ4_FLG_VERSION | LZ4_FLG_CONTENT_SIZE) ||
+	    (bd & LZ4_BD_RESERVED) != 0) {
+		return false;
+	}
+
+	/* Maximum sizes 4 to 7 stand for blocks of 64KiB to 4MiB. */
+	bd = (bd & LZ4_BD_MAX_SIZE_MASK) >> LZ4_BD_MAX_SIZE_SHIFT;
+	if (bd < 4) {
+		return false;
+	}
+
+	content_size = lz4_read_le64(&header[6]);
+	if (content_size > RSIZE_MAX) {
+		return false;
+	}
+
+	frame->blocks = it;
+	frame->content_size = (size_t)content_size;
+	frame->decompressed = 0;
+	frame->max_block_size = (size_t)1 << (8 + 2 * bd);
+	frame->block_checksum = (flg & LZ4_FLG_BLOCK_CHECKSUM) != 0;
+
+	return true;
+}
+
+/**
+ * Adds the bytes continuing a length which didn't fit in its 4 bits of the
+ * token, up to the first which isn't 255.
+ */
+static bool lz4_read_length(const uint8_t **in, const uint8_t *in_end,
+			    size_t *length)
+{
+	uint8_t byte;
+
+	do {
+		if (*in == in_end) {
+			return false;
+		}
+
+		byte = *(*in)++;
+		*length += byte;
+	} while (byte == UINT8_MAX && *length <= RSIZE_MAX);
+
+	return *length <= RSIZE_MAX;
+}
+
+/**
+ * Decompresses the sequences of a compressed block into `dest` from offset
+ * `*out`, without writing at or beyond `limit`. Matches may refer back to the
+ * previous blocks, which were decompressed just before it. Returns false if
+ * the block is malformed.
+ */
+static bool lz4_decompress_block(const uint8_t *in, const uint8_t *in_end,
+				 uint8_t *dest, size_t *out, size_t limit)
+{
+	size_t pos = *out;
+
+	for (;;) {
+		uint8_t token;
+		size_t length;
+		size_t offset;
+
+		if (in == in_end) {
+			return false;
+		}
+
+		token = *in++;
+		length = token >> 4;
+		if (length == LZ4_LENGTH_MORE &&
+		    !lz4_read_length(&in, in_end, &length)) {
+			return false;
+		}
+
+		if (length > (size_t)(in_end - in) || length > limit - pos) {
+			return false;
+		}
+
+		memcpy_s(&dest[pos], limit - pos, in, length);
+		in += length;
+		pos += length;
+
+		/* The last sequence only has literals. */
+		if (in == in_end) {
+			break;
+		}
+
+		if (in_end - in < 2) {
+			return false;
+		}
+
+		offset = (size_t)in[0] | ((size_t)in[1] << 8);
+		in += 2;
+		if (offset == 0 || offset > pos) {
+			return false;
+		}
+
+		length = token & LZ4_LENGTH_MORE;
+		if (length == LZ4_LENGTH_MORE &&
+		    !lz4_read_length(&in, in_end, &length)) {
+			return false;
+		}
+
+		length += LZ4_MIN_MATCH;
+		if (length > limit - pos) {
+			return false;
+		}
+
+		if (offset >= length) {
+			memcpy_s(&dest[pos], limit - pos, &dest[pos - offset],
+				 length);
+			pos += length;
+		} else {
+			/* The match overlaps the bytes it repeats. */
+			for (; length > 0; length--, pos++) {
+				dest[pos] = dest[pos - offset];
+			}
+		}
+	}
+
+	*out = pos;
+	return true;
+}
+
+/**
+ * Decompresses the next block of the frame into `dest`, which must hold the
+ * frame's content size, following the blocks already decompressed. Returns
+ * LZ4_END once the end of the frame is reached with all the contents
+ * decompressed.
+ */
+enum lz4_result lz4_frame_next(struct lz4_frame *frame, void *dest)
+{
+	struct memiter block;
+	const uint8_t *in;
+	uint32_t block_size;
+	size_t limit;
+
+	if (memiter_size(&frame->blocks) < sizeof(uint32_t)) {
+		return LZ4_MALFORMED;
+	}
+
+	block_size = lz4_read_le32(memiter_base(&frame->blocks));
+	CHECK(memiter_advance(&frame->blocks, sizeof(uint32_t)));
+
+	if (block_size == 0) {
+		return frame->decompressed == frame->content_size
+			       ? LZ4_END
+			       : LZ4_MALFORMED;
+	}
+
+	if ((block_size & ~LZ4_BLOCK_UNCOMPRESSED) > frame->max_block_size ||
+	    !memiter_consume(&frame->blocks,
+			     block_size & ~LZ4_BLOCK_UNCOMPRESSED, &block) ||
+	    (frame->block_checksum &&
+	     !memiter_advance(&frame->blocks, LZ4_BLOCK_CHECKSUM_SIZE))) {
+		return LZ4_MALFORMED;
+	}
+
+	limit = frame->content_size - frame->decompressed;
+	if (limit > frame->max_block_size) {
+		limit = frame->max_block_size;
+	}
+	limit += frame->decompressed;
+
+	in = memiter_base(&block);
+	if ((block_size & LZ4_BLOCK_UNCOMPRESSED) == 0) {
+		if (!lz4_decompress_block(in, in + memiter_size(&block), dest,
+					  &frame->decompressed, limit)) {
+			return LZ4_MALFORMED;
+		}
+	} else {
+		if (memiter_size(&block) > limit - frame->decompressed) {
+			return LZ4_MALFORMED;
+		}
+
+		memcpy_s((uint8_t *)dest + frame->decompressed,
+			 limit - frame->decompressed, in, memiter_size(&block));
+		frame->decompressed += memiter_size(&block);
+	}
+
+	return LZ4_BLOCK;
+}
+
+/**
+ * Decompresses the rest of the frame into `dest`, which must hold the frame's
+ * content size. Each block is written back to memory as soon as it has been
+ * decompressed, while it is still in the cache, so that it is found there by
+ * a VM starting with its caches disabled.
+ *
+ * Returns false if the frame is malformed, having decompressed part of it.
+ */
+bool lz4_frame_decompress(struct lz4_frame *frame, void *dest)
+{
+	enum lz4_result ret;
+
+	for (;;) {
+		size_t begin = frame->decompressed;
+
+		ret = lz4_frame_next(frame, dest);
+		if (ret != LZ4_BLOCK) {
+			break;
+		}
+
+		arch_mm_flush_dcache((uint8_t *)dest + begin,
+				     frame->decompressed - begin);
+	}
+
+	return ret == LZ4_END;
+}
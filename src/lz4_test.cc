@@ -0,0 +1,401 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "hf/lz4.h"
+}
+
+namespace
+{
+using ::testing::Eq;
+
+using Bytes = std::vector<uint8_t>;
+
+constexpr uint8_t kFlgVersion = 0x40;
+constexpr uint8_t kFlgBlockChecksum = 0x10;
+constexpr uint8_t kFlgContentSize = 0x08;
+constexpr uint8_t kFlgDictId = 0x01;
+
+/* A maximum block size of 64KiB. */
+constexpr uint8_t kBd64K = 0x40;
+constexpr size_t kBlockSize64K = 64 * 1024;
+
+void append_le(Bytes &out, uint64_t value, int size)
+{
+	for (int i = 0; i < size; i++) {
+		out.push_back((uint8_t)(value >> (8 * i)));
+	}
+}
+
+void append_length(Bytes &out, size_t length)
+{
+	for (; length >= 255; length -= 255) {
+		out.push_back(255);
+	}
+	out.push_back((uint8_t)length);
+}
+
+/**
+ * Appends a sequence of literals followed by a match, or by nothing if the
+ * match length is 0.
+ */
+void append_sequence(Bytes &out, const uint8_t *literals, size_t literal_count,
+		     size_t offset, size_t match_length)
+{
+	size_t match = match_length == 0 ? 0 : match_length - 4;
+
+	out.push_back((uint8_t)((std::min<size_t>(literal_count, 15) << 4) |
+				std::min<size_t>(match, 15)));
+	if (literal_count >= 15) {
+		append_length(out, literal_count - 15);
+	}
+	out.insert(out.end(), literals, literals + literal_count);
+
+	if (match_length == 0) {
+		return;
+	}
+
+	append_le(out, offset, 2);
+	if (match >= 15) {
+		append_length(out, match - 15);
+	}
+}
+
+/**
+ * Compresses a block of `data` greedily, as the packing scripts do. Matches
+ * may refer back into the previous blocks, as far as they are in `last_seen`.
+ */
+Bytes compress_block(const Bytes &data, size_t begin, size_t end,
+		     std::unordered_map<uint32_t, size_t> &last_seen)
+{
+	Bytes out;
+	size_t anchor = begin;
+	size_t i = begin;
+
+	auto key = [&](size_t pos) {
+		return (uint32_t)data[pos] | ((uint32_t)data[pos + 1] << 8) |
+		       ((uint32_t)data[pos + 2] << 16) |
+		       ((uint32_t)data[pos + 3] << 24);
+	};
+
+	/* The last 5 bytes are literals, and the last match starts before. */
+	while (end - begin >= 12 && i < end - 12) {
+		auto found = last_seen.find(key(i));
+		size_t length = 4;
+		size_t ref;
+
+		if (found == last_seen.end() || i - found->second > 0xffff) {
+			last_seen[key(i)] = i;
+			i++;
+			continue;
+		}
+
+		ref = found->second;
+		found->second = i;
+		while (i + length < end - 5 &&
+		       data[ref + length] == data[i + length]) {
+			length++;
+		}
+
+		append_sequence(out, &data[anchor], i - anchor, i - ref,
+				length);
+		i += length;
+		anchor = i;
+	}
+
+	append_sequence(out, &data[anchor], end - anchor, 0, 0);
+
+	return out;
+}
+
+Bytes frame_header(uint64_t content_size, uint8_t flg = kFlgContentSize,
+		   uint8_t bd = kBd64K)
+{
+	Bytes out;
+
+	append_le(out, LZ4_FRAME_MAGIC, 4);
+	out.push_back(kFlgVersion | flg);
+	out.push_back(bd);
+	if (flg & kFlgContentSize) {
+		append_le(out, content_size, 8);
+	}
+	/* The header checksum, which isn't verified. */
+	out.push_back(0);
+
+	return out;
+}
+
+void append_block(Bytes &frame, const Bytes &block, bool compressed = true)
+{
+	append_le(frame, block.size() | (compressed ? 0 : 0x80000000), 4);
+	frame.insert(frame.end(), block.begin(), block.end());
+}
+
+/**
+ * Compresses the data into a frame of linked blocks of at most 64KiB, storing
+ * every `uncompressed_every`th block uncompressed.
+ */
+Bytes compress(const Bytes &data, int uncompressed_every = 0)
+{
+	std::unordered_map<uint32_t, size_t> last_seen;
+	Bytes frame = frame_header(data.size());
+	int block_count = 0;
+
+	for (size_t begin = 0; begin < data.size(); begin += kBlockSize64K) {
+		size_t end = std::min(begin + kBlockSize64K, data.size());
+
+		block_count++;
+		if (uncompressed_every &&
+		    block_count % uncompressed_every == 0) {
+			append_block(frame,
+				     Bytes(data.begin() + begin,
+					   data.begin() + end),
+				     false);
+		} else {
+			append_block(frame, compress_block(data, begin, end,
+							   last_seen));
+		}
+	}
+
+	append_le(frame, 0, 4);
+	return frame;
+}
+
+/**
+ * Decompresses the frame into a buffer of its content size, returning false if
+ * it can't be.
+ */
+bool decompress(const Bytes &frame_data, Bytes &out)
+{
+	struct lz4_frame frame;
+	struct memiter it;
+
+	memiter_init(&it, frame_data.data(), frame_data.size());
+	if (!lz4_frame_init(&frame, &it)) {
+		return false;
+	}
+
+	out.assign(frame.content_size, 0);
+	return lz4_frame_decompress(&frame, out.data());
+}
+
+TEST(lz4, is_frame)
+{
+	Bytes frame = compress({'a', 'b', 'c'});
+	Bytes other = {'M', 'Z', 0, 0, 0};
+	struct memiter it;
+
+	memiter_init(&it, frame.data(), frame.size());
+	EXPECT_TRUE(lz4_is_frame(&it));
+
+	memiter_init(&it, other.data(), other.size());
+	EXPECT_FALSE(lz4_is_frame(&it));
+
+	memiter_init(&it, frame.data(), 3);
+	EXPECT_FALSE(lz4_is_frame(&it));
+}
+
+/**
+ * A match may overlap the bytes it repeats, as it does for runs of a byte.
+ */
+TEST(lz4, overlapping_match)
+{
+	const uint8_t literals[] = {'a', 'b'};
+	Bytes block;
+	Bytes frame;
+	Bytes out;
+	Bytes expected = {'a', 'b'};
+
+	append_sequence(block, literals, 2, 2, 300);
+	append_sequence(block, literals, 1, 0, 0);
+	frame = frame_header(303);
+	append_block(frame, block);
+	append_le(frame, 0, 4);
+
+	ASSERT_TRUE(decompress(frame, out));
+	for (int i = 0; i < 150; i++) {
+		expected.push_back('a');
+		expected.push_back('b');
+	}
+	expected.push_back('a');
+	EXPECT_TRUE(out == expected);
+}
+
+/**
+ * Data compressed in several blocks, referring back to earlier blocks and with
+ * some blocks stored uncompressed, is decompressed a block at a time.
+ */
+TEST(lz4, blocks)
+{
+	std::mt19937 rng(0);
+	Bytes data;
+	Bytes out;
+
+	/* Random runs, repeated with variations, to be partly compressible. */
+	while (data.size() < 5 * kBlockSize64K + 123) {
+		if (data.size() > 1000 && rng() % 2) {
+			size_t from = rng() % (data.size() - 1000);
+
+			data.insert(data.end(), data.begin() + from,
+				    data.begin() + from + rng() % 1000);
+		} else {
+			for (int i = rng() % 100; i > 0; i--) {
+				data.push_back((uint8_t)rng());
+			}
+		}
+	}
+
+	for (int uncompressed_every : {0, 3}) {
+		Bytes frame_data = compress(data, uncompressed_every);
+		struct lz4_frame frame;
+		struct memiter it;
+		enum lz4_result ret;
+		int blocks = 0;
+
+		EXPECT_LT(frame_data.size(), data.size());
+
+		memiter_init(&it, frame_data.data(), frame_data.size());
+		ASSERT_TRUE(lz4_frame_init(&frame, &it));
+		EXPECT_THAT(frame.content_size, Eq(data.size()));
+		EXPECT_THAT(frame.max_block_size, Eq(kBlockSize64K));
+
+		out.assign(data.size(), 0);
+		while ((ret = lz4_frame_next(&frame, out.data())) ==
+		       LZ4_BLOCK) {
+			blocks++;
+			EXPECT_THAT(frame.decompressed,
+				    Eq(std::min(blocks * kBlockSize64K,
+						data.size())));
+		}
+		EXPECT_THAT(ret, Eq(LZ4_END));
+		EXPECT_THAT(blocks, Eq(6));
+		EXPECT_TRUE(out == data);
+	}
+}
+
+/**
+ * Frames with block checksums are decompressed, skipping the checksums.
+ */
+TEST(lz4, block_checksums)
+{
+	Bytes data(1000, 'x');
+	Bytes frame = frame_header(data.size(),
+				   kFlgContentSize | kFlgBlockChecksum);
+	std::unordered_map<uint32_t, size_t> last_seen;
+	Bytes out;
+
+	append_block(frame, compress_block(data, 0, data.size(), last_seen));
+	append_le(frame, 0x12345678, 4);
+	append_le(frame, 0, 4);
+
+	ASSERT_TRUE(decompress(frame, out));
+	EXPECT_TRUE(out == data);
+}
+
+/**
+ * Only frames which record their content size and don't need a dictionary
+ * are supported.
+ */
+TEST(lz4, unsupported_header)
+{
+	struct lz4_frame frame;
+	struct memiter it;
+	Bytes truncated = frame_header(0);
+
+	truncated.pop_back();
+	for (const Bytes &header : {
+		     frame_header(0, 0),
+		     frame_header(0, kFlgContentSize | kFlgDictId),
+		     frame_header(0, kFlgContentSize, 0x30),
+		     frame_header(0, kFlgContentSize, kBd64K | 0x80),
+		     frame_header(UINT64_MAX),
+		     truncated,
+	     }) {
+		memiter_init(&it, header.data(), header.size());
+		EXPECT_FALSE(lz4_frame_init(&frame, &it));
+	}
+}
+
+/**
+ * Malformed blocks are rejected without writing outside the content size.
+ */
+TEST(lz4, malformed)
+{
+	const uint8_t literals[] = {'a', 'b', 'c', 'd'};
+	Bytes block;
+	Bytes frame;
+	Bytes out;
+
+	/* Match referring back before the start of the contents. */
+	append_sequence(block, literals, 4, 5, 4);
+	append_sequence(block, literals, 1, 0, 0);
+	frame = frame_header(9);
+	append_block(frame, block);
+	append_le(frame, 0, 4);
+	EXPECT_FALSE(decompress(frame, out));
+
+	/* Offset of 0. */
+	block.clear();
+	append_sequence(block, literals, 4, 0, 0);
+	append_le(block, 0, 2);
+	frame = frame_header(8);
+	append_block(frame, block);
+	append_le(frame, 0, 4);
+	EXPECT_FALSE(decompress(frame, out));
+
+	/* Contents larger than their recorded size. */
+	block.clear();
+	append_sequence(block, literals, 4, 4, 100);
+	append_sequence(block, literals, 1, 0, 0);
+	frame = frame_header(104);
+	append_block(frame, block);
+	append_le(frame, 0, 4);
+	EXPECT_FALSE(decompress(frame, out));
+	frame = frame_header(3);
+	append_block(frame, Bytes(literals, literals + 4), false);
+	append_le(frame, 0, 4);
+	EXPECT_FALSE(decompress(frame, out));
+
+	/* Contents smaller than their recorded size. */
+	frame = frame_header(110);
+	append_block(frame, block);
+	append_le(frame, 0, 4);
+	EXPECT_FALSE(decompress(frame, out));
+
+	/* Literals running past the end of the block. */
+	block.clear();
+	append_sequence(block, literals, 4, 0, 0);
+	block[0] = 0x50;
+	frame = frame_header(5);
+	append_block(frame, block);
+	append_le(frame, 0, 4);
+	EXPECT_FALSE(decompress(frame, out));
+
+	/* Block running past the end of the frame, or missing the end mark. */
+	frame = frame_header(4);
+	append_block(frame, Bytes(literals, literals + 4), false);
+	EXPECT_FALSE(decompress(frame, out));
+	frame.resize(frame.size() - 1);
+	EXPECT_FALSE(decompress(frame, out));
+
+	/* Block larger than the maximum block size. */
+	Bytes large(kBlockSize64K + 1, 'a');
+	frame = frame_header(large.size());
+	append_block(frame, large, false);
+	append_le(frame, 0, 4);
+	EXPECT_FALSE(decompress(frame, out));
+}
+
+} /* namespace */
@@ -6,6 +6,7 @@
  * https://opensource.org/licenses/BSD-3-Clause.
  */
 
+#include "hf/arch/cpu.h"
 #include "hf/arch/plat/ffa.h"
 
 #include "hf/cpu.h"
@@ -23,6 +24,9 @@ struct vcpu *cpu_main(struct cpu *c)
 	struct vm *first_boot;
 	struct vcpu *vcpu;
 
+	/* A CPU powered on to help with loading powers off once it's done. */
+	arch_cpu_run_helper(c);
+
 	/*
 	 * This returns the PVM in the normal world and the first
 	 * booted Secure Partition in the secure world.
@@ -15,6 +15,7 @@
 #include "hf/boot_info.h"
 #include "hf/check.h"
 #include "hf/dlog.h"
+#include "hf/fdt_index.h"
 #include "hf/sp_pkg.h"
 #include "hf/static_assert.h"
 #include "hf/std.h"
@@ -44,10 +45,6 @@ static_assert((HF_OTHER_WORLD_ID > VM_ID_MAX) ||
  */
 struct allocated_fields {
 	struct interrupt_bitmap intids;
-	struct {
-		uintptr_t base;
-		uintptr_t limit;
-	} mem_regions[PARTITION_MAX_MEMORY_REGIONS * MAX_VMS];
 };
 /**
  * Calculate the number of entries in the ppool that are required to
@@ -58,8 +55,6 @@ static size_t allocated_fields_ppool_entries =
 	 MM_PPOOL_ENTRY_SIZE);
 
 static struct allocated_fields *allocated_fields;
-/* Index used the track the number of memory regions allocted. */
-static size_t allocated_mem_regions_index = 0;
 
 /**
  * Allocates memory for the allocated fields struct in the given memory
@@ -85,12 +80,50 @@ static void manifest_allocated_fields_deinit(struct mpool *ppool)
 	 * memory pool
 	 */
 	mpool_add_chunk(ppool, allocated_fields,
-			allocated_fields_ppool_entries);
-	/**
-	 * Reset the index used for tracking the number of memory regions
-	 * allocated.
-	 */
-	allocated_mem_regions_index = 0;
+			allocated_fields_ppool_entries * MM_PPOOL_ENTRY_SIZE);
+}
+
+/**
+ * Returns the size of the memory allocated from the pool for the index of the
+ * given FDT.
+ */
+static size_t manifest_fdt_index_size(const struct fdt *fdt)
+{
+	return align_up(fdt_index_size(fdt), MM_PPOOL_ENTRY_SIZE);
+}
+
+/**
+ * Indexes the nodes and properties of the FDT in memory allocated from the
+ * given pool, so that looking them up while parsing doesn't scan the FDT each
+ * time. The FDT is parsed without an index if one can't be built.
+ */
+static void manifest_fdt_index_init(struct fdt *fdt, struct mpool *ppool)
+{
+	size_t size = manifest_fdt_index_size(fdt);
+	void *buf =
+		mpool_alloc_contiguous(ppool, size / MM_PPOOL_ENTRY_SIZE, 1);
+
+	if (buf == NULL) {
+		dlog_verbose("Not enough memory to index the manifest.\n");
+		return;
+	}
+
+	if (!fdt_index_init(fdt, buf, size)) {
+		dlog_verbose("Unable to index the manifest.\n");
+		mpool_add_chunk(ppool, buf, size);
+	}
+}
+
+/**
+ * Frees the index of the FDT, if it has one, back to the given pool.
+ */
+static void manifest_fdt_index_fini(struct fdt *fdt, struct mpool *ppool)
+{
+	void *buf = fdt_index_fini(fdt);
+
+	if (buf != NULL) {
+		mpool_add_chunk(ppool, buf, manifest_fdt_index_size(fdt));
+	}
 }
 
 static inline size_t count_digits(ffa_vm_id_t vm_id)
@@ -374,12 +407,15 @@ static enum manifest_return_code parse_vm_common(const struct fdt_node *node,
 	}
 
 	if (uint32list_has_next(&smcs)) {
-		dlog_warning("%s SMC whitelist too long.\n", vm->debug_name);
+		dlog_warning("%s SMC whitelist too long.\n",
+			     string_data(&vm->debug_name));
 	}
 
 	TRY(read_bool(node, "smc_whitelist_permissive",
 		      &vm->smc_whitelist.permissive));
 
+	TRY(read_bool(node, "consistent_asids", &vm->consistent_asids));
+
 	if (vm_id != HF_PRIMARY_VM_ID) {
 		TRY(read_uint64(node, "mem_size", &vm->secondary.mem_size));
 		TRY(read_uint16(node, "vcpu_count", &vm->secondary.vcpu_count));
@@ -410,39 +446,6 @@ static enum manifest_return_code parse_vm(struct fdt_node *node,
 	return MANIFEST_SUCCESS;
 }
 
-static bool check_and_record_mem_regions(uintptr_t base_address,
-					 uint32_t page_count)
-{
-	uintptr_t limit = base_address + page_count * PAGE_SIZE;
-
-	for (size_t i = 0; i < allocated_mem_regions_index; i++) {
-		uintptr_t mem_region_base =
-			allocated_fields->mem_regions[i].base;
-		uintptr_t mem_region_limit =
-			allocated_fields->mem_regions[i].limit;
-
-		if ((base_address >= mem_region_base &&
-		     base_address < mem_region_limit) ||
-		    (limit < mem_region_limit && limit >= mem_region_base)) {
-			dlog_error(
-				"Overlapping memory regions\n"
-				"New Region %#x - %#x\n"
-				"Overlapping region %#x - %#x\n",
-				base_address, limit, mem_region_base,
-				mem_region_limit);
-			return false;
-		}
-	}
-
-	allocated_fields->mem_regions[allocated_mem_regions_index].base =
-		base_address;
-	allocated_fields->mem_regions[allocated_mem_regions_index].limit =
-		limit;
-	allocated_mem_regions_index++;
-
-	return true;
-}
-
 static enum manifest_return_code parse_ffa_memory_region_node(
 	struct fdt_node *mem_node, struct memory_region *mem_regions,
 	uint16_t *count, struct rx_tx *rxtx)
@@ -471,7 +474,7 @@ static enum manifest_return_code parse_ffa_memory_region_node(
 		TRY(read_optional_uint64(mem_node, "base-address",
 					 MANIFEST_INVALID_ADDRESS,
 					 &mem_regions[i].base_address));
-		dlog_verbose("      Base address:  %#x\n",
+		dlog_verbose("      Base address:  %#lx\n",
 			     mem_regions[i].base_address);
 
 		TRY(read_uint32(mem_node, "pages-count",
@@ -479,11 +482,6 @@ static enum manifest_return_code parse_ffa_memory_region_node(
 		dlog_verbose("      Pages_count:  %u\n",
 			     mem_regions[i].page_count);
 
-		if (!check_and_record_mem_regions(mem_regions[i].base_address,
-						  mem_regions[i].page_count)) {
-			return MANIFEST_ERROR_MEM_REGION_OVERLAP;
-		}
-
 		TRY(read_uint32(mem_node, "attributes",
 				&mem_regions[i].attributes));
 
@@ -565,7 +563,7 @@ static enum manifest_return_code parse_ffa_device_region_node(
 
 		TRY(read_uint64(dev_node, "base-address",
 				&dev_regions[i].base_address));
-		dlog_verbose("      Base address:  %#x\n",
+		dlog_verbose("      Base address:  %#lx\n",
 			     dev_regions[i].base_address);
 
 		TRY(read_uint32(dev_node, "pages-count",
@@ -827,11 +825,11 @@ enum manifest_return_code parse_ffa_manifest(struct fdt *fdt,
 
 	TRY(read_optional_uint64(&root, "load-address", 0,
 				 &vm->partition.load_addr));
-	dlog_verbose("  Load address %#x\n", vm->partition.load_addr);
+	dlog_verbose("  Load address %#lx\n", vm->partition.load_addr);
 
 	TRY(read_optional_uint64(&root, "entrypoint-offset", 0,
 				 &vm->partition.ep_offset));
-	dlog_verbose("  Entry point offset %#x\n", vm->partition.ep_offset);
+	dlog_verbose("  Entry point offset %#zx\n", vm->partition.ep_offset);
 
 	TRY(read_optional_uint32(&root, "gp-register-num",
 				 DEFAULT_BOOT_GP_REGISTER,
@@ -841,7 +839,7 @@ enum manifest_return_code parse_ffa_manifest(struct fdt *fdt,
 
 	TRY(read_optional_uint16(&root, "boot-order", DEFAULT_BOOT_ORDER,
 				 &vm->partition.boot_order));
-	dlog_verbose("  Boot order %#u\n", vm->partition.boot_order);
+	dlog_verbose("  Boot order %u\n", vm->partition.boot_order);
 
 	TRY(read_optional_uint8(&root, "xlat-granule", 0,
 				(uint8_t *)&vm->partition.xlat_granule));
@@ -1006,11 +1004,13 @@ static enum manifest_return_code parse_ffa_partition_package(
 		goto out;
 	}
 
+	manifest_fdt_index_init(&sp_fdt, ppool);
+
 	ret = parse_ffa_manifest(&sp_fdt, vm, &boot_info_node);
 	if (ret != MANIFEST_SUCCESS) {
 		dlog_error("Error parsing partition manifest: %s.\n",
 			   manifest_strerror(ret));
-		goto out;
+		goto out_index;
 	}
 
 	if (vm->partition.load_addr != load_address) {
@@ -1028,39 +1028,177 @@ static enum manifest_return_code parse_ffa_partition_package(
 		}
 	}
 
+out_index:
+	manifest_fdt_index_fini(&sp_fdt, ppool);
 out:
 	sp_pkg_deinit(stage1_locked, pkg_start, &header, ppool);
 	return ret;
 }
 
 /**
- * Parse manifest from FDT.
+ * The range of addresses of a partition's memory region, as checked for
+ * overlaps with those of the other regions.
  */
-enum manifest_return_code manifest_init(struct mm_stage1_locked stage1_locked,
-					struct manifest *manifest,
-					struct memiter *manifest_fdt,
-					struct mpool *ppool)
+struct mem_region_range {
+	uintptr_t base;
+	uintptr_t limit;
+	ffa_vm_id_t vm_id;
+	uint16_t region;
+};
+
+/**
+ * Moves the range at `root` down the max-heap of `count` ranges, ordered by
+ * base address, until it is no smaller than its children.
+ */
+static void mem_region_ranges_sift_down(struct mem_region_range *ranges,
+					size_t root, size_t count)
 {
-	struct string vm_name;
-	struct fdt fdt;
-	struct fdt_node hyp_node;
-	size_t i = 0;
-	bool found_primary_vm = false;
+	struct mem_region_range tmp;
 
-	memset_s(manifest, sizeof(*manifest), 0, sizeof(*manifest));
+	while (2 * root + 1 < count) {
+		size_t child = 2 * root + 1;
 
-	/* Allocate space in the ppool for tracking the allocated fields. */
-	if (!manifest_allocated_fields_init(ppool)) {
-		panic("Unable to allocated space for allocated fields "
-		      "struct.\n");
+		if (child + 1 < count &&
+		    ranges[child + 1].base > ranges[child].base) {
+			child++;
+		}
+
+		if (ranges[root].base >= ranges[child].base) {
+			return;
+		}
+
+		tmp = ranges[root];
+		ranges[root] = ranges[child];
+		ranges[child] = tmp;
+		root = child;
 	}
+}
 
-	if (!fdt_init_from_memiter(&fdt, manifest_fdt)) {
-		return MANIFEST_ERROR_FILE_SIZE; /* TODO */
+/**
+ * Sorts the ranges by base address, in place and without recursion.
+ */
+static void mem_region_ranges_sort(struct mem_region_range *ranges,
+				   size_t count)
+{
+	struct mem_region_range tmp;
+	size_t i;
+
+	for (i = count / 2; i > 0; i--) {
+		mem_region_ranges_sift_down(ranges, i - 1, count);
+	}
+
+	for (i = count; i > 1; i--) {
+		tmp = ranges[0];
+		ranges[0] = ranges[i - 1];
+		ranges[i - 1] = tmp;
+		mem_region_ranges_sift_down(ranges, 0, i - 1);
+	}
+}
+
+/**
+ * Checks that no two memory regions of the partitions in the manifest overlap.
+ * The regions are sorted by base address and swept once, so each region which
+ * overlaps one before it is reported along with the partitions owning both.
+ * Regions without a base address are placed by the loader and can't overlap.
+ */
+static enum manifest_return_code check_mem_regions_overlap(
+	const struct manifest *manifest, struct mpool *ppool)
+{
+	struct mem_region_range *ranges;
+	const struct mem_region_range *furthest;
+	enum manifest_return_code ret = MANIFEST_SUCCESS;
+	size_t ppool_entries;
+	size_t count = 0;
+	size_t i;
+
+	for (i = 0; i < manifest->vm_count; i++) {
+		count += manifest->vm[i].partition.mem_region_count;
+	}
+
+	if (count < 2) {
+		return MANIFEST_SUCCESS;
+	}
+
+	ppool_entries = align_up(count * sizeof(struct mem_region_range),
+				 MM_PPOOL_ENTRY_SIZE) /
+			MM_PPOOL_ENTRY_SIZE;
+	ranges = mpool_alloc_contiguous(ppool, ppool_entries, 1);
+	if (ranges == NULL) {
+		panic("Unable to allocate space for memory region ranges.\n");
 	}
 
+	count = 0;
+	for (i = 0; i < manifest->vm_count; i++) {
+		const struct partition_manifest *partition =
+			&manifest->vm[i].partition;
+
+		for (uint16_t j = 0; j < partition->mem_region_count; j++) {
+			const struct memory_region *region =
+				&partition->mem_regions[j];
+			uintptr_t base = region->base_address;
+			uintptr_t size = (uintptr_t)region->page_count *
+					 PAGE_SIZE;
+			uintptr_t limit = base + size;
+
+			if (base == MANIFEST_INVALID_ADDRESS) {
+				continue;
+			}
+
+			/* A region wrapping around overlaps all above it. */
+			if (limit < base) {
+				limit = UINTPTR_MAX;
+			}
+
+			ranges[count++] = (struct mem_region_range){
+				.base = base,
+				.limit = limit,
+				.vm_id = HF_VM_ID_OFFSET + i,
+				.region = j,
+			};
+		}
+	}
+
+	mem_region_ranges_sort(ranges, count);
+
+	/* Only the range reaching furthest can overlap the next one. */
+	furthest = &ranges[0];
+	for (i = 1; i < count; i++) {
+		if (ranges[i].base < furthest->limit) {
+			dlog_error(
+				"Overlapping memory regions\n"
+				"Region %u of partition %#x: %#lx - %#lx\n"
+				"Region %u of partition %#x: %#lx - %#lx\n",
+				ranges[i].region, ranges[i].vm_id,
+				ranges[i].base, ranges[i].limit,
+				furthest->region, furthest->vm_id,
+				furthest->base, furthest->limit);
+			ret = MANIFEST_ERROR_MEM_REGION_OVERLAP;
+		}
+
+		if (ranges[i].limit > furthest->limit) {
+			furthest = &ranges[i];
+		}
+	}
+
+	mpool_add_chunk(ppool, ranges, ppool_entries * MM_PPOOL_ENTRY_SIZE);
+
+	return ret;
+}
+
+/**
+ * Parse the hypervisor node of the manifest and the VMs it describes.
+ */
+static enum manifest_return_code parse_hypervisor_manifest(
+	struct mm_stage1_locked stage1_locked, struct manifest *manifest,
+	const struct fdt *fdt, struct mpool *ppool)
+{
+	struct string vm_name;
+	struct fdt_node hyp_node;
+	size_t i = 0;
+	bool found_primary_vm = false;
+
 	/* Find hypervisor node. */
-	if (!fdt_find_node(&fdt, "/hypervisor", &hyp_node)) {
+	if (!fdt_find_node(fdt, "/hypervisor", &hyp_node)) {
 		return MANIFEST_ERROR_NO_HYPERVISOR_FDT_NODE;
 	}
 
@@ -1123,7 +1261,37 @@ enum manifest_return_code manifest_init(struct mm_stage1_locked stage1_locked,
 		return MANIFEST_ERROR_NO_PRIMARY_VM;
 	}
 
-	return MANIFEST_SUCCESS;
+	return check_mem_regions_overlap(manifest, ppool);
+}
+
+/**
+ * Parse manifest from FDT.
+ */
+enum manifest_return_code manifest_init(struct mm_stage1_locked stage1_locked,
+					struct manifest *manifest,
+					struct memiter *manifest_fdt,
+					struct mpool *ppool)
+{
+	struct fdt fdt;
+	enum manifest_return_code ret;
+
+	memset_s(manifest, sizeof(*manifest), 0, sizeof(*manifest));
+
+	/* Allocate space in the ppool for tracking the allocated fields. */
+	if (!manifest_allocated_fields_init(ppool)) {
+		panic("Unable to allocated space for allocated fields "
+		      "struct.\n");
+	}
+
+	if (!fdt_init_from_memiter(&fdt, manifest_fdt)) {
+		return MANIFEST_ERROR_FILE_SIZE; /* TODO */
+	}
+
+	manifest_fdt_index_init(&fdt, ppool);
+	ret = parse_hypervisor_manifest(stage1_locked, manifest, &fdt, ppool);
+	manifest_fdt_index_fini(&fdt, ppool);
+
+	return ret;
 }
 
 /* Free resources used when parsing the manifest. */
@@ -7,15 +7,19 @@
  */
 
 #include <array>
+#include <chrono>
 #include <cstdio>
+#include <memory>
 #include <span>
 #include <sstream>
+#include <string>
 
 #include <gmock/gmock.h>
 
 extern "C" {
 #include "hf/arch/std.h"
 
+#include "hf/fdt_index.h"
 #include "hf/manifest.h"
 #include "hf/sp_pkg.h"
 }
@@ -207,6 +211,11 @@ class ManifestDtBuilder
 		return BooleanProperty("smc_whitelist_permissive");
 	}
 
+	ManifestDtBuilder &ConsistentAsids()
+	{
+		return BooleanProperty("consistent_asids");
+	}
+
 	ManifestDtBuilder &LoadAddress(uint64_t value)
 	{
 		return Integer64Property("load_address", value);
@@ -394,6 +403,44 @@ class manifest : public ::testing::Test
 		manifest_deinit(&ppool);
 		return ret;
 	}
+
+	/**
+	 * Parses a manifest with an FF-A partition for each of the given
+	 * partition manifests, in VMs from vm1 onwards.
+	 */
+	enum manifest_return_code ffa_manifests_from_vecs(
+		struct_manifest *m, const std::vector<std::vector<char>> &vecs)
+	{
+		struct memiter it;
+		struct mm_stage1_locked mm_stage1_locked;
+		enum manifest_return_code ret;
+		std::vector<std::unique_ptr<Partition_package>> spkgs;
+		ManifestDtBuilder builder;
+
+		builder.StartChild("hypervisor").Compatible();
+		for (size_t i = 0; i < vecs.size(); i++) {
+			spkgs.push_back(
+				std::make_unique<Partition_package>(vecs[i]));
+
+			/* clang-format off */
+			builder.StartChild("vm" + std::to_string(i + 1))
+				.DebugName("partition")
+				.FfaPartition()
+				.VcpuCount(1)
+				.MemSize(0x100000)
+				.LoadAddress((uint64_t)spkgs.back().get())
+			.EndChild();
+			/* clang-format on */
+		}
+		builder.EndChild();
+
+		std::vector<char> core_dtb = builder.Build();
+		memiter_init(&it, core_dtb.data(), core_dtb.size());
+		ret = manifest_init(mm_stage1_locked, m, &it, &ppool);
+
+		manifest_deinit(&ppool);
+		return ret;
+	}
 };
 
 TEST_F(manifest, no_hypervisor_node)
@@ -683,6 +730,7 @@ TEST_F(manifest, valid)
 				.MemSize(12345)
 				.SmcWhitelist({0x04000000, 0x30002222, 0x31445566})
 				.SmcWhitelistPermissive()
+				.ConsistentAsids()
 			.EndChild()
 		.EndChild()
 		.Build();
@@ -700,6 +748,7 @@ TEST_F(manifest, valid)
 		std::span(vm->smc_whitelist.smcs, vm->smc_whitelist.smc_count),
 		ElementsAre(0x32000000, 0x33001111));
 	ASSERT_FALSE(vm->smc_whitelist.permissive);
+	ASSERT_FALSE(vm->consistent_asids);
 
 	vm = &m.vm[1];
 	ASSERT_STREQ(string_data(&vm->debug_name), "first_secondary_vm");
@@ -710,6 +759,7 @@ TEST_F(manifest, valid)
 		std::span(vm->smc_whitelist.smcs, vm->smc_whitelist.smc_count),
 		ElementsAre(0x04000000, 0x30002222, 0x31445566));
 	ASSERT_TRUE(vm->smc_whitelist.permissive);
+	ASSERT_TRUE(vm->consistent_asids);
 
 	vm = &m.vm[2];
 	ASSERT_STREQ(string_data(&vm->debug_name), "second_secondary_vm");
@@ -721,6 +771,7 @@ TEST_F(manifest, valid)
 		std::span(vm->smc_whitelist.smcs, vm->smc_whitelist.smc_count),
 		IsEmpty());
 	ASSERT_FALSE(vm->smc_whitelist.permissive);
+	ASSERT_FALSE(vm->consistent_asids);
 }
 
 TEST_F(manifest, ffa_not_compatible)
@@ -1357,4 +1408,232 @@ TEST_F(manifest, ffa_valid)
 	ASSERT_EQ(m.vm[0].partition.dev_regions[1].attributes, (8 | 1));
 }
 
+/**
+ * Builds a hypervisor manifest with the given number of partitions, each with
+ * the given number of memory regions.
+ */
+static std::vector<char> gen_many_partitions_dtb(int partitions, int regions)
+{
+	ManifestDtBuilder builder;
+
+	builder.StartChild("hypervisor").Compatible();
+	for (int i = 1; i <= partitions; i++) {
+		/* clang-format off */
+		builder.StartChild("vm" + std::to_string(i))
+			.DebugName("partition")
+			.FfaPartition()
+			.VcpuCount(8)
+			.MemSize(0x100000)
+			.LoadAddress(0x80000000 + i * 0x100000)
+			.StartChild("memory-regions")
+				.Compatible({ "arm,ffa-manifest-memory-regions" });
+		/* clang-format on */
+		for (int j = 0; j < regions; j++) {
+			std::string base_address = "<" +
+				std::to_string(i * 0x100000 + j * 0x1000) + ">";
+
+			/* clang-format off */
+			builder.StartChild("region" + std::to_string(j))
+				.Description("region")
+				.Property("base-address", base_address)
+				.Property("pages-count", "<1>")
+				.Property("attributes", "<3>")
+			.EndChild();
+			/* clang-format on */
+		}
+		builder.EndChild().EndChild();
+	}
+	builder.EndChild();
+
+	return builder.Build();
+}
+
+/**
+ * Finds the named child of the node, as the manifest parser does.
+ */
+static bool find_child(struct fdt_node *node, const std::string &name)
+{
+	struct string str;
+	struct memiter it;
+
+	memiter_init(&it, name.c_str(), name.size() + 1);
+	return string_init(&str, &it) == STRING_SUCCESS &&
+	       fdt_find_child(node, &str);
+}
+
+/**
+ * Looks up the nodes and properties of each partition in the way the manifest
+ * parser does, returning the sum of the numbers read.
+ */
+static uint64_t read_many_partitions(const struct fdt *fdt, int partitions)
+{
+	struct fdt_node hyp_node;
+	uint64_t sum = 0;
+
+	EXPECT_TRUE(fdt_find_node(fdt, "/hypervisor", &hyp_node));
+	for (int i = 1; i <= partitions + 1; i++) {
+		struct fdt_node vm_node = hyp_node;
+		struct fdt_node region_node;
+		struct memiter data;
+		uint64_t value;
+
+		/* The parser stops at the first partition which is missing. */
+		if (!find_child(&vm_node, "vm" + std::to_string(i))) {
+			EXPECT_THAT(i, Eq(partitions + 1));
+			break;
+		}
+
+		EXPECT_TRUE(fdt_read_property(&vm_node, "is_ffa_partition",
+					      &data));
+		EXPECT_TRUE(fdt_read_property(&vm_node, "debug_name", &data));
+		EXPECT_FALSE(fdt_read_property(&vm_node, "hyp_loaded", &data));
+		for (const char *name :
+		     {"vcpu_count", "mem_size", "load_address"}) {
+			EXPECT_TRUE(fdt_read_number(&vm_node, name, &value));
+			sum += value;
+		}
+
+		region_node = vm_node;
+		EXPECT_TRUE(find_child(&region_node, "memory-regions"));
+		EXPECT_TRUE(fdt_is_compatible(
+			&region_node, "arm,ffa-manifest-memory-regions"));
+		EXPECT_TRUE(fdt_first_child(&region_node));
+		do {
+			EXPECT_TRUE(fdt_read_property(&region_node,
+						      "description", &data));
+			for (const char *name :
+			     {"base-address", "pages-count", "attributes"}) {
+				EXPECT_TRUE(fdt_read_number(&region_node, name,
+							    &value));
+				sum += value;
+			}
+		} while (fdt_next_sibling(&region_node));
+	}
+
+	return sum;
+}
+
+/**
+ * Times looking up every node and property of a 64 partition manifest with and
+ * without the FDT index, which must both find the same values.
+ */
+TEST_F(manifest, fdt_index_benchmark)
+{
+	constexpr int partitions = 64;
+	constexpr int regions = 8;
+	constexpr int runs = 10;
+	std::vector<char> dtb = gen_many_partitions_dtb(partitions, regions);
+	struct fdt fdt;
+	uint64_t expected;
+	uint64_t sum;
+
+	ASSERT_TRUE(fdt_init_from_ptr(&fdt, dtb.data(), dtb.size()));
+	expected = read_many_partitions(&fdt, partitions);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int run = 0; run < runs; run++) {
+		sum = read_many_partitions(&fdt, partitions);
+	}
+	auto unindexed = std::chrono::steady_clock::now() - start;
+	EXPECT_THAT(sum, Eq(expected));
+
+	size_t size = fdt_index_size(&fdt);
+	std::unique_ptr<uint64_t[]> buf =
+		std::make_unique<uint64_t[]>(size / sizeof(uint64_t) + 1);
+
+	start = std::chrono::steady_clock::now();
+	for (int run = 0; run < runs; run++) {
+		ASSERT_TRUE(fdt_index_init(&fdt, buf.get(), size));
+		sum = read_many_partitions(&fdt, partitions);
+		fdt_index_fini(&fdt);
+	}
+	auto indexed = std::chrono::steady_clock::now() - start;
+	EXPECT_THAT(sum, Eq(expected));
+
+	std::cout << "Lookups of a " << partitions << " partition manifest: "
+		  << std::chrono::duration_cast<std::chrono::microseconds>(
+			     unindexed)
+				     .count() /
+			     runs
+		  << "us without index, "
+		  << std::chrono::duration_cast<std::chrono::microseconds>(
+			     indexed)
+				     .count() /
+			     runs
+		  << "us with index (" << size << " bytes)" << std::endl;
+}
+
+/**
+ * Generates the manifest of a partition with the maximum number of memory
+ * regions, of a page each at `stride` pages apart from `base`, except that
+ * the first region has `first_pages` pages.
+ */
+static std::vector<char> gen_mem_regions_dtb(uint64_t base, uint64_t stride,
+					     uint32_t first_pages)
+{
+	ManifestDtBuilder builder;
+
+	/* clang-format off */
+	builder.FfaValidManifest()
+		.StartChild("memory-regions")
+			.Compatible({ "arm,ffa-manifest-memory-regions" });
+	/* clang-format on */
+	for (int i = 0; i < PARTITION_MAX_MEMORY_REGIONS; i++) {
+		uint32_t pages = i == 0 ? first_pages : 1;
+
+		/* clang-format off */
+		builder.StartChild("region" + std::to_string(i))
+			.Description("region")
+			.Property("base-address", "<" + std::to_string(
+				base + i * stride * PAGE_SIZE) + ">")
+			.Property("pages-count", "<" + std::to_string(pages) +
+				">")
+			.Property("attributes", "<3>")
+		.EndChild();
+		/* clang-format on */
+	}
+	builder.EndChild();
+
+	return builder.Build();
+}
+
+/**
+ * The memory regions of all partitions are checked against each other, however
+ * many there are and in whichever order they are declared.
+ */
+TEST_F(manifest, ffa_mem_regions_overlap_many_partitions)
+{
+	struct_manifest m;
+	std::vector<std::vector<char>> vecs;
+	uint64_t base = 0x80000000;
+
+	/*
+	 * Interleave the regions of the partitions, so that those of each
+	 * partition are between those of the others and each region is
+	 * adjacent to two others.
+	 */
+	for (int i = 0; i < MAX_VMS; i++) {
+		vecs.push_back(gen_mem_regions_dtb(
+			base + (MAX_VMS - 1 - i) * PAGE_SIZE, MAX_VMS, 1));
+	}
+	ASSERT_EQ(ffa_manifests_from_vecs(&m, vecs), MANIFEST_SUCCESS);
+	ASSERT_EQ(m.vm_count, MAX_VMS);
+	for (int i = 0; i < MAX_VMS; i++) {
+		ASSERT_EQ(m.vm[i].partition.mem_region_count,
+			  PARTITION_MAX_MEMORY_REGIONS);
+	}
+
+	/* Grow the first region of the last partition into the next one. */
+	vecs.back() = gen_mem_regions_dtb(base, MAX_VMS, 2);
+	ASSERT_EQ(ffa_manifests_from_vecs(&m, vecs),
+		  MANIFEST_ERROR_MEM_REGION_OVERLAP);
+
+	/* Make it overlap the regions of every other partition. */
+	vecs.back() = gen_mem_regions_dtb(base, MAX_VMS,
+					  PARTITION_MAX_MEMORY_REGIONS *
+						  MAX_VMS);
+	ASSERT_EQ(ffa_manifests_from_vecs(&m, vecs),
+		  MANIFEST_ERROR_MEM_REGION_OVERLAP);
+}
+
 } /* namespace */
@@ -29,6 +29,7 @@ noreturn void panic(const char *fmt, ...)
 	va_end(args);
 
 	dlog("\n");
+	dlog_binary_drain();
 
 	abort();
 }
@@ -15,6 +15,7 @@
 #include "hf/addr.h"
 #include "hf/check.h"
 #include "hf/dlog.h"
+#include "hf/lz4.h"
 #include "hf/std.h"
 
 /**
@@ -177,3 +178,93 @@ void sp_pkg_deinit(struct mm_stage1_locked stage1_locked, vaddr_t pkg_start,
 	CHECK(mm_unmap(stage1_locked, pa_from_va(pkg_start), to_unmap_end,
 		       ppool));
 }
+
+/**
+ * Decompresses the image of the package loaded at `pkg_start`, if it was
+ * packed compressed, to where the image is expected. The image is decompressed
+ * over its compressed form, so that is first moved to the end of the
+ * partition's memory, which ends at `mem_end` and must hold both. Returns false
+ * if the image is compressed but can't be decompressed.
+ */
+bool sp_pkg_decompress_image(struct mm_stage1_locked stage1_locked,
+			     paddr_t pkg_start, paddr_t mem_end,
+			     struct mpool *ppool)
+{
+	struct sp_pkg_header header;
+	paddr_t img_begin;
+	size_t mem_size;
+	struct memiter image;
+	struct lz4_frame frame;
+	uint8_t *ptr;
+	uint8_t *compressed;
+	size_t magic_size;
+	bool is_frame;
+	bool ret = false;
+
+	if (!sp_pkg_init(stage1_locked, pkg_start, &header, ppool)) {
+		return false;
+	}
+	sp_pkg_deinit(stage1_locked, va_from_pa(pkg_start), &header, ppool);
+
+	img_begin = pa_add(pkg_start, header.img_offset);
+	if (pa_addr(mem_end) < pa_addr(img_begin) ||
+	    pa_difference(img_begin, mem_end) < header.img_size ||
+	    header.img_size > RSIZE_MAX) {
+		dlog_error("SP pkg image doesn't fit in the partition.\n");
+		return false;
+	}
+	mem_size = pa_difference(img_begin, mem_end);
+
+	/*
+	 * Most images aren't compressed, so only map the start of the image
+	 * to look for the LZ4 magic before mapping all of the memory.
+	 */
+	magic_size = header.img_size < PAGE_SIZE ? header.img_size : PAGE_SIZE;
+	ptr = mm_identity_map(stage1_locked, img_begin,
+			      pa_add(img_begin, magic_size), MM_MODE_R, ppool);
+	CHECK(ptr != NULL);
+
+	memiter_init(&image, ptr, magic_size);
+	is_frame = lz4_is_frame(&image);
+	CHECK(mm_unmap(stage1_locked, img_begin, pa_add(img_begin, magic_size),
+		       ppool));
+
+	if (!is_frame) {
+		return true;
+	}
+
+	ptr = mm_identity_map(stage1_locked, img_begin, mem_end,
+			      MM_MODE_R | MM_MODE_W, ppool);
+	CHECK(ptr != NULL);
+
+	memiter_init(&image, ptr, header.img_size);
+	if (!lz4_frame_init(&frame, &image)) {
+		dlog_error("Unsupported LZ4 frame in SP pkg image.\n");
+		goto out;
+	}
+
+	if (frame.content_size > mem_size - header.img_size) {
+		dlog_error(
+			"Partition memory can't hold both its compressed and "
+			"decompressed image.\n");
+		goto out;
+	}
+
+	compressed = ptr + mem_size - header.img_size;
+	memmove_s(compressed, header.img_size, ptr, header.img_size);
+	memiter_init(&image, compressed, header.img_size);
+	CHECK(lz4_frame_init(&frame, &image));
+
+	dlog_verbose("Decompressing SP pkg image of %u bytes to %zu bytes.\n",
+		     header.img_size, frame.content_size);
+
+	ret = lz4_frame_decompress(&frame, ptr);
+	if (!ret) {
+		dlog_error("Malformed LZ4 frame in SP pkg image.\n");
+	}
+
+out:
+	CHECK(mm_unmap(stage1_locked, img_begin, mem_end, ppool));
+
+	return ret;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "hf/timer_queue.h"
+
+#include "hf/check.h"
+
+/**
+ * Initialises the given queue to be empty.
+ */
+void timer_queue_init(struct timer_queue *queue)
+{
+	sl_init(&queue->lock);
+	queue->count = 0;
+}
+
+/**
+ * Stores the entry at the given index of the heap.
+ */
+static void timer_queue_place(struct timer_queue *queue, uint32_t index,
+			      struct timer_queue_entry *entry)
+{
+	queue->heap[index] = entry;
+	__atomic_store_n(&entry->position, index + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Moves the entry at the given index towards the root until its parent expires
+ * no later than it.
+ */
+static void timer_queue_sift_up(struct timer_queue *queue, uint32_t index)
+{
+	struct timer_queue_entry *entry = queue->heap[index];
+
+	while (index > 0) {
+		uint32_t parent = (index - 1) / 2;
+
+		if (queue->heap[parent]->deadline_ns <= entry->deadline_ns) {
+			break;
+		}
+
+		timer_queue_place(queue, index, queue->heap[parent]);
+		index = parent;
+	}
+
+	timer_queue_place(queue, index, entry);
+}
+
+/**
+ * Moves the entry at the given index towards the leaves until its children
+ * expire no earlier than it.
+ */
+static void timer_queue_sift_down(struct timer_queue *queue, uint32_t index)
+{
+	struct timer_queue_entry *entry = queue->heap[index];
+
+	for (;;) {
+		uint32_t child = 2 * index + 1;
+
+		if (child >= queue->count) {
+			break;
+		}
+
+		if (child + 1 < queue->count &&
+		    queue->heap[child + 1]->deadline_ns <
+			    queue->heap[child]->deadline_ns) {
+			child++;
+		}
+
+		if (entry->deadline_ns <= queue->heap[child]->deadline_ns) {
+			break;
+		}
+
+		timer_queue_place(queue, index, queue->heap[child]);
+		index = child;
+	}
+
+	timer_queue_place(queue, index, entry);
+}
+
+/**
+ * Removes the entry at the given index, the queue's lock must be held.
+ */
+static void timer_queue_remove_at(struct timer_queue *queue, uint32_t index)
+{
+	struct timer_queue_entry *last;
+
+	__atomic_store_n(&queue->heap[index]->position, 0, __ATOMIC_RELAXED);
+	queue->count--;
+	if (index == queue->count) {
+		return;
+	}
+
+	/* Fill the hole with the last entry and restore the heap order. */
+	last = queue->heap[queue->count];
+	timer_queue_place(queue, index, last);
+	timer_queue_sift_up(queue, index);
+	timer_queue_sift_down(queue, last->position - 1);
+}
+
+/**
+ * Queues the entry to expire at the given deadline, or moves it to the given
+ * deadline if it is already queued.
+ */
+void timer_queue_update(struct timer_queue *queue,
+			struct timer_queue_entry *entry, uint64_t deadline_ns)
+{
+	uint32_t index;
+
+	sl_lock(&queue->lock);
+
+	entry->deadline_ns = deadline_ns;
+	if (timer_queue_entry_is_queued(entry)) {
+		index = entry->position - 1;
+	} else {
+		CHECK(queue->count < TIMER_QUEUE_CAPACITY);
+		index = queue->count++;
+		timer_queue_place(queue, index, entry);
+	}
+
+	timer_queue_sift_up(queue, index);
+	timer_queue_sift_down(queue, entry->position - 1);
+
+	sl_unlock(&queue->lock);
+}
+
+/**
+ * Removes the entry from the queue, if it is queued.
+ *
+ * The caller must serialise queueing the entry with removing it, e.g. by
+ * holding the lock of the object the entry belongs to, so an entry found not to
+ * be queued stays so and the queue's lock needn't be taken. It may still be
+ * concurrently popped on expiry, which is why it is checked again under the
+ * lock.
+ */
+void timer_queue_remove(struct timer_queue *queue,
+			struct timer_queue_entry *entry)
+{
+	if (!timer_queue_entry_is_queued(entry)) {
+		return;
+	}
+
+	sl_lock(&queue->lock);
+
+	if (timer_queue_entry_is_queued(entry)) {
+		timer_queue_remove_at(queue, entry->position - 1);
+	}
+
+	sl_unlock(&queue->lock);
+}
+
+/**
+ * Returns the earliest deadline queued, or TIMER_QUEUE_NO_DEADLINE if the queue
+ * is empty.
+ */
+uint64_t timer_queue_next_deadline(struct timer_queue *queue)
+{
+	uint64_t deadline_ns = TIMER_QUEUE_NO_DEADLINE;
+
+	sl_lock(&queue->lock);
+
+	if (queue->count > 0) {
+		deadline_ns = queue->heap[0]->deadline_ns;
+	}
+
+	sl_unlock(&queue->lock);
+
+	return deadline_ns;
+}
+
+/**
+ * Removes and returns the entry with the earliest deadline if it has expired by
+ * the given time, or NULL if none has.
+ */
+struct timer_queue_entry *timer_queue_pop_expired(struct timer_queue *queue,
+						  uint64_t now_ns)
+{
+	struct timer_queue_entry *entry = NULL;
+
+	sl_lock(&queue->lock);
+
+	if (queue->count > 0 && queue->heap[0]->deadline_ns <= now_ns) {
+		entry = queue->heap[0];
+		timer_queue_remove_at(queue, 0);
+	}
+
+	sl_unlock(&queue->lock);
+
+	return entry;
+}
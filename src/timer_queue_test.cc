@@ -0,0 +1,190 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "hf/timer_queue.h"
+}
+
+namespace
+{
+using ::testing::Eq;
+using ::testing::IsNull;
+
+using struct_timer_queue = struct timer_queue;
+using struct_timer_queue_entry = struct timer_queue_entry;
+
+/**
+ * The queue is driven by a fake clock, advanced explicitly by the tests.
+ */
+class timer_queue : public ::testing::Test
+{
+	void SetUp() override
+	{
+		queue = std::make_unique<struct_timer_queue>();
+		timer_queue_init(queue.get());
+		now_ns = 0;
+	}
+
+       protected:
+	std::unique_ptr<struct_timer_queue> queue;
+	uint64_t now_ns;
+
+	/** Queues the entry to expire after the given time from now. */
+	void arm(struct_timer_queue_entry *entry, uint64_t delay_ns)
+	{
+		timer_queue_update(queue.get(), entry, now_ns + delay_ns);
+	}
+
+	/** Advances the fake clock and returns the entries which expired. */
+	std::vector<struct_timer_queue_entry *> advance(uint64_t delay_ns)
+	{
+		std::vector<struct_timer_queue_entry *> expired;
+		struct_timer_queue_entry *entry;
+
+		now_ns += delay_ns;
+		while ((entry = timer_queue_pop_expired(queue.get(), now_ns)) !=
+		       nullptr) {
+			expired.push_back(entry);
+		}
+
+		return expired;
+	}
+};
+
+/**
+ * An empty queue has no deadline and nothing ever expires.
+ */
+TEST_F(timer_queue, empty)
+{
+	EXPECT_THAT(timer_queue_next_deadline(queue.get()),
+		    Eq(TIMER_QUEUE_NO_DEADLINE));
+	EXPECT_THAT(timer_queue_pop_expired(queue.get(), UINT64_MAX),
+		    IsNull());
+}
+
+/**
+ * Entries expire in order of deadline once the clock reaches them, and the
+ * next deadline is always the earliest one still queued.
+ */
+TEST_F(timer_queue, expire_in_deadline_order)
+{
+	struct_timer_queue_entry a = {};
+	struct_timer_queue_entry b = {};
+	struct_timer_queue_entry c = {};
+
+	arm(&a, 300);
+	arm(&b, 100);
+	arm(&c, 200);
+	EXPECT_THAT(timer_queue_next_deadline(queue.get()), Eq(100));
+
+	EXPECT_THAT(advance(99).size(), Eq(0));
+	EXPECT_THAT(advance(1),
+		    Eq(std::vector<struct_timer_queue_entry *>{&b}));
+	EXPECT_FALSE(timer_queue_entry_is_queued(&b));
+	EXPECT_THAT(timer_queue_next_deadline(queue.get()), Eq(200));
+
+	EXPECT_THAT(advance(500),
+		    Eq(std::vector<struct_timer_queue_entry *>{&c, &a}));
+	EXPECT_THAT(timer_queue_next_deadline(queue.get()),
+		    Eq(TIMER_QUEUE_NO_DEADLINE));
+}
+
+/**
+ * Updating a queued entry moves its deadline rather than queuing it twice.
+ */
+TEST_F(timer_queue, update_moves_deadline)
+{
+	struct_timer_queue_entry a = {};
+	struct_timer_queue_entry b = {};
+
+	arm(&a, 100);
+	arm(&b, 200);
+
+	/* Postpone the earliest past the other. */
+	arm(&a, 300);
+	EXPECT_THAT(timer_queue_next_deadline(queue.get()), Eq(200));
+
+	/* Bring it forward again. */
+	arm(&a, 50);
+	EXPECT_THAT(timer_queue_next_deadline(queue.get()), Eq(50));
+
+	EXPECT_THAT(advance(1000),
+		    Eq(std::vector<struct_timer_queue_entry *>{&a, &b}));
+}
+
+/**
+ * Removed entries never expire, and removing an entry which isn't queued has
+ * no effect.
+ */
+TEST_F(timer_queue, remove)
+{
+	struct_timer_queue_entry a = {};
+	struct_timer_queue_entry b = {};
+	struct_timer_queue_entry c = {};
+
+	arm(&a, 100);
+	arm(&b, 200);
+	arm(&c, 300);
+
+	timer_queue_remove(queue.get(), &a);
+	timer_queue_remove(queue.get(), &a);
+	EXPECT_FALSE(timer_queue_entry_is_queued(&a));
+	EXPECT_THAT(timer_queue_next_deadline(queue.get()), Eq(200));
+
+	timer_queue_remove(queue.get(), &c);
+	EXPECT_THAT(advance(1000),
+		    Eq(std::vector<struct_timer_queue_entry *>{&b}));
+}
+
+/**
+ * A full queue of entries with random deadlines, updated and removed at random,
+ * expires in the same order as a sorted copy of the deadlines.
+ */
+TEST_F(timer_queue, random_deadlines)
+{
+	std::vector<struct_timer_queue_entry> entries(TIMER_QUEUE_CAPACITY);
+	std::vector<uint64_t> expected;
+	std::mt19937 rng(0);
+
+	for (auto &entry : entries) {
+		entry = {};
+		arm(&entry, 1 + rng() % 10000);
+	}
+
+	for (size_t i = 0; i < entries.size(); i += 3) {
+		arm(&entries[i], 1 + rng() % 10000);
+	}
+
+	for (size_t i = 1; i < entries.size(); i += 5) {
+		timer_queue_remove(queue.get(), &entries[i]);
+	}
+
+	for (auto &entry : entries) {
+		if (timer_queue_entry_is_queued(&entry)) {
+			expected.push_back(entry.deadline_ns);
+		}
+	}
+	std::sort(expected.begin(), expected.end());
+
+	for (auto *entry : advance(10000)) {
+		ASSERT_FALSE(expected.empty());
+		EXPECT_THAT(entry->deadline_ns, Eq(expected.front()));
+		expected.erase(expected.begin());
+	}
+
+	EXPECT_TRUE(expected.empty());
+}
+
+} /* namespace */
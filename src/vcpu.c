@@ -66,6 +66,9 @@ void vcpu_init(struct vcpu *vcpu, struct vm *vm)
 	vcpu->state = VCPU_STATE_OFF;
 	vcpu->direct_request_origin_vm_id = HF_INVALID_VM_ID;
 	vcpu->present_action_ns_interrupts = NS_ACTION_INVALID;
+	memset_s(vcpu->interrupts.priority, sizeof(vcpu->interrupts.priority),
+		 VIRT_INTERRUPT_DEFAULT_PRIORITY,
+		 sizeof(vcpu->interrupts.priority));
 }
 
 /**
@@ -184,11 +187,11 @@ bool vcpu_handle_page_fault(const struct vcpu *current,
 
 	if (!resume) {
 		dlog_warning(
-			"Stage-%d page fault: pc=%#x, vmid=%#x, vcpu=%u, "
-			"vaddr=%#x, ipaddr=%#x, mode=%#x %#x\n",
-			current->vm->el0_partition ? 1 : 2, f->pc, vm->id,
-			vcpu_index(current), f->vaddr, f->ipaddr, f->mode,
-			mode);
+			"Stage-%d page fault: pc=%#lx, vmid=%#x, vcpu=%u, "
+			"vaddr=%#lx, ipaddr=%#lx, mode=%#x %#x\n",
+			current->vm->el0_partition ? 1 : 2, va_addr(f->pc),
+			vm->id, vcpu_index(current), va_addr(f->vaddr),
+			ipa_addr(f->ipaddr), f->mode, mode);
 	}
 
 	return resume;
@@ -208,3 +211,395 @@ void vcpu_set_phys_core_idx(struct vcpu *vcpu)
 	arch_regs_set_gp_reg(&vcpu->regs, cpu_index(vcpu->cpu),
 			     PHYS_CORE_IDX_GP_REG);
 }
+
+/**
+ * Returns the amount by which `enabled_and_pending_count` changes for the given
+ * interrupt, according to its type.
+ */
+static uint64_t vcpu_virt_interrupt_count_unit(struct interrupts *interrupts,
+					       uint32_t intid)
+{
+	return vcpu_virt_interrupt_get_type(interrupts, intid) ==
+			       INTERRUPT_TYPE_IRQ
+		       ? UINT64_C(1)
+		       : UINT64_C(1) << INTERRUPT_COUNT_FIQ_SHIFT;
+}
+
+/** Returns the priority level of the given interrupt. */
+static uint32_t vcpu_virt_interrupt_level(struct interrupts *interrupts,
+					  uint32_t intid)
+{
+	return vcpu_virt_interrupt_get_priority(interrupts, intid) >>
+	       VIRT_INTERRUPT_PRIORITY_LEVEL_SHIFT;
+}
+
+/**
+ * Clears the bit of the given priority level in the summary of levels, unless
+ * an interrupt of the level is still enabled and pending.
+ */
+static void vcpu_virt_interrupt_clear_level(struct interrupts *interrupts,
+					    uint32_t level)
+{
+	uint32_t *levels = &interrupts->enabled_and_pending_levels;
+
+	__atomic_fetch_and(levels, ~(UINT32_C(1) << level), __ATOMIC_ACQ_REL);
+
+	/* A concurrent injection may have made the level non-empty again. */
+	for (uint32_t i = 0; i < INTERRUPT_SUMMARY_L1_WORDS; i++) {
+		uint64_t *l1 = &interrupts->enabled_and_pending_l1[level][i];
+
+		if (__atomic_load_n(l1, __ATOMIC_ACQUIRE) != 0U) {
+			__atomic_fetch_or(levels, UINT32_C(1) << level,
+					  __ATOMIC_RELEASE);
+			return;
+		}
+	}
+}
+
+/**
+ * Sets the bit of the given interrupt in the summary of the given priority
+ * level, counting it if it wasn't set.
+ *
+ * Returns the total number of enabled and pending interrupts if this call set
+ * the bit, or 0 otherwise.
+ */
+static uint32_t vcpu_virt_interrupt_summary_set(struct interrupts *interrupts,
+						uint32_t intid, uint32_t level)
+{
+	uint32_t index = intid / INTERRUPT_SUMMARY_BITS;
+	uint64_t bit = UINT64_C(1) << (intid % INTERRUPT_SUMMARY_BITS);
+	uint64_t l1_bit = UINT64_C(1) << (index % INTERRUPT_SUMMARY_BITS);
+	uint32_t l1_index = index / INTERRUPT_SUMMARY_BITS;
+	uint64_t *word = &interrupts->enabled_and_pending[level][index];
+	uint64_t *l1 = &interrupts->enabled_and_pending_l1[level][l1_index];
+	uint64_t old;
+	uint64_t new_count;
+
+	old = __atomic_fetch_or(word, bit, __ATOMIC_ACQ_REL);
+	__atomic_fetch_or(l1, l1_bit, __ATOMIC_RELEASE);
+	__atomic_fetch_or(&interrupts->enabled_and_pending_levels,
+			  UINT32_C(1) << level, __ATOMIC_RELEASE);
+	if ((old & bit) != 0U) {
+		return 0;
+	}
+
+	new_count = __atomic_add_fetch(
+		&interrupts->enabled_and_pending_count,
+		vcpu_virt_interrupt_count_unit(interrupts, intid),
+		__ATOMIC_ACQ_REL);
+
+	return (uint32_t)new_count +
+	       (uint32_t)(new_count >> INTERRUPT_COUNT_FIQ_SHIFT);
+}
+
+/**
+ * Clears the bit of the given interrupt in the summary of the given priority
+ * level, uncounting it if it was set.
+ */
+static void vcpu_virt_interrupt_summary_clear(struct interrupts *interrupts,
+					      uint32_t intid, uint32_t level)
+{
+	uint32_t index = intid / INTERRUPT_SUMMARY_BITS;
+	uint64_t bit = UINT64_C(1) << (intid % INTERRUPT_SUMMARY_BITS);
+	uint64_t l1_bit = UINT64_C(1) << (index % INTERRUPT_SUMMARY_BITS);
+	uint32_t l1_index = index / INTERRUPT_SUMMARY_BITS;
+	uint64_t *word = &interrupts->enabled_and_pending[level][index];
+	uint64_t *l1 = &interrupts->enabled_and_pending_l1[level][l1_index];
+	uint64_t old;
+
+	old = __atomic_fetch_and(word, ~bit, __ATOMIC_ACQ_REL);
+	if ((old & bit) != 0U) {
+		__atomic_fetch_sub(
+			&interrupts->enabled_and_pending_count,
+			vcpu_virt_interrupt_count_unit(interrupts, intid),
+			__ATOMIC_ACQ_REL);
+	}
+
+	if ((old & ~bit) == 0U) {
+		/*
+		 * The word may have been made non-zero again by a concurrent
+		 * injection before the l1 bit is cleared, in which case it is
+		 * set back.
+		 */
+		old = __atomic_fetch_and(l1, ~l1_bit, __ATOMIC_ACQ_REL);
+		if (__atomic_load_n(word, __ATOMIC_ACQUIRE) != 0U) {
+			__atomic_fetch_or(l1, l1_bit, __ATOMIC_RELEASE);
+		} else if ((old & ~l1_bit) == 0U) {
+			vcpu_virt_interrupt_clear_level(interrupts, level);
+		}
+	}
+}
+
+/**
+ * Updates the enabled and pending summary and counters for the given interrupt
+ * ID, to be called whenever its enabled or pending state changes.
+ *
+ * The enabled bit and the priority are only changed with the vCPU lock held,
+ * but the pending bit can be set concurrently by other CPUs injecting
+ * interrupts. Only the caller which flips the summary bit updates the counters,
+ * and the update is repeated until it matches the bitmaps and the priority, so
+ * the summary and counters converge to the bitmaps once all concurrent updates
+ * have completed. The priority level is read again on each attempt, and the
+ * interrupt removed from a level it was added to after its priority changed.
+ *
+ * Returns the total number of enabled and pending interrupts if this call made
+ * the interrupt enabled and pending, or 0 otherwise.
+ */
+uint32_t vcpu_virt_interrupt_update_summary(struct interrupts *interrupts,
+					    uint32_t intid)
+{
+	uint32_t ret;
+	uint32_t level;
+	bool set;
+	bool moved;
+
+	do {
+		level = vcpu_virt_interrupt_level(interrupts, intid);
+		set = vcpu_is_virt_interrupt_enabled(interrupts, intid) &&
+		      vcpu_is_virt_interrupt_pending(interrupts, intid);
+
+		if (set) {
+			ret = vcpu_virt_interrupt_summary_set(interrupts, intid,
+							      level);
+		} else {
+			ret = 0;
+			vcpu_virt_interrupt_summary_clear(interrupts, intid,
+							  level);
+		}
+
+		moved = level != vcpu_virt_interrupt_level(interrupts, intid);
+		if (moved && set) {
+			ret = 0;
+			vcpu_virt_interrupt_summary_clear(interrupts, intid,
+							  level);
+		}
+	} while (moved ||
+		 set != (vcpu_is_virt_interrupt_enabled(interrupts, intid) &&
+			 vcpu_is_virt_interrupt_pending(interrupts, intid)));
+
+	return ret;
+}
+
+/**
+ * Makes the given interrupt pending without requiring the vCPU lock.
+ *
+ * Returns the total number of enabled and pending interrupts if the interrupt
+ * has just become enabled and pending, or 0 if it was already pending or is not
+ * enabled.
+ */
+uint32_t vcpu_virt_interrupt_inject(struct interrupts *interrupts,
+				    uint32_t intid)
+{
+	if (interrupt_bitmap_set_value(&interrupts->interrupt_pending, intid) !=
+	    0U) {
+		return 0;
+	}
+
+	return vcpu_virt_interrupt_update_summary(interrupts, intid);
+}
+
+/**
+ * Sets the priority of the given interrupt, moving it to the summary of its new
+ * priority level if it is enabled and pending. The caller must hold the vCPU
+ * lock.
+ */
+void vcpu_virt_interrupt_set_priority(struct interrupts *interrupts,
+				      uint32_t intid, uint8_t priority)
+{
+	bool enabled = vcpu_is_virt_interrupt_enabled(interrupts, intid);
+
+	if (enabled) {
+		vcpu_virt_interrupt_clear_enabled(interrupts, intid);
+	}
+
+	__atomic_store_n(&interrupts->priority[intid], priority,
+			 __ATOMIC_RELAXED);
+
+	if (enabled) {
+		vcpu_virt_interrupt_set_enabled(interrupts, intid);
+	}
+}
+
+/**
+ * Returns the lowest enabled and pending interrupt ID of the given priority
+ * level, or HF_INVALID_INTID if there is none, with a CTZ on each level of the
+ * summary.
+ */
+static uint32_t vcpu_virt_interrupt_first_in_level(
+	struct interrupts *interrupts, uint32_t level)
+{
+	for (uint32_t i = 0; i < INTERRUPT_SUMMARY_L1_WORDS; i++) {
+		uint64_t l1;
+
+		/*
+		 * Words may transiently be empty while a concurrent update of
+		 * the summary is in flight, so skip them rather than assume
+		 * the l1 bit is exact.
+		 */
+		for (l1 = __atomic_load_n(
+			     &interrupts->enabled_and_pending_l1[level][i],
+			     __ATOMIC_ACQUIRE);
+		     l1 != 0U; l1 &= l1 - 1) {
+			uint32_t index = i * INTERRUPT_SUMMARY_BITS + ctz64(l1);
+			uint64_t word = __atomic_load_n(
+				&interrupts->enabled_and_pending[level][index],
+				__ATOMIC_ACQUIRE);
+
+			if (word != 0U) {
+				return index * INTERRUPT_SUMMARY_BITS +
+				       ctz64(word);
+			}
+		}
+	}
+
+	return HF_INVALID_INTID;
+}
+
+/**
+ * Returns the lowest interrupt ID which is both enabled and pending, or
+ * HF_INVALID_INTID if there is none. It relies on the summary of the interrupt
+ * bitmaps, so the search doesn't depend on the number of interrupt IDs
+ * supported, only on the number of priority levels with pending interrupts.
+ */
+uint32_t vcpu_virt_interrupt_first_enabled_and_pending(
+	struct interrupts *interrupts)
+{
+	uint32_t first = HF_INVALID_INTID;
+	uint32_t levels;
+
+	for (levels = __atomic_load_n(&interrupts->enabled_and_pending_levels,
+				      __ATOMIC_ACQUIRE);
+	     levels != 0U; levels &= levels - 1) {
+		uint32_t intid = vcpu_virt_interrupt_first_in_level(
+			interrupts, ctz(levels));
+
+		if (intid < first) {
+			first = intid;
+		}
+	}
+
+	return first;
+}
+
+/**
+ * Returns the enabled and pending interrupt with the highest priority, or
+ * HF_INVALID_INTID if there is none. Among interrupts of the same priority
+ * level the lowest interrupt ID is returned.
+ *
+ * The highest priority level with interrupts pending is the first bit set in
+ * the summary of levels, so this takes a CTZ on each level of the summary.
+ */
+uint32_t vcpu_virt_interrupt_highest_priority_pending(
+	struct interrupts *interrupts)
+{
+	uint32_t levels;
+
+	for (levels = __atomic_load_n(&interrupts->enabled_and_pending_levels,
+				      __ATOMIC_ACQUIRE);
+	     levels != 0U; levels &= levels - 1) {
+		uint32_t intid = vcpu_virt_interrupt_first_in_level(
+			interrupts, ctz(levels));
+
+		/* The level may have just been emptied concurrently. */
+		if (intid != HF_INVALID_INTID) {
+			return intid;
+		}
+	}
+
+	return HF_INVALID_INTID;
+}
+
+/**
+ * Returns the priority level the vCPU is running at, i.e. the highest of the
+ * interrupts it is handling, or VIRT_INTERRUPT_PRIORITY_LEVELS if it isn't
+ * handling any.
+ */
+static uint32_t vcpu_virt_interrupt_running_level(struct interrupts *interrupts)
+{
+	uint32_t active = __atomic_load_n(&interrupts->active_priorities,
+					  __ATOMIC_RELAXED);
+
+	return active == 0U ? VIRT_INTERRUPT_PRIORITY_LEVELS : ctz(active);
+}
+
+/**
+ * Returns the priority the vCPU is running at, or VIRT_INTERRUPT_IDLE_PRIORITY
+ * if it isn't handling any interrupt.
+ */
+uint8_t vcpu_virt_interrupt_running_priority(struct interrupts *interrupts)
+{
+	uint32_t level = vcpu_virt_interrupt_running_level(interrupts);
+
+	if (level == VIRT_INTERRUPT_PRIORITY_LEVELS) {
+		return VIRT_INTERRUPT_IDLE_PRIORITY;
+	}
+
+	return (uint8_t)(level << VIRT_INTERRUPT_PRIORITY_LEVEL_SHIFT);
+}
+
+/**
+ * Records that the vCPU acknowledged the given interrupt and is handling it.
+ *
+ * If it has higher priority than the interrupts being handled, it preempted
+ * them and is nested within their handlers. Otherwise those of the same or
+ * higher priority must have completed, as it wouldn't be taken while they run.
+ * The caller must hold the vCPU lock.
+ */
+void vcpu_virt_interrupt_activate(struct interrupts *interrupts,
+				  uint32_t intid)
+{
+	uint32_t level = vcpu_virt_interrupt_level(interrupts, intid);
+	uint32_t active = __atomic_load_n(&interrupts->active_priorities,
+					  __ATOMIC_RELAXED);
+
+	/* Keep only the preempted levels, of lower priority. */
+	active &= ~((UINT32_C(2) << level) - 1);
+	active |= UINT32_C(1) << level;
+
+	__atomic_store_n(&interrupts->active_priorities, active,
+			 __ATOMIC_RELAXED);
+}
+
+/**
+ * Drops the running priority of the vCPU as it completes the handler of the
+ * highest priority, resuming the one it preempted if any. The caller must hold
+ * the vCPU lock.
+ */
+void vcpu_virt_interrupt_priority_drop(struct interrupts *interrupts)
+{
+	uint32_t active = __atomic_load_n(&interrupts->active_priorities,
+					  __ATOMIC_RELAXED);
+
+	__atomic_store_n(&interrupts->active_priorities, active & (active - 1),
+			 __ATOMIC_RELAXED);
+}
+
+/**
+ * Drops all the active priorities of the vCPU, e.g. when it waits for
+ * interrupts and so must be done handling them. The caller must hold the vCPU
+ * lock.
+ */
+void vcpu_virt_interrupt_priority_drop_all(struct interrupts *interrupts)
+{
+	__atomic_store_n(&interrupts->active_priorities, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Checks whether the given interrupt, about to be made pending, preempts what
+ * the vCPU is doing: i.e. its priority level is higher than both that of the
+ * interrupts being handled and that of all the interrupts already pending.
+ * Both are single loads, so this doesn't depend on how many are pending.
+ */
+bool vcpu_virt_interrupt_preempts(struct interrupts *interrupts,
+				  uint32_t intid)
+{
+	uint32_t level = vcpu_virt_interrupt_level(interrupts, intid);
+	uint32_t pending = __atomic_load_n(
+		&interrupts->enabled_and_pending_levels, __ATOMIC_ACQUIRE);
+
+	if (level >= vcpu_virt_interrupt_running_level(interrupts)) {
+		return false;
+	}
+
+	return pending == 0U || level < ctz(pending);
+}
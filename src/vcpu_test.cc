@@ -0,0 +1,601 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+extern "C" {
+#include "hf/api.h"
+#include "hf/vcpu.h"
+#include "hf/vm.h"
+}
+
+namespace
+{
+using struct_vcpu = struct vcpu;
+using struct_vm = struct vm;
+using struct_interrupts = struct interrupts;
+
+/** Returns the bit of the priority level of the given priority. */
+constexpr uint32_t level_bit(uint8_t priority)
+{
+	return 1U << (priority >> VIRT_INTERRUPT_PRIORITY_LEVEL_SHIFT);
+}
+
+class vcpu : public ::testing::Test
+{
+	void SetUp() override
+	{
+		test_vm = std::make_unique<struct_vm>();
+		vcpu_init(&test_vcpu, test_vm.get());
+
+		primary_vm = std::make_unique<struct_vm>();
+		primary_vm->id = HF_PRIMARY_VM_ID;
+		vcpu_init(&primary_vcpu, primary_vm.get());
+	}
+
+       protected:
+	std::unique_ptr<struct_vm> test_vm;
+	struct_vcpu test_vcpu;
+	std::unique_ptr<struct_vm> primary_vm;
+	struct_vcpu primary_vcpu;
+
+	void enable(uint32_t intid)
+	{
+		EXPECT_EQ(api_interrupt_enable(intid, true, INTERRUPT_TYPE_IRQ,
+					       &test_vcpu),
+			  0);
+	}
+
+	void inject(uint32_t intid)
+	{
+		struct vcpu_locked locked = vcpu_lock(&test_vcpu);
+
+		/* Use the vCPU itself as current so no wake up is needed. */
+		api_interrupt_inject_locked(locked, intid, &test_vcpu, nullptr);
+		vcpu_unlock(&locked);
+	}
+
+	/**
+	 * Injects the interrupt from the primary VM, returning whether it has
+	 * to kick the target vCPU.
+	 */
+	int64_t inject_from_primary(uint32_t intid)
+	{
+		struct vcpu_locked locked = vcpu_lock(&test_vcpu);
+		int64_t ret = api_interrupt_inject_locked(
+			locked, intid, &primary_vcpu, nullptr);
+
+		vcpu_unlock(&locked);
+		return ret;
+	}
+
+	uint8_t running_priority()
+	{
+		return vcpu_virt_interrupt_running_priority(
+			&test_vcpu.interrupts);
+	}
+
+	bool preempts(uint32_t intid)
+	{
+		return vcpu_virt_interrupt_preempts(&test_vcpu.interrupts,
+						    intid);
+	}
+
+	void set_priority(uint32_t intid, uint8_t priority)
+	{
+		vcpu_virt_interrupt_set_priority(&test_vcpu.interrupts, intid,
+						 priority);
+	}
+};
+
+/**
+ * With nothing pending, there is no interrupt to be acknowledged.
+ */
+TEST_F(vcpu, interrupt_get_none_pending)
+{
+	EXPECT_EQ(vcpu_virt_interrupt_first_enabled_and_pending(
+			  &test_vcpu.interrupts),
+		  HF_INVALID_INTID);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+}
+
+/**
+ * Interrupts which are pending but not enabled, or enabled but not pending,
+ * are not reported by the summary.
+ */
+TEST_F(vcpu, interrupt_summary_requires_enabled_and_pending)
+{
+	struct_interrupts *interrupts = &test_vcpu.interrupts;
+
+	vcpu_virt_interrupt_set_pending(interrupts, 3);
+	vcpu_virt_interrupt_set_enabled(interrupts, 5);
+	EXPECT_EQ(vcpu_virt_interrupt_first_enabled_and_pending(interrupts),
+		  HF_INVALID_INTID);
+
+	vcpu_virt_interrupt_set_enabled(interrupts, 3);
+	EXPECT_EQ(vcpu_virt_interrupt_first_enabled_and_pending(interrupts),
+		  3);
+
+	vcpu_virt_interrupt_clear_enabled(interrupts, 3);
+	EXPECT_EQ(vcpu_virt_interrupt_first_enabled_and_pending(interrupts),
+		  HF_INVALID_INTID);
+}
+
+/**
+ * The summary is kept in sync with the bitmaps for every interrupt ID, and the
+ * lowest enabled and pending interrupt ID is always the one reported.
+ */
+TEST_F(vcpu, interrupt_summary_matches_bitmaps)
+{
+	struct_interrupts *interrupts = &test_vcpu.interrupts;
+
+	for (uint32_t intid = 0; intid < HF_NUM_INTIDS; intid++) {
+		vcpu_virt_interrupt_set_enabled(interrupts, intid);
+	}
+
+	for (uint32_t intid = HF_NUM_INTIDS; intid > 0; intid--) {
+		vcpu_virt_interrupt_set_pending(interrupts, intid - 1);
+		EXPECT_EQ(vcpu_virt_interrupt_first_enabled_and_pending(
+				  interrupts),
+			  intid - 1);
+	}
+
+	for (uint32_t intid = 0; intid < HF_NUM_INTIDS; intid++) {
+		EXPECT_EQ(vcpu_virt_interrupt_first_enabled_and_pending(
+				  interrupts),
+			  intid);
+		vcpu_virt_interrupt_clear_pending(interrupts, intid);
+	}
+
+	EXPECT_EQ(vcpu_virt_interrupt_first_enabled_and_pending(interrupts),
+		  HF_INVALID_INTID);
+
+	for (uint32_t level = 0; level < VIRT_INTERRUPT_PRIORITY_LEVELS;
+	     level++) {
+		for (uint32_t i = 0; i < INTERRUPT_SUMMARY_WORDS; i++) {
+			EXPECT_EQ(interrupts->enabled_and_pending[level][i],
+				  0U);
+		}
+
+		for (uint32_t i = 0; i < INTERRUPT_SUMMARY_L1_WORDS; i++) {
+			EXPECT_EQ(interrupts->enabled_and_pending_l1[level][i],
+				  0U);
+		}
+	}
+
+	EXPECT_EQ(interrupts->enabled_and_pending_levels, 0U);
+}
+
+/**
+ * Pending interrupts are acknowledged in ascending order of interrupt ID, and
+ * the enabled and pending count is kept consistent.
+ */
+TEST_F(vcpu, interrupt_get_ascending_order)
+{
+	const uint32_t intids[] = {HF_NUM_INTIDS - 1, 1, 40, 7};
+	const uint32_t expected[] = {1, 7, 40, HF_NUM_INTIDS - 1};
+	struct vcpu_locked locked;
+
+	for (uint32_t intid : intids) {
+		enable(intid);
+		inject(intid);
+	}
+
+	/* Pending but not enabled, so never acknowledged. */
+	inject(0);
+
+	locked = vcpu_lock(&test_vcpu);
+	EXPECT_EQ(vcpu_interrupt_count_get(locked), 4U);
+	vcpu_unlock(&locked);
+
+	for (uint32_t intid : expected) {
+		EXPECT_EQ(api_interrupt_get(&test_vcpu), intid);
+	}
+
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+
+	locked = vcpu_lock(&test_vcpu);
+	EXPECT_EQ(vcpu_interrupt_count_get(locked), 0U);
+	vcpu_unlock(&locked);
+
+	/* Enabling the pending interrupt makes it available. */
+	enable(0);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 0U);
+}
+
+/**
+ * Pending interrupts are acknowledged in order of priority, and in ascending
+ * order of interrupt ID among those of the same priority.
+ */
+TEST_F(vcpu, interrupt_get_priority_order)
+{
+	const uint32_t intids[] = {1, 7, 12, 40, HF_NUM_INTIDS - 1};
+	const uint32_t expected[] = {HF_NUM_INTIDS - 1, 12, 40, 1, 7};
+
+	set_priority(HF_NUM_INTIDS - 1, 0x10);
+	set_priority(12, 0x40);
+	set_priority(40, 0x40);
+
+	for (uint32_t intid : intids) {
+		enable(intid);
+		inject(intid);
+	}
+
+	for (uint32_t intid : expected) {
+		EXPECT_EQ(api_interrupt_get(&test_vcpu), intid);
+	}
+
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+}
+
+/**
+ * The vCPU is handling the last interrupt it acknowledged, so it is only
+ * preempted by interrupts of higher priority.
+ */
+TEST_F(vcpu, interrupt_get_sets_running_priority)
+{
+	set_priority(3, 0x20);
+	enable(3);
+	enable(4);
+	inject(3);
+	inject(4);
+
+	EXPECT_EQ(running_priority(), VIRT_INTERRUPT_IDLE_PRIORITY);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 3U);
+	EXPECT_EQ(running_priority(), 0x20);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 4U);
+	EXPECT_EQ(running_priority(), VIRT_INTERRUPT_DEFAULT_PRIORITY);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+	EXPECT_EQ(running_priority(), VIRT_INTERRUPT_IDLE_PRIORITY);
+}
+
+/**
+ * The primary VM is asked to kick the target vCPU for the first pending
+ * interrupt, and then only for interrupts with higher priority than any being
+ * handled or pending.
+ */
+TEST_F(vcpu, interrupt_inject_preempts_by_priority)
+{
+	set_priority(10, 0x60);
+	set_priority(11, 0x70);
+	set_priority(12, 0x50);
+	set_priority(13, 0x20);
+	set_priority(14, 0x40);
+	for (uint32_t intid = 10; intid <= 14; intid++) {
+		enable(intid);
+	}
+
+	/* First pending interrupt. */
+	EXPECT_EQ(inject_from_primary(10), 1);
+
+	/* Lower priority than the one already pending. */
+	EXPECT_EQ(inject_from_primary(11), 0);
+
+	/* Higher priority than everything pending. */
+	EXPECT_EQ(inject_from_primary(12), 1);
+
+	/* Already pending. */
+	EXPECT_EQ(inject_from_primary(12), 0);
+
+	/* The vCPU is now handling interrupt 12. */
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 12U);
+
+	/* Higher priority than both pending and running. */
+	EXPECT_EQ(inject_from_primary(13), 1);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 13U);
+
+	/* Higher than pending, but not than the one being handled. */
+	EXPECT_EQ(inject_from_primary(14), 0);
+}
+
+/**
+ * Interrupts all of the default priority behave as before priorities were
+ * introduced: only the first pending interrupt requires a kick.
+ */
+TEST_F(vcpu, interrupt_inject_default_priority_no_preemption)
+{
+	enable(5);
+	enable(6);
+
+	EXPECT_EQ(inject_from_primary(6), 1);
+	EXPECT_EQ(inject_from_primary(5), 0);
+}
+
+/**
+ * Handlers are nested as interrupts of higher priority preempt them, and once
+ * the handler of the highest priority is done the vCPU resumes at the priority
+ * of the one it preempted.
+ */
+TEST_F(vcpu, interrupt_nested_preemption)
+{
+	set_priority(20, 0x80);
+	set_priority(21, 0x40);
+	set_priority(22, 0x10);
+	set_priority(23, 0x60);
+	for (uint32_t intid = 20; intid <= 23; intid++) {
+		enable(intid);
+	}
+
+	inject(20);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 20U);
+	EXPECT_EQ(running_priority(), 0x80);
+
+	/* 21 preempts the handler of 20, and 22 that of 21. */
+	EXPECT_TRUE(preempts(21));
+	inject(21);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 21U);
+	EXPECT_TRUE(preempts(22));
+	inject(22);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 22U);
+	EXPECT_EQ(running_priority(), 0x10);
+	EXPECT_FALSE(preempts(21));
+
+	/* Once 22 is handled, the handler of 21 resumes. */
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+	EXPECT_EQ(running_priority(), 0x40);
+	EXPECT_FALSE(preempts(23));
+	EXPECT_TRUE(preempts(22));
+
+	/* Then that of 20. */
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+	EXPECT_EQ(running_priority(), 0x80);
+	EXPECT_TRUE(preempts(23));
+
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+	EXPECT_EQ(running_priority(), VIRT_INTERRUPT_IDLE_PRIORITY);
+}
+
+/**
+ * Taking an interrupt of lower priority than the handlers that were nested
+ * means those of the same or higher priority are done.
+ */
+TEST_F(vcpu, interrupt_activate_completes_higher_priorities)
+{
+	set_priority(20, 0x80);
+	set_priority(21, 0x10);
+	set_priority(22, 0x40);
+	for (uint32_t intid = 20; intid <= 22; intid++) {
+		enable(intid);
+	}
+
+	inject(20);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 20U);
+	inject(21);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 21U);
+	inject(22);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 22U);
+	EXPECT_EQ(running_priority(), 0x40);
+
+	/* The handler of 22 resumes that of 20 rather than of 21. */
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+	EXPECT_EQ(running_priority(), 0x80);
+
+	vcpu_virt_interrupt_priority_drop_all(&test_vcpu.interrupts);
+	EXPECT_EQ(running_priority(), VIRT_INTERRUPT_IDLE_PRIORITY);
+}
+
+/**
+ * Interrupts are ordered by priority level, so those whose priorities only
+ * differ in the low bits are taken in order of interrupt ID. Changing the
+ * priority of a pending interrupt moves it to its new level.
+ */
+TEST_F(vcpu, interrupt_priority_levels)
+{
+	struct_interrupts *interrupts = &test_vcpu.interrupts;
+
+	set_priority(30, 0x41);
+	set_priority(31, 0x40);
+	for (uint32_t intid = 30; intid <= 32; intid++) {
+		enable(intid);
+		inject(intid);
+	}
+
+	EXPECT_EQ(interrupts->enabled_and_pending_levels,
+		  level_bit(0x40) | level_bit(VIRT_INTERRUPT_DEFAULT_PRIORITY));
+
+	set_priority(32, 0x20);
+	EXPECT_EQ(interrupts->enabled_and_pending_levels,
+		  level_bit(0x20) | level_bit(0x40));
+
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 32U);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 30U);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), 31U);
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+	EXPECT_EQ(interrupts->enabled_and_pending_levels, 0U);
+}
+
+/**
+ * Interrupts of both types are counted separately, and changing the type of an
+ * interrupt which is already pending moves it to the other count.
+ */
+TEST_F(vcpu, interrupt_count_by_type)
+{
+	struct vcpu_locked locked;
+
+	enable(1);
+	EXPECT_EQ(api_interrupt_enable(2, true, INTERRUPT_TYPE_FIQ,
+				       &test_vcpu),
+		  0);
+	inject(1);
+	inject(2);
+
+	locked = vcpu_lock(&test_vcpu);
+	EXPECT_EQ(vcpu_interrupt_irq_count_get(locked), 1U);
+	EXPECT_EQ(vcpu_interrupt_fiq_count_get(locked), 1U);
+	vcpu_unlock(&locked);
+
+	EXPECT_EQ(api_interrupt_enable(1, true, INTERRUPT_TYPE_FIQ,
+				       &test_vcpu),
+		  0);
+
+	locked = vcpu_lock(&test_vcpu);
+	EXPECT_EQ(vcpu_interrupt_irq_count_get(locked), 0U);
+	EXPECT_EQ(vcpu_interrupt_fiq_count_get(locked), 2U);
+	vcpu_unlock(&locked);
+
+	EXPECT_EQ(api_interrupt_enable(2, false, INTERRUPT_TYPE_FIQ,
+				       &test_vcpu),
+		  0);
+
+	locked = vcpu_lock(&test_vcpu);
+	EXPECT_EQ(vcpu_interrupt_count_get(locked), 1U);
+	vcpu_unlock(&locked);
+}
+
+/**
+ * Interrupts injected concurrently from several CPUs without the vCPU lock,
+ * while the vCPU acknowledges them, are each delivered exactly once and leave
+ * the counters and summary consistent.
+ */
+TEST_F(vcpu, interrupt_inject_concurrent)
+{
+	constexpr uint32_t injectors = 4;
+	constexpr uint32_t rounds = 200;
+	std::array<uint32_t, HF_NUM_INTIDS> delivered{};
+	std::vector<std::thread> threads;
+	struct_interrupts *interrupts = &test_vcpu.interrupts;
+	struct vcpu_locked locked;
+
+	for (uint32_t intid = 0; intid < HF_NUM_INTIDS; intid++) {
+		enable(intid);
+	}
+
+	for (uint32_t t = 0; t < injectors; t++) {
+		threads.emplace_back([interrupts, t] {
+			for (uint32_t r = 0; r < rounds; r++) {
+				for (uint32_t intid = t; intid < HF_NUM_INTIDS;
+				     intid += injectors) {
+					vcpu_virt_interrupt_inject(interrupts,
+								   intid);
+				}
+
+				/* Wait for delivery before injecting again. */
+				for (uint32_t intid = t; intid < HF_NUM_INTIDS;
+				     intid += injectors) {
+					while (vcpu_is_virt_interrupt_pending(
+						interrupts, intid)) {
+						std::this_thread::yield();
+					}
+				}
+			}
+		});
+	}
+
+	for (uint32_t total = 0; total < rounds * HF_NUM_INTIDS;) {
+		uint32_t intid = api_interrupt_get(&test_vcpu);
+
+		if (intid != HF_INVALID_INTID) {
+			delivered[intid]++;
+			total++;
+		}
+	}
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	for (uint32_t intid = 0; intid < HF_NUM_INTIDS; intid++) {
+		EXPECT_EQ(delivered[intid], rounds);
+	}
+
+	locked = vcpu_lock(&test_vcpu);
+	EXPECT_EQ(vcpu_interrupt_count_get(locked), 0U);
+	vcpu_unlock(&locked);
+	EXPECT_EQ(vcpu_virt_interrupt_first_enabled_and_pending(interrupts),
+		  HF_INVALID_INTID);
+}
+
+/**
+ * Changing the priorities of interrupts while they are injected concurrently
+ * leaves each of them only in the summary of its final priority level.
+ */
+TEST_F(vcpu, interrupt_set_priority_concurrent)
+{
+	constexpr uint32_t injectors = 4;
+	constexpr uint32_t rounds = 200;
+	const uint8_t priorities[] = {0x20, 0x80};
+	std::atomic<uint32_t> started{0};
+	std::atomic<bool> done{false};
+	std::vector<std::thread> threads;
+	struct_interrupts *interrupts = &test_vcpu.interrupts;
+	struct vcpu_locked locked;
+
+	for (uint32_t intid = 0; intid < HF_NUM_INTIDS; intid++) {
+		enable(intid);
+	}
+
+	for (uint32_t t = 0; t < injectors; t++) {
+		threads.emplace_back([interrupts, t, &started, &done] {
+			for (uint32_t pass = 0; pass == 0 || !done; pass++) {
+				for (uint32_t intid = t; intid < HF_NUM_INTIDS;
+				     intid += injectors) {
+					vcpu_virt_interrupt_inject(interrupts,
+								   intid);
+				}
+
+				if (pass == 0) {
+					started++;
+				}
+			}
+		});
+	}
+
+	/* Let every injector make its interrupts pending at least once. */
+	while (started < injectors) {
+		std::this_thread::yield();
+	}
+
+	for (uint32_t r = 0; r < rounds; r++) {
+		for (uint32_t intid = 0; intid < HF_NUM_INTIDS; intid++) {
+			set_priority(intid, priorities[r % 2]);
+		}
+	}
+
+	done = true;
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	uint32_t level = priorities[(rounds - 1) % 2] >>
+			 VIRT_INTERRUPT_PRIORITY_LEVEL_SHIFT;
+
+	for (uint32_t l = 0; l < VIRT_INTERRUPT_PRIORITY_LEVELS; l++) {
+		for (uint32_t intid = 0; intid < HF_NUM_INTIDS; intid++) {
+			uint64_t word =
+				interrupts->enabled_and_pending
+					[l][intid / INTERRUPT_SUMMARY_BITS];
+			bool set = (word >> (intid % INTERRUPT_SUMMARY_BITS)) &
+				   1U;
+
+			EXPECT_EQ(set, l == level) << "level " << l << " intid "
+						   << intid;
+		}
+	}
+
+	EXPECT_EQ(interrupts->enabled_and_pending_levels,
+		  level_bit(priorities[(rounds - 1) % 2]));
+
+	locked = vcpu_lock(&test_vcpu);
+	EXPECT_EQ(vcpu_interrupt_count_get(locked), HF_NUM_INTIDS);
+	vcpu_unlock(&locked);
+
+	for (uint32_t intid = 0; intid < HF_NUM_INTIDS; intid++) {
+		EXPECT_EQ(api_interrupt_get(&test_vcpu), intid);
+	}
+
+	EXPECT_EQ(api_interrupt_get(&test_vcpu), HF_INVALID_INTID);
+	EXPECT_EQ(interrupts->enabled_and_pending_levels, 0U);
+}
+
+} /* namespace */
@@ -284,6 +284,7 @@ bool vm_identity_map(struct vm_locked vm_locked, paddr_t begin, paddr_t end,
 	}
 
 	vm_identity_commit(vm_locked, begin, end, mode, ppool, ipa);
+	plat_iommu_sync(vm_locked);
 
 	return true;
 }
@@ -351,7 +352,8 @@ bool vm_unmap(struct vm_locked vm_locked, paddr_t begin, paddr_t end,
 }
 
 /**
- * Defrag page tables for an EL0 partition or for a VM.
+ * Defrag page tables for an EL0 partition or for a VM, and complete the changes
+ * made to its IOMMU mappings.
  */
 void vm_ptable_defrag(struct vm_locked vm_locked, struct mpool *ppool)
 {
@@ -360,6 +362,8 @@ void vm_ptable_defrag(struct vm_locked vm_locked, struct mpool *ppool)
 	} else {
 		mm_vm_defrag(&vm_locked.vm->ptable, ppool);
 	}
+
+	plat_iommu_sync(vm_locked);
 }
 
 /**
@@ -19,12 +19,13 @@
 #define HFTEST_MAX_TESTS 50
 
 /*
- * Log with the HFTEST_LOG_PREFIX and a new line. The zero is added so there is
- * always at least one variadic argument.
+ * Log with the HFTEST_LOG_PREFIX and a new line. The empty string is added so
+ * there is always at least one variadic argument, and is consumed by the format
+ * so it can be checked.
  */
-#define HFTEST_LOG(...) HFTEST_LOG_IMPL(__VA_ARGS__, 0)
+#define HFTEST_LOG(...) HFTEST_LOG_IMPL(__VA_ARGS__, "")
 #define HFTEST_LOG_IMPL(format, ...) \
-	dlog("%s" format "\n", HFTEST_LOG_PREFIX, __VA_ARGS__)
+	dlog("%s" format "%s\n", HFTEST_LOG_PREFIX, __VA_ARGS__)
 
 /* Helper to wrap the argument in quotes. */
 #define HFTEST_STR(str) #str
@@ -205,10 +206,7 @@ union hftest_any {
 		signed long long int:   (any).slli, \
 		unsigned long long int: (any).ulli)
 
-/*
- * dlog format specifier for types. Note, these aren't the standard specifiers
- * for the types.
- */
+/* dlog format specifier for types. */
 #define hftest_dlog_format(x)                 \
 	_Generic((x),                         \
 		bool:                   "%u", \
@@ -219,10 +217,10 @@ union hftest_any {
 		unsigned short:         "%u", \
 		signed int:             "%d", \
 		unsigned int:           "%u", \
-		signed long int:        "%d", \
-		unsigned long int:      "%u", \
-		signed long long int:   "%d", \
-		unsigned long long int: "%u")
+		signed long int:        "%ld", \
+		unsigned long int:      "%lu", \
+		signed long long int:   "%lld", \
+		unsigned long long int: "%llu")
 
 /* clang-format on */
 
@@ -148,8 +148,8 @@ static void timer_secondary(const char message[], uint64_t expected_code)
 	 */
 
 	if (run_res.func != expected_code && run_res.func != FFA_INTERRUPT_32) {
-		FAIL("Expected run to return FFA_INTERRUPT or %#x, but "
-		     "got %#x",
+		FAIL("Expected run to return FFA_INTERRUPT or %#lx, but "
+		     "got %#lx",
 		     expected_code, run_res.func);
 	}
 
@@ -163,7 +163,7 @@ static void timer_secondary(const char message[], uint64_t expected_code)
 		if (expected_code == HF_FFA_RUN_WAIT_FOR_INTERRUPT ||
 		    expected_code == FFA_MSG_WAIT_32) {
 			EXPECT_NE(run_res.arg2, FFA_SLEEP_INDEFINITE);
-			dlog("%d ns remaining\n", run_res.arg2);
+			dlog("%ld ns remaining\n", run_res.arg2);
 		}
 		run_res = ffa_run(SERVICE_VM1, 0);
 	}
@@ -287,7 +287,7 @@ TEST(timer_secondary, wfi_very_long)
 	for (int i = 0; i < 20; ++i) {
 		run_res = ffa_run(SERVICE_VM1, 0);
 		EXPECT_EQ(run_res.func, HF_FFA_RUN_WAIT_FOR_INTERRUPT);
-		dlog("Primary looping until timer fires; %d ns "
+		dlog("Primary looping until timer fires; %ld ns "
 		     "remaining\n",
 		     run_res.arg2);
 	}
@@ -45,7 +45,7 @@ static ffa_memory_handle_t init_and_send(
 	ret = ffa_mem_share(total_length, fragment_length);
 	EXPECT_EQ(ret.func, FFA_SUCCESS_32);
 	handle = ffa_mem_success_handle(ret);
-	dlog("Got handle %#x.\n", handle);
+	dlog("Got handle %#lx.\n", handle);
 	EXPECT_NE(handle, 0);
 	EXPECT_NE(handle & FFA_MEMORY_HANDLE_ALLOCATOR_MASK,
 		  FFA_MEMORY_HANDLE_ALLOCATOR_HYPERVISOR);
@@ -123,7 +123,7 @@ TEST(trusty, memory_share_fragmented)
 	ret = ffa_mem_frag_tx(handle, fragment_length);
 	EXPECT_EQ(ret.func, FFA_SUCCESS_32);
 	EXPECT_EQ(ffa_mem_success_handle(ret), handle);
-	dlog("Got handle %#x.\n", handle);
+	dlog("Got handle %#lx.\n", handle);
 	EXPECT_NE(handle, 0);
 	EXPECT_NE(handle & FFA_MEMORY_HANDLE_ALLOCATOR_MASK,
 		  FFA_MEMORY_HANDLE_ALLOCATOR_HYPERVISOR);
@@ -187,7 +187,7 @@ TEST(trusty, memory_reclaim)
 		pages[i] = i;
 	}
 
-	dlog("Reclaiming handle %#x.\n", handle);
+	dlog("Reclaiming handle %#lx.\n", handle);
 	ret = ffa_mem_reclaim(handle, 0);
 	EXPECT_EQ(ret.func, FFA_SUCCESS_32);
 }
@@ -234,7 +234,7 @@ TEST(trusty, memory_reclaim_reshare_fragmented)
 	EXPECT_EQ(ret.func, FFA_MEM_FRAG_RX_32);
 	EXPECT_EQ(ret.arg3, fragment_length);
 	handle = ffa_frag_handle(ret);
-	dlog("Got handle %#x.\n", handle);
+	dlog("Got handle %#lx.\n", handle);
 	EXPECT_NE(handle, 0);
 	EXPECT_NE(handle & FFA_MEMORY_HANDLE_ALLOCATOR_MASK,
 		  FFA_MEMORY_HANDLE_ALLOCATOR_HYPERVISOR);
@@ -258,7 +258,7 @@ TEST(trusty, memory_reclaim_reshare_fragmented)
 		pages[i] = i;
 	}
 
-	dlog("Reclaiming handle %#x.\n", handle);
+	dlog("Reclaiming handle %#lx.\n", handle);
 	ret = ffa_mem_reclaim(handle, 0);
 	EXPECT_EQ(ret.func, FFA_SUCCESS_32);
 
@@ -278,7 +278,7 @@ TEST(trusty, memory_reclaim_reshare_fragmented)
 	EXPECT_EQ(ret.func, FFA_MEM_FRAG_RX_32);
 	EXPECT_EQ(ret.arg3, fragment_length);
 	handle = ffa_frag_handle(ret);
-	dlog("Got handle %#x.\n", handle);
+	dlog("Got handle %#lx.\n", handle);
 	EXPECT_NE(handle, 0);
 	EXPECT_NE(handle & FFA_MEMORY_HANDLE_ALLOCATOR_MASK,
 		  FFA_MEMORY_HANDLE_ALLOCATOR_HYPERVISOR);
@@ -81,7 +81,7 @@ noreturn void test_main_sp(bool is_boot_vcpu)
 		default:
 			HFTEST_LOG_FAILURE();
 			HFTEST_LOG(HFTEST_LOG_INDENT
-				   "0x%x is not a valid command id\n",
+				   "0x%lx is not a valid command id\n",
 				   res.arg3);
 			abort();
 		}
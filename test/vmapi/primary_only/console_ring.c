@@ -0,0 +1,130 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include <stdalign.h>
+
+#include "hf/mm.h"
+#include "hf/std.h"
+
+#include "vmapi/hf/call.h"
+#include "vmapi/hf/console_ring.h"
+
+#include "test/hftest.h"
+#include "test/vmapi/ffa.h"
+
+alignas(PAGE_SIZE) static struct hf_console_ring ring;
+
+/**
+ * Writes the line to the ring, flushing it first if there isn't enough room.
+ */
+static void write_line(const char *line)
+{
+	uint32_t size = strnlen_s(line, HF_CONSOLE_RING_DATA_SIZE);
+
+	if (!hf_console_ring_write(&ring, line, size)) {
+		ASSERT_EQ(hf_console_ring_flush(), 0);
+		ASSERT_TRUE(hf_console_ring_write(&ring, line, size));
+	}
+}
+
+/**
+ * Only a page owned exclusively by the VM can be registered, and only one.
+ */
+TEST(console_ring, register_bad_address)
+{
+	struct mailbox_buffers mb = set_up_mailbox();
+
+	/* Not aligned to a page. */
+	EXPECT_EQ(hf_console_ring_register((hf_ipaddr_t)&ring + 8), -1);
+
+	/* Not mapped in the VM. */
+	EXPECT_EQ(hf_console_ring_register(1ULL << 40), -1);
+
+	/* Already shared with the hypervisor as the RX/TX buffers. */
+	EXPECT_EQ(hf_console_ring_register((hf_ipaddr_t)mb.send), -1);
+	EXPECT_EQ(hf_console_ring_register((hf_ipaddr_t)mb.recv), -1);
+
+	ASSERT_EQ(hf_console_ring_register((hf_ipaddr_t)&ring), 0);
+	EXPECT_EQ(hf_console_ring_register((hf_ipaddr_t)&ring), -1);
+}
+
+/** Nothing can be flushed or unregistered without a console ring. */
+TEST(console_ring, not_registered)
+{
+	EXPECT_EQ(hf_console_ring_flush(), -1);
+	EXPECT_EQ(hf_console_ring_unregister(), -1);
+}
+
+/**
+ * Writes only succeed while there is room, which flushing the ring makes
+ * available again.
+ */
+TEST(console_ring, flush)
+{
+	char line[HF_CONSOLE_RING_DATA_SIZE];
+
+	ASSERT_EQ(hf_console_ring_register((hf_ipaddr_t)&ring), 0);
+
+	/* The ring holds one character less than its data. */
+	memset_s(line, sizeof(line), 'x', sizeof(line));
+	line[HF_CONSOLE_RING_DATA_SIZE - 2] = '\n';
+	EXPECT_FALSE(hf_console_ring_write(&ring, line, sizeof(line)));
+	ASSERT_TRUE(hf_console_ring_write(&ring, line, sizeof(line) - 1));
+	EXPECT_FALSE(hf_console_ring_write(&ring, "\n", 1));
+
+	ASSERT_EQ(hf_console_ring_flush(), 0);
+	EXPECT_EQ(ring.tail, ring.head);
+	EXPECT_TRUE(hf_console_ring_write(&ring, "flushed\n", 8));
+	EXPECT_EQ(hf_console_ring_flush(), 0);
+	EXPECT_EQ(ring.tail, ring.head);
+}
+
+/**
+ * Lines of a length which doesn't divide the size of the ring end up wrapping
+ * around its end, and are still read in full.
+ */
+TEST(console_ring, wrap_around)
+{
+	const char *line = "Lines wrap around the end of the console ring.\n";
+	uint32_t size = strnlen_s(line, HF_CONSOLE_RING_DATA_SIZE);
+	uint32_t i;
+	bool wrapped = false;
+
+	ASSERT_EQ(hf_console_ring_register((hf_ipaddr_t)&ring), 0);
+
+	for (i = 0; i < 3 * HF_CONSOLE_RING_DATA_SIZE / size; i++) {
+		uint32_t head = ring.head;
+
+		write_line(line);
+		EXPECT_LT(ring.head, HF_CONSOLE_RING_DATA_SIZE);
+		wrapped = wrapped || ring.head < head;
+	}
+
+	EXPECT_TRUE(wrapped);
+	ASSERT_EQ(hf_console_ring_flush(), 0);
+	EXPECT_EQ(ring.tail, ring.head);
+}
+
+/**
+ * Unregistering flushes the ring and gives the page back to the VM, so that it
+ * can be registered again.
+ */
+TEST(console_ring, unregister)
+{
+	ASSERT_EQ(hf_console_ring_register((hf_ipaddr_t)&ring), 0);
+	write_line("Unregistering the console ring.\n");
+
+	EXPECT_EQ(hf_console_ring_unregister(), 0);
+	EXPECT_EQ(ring.tail, ring.head);
+	EXPECT_EQ(hf_console_ring_flush(), -1);
+	EXPECT_EQ(hf_console_ring_unregister(), -1);
+
+	EXPECT_EQ(hf_console_ring_register((hf_ipaddr_t)&ring), 0);
+	write_line("Registered again.\n");
+	EXPECT_EQ(hf_console_ring_flush(), 0);
+}
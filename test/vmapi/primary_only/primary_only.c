@@ -400,3 +400,98 @@ TEST(fp, fp)
 	EXPECT_TRUE(b == 1.0);
 	EXPECT_TRUE(result == 8.0);
 }
+
+/**
+ * Sums the histogram buckets of the calls of the function ID on the CPU, which
+ * should add up to the number of calls.
+ */
+static int64_t exit_stat_call_buckets_sum(uint32_t cpu_index, uint32_t func)
+{
+	int64_t sum = 0;
+	uint32_t i;
+
+	for (i = 0; i < HF_EXIT_STAT_CALL_BUCKETS; i++) {
+		int64_t count = hf_cpu_exit_stat_get(
+			cpu_index, HF_EXIT_STAT_CALL_BUCKET(i), func);
+
+		EXPECT_NE(count, -1);
+		sum += count;
+	}
+
+	return sum;
+}
+
+/**
+ * Calls to Hafnium are counted, along with the time they took, against the CPU
+ * they were made on.
+ */
+TEST(hf_cpu_exit_stat_get, calls_counted)
+{
+	/* Exception class of HVC instructions, which calls are made with. */
+	const uint32_t ec_hvc = 0x16;
+	const uint32_t func = FFA_VERSION_32;
+	const uint32_t calls = 10;
+	int64_t hvcs = hf_cpu_exit_stat_get(0, HF_EXIT_STAT_SYNC, ec_hvc);
+	int64_t count = hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_COUNT, func);
+	int64_t ticks = hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_TICKS, func);
+	uint32_t i;
+
+	ASSERT_NE(hvcs, -1);
+	ASSERT_NE(count, -1);
+	ASSERT_NE(ticks, -1);
+
+	for (i = 0; i < calls; i++) {
+		ffa_version(MAKE_FFA_VERSION(1, 1));
+	}
+
+	EXPECT_EQ(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_COUNT, func),
+		  count + calls);
+	EXPECT_GE(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_TICKS, func),
+		  ticks);
+	EXPECT_EQ(exit_stat_call_buckets_sum(0, func), count + calls);
+
+	/* The calls reading the statistics are counted as well. */
+	EXPECT_GE(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_SYNC, ec_hvc),
+		  hvcs + calls + 2);
+	EXPECT_GT(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_COUNT,
+				       HF_CPU_EXIT_STAT_GET),
+		  0);
+}
+
+/** Statistics of CPUs or kinds that don't exist can't be read. */
+TEST(hf_cpu_exit_stat_get, invalid)
+{
+	const uint32_t past_last_bucket =
+		HF_EXIT_STAT_CALL_BUCKET(HF_EXIT_STAT_CALL_BUCKETS);
+
+	EXPECT_EQ(hf_cpu_exit_stat_get(UINT32_MAX, HF_EXIT_STAT_IRQ, 0), -1);
+	EXPECT_EQ(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_SYNC, 64), -1);
+	EXPECT_EQ(hf_cpu_exit_stat_get(0, past_last_bucket, FFA_VERSION_32),
+		  -1);
+	EXPECT_EQ(hf_cpu_exit_stat_get(0, 0xff, 0), -1);
+
+	/* Function IDs that aren't counted on their own can't be read. */
+	EXPECT_EQ(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_COUNT, 0x84000000),
+		  -1);
+	EXPECT_EQ(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_COUNT, 0xff80), -1);
+	EXPECT_NE(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_COUNT,
+				       HF_EXIT_STAT_CALL_OTHER),
+		  -1);
+
+	/* Functions that were never called read as zero. */
+	EXPECT_EQ(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_COUNT, 0xff1f), 0);
+	EXPECT_EQ(hf_cpu_exit_stat_get(0, HF_EXIT_STAT_CALL_COUNT, 0xc400009f),
+		  0);
+}
+
+/**
+ * The hypervisor sends no Schedule Receiver Interrupts, so all statistics of
+ * them read as zero, and those that don't exist can't be read.
+ */
+TEST(hf_sri_stat_get, no_spmc)
+{
+	EXPECT_EQ(hf_sri_stat_get(HF_SRI_STAT_SENT), 0);
+	EXPECT_EQ(hf_sri_stat_get(HF_SRI_STAT_COALESCED), 0);
+	EXPECT_EQ(hf_sri_stat_get(HF_SRI_STAT_SUPPRESSED), 0);
+	EXPECT_EQ(hf_sri_stat_get(HF_SRI_STAT_SUPPRESSED + 1), -1);
+}
@@ -9,6 +9,7 @@
 #include "hf/arch/std.h"
 #include "hf/arch/vm/registers.h"
 
+#include "hf/dlog.h"
 #include "hf/ffa.h"
 
 #include "vmapi/hf/call.h"
@@ -68,3 +69,98 @@ TEST(floating_point, fp_fpcr)
 	EXPECT_EQ(run_res.func, FFA_YIELD_32);
 	EXPECT_EQ(read_msr(fpcr), value);
 }
+
+/**
+ * Test that the floating point registers are restored when the first access
+ * to them after a switch is an SVE instruction.
+ */
+TEST(floating_point, fp_fill_sve)
+{
+	const double first = 1.2;
+	struct ffa_value run_res;
+	struct mailbox_buffers mb = set_up_mailbox();
+	uintreg_t cpacr_el1 = read_msr(cpacr_el1);
+
+	if (((read_msr(id_aa64pfr0_el1) >> 32) & 0xf) == 0) {
+		dlog("SVE not implemented, skipping.\n");
+		return;
+	}
+
+	/* Don't trap SVE instructions at EL1. */
+	write_msr(cpacr_el1, cpacr_el1 | (UINT64_C(0x3) << 16));
+
+	fill_fp_registers(first);
+	SERVICE_SELECT(SERVICE_VM1, "fp_fill", mb.send);
+	run_res = ffa_run(SERVICE_VM1, 0);
+	EXPECT_EQ(run_res.func, FFA_YIELD_32);
+
+	/* z0 and z1 both hold `first` in their low 64 bits. */
+	__asm__ volatile(
+		".arch_extension sve\n"
+		"mov z1.d, z0.d\n"
+		".arch_extension nosve" ::
+			: "v1");
+	EXPECT_EQ(check_fp_register(first), true);
+
+	write_msr(cpacr_el1, cpacr_el1);
+}
+
+/** Number of round trips to the service timed by the switch latency tests. */
+#define FP_SWITCH_ROUND_TRIPS 1000
+
+/**
+ * Runs the selected service until it has yielded back FP_SWITCH_ROUND_TRIPS
+ * times, and logs the average time of a round trip. If `use_fp`, the floating
+ * point registers are filled before each run and checked afterwards, so that
+ * they are switched on every round trip.
+ */
+static void fp_switch_latency(const char *name, bool use_fp)
+{
+	const double value = 1.5;
+	struct ffa_value run_res;
+	uint64_t start;
+	uint64_t ticks;
+	uint64_t ns;
+	uint32_t i;
+
+	start = read_msr(cntvct_el0);
+	for (i = 0; i < FP_SWITCH_ROUND_TRIPS; i++) {
+		if (use_fp) {
+			fill_fp_registers(value);
+		}
+		run_res = ffa_run(SERVICE_VM1, 0);
+		ASSERT_EQ(run_res.func, FFA_YIELD_32);
+		if (use_fp) {
+			ASSERT_TRUE(check_fp_register(value));
+		}
+	}
+	ticks = read_msr(cntvct_el0) - start;
+
+	ns = ticks * 1000000000 / read_msr(cntfrq_el0) / FP_SWITCH_ROUND_TRIPS;
+	dlog("%s: %lu ns per round trip (%lu ticks for %u).\n", name, ns, ticks,
+	     FP_SWITCH_ROUND_TRIPS);
+}
+
+/**
+ * Benchmark the round trip to a secondary VM which doesn't use the floating
+ * point registers, so they never need to be switched.
+ */
+TEST(floating_point, switch_latency)
+{
+	struct mailbox_buffers mb = set_up_mailbox();
+
+	SERVICE_SELECT(SERVICE_VM1, "fp_switch_latency", mb.send);
+	fp_switch_latency("switch_latency", false);
+}
+
+/**
+ * Benchmark the round trip to a secondary VM when both sides use the floating
+ * point registers, so they are switched both ways every time.
+ */
+TEST(floating_point, switch_latency_fp)
+{
+	struct mailbox_buffers mb = set_up_mailbox();
+
+	SERVICE_SELECT(SERVICE_VM1, "fp_switch_latency_fp", mb.send);
+	fp_switch_latency("switch_latency_fp", true);
+}
@@ -35,3 +35,21 @@ TEST_SERVICE(fp_fpcr)
 	ASSERT_EQ(read_msr(fpcr), value);
 	ffa_yield();
 }
+
+TEST_SERVICE(fp_switch_latency)
+{
+	for (;;) {
+		ffa_yield();
+	}
+}
+
+TEST_SERVICE(fp_switch_latency_fp)
+{
+	const double value = -0.5;
+
+	for (;;) {
+		fill_fp_registers(value);
+		ffa_yield();
+		ASSERT_TRUE(check_fp_register(value));
+	}
+}
@@ -72,3 +72,29 @@ TEST_SERVICE(smp)
 
 	send_message("vCPU 0", sizeof("vCPU 0"));
 }
+
+/**
+ * Entry point of the second vCPU for the `smp_yield` service.
+ */
+static void vm_cpu_entry_yield(uintptr_t arg)
+{
+	ASSERT_EQ(arg, ARG_VALUE);
+
+	for (;;) {
+		ffa_yield();
+	}
+}
+
+/*
+ * Secondary VM that starts a second vCPU and then yields from both, so the
+ * primary can switch between them.
+ */
+TEST_SERVICE(smp_yield)
+{
+	ASSERT_TRUE(hftest_cpu_start(1, stack, sizeof(stack),
+				     vm_cpu_entry_yield, ARG_VALUE));
+
+	for (;;) {
+		ffa_yield();
+	}
+}
@@ -0,0 +1,21 @@
+/*
+ * Copyright 2023 The Hafnium Authors.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+#include "../sysregs.h"
+
+TEST_SERVICE(sysregs_switch_latency)
+{
+	const uintreg_t value = 0x5678;
+
+	write_msr(tpidrro_el0, value);
+
+	for (;;) {
+		ffa_yield();
+		ASSERT_EQ(read_msr(tpidrro_el0), value);
+	}
+}
@@ -66,3 +66,43 @@ TEST(smp, two_vcpus)
 	EXPECT_EQ(run_res.func, HF_FFA_RUN_WAIT_FOR_INTERRUPT);
 	EXPECT_EQ(run_res.arg2, FFA_SLEEP_INDEFINITE);
 }
+
+/**
+ * Switch back and forth between two vCPUs of a VM declaring consistent ASIDs on
+ * the same CPU, and check that Hafnium keeps its TLB entries rather than
+ * invalidating them on each switch.
+ */
+TEST(smp, consistent_asids_tlb_retention)
+{
+	const uint32_t switches = 10;
+	struct ffa_value run_res;
+	struct mailbox_buffers mb = set_up_mailbox();
+	int64_t issued;
+	int64_t skipped;
+	uint32_t i;
+
+	SERVICE_SELECT(SERVICE_VM3, "smp_yield", mb.send);
+
+	/* Let the first vCPU start the second vCPU. */
+	run_res = ffa_run(SERVICE_VM3, 0);
+	EXPECT_EQ(run_res.func, FFA_INTERRUPT_32);
+	EXPECT_EQ(ffa_vm_id(run_res), SERVICE_VM3);
+	EXPECT_EQ(ffa_vcpu_index(run_res), 1);
+
+	issued = hf_vm_tlb_invalidations_get(SERVICE_VM3, false);
+	skipped = hf_vm_tlb_invalidations_get(SERVICE_VM3, true);
+	ASSERT_NE(issued, -1);
+	ASSERT_NE(skipped, -1);
+
+	for (i = 0; i < switches; i++) {
+		run_res = ffa_run(SERVICE_VM3, 1);
+		EXPECT_EQ(run_res.func, FFA_YIELD_32);
+		run_res = ffa_run(SERVICE_VM3, 0);
+		EXPECT_EQ(run_res.func, FFA_YIELD_32);
+	}
+
+	EXPECT_EQ(hf_vm_tlb_invalidations_get(SERVICE_VM3, false), issued);
+	EXPECT_EQ(hf_vm_tlb_invalidations_get(SERVICE_VM3, true),
+		  skipped + 2 * switches);
+	EXPECT_EQ(hf_vm_tlb_invalidations_get(HF_INVALID_VM_ID, true), -1);
+}
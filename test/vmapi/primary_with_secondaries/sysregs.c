@@ -29,3 +29,42 @@ TEST(sysregs, lor_exception)
 
 	EXPECT_EQ(exception_handler_get_num(), 1);
 }
+
+/** Number of round trips to the service timed by the switch latency test. */
+#define SYSREGS_SWITCH_ROUND_TRIPS 1000
+
+/**
+ * Benchmark switching between the primary and a secondary VM, and check that
+ * EL1 registers written by either VM are preserved across the switches.
+ *
+ * The time is measured in generic timer ticks, not CPU cycles, as Hafnium sets
+ * MDCR_EL2.HCCD so the cycle counter doesn't count while at EL2.
+ */
+TEST(sysregs, switch_latency)
+{
+	const uintreg_t value = 0x1234;
+	struct mailbox_buffers mb = set_up_mailbox();
+	struct ffa_value run_res;
+	uint64_t start;
+	uint64_t ticks;
+	uint64_t ns;
+	uint32_t i;
+
+	write_msr(tpidrro_el0, value);
+	SERVICE_SELECT(SERVICE_VM1, "sysregs_switch_latency", mb.send);
+
+	start = read_msr(cntvct_el0);
+	for (i = 0; i < SYSREGS_SWITCH_ROUND_TRIPS; i++) {
+		run_res = ffa_run(SERVICE_VM1, 0);
+		ASSERT_EQ(run_res.func, FFA_YIELD_32);
+	}
+	ticks = read_msr(cntvct_el0) - start;
+
+	EXPECT_EQ(read_msr(tpidrro_el0), value);
+
+	/* Each round trip takes two world switches. */
+	ns = ticks * 1000000000 / read_msr(cntfrq_el0) /
+	     (SYSREGS_SWITCH_ROUND_TRIPS * 2);
+	dlog("switch_latency: %lu ns per world switch (%lu ticks for %u).\n",
+	     ns, ticks, SYSREGS_SWITCH_ROUND_TRIPS * 2);
+}